@@ -0,0 +1,343 @@
+#include <stdio.h>
+#include <string.h>
+#include "Aggregator.h"
+#include "imu/frame/QuatFrame.h"
+#include "osc/OscMessageReader.h"
+#include "osc/OscPacketWriter.h"
+
+namespace host
+{
+
+    static const char *FrameAddr = "/kaitenboh/frame";
+    static const char *DeviceAddr = "/kaitenboh/device";
+    static const char PlaceholderPrefix = '#'; // 名前を知る前にQuatFrameだけを受けた端末
+
+    static uint64_t Endpoint(uint32_t address, uint16_t port)
+    {
+        return (uint64_t)address << 16 | port;
+    }
+
+    DeviceState::DeviceState()
+        : frameDeviceId(0), sourceAddress(0), sourcePort(0), firstSeen(0), lastSeen(0), deviceTimestamp(0), quat(),
+          twistDegree(), twistCount(), poses(0), messages(0), hasSeq(false), lastSeq(0), lostFrames(0),
+          rateHz(0.0F), rateWindowStart(0), rateWindowPoses(0)
+    {
+        quat[0] = 1.0F;
+    }
+
+    Aggregator::Aggregator() : frameSeq(0)
+    {
+        key.reserve(AggregatorMaxIdLen + 1);
+    }
+
+    /**
+     * @brief 受けたUDPパケットを1つ反映する
+     *
+     * @param data OSCメッセージ / バンドル (send_port) か QuatFrame (frame_port)
+     * @param sourceAddress 送信元 (IPv4, ネットワークバイトオーダー)
+     * @param sourcePort 送信元のポート (ネットワークバイトオーダー)
+     * @param nowMicros 受信時刻 (ホストの時計)
+     * @return true 正常終了
+     * @return false 異常終了 どの端末のものでもなかった
+     */
+    bool Aggregator::ingest(const uint8_t *data, size_t len, uint32_t sourceAddress, uint16_t sourcePort, int64_t nowMicros)
+    {
+        counts.packets++;
+        uint64_t endpoint = Endpoint(sourceAddress, sourcePort);
+        if (len == imu::frame::QuatFrameLen && data[0] == imu::frame::QuatFrameMagic)
+            return ingestFrame(data, len, endpoint, nowMicros);
+        if (ingestElement(data, len, endpoint, nowMicros, 0) > 0)
+            return true;
+        counts.malformed++;
+        return false;
+    }
+
+    /**
+     * @brief バンドルを再帰的に開き，含まれるメッセージを反映する
+     *
+     * @return int 反映したメッセージの数
+     */
+    int Aggregator::ingestElement(const uint8_t *data, size_t len, uint64_t endpoint, int64_t nowMicros, int depth)
+    {
+        // バンドル: "#bundle\0" timetag(8byte) { size(4byte) element }*
+        if (len >= 16 && memcmp(data, "#bundle", 8) == 0)
+        {
+            if (depth >= AggregatorMaxBundleDepth)
+                return 0;
+            int handled = 0;
+            size_t pos = 16;
+            while (pos + 4 <= len)
+            {
+                uint32_t size = (uint32_t)data[pos] << 24 | (uint32_t)data[pos + 1] << 16 |
+                                (uint32_t)data[pos + 2] << 8 | (uint32_t)data[pos + 3];
+                pos += 4;
+                if (size > len - pos)
+                    break;
+                handled += ingestElement(data + pos, size, endpoint, nowMicros, depth + 1);
+                pos += size;
+            }
+            return handled;
+        }
+        return ingestMessage(data, len, endpoint, nowMicros) ? 1 : 0;
+    }
+
+    /**
+     * @brief /<uniqueId>/quat, /twist, /imu を状態に反映する．ほかのメッセージは受信の記録だけ行う
+     */
+    bool Aggregator::ingestMessage(const uint8_t *data, size_t len, uint64_t endpoint, int64_t nowMicros)
+    {
+        osc::OscMessageReader m;
+        if (!m.parse(data, len))
+            return false;
+        const char *addr = m.address();
+        const char *suffix = strchr(addr + 1, '/');
+        if (suffix == NULL || suffix == addr + 1 || (size_t)(suffix - addr - 1) > AggregatorMaxIdLen)
+            return false;
+        counts.messages++;
+        DeviceState &state = device(addr + 1, suffix - addr - 1, endpoint, nowMicros);
+        // /stats や /get/filter への返信はコマンドのポートから届くため，送信元を結び付け直さない
+        bool stream = strcmp(suffix, "/quat") == 0 || strcmp(suffix, "/twist") == 0 || strcmp(suffix, "/imu") == 0;
+        touch(state, endpoint, nowMicros, stream);
+
+        const char *tags = m.typeTags();
+        if (strcmp(suffix, "/quat") == 0 && strcmp(tags, "ffff") == 0)
+        {
+            for (int i = 0; i < imu::ImuWxyz; i++)
+                state.quat[i] = m.getFloat(i);
+            countPose(state, nowMicros);
+        }
+        else if (strcmp(suffix, "/twist") == 0 && strcmp(tags, "fffiii") == 0)
+        {
+            for (int i = 0; i < imu::twist::TwistAxisNum; i++)
+            {
+                state.twistDegree[i] = m.getFloat(i);
+                state.twistCount[i] = m.getInt32(imu::twist::TwistAxisNum + i);
+            }
+        }
+        else if (strcmp(suffix, "/imu") == 0 && strcmp(tags, "iffffffffff") == 0)
+        {
+            // timestamp, acc[3], gyro[3], quat[4]
+            state.deviceTimestamp = (uint32_t)m.getInt32(0);
+            for (int i = 0; i < imu::ImuWxyz; i++)
+                state.quat[i] = m.getFloat(1 + imu::ImuXyz * 2 + i);
+            countPose(state, nowMicros);
+        }
+        return true;
+    }
+
+    /**
+     * @brief QuatFrameを反映する．seqの抜けを欠落として数える
+     * @brief 送信元が同じ名前付きのOSCを受けていればその端末に，まだなら仮の名前の端末に反映する
+     */
+    bool Aggregator::ingestFrame(const uint8_t *data, size_t len, uint64_t endpoint, int64_t nowMicros)
+    {
+        imu::frame::QuatFrame frame;
+        if (!imu::frame::DecodeFrame(data, len, frame))
+        {
+            counts.malformed++;
+            return false;
+        }
+        counts.frames++;
+        DeviceState *state;
+        std::unordered_map<uint64_t, size_t>::iterator it = byEndpoint.find(endpoint);
+        if (it != byEndpoint.end())
+        {
+            state = &states[it->second];
+        }
+        else
+        {
+            // 名前付きのメッセージ (/twist など) が届いたら本来の名前に付け替える
+            char placeholder[8];
+            snprintf(placeholder, sizeof(placeholder), "%c%04x", PlaceholderPrefix, frame.deviceId);
+            state = &device(placeholder, strlen(placeholder), endpoint, nowMicros);
+            state->frameDeviceId = frame.deviceId;
+        }
+        touch(*state, endpoint, nowMicros, true);
+
+        // seqは16bitで折り返す．差分が1より大きければその分を欠落として数える (Host/QuatFrameReceiver と同じ)
+        if (state->hasSeq)
+        {
+            uint16_t gap = (uint16_t)(frame.seq - state->lastSeq);
+            if (gap > 1 && gap < 0x8000)
+                state->lostFrames += gap - 1;
+        }
+        state->hasSeq = true;
+        state->lastSeq = frame.seq;
+        state->deviceTimestamp = frame.timestamp;
+        for (int i = 0; i < imu::ImuWxyz; i++)
+            state->quat[i] = frame.quat[i];
+        countPose(*state, nowMicros);
+        return true;
+    }
+
+    /**
+     * @brief 名前から端末の状態を探す．なければ作る
+     * @brief 同じ送信元の仮の名前の端末があれば，それを名前付きの端末にする
+     */
+    DeviceState &Aggregator::device(const char *id, size_t idLen, uint64_t endpoint, int64_t nowMicros)
+    {
+        key.assign(id, idLen);
+        std::unordered_map<std::string, size_t>::iterator it = byId.find(key);
+        if (it != byId.end())
+            return states[it->second];
+
+        std::unordered_map<uint64_t, size_t>::iterator endpointIt = byEndpoint.find(endpoint);
+        if (key[0] != PlaceholderPrefix && endpointIt != byEndpoint.end() &&
+            states[endpointIt->second].uniqueId[0] == PlaceholderPrefix)
+        {
+            DeviceState &state = states[endpointIt->second];
+            byId.erase(state.uniqueId);
+            state.uniqueId = key;
+            state.frameDeviceId = imu::frame::DeviceIdFromName(key.c_str());
+            byId[key] = endpointIt->second;
+            return state;
+        }
+
+        DeviceState state;
+        state.uniqueId = key;
+        state.frameDeviceId = imu::frame::DeviceIdFromName(key.c_str());
+        state.firstSeen = nowMicros;
+        state.rateWindowStart = nowMicros;
+        states.push_back(state);
+        byId[key] = states.size() - 1;
+        return states.back();
+    }
+
+    /**
+     * @brief 受信を記録し，送信元を端末に結び付ける (QuatFrameの振り分けに使う)
+     *
+     * @param bind true: 周期送信と同じソケットから届いたもの (/quat, /twist, /imu, QuatFrame)．送信元を結び付け直す
+     */
+    void Aggregator::touch(DeviceState &state, uint64_t endpoint, int64_t nowMicros, bool bind)
+    {
+        uint32_t address = (uint32_t)(endpoint >> 16);
+        uint16_t port = (uint16_t)endpoint;
+        if (bind && (state.sourceAddress != address || state.sourcePort != port))
+        {
+            std::unordered_map<uint64_t, size_t>::iterator it = byEndpoint.find(Endpoint(state.sourceAddress, state.sourcePort));
+            if (it != byEndpoint.end() && &states[it->second] == &state)
+                byEndpoint.erase(it);
+            state.sourceAddress = address;
+            state.sourcePort = port;
+            byEndpoint[endpoint] = (size_t)(&state - &states[0]);
+        }
+        state.lastSeen = nowMicros;
+        state.messages++;
+    }
+
+    /**
+     * @brief 姿勢を1つ受けたことを記録し，窓が終わっていれば受信レートを更新する
+     */
+    void Aggregator::countPose(DeviceState &state, int64_t nowMicros)
+    {
+        state.poses++;
+        state.rateWindowPoses++;
+        int64_t elapsed = nowMicros - state.rateWindowStart;
+        if (elapsed >= AggregatorRateWindowMicros)
+        {
+            state.rateHz = (float)(state.rateWindowPoses * 1e6 / (double)elapsed);
+            state.rateWindowStart = nowMicros;
+            state.rateWindowPoses = 0;
+        }
+    }
+
+    /**
+     * @brief 全端末の状態フレームを作り，バンドル毎に sink へ渡す
+     *
+     * @param buffer エンコードに使うバッファ．capacity が1パケットの上限になる
+     * @return int 作ったパケットの数
+     */
+    int Aggregator::publish(int64_t nowMicros, uint8_t *buffer, size_t capacity, const PacketSink &sink)
+    {
+        osc::OscPacketWriter writer(buffer, capacity);
+        size_t next = 0;
+        int packets = 0;
+        do
+        {
+            writer.beginBundle();
+            writer.beginMessage(FrameAddr, ",iii");
+            writer.writeInt32((int32_t)frameSeq);
+            writer.writeInt32((int32_t)states.size());
+            writer.writeInt32((int32_t)next);
+            if (!writer.endMessage())
+                return packets;
+            size_t first = next;
+            while (next < states.size())
+            {
+                const DeviceState &state = states[next];
+                // 送らなくなった端末は窓が終わらないため，経過時間で割って下げていく
+                float rate = state.rateHz;
+                int64_t elapsed = nowMicros - state.rateWindowStart;
+                if (elapsed > AggregatorRateWindowMicros * 2)
+                    rate = (float)(state.rateWindowPoses * 1e6 / (double)elapsed);
+                writer.beginMessage(DeviceAddr, ",siffffffffiiii");
+                writer.writeString(state.uniqueId.c_str());
+                writer.writeInt32((int32_t)((nowMicros - state.lastSeen) / 1000));
+                writer.writeFloat(rate);
+                for (int i = 0; i < imu::ImuWxyz; i++)
+                    writer.writeFloat(state.quat[i]);
+                for (int i = 0; i < imu::twist::TwistAxisNum; i++)
+                    writer.writeFloat(state.twistDegree[i]);
+                for (int i = 0; i < imu::twist::TwistAxisNum; i++)
+                    writer.writeInt32(state.twistCount[i]);
+                writer.writeInt32((int32_t)state.lostFrames);
+                if (!writer.endMessage())
+                {
+                    writer.discardMessage();
+                    break;
+                }
+                next++;
+            }
+            if (next == first && next < states.size())
+                next++; // 1端末分も収まらない大きさ (capacity が小さすぎる) は飛ばす
+            sink(writer.data(), writer.size());
+            packets++;
+        } while (next < states.size());
+        frameSeq++;
+        counts.published += packets;
+        return packets;
+    }
+
+    /**
+     * @brief 一定時間受信のない端末を消す
+     *
+     * @return int 消した端末の数
+     */
+    int Aggregator::expire(int64_t nowMicros, int64_t timeoutMicros)
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < states.size(); i++)
+        {
+            if (nowMicros - states[i].lastSeen > timeoutMicros)
+                continue;
+            if (kept != i)
+                states[kept] = states[i];
+            kept++;
+        }
+        int removed = (int)(states.size() - kept);
+        if (removed > 0)
+        {
+            states.resize(kept);
+            rebuildIndex();
+        }
+        return removed;
+    }
+
+    const DeviceState *Aggregator::find(const char *uniqueId) const
+    {
+        std::unordered_map<std::string, size_t>::const_iterator it = byId.find(uniqueId);
+        return (it != byId.end()) ? &states[it->second] : NULL;
+    }
+
+    void Aggregator::rebuildIndex()
+    {
+        byId.clear();
+        byEndpoint.clear();
+        for (size_t i = 0; i < states.size(); i++)
+        {
+            byId[states[i].uniqueId] = i;
+            byEndpoint[Endpoint(states[i].sourceAddress, states[i].sourcePort)] = i;
+        }
+    }
+
+} // host
@@ -0,0 +1,98 @@
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "imu/ImuData.h"
+#include "imu/twist/Twist.h"
+
+namespace host
+{
+
+    static const size_t AggregatorMaxIdLen = 31;               // main.cpp の StreamConfig::uniqueId に合わせる
+    static const int64_t AggregatorRateWindowMicros = 1000000; // 受信レートを数える窓の長さ[us]
+    static const int AggregatorMaxBundleDepth = 4;
+
+    /**
+     * @brief 1本分の最新の状態
+     */
+    struct DeviceState
+    {
+        std::string uniqueId;
+        uint16_t frameDeviceId;   // imu::frame::DeviceIdFromName(uniqueId)
+        uint32_t sourceAddress;   // 最後に受けた周期送信の送信元 (IPv4, ネットワークバイトオーダー)
+        uint16_t sourcePort;      // (ネットワークバイトオーダー)
+        int64_t firstSeen;        // [us] ホストの時計
+        int64_t lastSeen;         // [us]
+        uint32_t deviceTimestamp; // [us] デバイスの micros() (/imu か QuatFrame のもの．0: 未受信)
+        float quat[imu::ImuWxyz]; // w, x, y, z
+        float twistDegree[imu::twist::TwistAxisNum];
+        int32_t twistCount[imu::twist::TwistAxisNum];
+        uint32_t poses;           // 受けた姿勢の数 (/quat, /imu, QuatFrame)
+        uint32_t messages;        // 受けたメッセージの数 (種類を問わない)
+        bool hasSeq;              // QuatFrameを受けた
+        uint16_t lastSeq;
+        uint32_t lostFrames;      // QuatFrameのseqの抜けから数えた欠落
+        float rateHz;             // 直近の窓での姿勢の受信レート
+        int64_t rateWindowStart;  // [us]
+        uint32_t rateWindowPoses;
+
+        explicit DeviceState();
+    };
+
+    /**
+     * @brief 受信の統計 (全端末の合計)
+     */
+    struct AggregatorCounters
+    {
+        uint64_t packets;   // 受けたUDPパケット
+        uint64_t messages;  // 解析したOSCメッセージ
+        uint64_t frames;    // QuatFrame
+        uint64_t malformed; // OSCでもQuatFrameでもない，または端末を特定できないもの
+        uint64_t published; // 送った状態フレームのパケット
+
+        explicit AggregatorCounters() : packets(0), messages(0), frames(0), malformed(0), published(0) {}
+    };
+
+    /**
+     * @brief 複数の端末から届く /<uniqueId>/... のOSCとQuatFrameを端末毎の状態にまとめ，
+     * @brief 一定周期で全端末分の状態フレームを作る．ソケットを持たないため，パケットを直接与えて確かめられる
+     * @brief QuatFrameの deviceId は16bitのハッシュで名前が衝突しうるため，同じ送信元から届いた名前付きのOSCで端末を決める
+     * @brief 状態フレーム (OSCバンドル．MTUを超える分は続くバンドルに分ける):
+     *        /kaitenboh/frame ,iii (フレーム番号, 端末数, このバンドルの最初の端末の番号)
+     *        /kaitenboh/device ,siffffffffiiii 端末毎に1つ (uniqueId, 最後の受信からの時間[ms], 受信レート[Hz],
+     *        quat w x y z, ねじれ角 x y z[deg], 回転数 x y z, 欠落したQuatFrameの数)
+     */
+    class Aggregator
+    {
+    public:
+        typedef std::function<void(const uint8_t *data, size_t len)> PacketSink;
+
+        explicit Aggregator();
+        bool ingest(const uint8_t *data, size_t len, uint32_t sourceAddress, uint16_t sourcePort, int64_t nowMicros);
+        int publish(int64_t nowMicros, uint8_t *buffer, size_t capacity, const PacketSink &sink);
+        int expire(int64_t nowMicros, int64_t timeoutMicros);
+        const std::vector<DeviceState> &devices() const { return states; }
+        const DeviceState *find(const char *uniqueId) const;
+        const AggregatorCounters &counters() const { return counts; }
+
+    private:
+        std::vector<DeviceState> states;
+        std::unordered_map<std::string, size_t> byId;
+        std::unordered_map<uint64_t, size_t> byEndpoint; // 送信元 (アドレス, ポート) -> states の添字
+        std::string key; // 探索用．毎回確保し直さないよう使い回す
+        AggregatorCounters counts;
+        uint32_t frameSeq;
+
+        int ingestElement(const uint8_t *data, size_t len, uint64_t endpoint, int64_t nowMicros, int depth);
+        bool ingestMessage(const uint8_t *data, size_t len, uint64_t endpoint, int64_t nowMicros);
+        bool ingestFrame(const uint8_t *data, size_t len, uint64_t endpoint, int64_t nowMicros);
+        DeviceState &device(const char *id, size_t idLen, uint64_t endpoint, int64_t nowMicros);
+        void touch(DeviceState &state, uint64_t endpoint, int64_t nowMicros, bool bind);
+        void countPose(DeviceState &state, int64_t nowMicros);
+        void rebuildIndex();
+    };
+
+} // host
@@ -0,0 +1,690 @@
+// 複数のKaitenBohから send_port (OSC) と frame_port (QuatFrame) に届くパケットを1つのepollループで受け，
+// 端末毎の状態 (姿勢 / ねじれ角 / 受信レート / 欠落) にまとめて一定周期でローカルの受け手へ送り直すデーモン
+// 状態フレームの形式は Aggregator.h を参照．受け手はUDPで /kaitenboh/frame, /kaitenboh/device を受ければよい
+//
+// build:
+//   S=../../PlatformIO/src
+//   c++ -std=c++11 -O2 -pthread -I$S main.cpp Aggregator.cpp $S/osc/OscMessageReader.cpp
+//       $S/osc/OscPacketWriter.cpp $S/imu/frame/QuatFrame.cpp -o kaitenboh_aggregator
+// usage:
+//   ./kaitenboh_aggregator [options]
+//     --port <n>          OSCの受信ポート (default: 33333 = send_port)
+//     --frame-port <n>    QuatFrameの受信ポート (default: 33334 = frame_port, 0: 受けない)
+//     --publish <ip:port> 状態フレームの送り先．複数指定できる (default: 127.0.0.1:33340)
+//     --rate <hz>         状態フレームの送信レート (default: 60)
+//     --expire <s>        この時間受信のない端末を消す (default: 10)
+//     --stats <s>         受信数とパケット当たりのCPU時間を標準エラーへ出す間隔 (default: 5, 0: 出さない)
+//   ./kaitenboh_aggregator --loadtest <devices> [--seconds <s>] [options]
+//     localhostから <devices> 本分のパケットを送り，全端末の状態とレート，欠落の数，送り直したフレームを確かめる
+//     奇数番目の端末は QuatFrame (100Hz) + /twist (30Hz)，偶数番目は /quat + /twist (30Hz) を送る
+//     全ての端末は別のソケット (コマンドのポートの代わり) から /stats の返信 (2Hz) も送る
+//     終了コード 0: 全て期待どおり, 1: 失敗あり
+//   Unityのシーンと同じ send_port を使うため，同じPCではどちらか一方だけが受ける
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Aggregator.h"
+#include "imu/frame/QuatFrame.h"
+#include "osc/OscMessageReader.h"
+#include "osc/OscPacketWriter.h"
+
+namespace
+{
+    const uint16_t OscPort = 33333;         // main.cpp の send_port
+    const uint16_t FramePort = 33334;       // main.cpp の frame_port
+    const uint16_t PublishPort = 33340;     // 状態フレームの既定の送り先
+    const int RecvBatch = 64;               // recvmmsg 1回で受けるパケット数
+    const size_t RecvBufferLen = 2048;      // 端末は OscPacketMaxLen (1472byte) までしか送らない
+    const int SocketBufferBytes = 4 << 20;  // 50本 x 200パケット/秒の揺らぎを吸収する
+    const int LoadPoseHz = 30;              // /quat, /twist の送信レート (TASK_SLEEP_SEND_OSC)
+    const int LoadFrameHz = 100;            // QuatFrameの送信レート
+    const int LoadSkipEvery = 50;           // QuatFrameのseqをこの数毎に1つ飛ばし，欠落として数えられるか確かめる
+    const int LoadReplyHz = 2;              // コマンドのポートから返る /stats の頻度 (送信元を結び付け直さないか確かめる)
+    const int64_t LoadDrainMicros = 300000; // 送信を止めてから受信を続ける時間[us]
+
+    struct Options
+    {
+        uint16_t oscPort;
+        uint16_t framePort;
+        std::vector<sockaddr_in> publish;
+        int rateHz;
+        double expireSeconds;
+        double statsSeconds;
+        int loadDevices; // 0: デーモンとして動く
+        double loadSeconds;
+    };
+
+    /**
+     * @brief ループが使ったCPU時間の内訳
+     */
+    struct LoopStats
+    {
+        uint64_t packets;
+        uint64_t batches;
+        int64_t recvNanos;   // recvmmsg に使ったスレッドのCPU時間
+        int64_t ingestNanos; // Aggregator::ingest に使ったスレッドのCPU時間
+        int64_t startNanos;  // ループ開始時のスレッドのCPU時間
+        int64_t startMicros;
+
+        explicit LoopStats() : packets(0), batches(0), recvNanos(0), ingestNanos(0), startNanos(0), startMicros(0) {}
+    };
+
+    int64_t NowMicros()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    int64_t ThreadCpuNanos()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    }
+
+    bool ParseEndpoint(const char *text, sockaddr_in &out)
+    {
+        std::string s(text);
+        size_t colon = s.rfind(':');
+        if (colon == std::string::npos)
+            return false;
+        out = sockaddr_in();
+        out.sin_family = AF_INET;
+        out.sin_port = htons((uint16_t)atoi(s.c_str() + colon + 1));
+        return out.sin_port != 0 && inet_pton(AF_INET, s.substr(0, colon).c_str(), &out.sin_addr) == 1;
+    }
+
+    /**
+     * @brief 受信用のノンブロッキングUDPソケットを開く
+     *
+     * @param address バインドするアドレス (ホストバイトオーダー)
+     * @return int ソケット．失敗したときは-1
+     */
+    int OpenUdp(uint32_t address, uint16_t port)
+    {
+        int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            perror("socket");
+            return -1;
+        }
+        int size = SocketBufferBytes;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(address);
+        addr.sin_port = htons(port);
+        if (bind(fd, (sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            fprintf(stderr, "bind %u: %s\n", port, strerror(errno));
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    int OpenTimer(int64_t periodMicros)
+    {
+        int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (fd < 0)
+            return -1;
+        itimerspec spec = {};
+        spec.it_interval.tv_sec = periodMicros / 1000000;
+        spec.it_interval.tv_nsec = (periodMicros % 1000000) * 1000;
+        spec.it_value = spec.it_interval;
+        timerfd_settime(fd, 0, &spec, NULL);
+        return fd;
+    }
+
+    /**
+     * @brief recvmmsg で受けられるだけ受け，Aggregatorへ渡す
+     */
+    class Receiver
+    {
+    public:
+        explicit Receiver() : buffers(RecvBatch * RecvBufferLen)
+        {
+            for (int i = 0; i < RecvBatch; i++)
+            {
+                iov[i].iov_base = &buffers[i * RecvBufferLen];
+                iov[i].iov_len = RecvBufferLen;
+            }
+        }
+
+        void drain(int fd, host::Aggregator &aggregator, LoopStats &stats)
+        {
+            while (true)
+            {
+                for (int i = 0; i < RecvBatch; i++)
+                {
+                    msgs[i].msg_hdr = msghdr();
+                    msgs[i].msg_hdr.msg_iov = &iov[i];
+                    msgs[i].msg_hdr.msg_iovlen = 1;
+                    msgs[i].msg_hdr.msg_name = &from[i];
+                    msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+                }
+                int64_t c0 = ThreadCpuNanos();
+                int n = recvmmsg(fd, msgs, RecvBatch, MSG_DONTWAIT, NULL);
+                int64_t c1 = ThreadCpuNanos();
+                stats.recvNanos += c1 - c0;
+                if (n <= 0)
+                    return; // EAGAIN: 受け切った
+                // 時計は1回だけ読む．同じ回に受けたパケットは同時刻とみなす
+                int64_t now = NowMicros();
+                for (int i = 0; i < n; i++)
+                    aggregator.ingest(&buffers[i * RecvBufferLen], msgs[i].msg_len, from[i].sin_addr.s_addr, from[i].sin_port,
+                                      now);
+                stats.ingestNanos += ThreadCpuNanos() - c1;
+                stats.packets += n;
+                stats.batches++;
+                if (n < RecvBatch)
+                    return;
+            }
+        }
+
+    private:
+        std::vector<uint8_t> buffers;
+        iovec iov[RecvBatch];
+        mmsghdr msgs[RecvBatch];
+        sockaddr_in from[RecvBatch];
+    };
+
+    void PrintStats(const host::Aggregator &aggregator, const LoopStats &stats, const LoopStats &last,
+                    uint64_t lastPublished, int64_t lastCpuNanos, int64_t lastMicros)
+    {
+        int64_t now = NowMicros();
+        int64_t cpu = ThreadCpuNanos();
+        double seconds = (now - lastMicros) * 1e-6;
+        uint64_t packets = stats.packets - last.packets;
+        double perPacket = (packets > 0) ? 1e-3 / packets : 0.0;
+        fprintf(stderr, "devices %zu  rx %.0f pkt/s  malformed %llu  published %.0f pkt/s  "
+                        "cpu/pkt %.2f us (recv %.2f, parse %.2f)  loop cpu %.1f%%\n",
+                aggregator.devices().size(), packets / seconds,
+                (unsigned long long)aggregator.counters().malformed,
+                (aggregator.counters().published - lastPublished) / seconds,
+                (cpu - lastCpuNanos) * perPacket,
+                (stats.recvNanos - last.recvNanos) * perPacket,
+                (stats.ingestNanos - last.ingestNanos) * perPacket,
+                100.0 * (cpu - lastCpuNanos) * 1e-3 / (now - lastMicros));
+    }
+
+    /**
+     * @brief epollのループ．シグナル (SIGINT/SIGTERM) を受けるか untilMicros を過ぎると戻る
+     *
+     * @param untilMicros 0: シグナルを受けるまで動く
+     * @param onReady ソケットを開いた後，受信を始める前に呼ぶ
+     * @return int 0: 正常終了, 1: 異常終了
+     */
+    int RunLoop(const Options &options, host::Aggregator &aggregator, LoopStats &stats, int64_t untilMicros,
+                const std::function<void()> &onReady)
+    {
+        int oscFd = OpenUdp(INADDR_ANY, options.oscPort);
+        int frameFd = (options.framePort != 0) ? OpenUdp(INADDR_ANY, options.framePort) : -1;
+        int publishFd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        int publishTimer = OpenTimer(1000000 / options.rateHz);
+        int statsTimer = (options.statsSeconds > 0.0) ? OpenTimer((int64_t)(options.statsSeconds * 1e6)) : -1;
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        sigprocmask(SIG_BLOCK, &signals, NULL);
+        int signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+        int epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (oscFd < 0 || (options.framePort != 0 && frameFd < 0) || publishFd < 0 || publishTimer < 0 || epollFd < 0)
+            return 1;
+
+        int fds[] = {oscFd, frameFd, publishTimer, statsTimer, signalFd};
+        for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++)
+        {
+            if (fds[i] < 0)
+                continue;
+            epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.fd = fds[i];
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, fds[i], &ev);
+        }
+
+        Receiver receiver;
+        std::vector<uint8_t> frame(osc::OscPacketMaxLen);
+        host::Aggregator::PacketSink sink = [&](const uint8_t *data, size_t len)
+        {
+            for (size_t i = 0; i < options.publish.size(); i++)
+                sendto(publishFd, data, len, MSG_DONTWAIT, (const sockaddr *)&options.publish[i], sizeof(options.publish[i]));
+        };
+        int64_t expireMicros = (int64_t)(options.expireSeconds * 1e6);
+        if (onReady)
+            onReady();
+        stats.startNanos = ThreadCpuNanos();
+        stats.startMicros = NowMicros();
+        LoopStats last = stats;
+        uint64_t lastPublished = 0;
+        int64_t lastCpuNanos = stats.startNanos;
+        int64_t lastMicros = stats.startMicros;
+
+        bool running = true;
+        while (running)
+        {
+            int timeoutMs = -1;
+            if (untilMicros != 0)
+            {
+                int64_t remaining = untilMicros - NowMicros();
+                if (remaining <= 0)
+                    break;
+                timeoutMs = (int)(remaining / 1000) + 1;
+            }
+            epoll_event events[8];
+            int n = epoll_wait(epollFd, events, 8, timeoutMs);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                perror("epoll_wait");
+                break;
+            }
+            for (int i = 0; i < n; i++)
+            {
+                int fd = events[i].data.fd;
+                uint64_t expirations;
+                if (fd == oscFd || fd == frameFd)
+                {
+                    receiver.drain(fd, aggregator, stats);
+                }
+                else if (fd == publishTimer)
+                {
+                    // 遅れて複数回分溜まっても1回だけ送る (受け手には最新の状態だけが要る)
+                    if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+                        continue;
+                    int64_t now = NowMicros();
+                    aggregator.expire(now, expireMicros);
+                    aggregator.publish(now, frame.data(), frame.size(), sink);
+                }
+                else if (fd == statsTimer)
+                {
+                    if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+                        continue;
+                    PrintStats(aggregator, stats, last, lastPublished, lastCpuNanos, lastMicros);
+                    last = stats;
+                    lastPublished = aggregator.counters().published;
+                    lastCpuNanos = ThreadCpuNanos();
+                    lastMicros = NowMicros();
+                }
+                else if (fd == signalFd)
+                {
+                    running = false;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++)
+        {
+            if (fds[i] >= 0)
+                close(fds[i]);
+        }
+        close(publishFd);
+        close(epollFd);
+        return 0;
+    }
+
+    /**
+     * @brief 負荷試験で送った内容と，受け手として受けた状態フレームの集計
+     */
+    struct LoadResult
+    {
+        std::vector<std::string> names;
+        std::vector<int> expectedLost;
+        std::vector<float> lastTwist; // 端末毎のZ軸のねじれ角
+        uint64_t sent;
+        uint32_t consumerFrames; // 受けた状態フレームの数 (フレーム番号の種類)
+        int maxDevicesInFrame;   // 1フレームで受けた端末数の最大
+        int32_t lastFrameSeq;
+        int devicesInFrame;
+
+        explicit LoadResult() : sent(0), consumerFrames(0), maxDevicesInFrame(0), lastFrameSeq(-1), devicesInFrame(0) {}
+    };
+
+    void SendTo(int fd, const uint8_t *data, size_t len, uint16_t port)
+    {
+        sockaddr_in to = {};
+        to.sin_family = AF_INET;
+        to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        to.sin_port = htons(port);
+        sendto(fd, data, len, 0, (const sockaddr *)&to, sizeof(to));
+    }
+
+    /**
+     * @brief 受け手として状態フレームを読み，フレーム数と1フレームに揃った端末数を数える
+     */
+    void ConsumeFrames(int fd, LoadResult &result)
+    {
+        uint8_t buffer[RecvBufferLen];
+        while (true)
+        {
+            ssize_t len = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (len < 16 || memcmp(buffer, "#bundle", 8) != 0)
+                return;
+            size_t pos = 16;
+            while (pos + 4 <= (size_t)len)
+            {
+                uint32_t size = (uint32_t)buffer[pos] << 24 | (uint32_t)buffer[pos + 1] << 16 |
+                                (uint32_t)buffer[pos + 2] << 8 | (uint32_t)buffer[pos + 3];
+                pos += 4;
+                if (size > (size_t)len - pos)
+                    break;
+                osc::OscMessageReader m;
+                if (m.parse(buffer + pos, size))
+                {
+                    if (strcmp(m.address(), "/kaitenboh/frame") == 0)
+                    {
+                        int32_t seq = m.getInt32(0);
+                        if (seq != result.lastFrameSeq)
+                        {
+                            result.consumerFrames++;
+                            result.lastFrameSeq = seq;
+                            result.devicesInFrame = 0;
+                        }
+                    }
+                    else if (strcmp(m.address(), "/kaitenboh/device") == 0)
+                    {
+                        result.devicesInFrame++;
+                        if (result.devicesInFrame > result.maxDevicesInFrame)
+                            result.maxDevicesInFrame = result.devicesInFrame;
+                    }
+                }
+                pos += size;
+            }
+        }
+    }
+
+    /**
+     * @brief 端末の代わりにlocalhostへパケットを送る．untilMicros まで送り続ける
+     * @brief 端末と同じく，1本毎に1つのソケットからOSCとQuatFrameを送り，/stats の返信は別のソケットから送る
+     */
+    void GenerateLoad(const Options &options, int consumerFd, int64_t untilMicros, LoadResult &result)
+    {
+        int devices = options.loadDevices;
+        std::vector<int> fds(devices);
+        std::vector<int> commandFds(devices); // 端末の bind_port の代わり
+        for (int d = 0; d < devices; d++)
+        {
+            fds[d] = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+            commandFds[d] = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        }
+        std::vector<int64_t> nextPose(devices);
+        std::vector<int64_t> nextFrame(devices);
+        std::vector<int64_t> nextReply(devices);
+        std::vector<uint16_t> seq(devices, 0);
+        std::vector<uint32_t> frames(devices, 0);
+        std::vector<int> poses(devices, 0);
+        result.expectedLost.assign(devices, 0);
+        result.lastTwist.assign(devices, 0.0F);
+        int64_t start = NowMicros();
+        for (int d = 0; d < devices; d++)
+        {
+            char name[32];
+            snprintf(name, sizeof(name), "stick%03d", d);
+            result.names.push_back(name);
+            // 端末毎に送る時刻をずらす
+            nextPose[d] = start + (int64_t)d * 1000000 / LoadPoseHz / devices;
+            nextFrame[d] = start + (int64_t)d * 1000000 / LoadFrameHz / devices;
+            nextReply[d] = start + (int64_t)d * 1000000 / LoadReplyHz / devices;
+        }
+
+        uint8_t packet[osc::OscPacketMaxLen];
+        std::string addr;
+        while (true)
+        {
+            int64_t now = NowMicros();
+            if (now >= untilMicros)
+                break;
+            for (int d = 0; d < devices; d++)
+            {
+                bool frameMode = (d % 2) == 1;
+                float angle = (float)((now - start) * 1e-6 * (90.0 + d)); // 端末毎に回転の速さを変える[deg]
+                float half = angle * 0.5F * 3.14159265F / 180.0F;
+                while (nextPose[d] <= now)
+                {
+                    osc::OscPacketWriter writer(packet, sizeof(packet));
+                    if (!frameMode)
+                    {
+                        addr = "/" + result.names[d] + "/quat";
+                        writer.beginMessage(addr.c_str(), ",ffff");
+                        writer.writeFloat(cosf(half));
+                        writer.writeFloat(0.0F);
+                        writer.writeFloat(0.0F);
+                        writer.writeFloat(sinf(half));
+                        writer.endMessage();
+                        SendTo(fds[d], writer.data(), writer.size(), options.oscPort);
+                        result.sent++;
+                    }
+                    addr = "/" + result.names[d] + "/twist";
+                    writer.beginMessage(addr.c_str(), ",fffiii");
+                    writer.writeFloat(0.0F);
+                    writer.writeFloat(0.0F);
+                    writer.writeFloat(angle);
+                    writer.writeInt32(0);
+                    writer.writeInt32(0);
+                    writer.writeInt32((int32_t)(angle / 360.0F));
+                    writer.endMessage();
+                    SendTo(fds[d], writer.data(), writer.size(), options.oscPort);
+                    result.sent++;
+                    result.lastTwist[d] = angle;
+                    poses[d]++;
+                    nextPose[d] += 1000000 / LoadPoseHz;
+                }
+                while (frameMode && options.framePort != 0 && nextFrame[d] <= now)
+                {
+                    if (++frames[d] % LoadSkipEvery == 0)
+                    {
+                        seq[d]++;
+                        result.expectedLost[d]++;
+                    }
+                    imu::ImuData imuData;
+                    imuData.timestamp = (uint32_t)(now - start);
+                    imuData.quat[0] = cosf(half);
+                    imuData.quat[3] = sinf(half);
+                    uint8_t frame[imu::frame::QuatFrameLen];
+                    size_t len = imu::frame::EncodeFrame(imuData, imu::frame::DeviceIdFromName(result.names[d].c_str()),
+                                                         seq[d]++, frame);
+                    SendTo(fds[d], frame, len, options.framePort);
+                    result.sent++;
+                    nextFrame[d] += 1000000 / LoadFrameHz;
+                }
+                while (nextReply[d] <= now)
+                {
+                    osc::OscPacketWriter writer(packet, sizeof(packet));
+                    addr = "/" + result.names[d] + "/stats";
+                    writer.beginMessage(addr.c_str(), ",siffff");
+                    writer.writeString("imu");
+                    writer.writeInt32(poses[d]);
+                    for (int i = 0; i < 4; i++)
+                        writer.writeFloat(100.0F * (i + 1));
+                    writer.endMessage();
+                    SendTo(commandFds[d], writer.data(), writer.size(), options.oscPort);
+                    result.sent++;
+                    nextReply[d] += 1000000 / LoadReplyHz;
+                }
+            }
+            ConsumeFrames(consumerFd, result);
+            usleep(500);
+        }
+        ConsumeFrames(consumerFd, result);
+        for (int d = 0; d < devices; d++)
+        {
+            close(fds[d]);
+            close(commandFds[d]);
+        }
+    }
+
+    int failures = 0;
+
+    void Check(bool condition, const char *what)
+    {
+        printf("%s: %s\n", condition ? "ok" : "NG", what);
+        if (!condition)
+            failures++;
+    }
+
+    /**
+     * @brief localhostのパケットだけで受信 / 集約 / 送り直しを確かめ，パケット当たりのCPU時間を示す
+     */
+    int RunLoadTest(Options options)
+    {
+        int consumerFd = OpenUdp(INADDR_LOOPBACK, 0);
+        if (consumerFd < 0)
+            return 1;
+        sockaddr_in consumer = {};
+        socklen_t consumerLen = sizeof(consumer);
+        getsockname(consumerFd, (sockaddr *)&consumer, &consumerLen);
+        options.publish.push_back(consumer);
+
+        host::Aggregator aggregator;
+        LoopStats stats;
+        LoadResult result;
+        int64_t sendUntil = NowMicros() + (int64_t)(options.loadSeconds * 1e6);
+        std::thread sender;
+        // 受信ポートを開く前に送ると捨てられるため，ループの準備ができてから送り始める
+        int rc = RunLoop(options, aggregator, stats, sendUntil + LoadDrainMicros,
+                         [&]()
+                         { sender = std::thread(GenerateLoad, std::cref(options), consumerFd, sendUntil, std::ref(result)); });
+        if (sender.joinable())
+            sender.join();
+        close(consumerFd);
+        if (rc != 0)
+            return rc;
+
+        int64_t cpuNanos = ThreadCpuNanos() - stats.startNanos;
+        double seconds = (NowMicros() - stats.startMicros) * 1e-6;
+        int devices = options.loadDevices;
+        printf("%d devices, %.1f s: sent %llu, received %llu packets (%.0f pkt/s), published %llu\n", devices,
+               options.loadSeconds, (unsigned long long)result.sent, (unsigned long long)stats.packets,
+               stats.packets / seconds, (unsigned long long)aggregator.counters().published);
+        double perPacket = (stats.packets > 0) ? 1e-3 / stats.packets : 0.0;
+        printf("    cpu per packet: %.2f us all-in (recvmmsg %.2f us, parse+update %.2f us), loop cpu %.1f%%, "
+               "%.1f packets per recvmmsg\n",
+               cpuNanos * perPacket, stats.recvNanos * perPacket, stats.ingestNanos * perPacket,
+               100.0 * cpuNanos * 1e-9 / seconds, stats.batches > 0 ? (double)stats.packets / stats.batches : 0.0);
+
+        Check(stats.packets == result.sent, "every packet received");
+        Check(aggregator.counters().malformed == 0, "no malformed packets");
+        Check((int)aggregator.devices().size() == devices,
+              "one state per device (frames merged by name, /stats replies from the command port do not split it)");
+        int rateErrors = 0;
+        int lostErrors = 0;
+        int twistErrors = 0;
+        for (int d = 0; d < devices; d++)
+        {
+            const host::DeviceState *state = aggregator.find(result.names[d].c_str());
+            if (state == NULL)
+            {
+                rateErrors++;
+                continue;
+            }
+            bool frameMode = (d % 2) == 1 && options.framePort != 0;
+            float expectedHz = frameMode ? (float)LoadFrameHz : (float)LoadPoseHz;
+            if (fabsf(state->rateHz - expectedHz) > expectedHz * 0.1F)
+                rateErrors++;
+            if ((int)state->lostFrames != (frameMode ? result.expectedLost[d] : 0))
+                lostErrors++;
+            if (state->twistDegree[2] != result.lastTwist[d])
+                twistErrors++;
+        }
+        Check(rateErrors == 0, "receive rate within 10% for every device");
+        Check(lostErrors == 0, "skipped QuatFrame seqs counted as lost");
+        Check(twistErrors == 0, "latest twist totals kept per device");
+        Check(result.consumerFrames >= (uint32_t)(options.rateHz * options.loadSeconds * 0.9),
+              "state frames republished at the configured rate");
+        Check(result.maxDevicesInFrame == devices, "a state frame carries every device");
+        printf("%s\n", failures == 0 ? "all passed" : "FAILED");
+        return failures == 0 ? 0 : 1;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    options.oscPort = OscPort;
+    options.framePort = FramePort;
+    options.rateHz = 60;
+    options.expireSeconds = 10.0;
+    options.statsSeconds = 5.0;
+    options.loadDevices = 0;
+    options.loadSeconds = 5.0;
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (value == NULL)
+        {
+            fprintf(stderr, "missing value for %s\n", arg);
+            return 1;
+        }
+        i++;
+        if (strcmp(arg, "--port") == 0)
+            options.oscPort = (uint16_t)atoi(value);
+        else if (strcmp(arg, "--frame-port") == 0)
+            options.framePort = (uint16_t)atoi(value);
+        else if (strcmp(arg, "--rate") == 0)
+            options.rateHz = atoi(value);
+        else if (strcmp(arg, "--expire") == 0)
+            options.expireSeconds = atof(value);
+        else if (strcmp(arg, "--stats") == 0)
+            options.statsSeconds = atof(value);
+        else if (strcmp(arg, "--loadtest") == 0)
+            options.loadDevices = atoi(value);
+        else if (strcmp(arg, "--seconds") == 0)
+            options.loadSeconds = atof(value);
+        else if (strcmp(arg, "--publish") == 0)
+        {
+            sockaddr_in endpoint;
+            if (!ParseEndpoint(value, endpoint))
+            {
+                fprintf(stderr, "invalid endpoint %s\n", value);
+                return 1;
+            }
+            options.publish.push_back(endpoint);
+        }
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", arg);
+            return 1;
+        }
+    }
+    if (options.rateHz < 1 || options.rateHz > 1000 || options.oscPort == 0)
+    {
+        fprintf(stderr, "invalid --rate or --port\n");
+        return 1;
+    }
+
+    if (options.loadDevices > 0)
+        return RunLoadTest(options);
+
+    if (options.publish.empty())
+    {
+        sockaddr_in endpoint = {};
+        endpoint.sin_family = AF_INET;
+        endpoint.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        endpoint.sin_port = htons(PublishPort);
+        options.publish.push_back(endpoint);
+    }
+    host::Aggregator aggregator;
+    LoopStats stats;
+    return RunLoop(options, aggregator, stats, 0, std::function<void()>());
+}
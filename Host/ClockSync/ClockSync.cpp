@@ -0,0 +1,106 @@
+#include "ClockSync.h"
+
+namespace host
+{
+
+    ClockSync::ClockSync()
+        : count(0), next(0), hasLastDevice(false), lastDeviceRaw(0), deviceHigh(0),
+          baseDevice(0), offset(0.0), drift(0.0), minDelay(0)
+    {
+    }
+
+    /**
+     * @brief ping/pongの結果を加えて推定をやり直す
+     */
+    void ClockSync::add(const ClockSample &sample)
+    {
+        int64_t t2 = unwrap(sample.deviceRecv);
+        int64_t t3 = t2 + (int32_t)(sample.deviceSend - sample.deviceRecv);
+
+        Point &p = points[next];
+        p.device = (t2 + t3) / 2;
+        p.offset = ((double)(sample.hostSend - t2) + (double)(sample.hostRecv - t3)) * 0.5;
+        p.delay = (sample.hostRecv - sample.hostSend) - (t3 - t2);
+        next = (next + 1) % ClockSyncWindow;
+        if (count < ClockSyncWindow)
+            count++;
+        fit();
+    }
+
+    /**
+     * @brief デバイスの時刻をホストの時刻に直す
+     *
+     * @param deviceMicros ImuData::timestamp などデバイスの micros() の値
+     * @return int64_t ホストの時刻 [us]．推定前はオフセット0とみなす
+     */
+    int64_t ClockSync::toHostMicros(uint32_t deviceMicros)
+    {
+        int64_t device = unwrap(deviceMicros);
+        return device + (int64_t)(offset + drift * (double)(device - baseDevice));
+    }
+
+    /**
+     * @brief 32bitの micros() を折り返しのない64bitに展開する．呼び出しは概ね時刻順であること
+     */
+    int64_t ClockSync::unwrap(uint32_t deviceMicros)
+    {
+        if (!hasLastDevice)
+        {
+            hasLastDevice = true;
+            lastDeviceRaw = deviceMicros;
+            return deviceMicros;
+        }
+        int32_t diff = (int32_t)(deviceMicros - lastDeviceRaw);
+        int64_t last = deviceHigh + lastDeviceRaw;
+        int64_t now = last + diff;
+        if (diff > 0)
+        {
+            deviceHigh = now - deviceMicros;
+            lastDeviceRaw = deviceMicros;
+        }
+        return now;
+    }
+
+    /**
+     * @brief 窓を時刻順に区切り，区間毎に往復遅延が最小のサンプルで offset(t) = a + b * (t - base) を最小二乗で求める
+     */
+    void ClockSync::fit()
+    {
+        int oldest = (next + ClockSyncWindow - count) % ClockSyncWindow;
+        baseDevice = points[oldest].device;
+        minDelay = points[oldest].delay;
+
+        int segmentLen = (count + ClockSyncSegments - 1) / ClockSyncSegments;
+        double n = 0.0, sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+        for (int start = 0; start < count; start += segmentLen)
+        {
+            const Point *best = NULL;
+            for (int i = start; i < start + segmentLen && i < count; i++)
+            {
+                const Point &p = points[(oldest + i) % ClockSyncWindow];
+                if (best == NULL || p.delay < best->delay)
+                    best = &p;
+            }
+            if (best->delay < minDelay)
+                minDelay = best->delay;
+            double x = (double)(best->device - baseDevice);
+            n += 1.0;
+            sx += x;
+            sy += best->offset;
+            sxx += x * x;
+            sxy += x * best->offset;
+        }
+
+        double denom = n * sxx - sx * sx;
+        // 時間幅が短いうち (標準偏差10s未満) はドリフトを推定せずオフセットだけを平均する
+        if (n < 4.0 || denom <= 1e14 * n * n)
+        {
+            drift = 0.0;
+            offset = sy / n;
+            return;
+        }
+        drift = (n * sxy - sx * sy) / denom;
+        offset = (sy - drift * sx) / n;
+    }
+
+} // host
@@ -0,0 +1,60 @@
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+
+namespace host
+{
+
+    static const int ClockSyncWindow = 1024; // 推定に使う直近のping/pong数
+    static const int ClockSyncSegments = 32; // 窓をこの数に区切り，区間毎に往復遅延が最小のサンプルを使う
+
+    /**
+     * @brief 1回のping/pongで得た4つの時刻 (NTP方式)
+     */
+    struct ClockSample
+    {
+        int64_t hostSend;      // t1 [us] ホストが /ping を送った時刻
+        uint32_t deviceRecv;   // t2 [us] デバイスが /ping を受けた時刻 (micros())
+        uint32_t deviceSend;   // t3 [us] デバイスが /pong を送った時刻 (micros())
+        int64_t hostRecv;      // t4 [us] ホストが /pong を受けた時刻
+    };
+
+    /**
+     * @brief デバイスの micros() とホストの時計の対応 (オフセットとドリフト) を推定する
+     * @brief 往復遅延の小さいサンプルほど経路の非対称が小さいとみなし，区間毎の最小遅延サンプルに直線を当てはめる
+     */
+    class ClockSync
+    {
+    public:
+        explicit ClockSync();
+        void add(const ClockSample &sample);
+        bool isValid() const { return count >= 2; }
+        int64_t toHostMicros(uint32_t deviceMicros);
+        double offsetMicros() const { return offset; }  // host - device [us] (基準時刻での値)
+        double driftPpm() const { return -drift * 1e6; } // ホストに対するデバイスの時計の進み
+        int64_t minDelayMicros() const { return minDelay; }
+
+    private:
+        struct Point
+        {
+            int64_t device; // 往復の中点のデバイス時刻 [us] (32bitの折り返しを展開済み)
+            double offset;  // host - device [us]
+            int64_t delay;  // 往復遅延からデバイス内の処理時間を除いたもの [us]
+        };
+
+        Point points[ClockSyncWindow];
+        int count;
+        int next;
+        bool hasLastDevice;
+        uint32_t lastDeviceRaw;
+        int64_t deviceHigh; // 折り返しの回数 * 2^32
+        int64_t baseDevice;
+        double offset;
+        double drift;
+        int64_t minDelay;
+
+        int64_t unwrap(uint32_t deviceMicros);
+        void fit();
+    };
+
+} // host
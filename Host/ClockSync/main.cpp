@@ -0,0 +1,134 @@
+// KaitenBoh と /ping /pong で時刻を合わせ，オフセットとドリフトの推定値を表示する
+//
+// build:
+//   c++ -std=c++11 -O2 -I../../PlatformIO/src main.cpp ClockSync.cpp ../../PlatformIO/src/osc/OscPacketWriter.cpp -o clock_sync
+// usage:
+//   ./clock_sync <device ip> [count] [interval ms]   (default: 100回, 100ms毎)
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include "ClockSync.h"
+#include "osc/OscPacketWriter.h"
+
+namespace
+{
+    const uint16_t DevicePort = 22222; // main.cpp の bind_port
+
+    int64_t NowMicros()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    uint32_t GetU32(const uint8_t *p)
+    {
+        return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
+    }
+
+    // OSC文字列は'\0'を含めて4byte境界まで詰められている
+    size_t SkipString(const uint8_t *p, size_t len, size_t pos)
+    {
+        while (pos < len && p[pos] != '\0')
+            pos++;
+        return (pos + 4) & ~(size_t)3;
+    }
+
+    /**
+     * @brief /<uniqueId>/pong ,iii を読む
+     */
+    bool ParsePong(const uint8_t *p, size_t len, int32_t &token, uint32_t &recv, uint32_t &send)
+    {
+        size_t addrEnd = strnlen((const char *)p, len);
+        if (addrEnd < 5 || memcmp(p + addrEnd - 5, "/pong", 5) != 0)
+            return false;
+        size_t pos = SkipString(p, len, 0);
+        if (pos + 4 > len || memcmp(p + pos, ",iii", 4) != 0)
+            return false;
+        pos = SkipString(p, len, pos);
+        if (pos + 12 > len)
+            return false;
+        token = (int32_t)GetU32(p + pos);
+        recv = GetU32(p + pos + 4);
+        send = GetU32(p + pos + 8);
+        return true;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <device ip> [count] [interval ms]\n", argv[0]);
+        return 1;
+    }
+    int count = (argc > 2) ? atoi(argv[2]) : 100;
+    int intervalMs = (argc > 3) ? atoi(argv[3]) : 100;
+
+    sockaddr_in device = {};
+    device.sin_family = AF_INET;
+    device.sin_port = htons(DevicePort);
+    if (inet_pton(AF_INET, argv[1], &device.sin_addr) != 1)
+    {
+        fprintf(stderr, "invalid address: %s\n", argv[1]);
+        return 1;
+    }
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0)
+    {
+        perror("socket");
+        return 1;
+    }
+
+    host::ClockSync clock;
+    std::map<int32_t, int64_t> pending; // token -> t1
+    uint8_t packet[256];
+    for (int32_t token = 0; token < count; token++)
+    {
+        osc::OscPacketWriter writer(packet, sizeof(packet));
+        writer.beginMessage("/ping", ",i");
+        writer.writeInt32(token);
+        writer.endMessage();
+        pending[token] = NowMicros();
+        sendto(sock, writer.data(), writer.size(), 0, (sockaddr *)&device, sizeof(device));
+
+        // 次のpingまでに届いたpongを全て処理する
+        int64_t deadline = NowMicros() + intervalMs * 1000LL;
+        for (int64_t now = NowMicros(); now < deadline; now = NowMicros())
+        {
+            fd_set fds;
+            FD_ZERO(&fds);
+            FD_SET(sock, &fds);
+            timeval timeout = {(time_t)((deadline - now) / 1000000), (suseconds_t)((deadline - now) % 1000000)};
+            if (select(sock + 1, &fds, NULL, NULL, &timeout) <= 0)
+                break;
+            ssize_t len = recv(sock, packet, sizeof(packet), 0);
+            int64_t t4 = NowMicros();
+            int32_t pongToken;
+            host::ClockSample sample;
+            if (len <= 0 || !ParsePong(packet, (size_t)len, pongToken, sample.deviceRecv, sample.deviceSend))
+                continue;
+            std::map<int32_t, int64_t>::iterator it = pending.find(pongToken);
+            if (it == pending.end())
+                continue;
+            sample.hostSend = it->second;
+            sample.hostRecv = t4;
+            pending.erase(it);
+            clock.add(sample);
+            printf("token %4d rtt %7lld us  offset %14.1f us  drift %+8.2f ppm  min delay %lld us\n",
+                   pongToken, (long long)(t4 - sample.hostSend), clock.offsetMicros(), clock.driftPpm(),
+                   (long long)clock.minDelayMicros());
+        }
+    }
+    printf("lost %zu / %d\n", pending.size(), count);
+    close(sock);
+    return 0;
+}
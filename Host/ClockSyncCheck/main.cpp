@@ -0,0 +1,147 @@
+// host::ClockSync に，既知のオフセットとドリフトを持つデバイスの時計と，上りと下りで大きさの異なる揺らぎを
+// 持つ経路を合成した ping/pong を与え，オフセットとドリフトの推定が真値へ収束することを確かめる
+// デバイスの micros() は途中で32bitを折り返す
+//
+// build:
+//   c++ -std=c++11 -O2 -I../ClockSync main.cpp ../ClockSync/ClockSync.cpp -o clock_sync_check
+// usage:
+//   ./clock_sync_check
+//   終了コード 0: 全ての場面で推定が基準以内, 1: 超過
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include "ClockSync.h"
+
+namespace
+{
+    const int64_t PingIntervalMicros = 100000; // clock_sync の既定と同じ100ms毎
+    const int Pings = 3000;                    // 5分
+    // 時刻の変換の誤差の上限 [us]．上りと下りの揺らぎの差は区間毎の最小遅延を選んでも一部残るため，
+    // 平均は揺らぎ (ms) より1桁小さく，区間が入れ替わる瞬間の最大もその数倍に収まればよいとする
+    const double TimeErrorMeanMaxMicros = 200.0;
+    const double TimeErrorMaxMicros = 1000.0;
+    const double DriftErrorMaxPpm = 3.0;
+
+    int failures = 0;
+
+    void Check(bool condition, const char *what)
+    {
+        printf("%s: %s\n", condition ? "ok" : "NG", what);
+        if (!condition)
+            failures++;
+    }
+
+    /**
+     * @brief 合成する場面．経路の遅延は 最小遅延 + 指数分布の揺らぎ (平均) で，上りと下りで揺らぎを変える
+     */
+    struct Scenario
+    {
+        const char *name;
+        double offsetMicros;    // host - device [us] (ホストの時刻0での値)
+        double driftPpm;        // ホストに対するデバイスの時計の進み
+        double upBaseMicros;    // /ping の最小遅延
+        double upJitterMicros;  // /ping の揺らぎの平均
+        double downBaseMicros;  // /pong の最小遅延
+        double downJitterMicros;
+        double spikeRate;       // WiFiの再送などで数十msの遅延が乗る割合
+    };
+
+    /**
+     * @brief デバイスの時計．host[us] の時点での micros() (32bitで折り返す)
+     */
+    struct DeviceClock
+    {
+        double offset;
+        double drift;
+
+        double at(double host) const { return (host - offset) * (1.0 + drift); }
+        uint32_t micros(double host) const { return (uint32_t)(int64_t)floor(at(host)); }
+    };
+
+    void Run(const Scenario &s, uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        std::exponential_distribution<double> up(1.0 / s.upJitterMicros);
+        std::exponential_distribution<double> down(1.0 / s.downJitterMicros);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+        DeviceClock clock = {s.offsetMicros, s.driftPpm * 1e-6};
+        host::ClockSync sync;
+        double worstLate = 0.0; // 最後の1分間の誤差の最大
+        double sumLate = 0.0, sumEarly = 0.0;
+        int late = 0, early = 0;
+        int64_t host = 1000000;
+        for (int i = 0; i < Pings; i++, host += PingIntervalMicros)
+        {
+            double upDelay = s.upBaseMicros + up(rng);
+            double downDelay = s.downBaseMicros + down(rng);
+            if (uniform(rng) < s.spikeRate)
+                upDelay += 30000.0 * uniform(rng);
+            if (uniform(rng) < s.spikeRate)
+                downDelay += 30000.0 * uniform(rng);
+            double processing = 50.0 + 250.0 * uniform(rng); // デバイス内で /pong を作る時間
+
+            host::ClockSample sample;
+            sample.hostSend = host;
+            sample.deviceRecv = clock.micros(host + upDelay);
+            sample.deviceSend = clock.micros(host + upDelay + processing);
+            sample.hostRecv = host + (int64_t)(upDelay + processing + downDelay);
+            sync.add(sample);
+
+            // 今の時刻と1秒先の時刻をホストの時刻に直して真値と比べる (最初の10秒と最後の1分)
+            bool isEarly = i < 100;
+            if (isEarly || i >= Pings - 600)
+            {
+                double probes[2] = {(double)host, (double)host + 1e6};
+                for (int k = 0; k < 2; k++)
+                {
+                    double error = fabs((double)sync.toHostMicros(clock.micros(probes[k])) - probes[k]);
+                    if (isEarly)
+                    {
+                        sumEarly += error;
+                        early++;
+                        continue;
+                    }
+                    sumLate += error;
+                    late++;
+                    worstLate = (error > worstLate) ? error : worstLate;
+                }
+            }
+        }
+
+        // オフセットは窓の最初の点を基準にした値のため，時刻の変換で比べる
+        double driftError = fabs(sync.driftPpm() - s.driftPpm);
+        double meanEarly = sumEarly / early, meanLate = sumLate / late;
+        printf("%s: drift %.2f ppm (true %.2f), min delay %lld us, time error first 10 s mean %.0f us, "
+               "last minute mean %.0f / max %.0f us\n",
+               s.name, sync.driftPpm(), s.driftPpm, (long long)sync.minDelayMicros(), meanEarly, meanLate, worstLate);
+        char what[160];
+        snprintf(what, sizeof(what), "%s: device time maps to host time within %.0f us mean, %.0f us max", s.name,
+                 TimeErrorMeanMaxMicros, TimeErrorMaxMicros);
+        Check(sync.isValid() && meanLate < TimeErrorMeanMaxMicros && worstLate < TimeErrorMaxMicros, what);
+        snprintf(what, sizeof(what), "%s: error shrinks as samples accumulate", s.name);
+        Check(meanLate < meanEarly, what);
+        snprintf(what, sizeof(what), "%s: drift within %.1f ppm", s.name, DriftErrorMaxPpm);
+        Check(driftError < DriftErrorMaxPpm, what);
+    }
+
+} // namespace
+
+int main()
+{
+    // 水晶の誤差は ±数十ppm．デバイスの micros() は開始から約50秒後に折り返す
+    const double wrapSoon = -(4294967296.0 - 50e6);
+    const Scenario scenarios[] = {
+        {"no drift, symmetric jitter", 123456789.0, 0.0, 1500.0, 2000.0, 1500.0, 2000.0, 0.0},
+        {"+40 ppm, slow uplink jitter", wrapSoon, 40.0, 1500.0, 6000.0, 1500.0, 1000.0, 0.0},
+        {"-25 ppm, slow downlink jitter", wrapSoon, -25.0, 1500.0, 1000.0, 1500.0, 8000.0, 0.0},
+        {"+60 ppm, asymmetric jitter and 5% spikes", -777000.0, 60.0, 2000.0, 3000.0, 2000.0, 10000.0, 0.05},
+    };
+    uint32_t seed = 1;
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+        Run(scenarios[i], seed++);
+
+    printf("%s\n", failures == 0 ? "all passed" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
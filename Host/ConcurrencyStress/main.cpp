@@ -0,0 +1,253 @@
+// concurrent::SeqLock と concurrent::SpscRing を2つの std::thread から休みなく叩き，
+// 読み出しのちぎれ (書き込み途中の値)，世代の逆戻り，データの欠落 / 重複 / 順序の入れ替わりがないことを確かめる
+// SeqLock は待つ read() と待たない tryRead() (失敗時は前の値を残す) の両方を確かめる
+//
+// build:
+//   c++ -std=c++11 -O2 -pthread -I../../PlatformIO/src main.cpp -o concurrency_stress
+// usage:
+//   ./concurrency_stress [seconds]   (default: 2秒ずつ)
+//   終了コード 0: 全て期待どおり, 1: 失敗あり
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "concurrent/SeqLock.h"
+#include "concurrent/SpscRing.h"
+#include "imu/ImuData.h"
+
+namespace
+{
+    const int PayloadWords = 30; // ImuSnapshot 程度の大きさ (120byte) にして，コピーの途中で割り込まれやすくする
+    const uint32_t RingSize = 64; // imu::ImuDataBufferSize と同じ
+
+    int failures = 0;
+
+    void Check(bool condition, const char *what)
+    {
+        printf("%s: %s\n", condition ? "ok" : "NG", what);
+        if (!condition)
+            failures++;
+    }
+
+    /**
+     * @brief 全ての語に同じ世代を書く．1語でも違えばちぎれた読み出し
+     */
+    struct Payload
+    {
+        uint32_t generation;
+        uint32_t words[PayloadWords];
+        uint32_t check; // generation ^ 0xA5A5A5A5
+
+        void fill(uint32_t g)
+        {
+            generation = g;
+            for (int i = 0; i < PayloadWords; i++)
+                words[i] = g * 2654435761U + i;
+            check = g ^ 0xA5A5A5A5U;
+        }
+
+        bool consistent() const
+        {
+            if (check != (generation ^ 0xA5A5A5A5U))
+                return false;
+            for (int i = 0; i < PayloadWords; i++)
+                if (words[i] != generation * 2654435761U + i)
+                    return false;
+            return true;
+        }
+    };
+
+    typedef std::chrono::steady_clock Clock;
+
+    /**
+     * @brief 書き込み1スレッド / 読み出し1スレッドで SeqLock を叩く
+     *
+     * @param nonBlocking true: tryRead() で読む (streamConfig と同じ), false: read() で読む (imuSnapshot と同じ)
+     */
+    void StressSeqLock(double seconds, bool nonBlocking)
+    {
+        concurrent::SeqLock<Payload> lock;
+        std::atomic<bool> stop(false);
+        uint32_t written = 0;
+        Payload initial;
+        initial.fill(0);
+        lock.write(initial); // 0埋めの初期値は check が合わない．世代0として書いておく (version 2)
+        std::thread writer([&]() {
+            Payload p;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                p.fill(++written);
+                lock.write(p);
+            }
+        });
+
+        uint64_t reads = 0, torn = 0, backwards = 0, versionMismatch = 0, changes = 0;
+        uint64_t refused = 0, clobbered = 0;
+        uint32_t last = 0;
+        Payload held; // tryRead() が失敗したときに残るべき値
+        uint32_t heldVersion = 0;
+        held.fill(0);
+        Clock::time_point end = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+        while (Clock::now() < end)
+        {
+            for (int i = 0; i < 1000; i++)
+            {
+                Payload p;
+                uint32_t version;
+                if (nonBlocking)
+                {
+                    p = held;
+                    version = heldVersion;
+                    if (!lock.tryRead(p, version))
+                    {
+                        refused++;
+                        if (memcmp(&p, &held, sizeof(p)) != 0 || version != heldVersion)
+                            clobbered++;
+                        continue;
+                    }
+                    held = p;
+                    heldVersion = version;
+                }
+                else
+                {
+                    version = lock.read(p);
+                }
+                reads++;
+                if (!p.consistent())
+                    torn++;
+                if (p.generation < last)
+                    backwards++;
+                if (p.generation != last)
+                    changes++;
+                if (version != p.generation * 2 + 2)
+                    versionMismatch++;
+                last = p.generation;
+            }
+        }
+        stop = true;
+        writer.join();
+
+        const char *mode = nonBlocking ? "SeqLock tryRead" : "SeqLock read";
+        printf("%s: %llu writes, %llu reads, %llu refused, %llu distinct values seen\n", mode, (unsigned long long)written,
+               (unsigned long long)reads, (unsigned long long)refused, (unsigned long long)changes);
+        char what[128];
+        snprintf(what, sizeof(what), "%s: no torn reads", mode);
+        Check(torn == 0, what);
+        snprintf(what, sizeof(what), "%s: generation never goes backwards", mode);
+        Check(backwards == 0, what);
+        snprintf(what, sizeof(what), "%s: returned version matches the value read", mode);
+        Check(versionMismatch == 0, what);
+        snprintf(what, sizeof(what), "%s: reader observes the writer's progress", mode);
+        Check(changes > 10, what); // 1コアではタイムスライス毎にしか進まない
+        if (nonBlocking)
+        {
+            snprintf(what, sizeof(what), "%s: a refused read keeps the previous value", mode);
+            Check(clobbered == 0, what);
+        }
+    }
+
+    /**
+     * @brief 書き込み1スレッド / 読み出し1スレッドで SpscRing を叩く
+     *
+     * @param retry true: 満杯なら空くまで入れ直す (欠落0を期待), false: 満杯なら捨てる (ImuLoopと同じ)
+     */
+    void StressRing(double seconds, bool retry)
+    {
+        concurrent::SpscRing<Payload, RingSize> ring;
+        std::atomic<bool> stop(false);
+        std::atomic<uint32_t> produced(0);
+        uint32_t accepted = 0;
+        std::thread producer([&]() {
+            Payload p;
+            uint32_t g = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                p.fill(++g);
+                if (ring.push(p))
+                {
+                    accepted++;
+                }
+                else if (retry)
+                {
+                    g--; // 同じ番号で入れ直す
+                    std::this_thread::yield();
+                }
+            }
+            produced = g;
+        });
+
+        uint64_t popped = 0, torn = 0, outOfOrder = 0, gaps = 0;
+        uint32_t last = 0;
+        bool countOk = true;
+        Clock::time_point end = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+        Payload p;
+        while (true)
+        {
+            bool running = Clock::now() < end;
+            if (!running && !stop)
+                stop = true;
+            if (!ring.pop(p))
+            {
+                if (!running && produced.load() != 0 && ring.count() == 0)
+                    break;
+                continue;
+            }
+            int c = ring.count();
+            if (c < 0 || c > (int)RingSize)
+                countOk = false;
+            popped++;
+            if (!p.consistent())
+                torn++;
+            if (p.generation <= last)
+                outOfOrder++;
+            else if (p.generation != last + 1)
+                gaps++;
+            last = p.generation;
+        }
+        producer.join();
+
+        const char *mode = retry ? "SpscRing (retry when full)" : "SpscRing (drop when full)";
+        printf("%s: %u produced, %llu popped, %u pushes refused when full\n", mode, produced.load(), (unsigned long long)popped,
+               ring.dropped());
+        char what[128];
+        snprintf(what, sizeof(what), "%s: no torn items", mode);
+        Check(torn == 0, what);
+        snprintf(what, sizeof(what), "%s: items arrive in order without duplicates", mode);
+        Check(outOfOrder == 0, what);
+        snprintf(what, sizeof(what), "%s: every accepted item is popped", mode);
+        Check(popped == accepted, what);
+        snprintf(what, sizeof(what), "%s: count() stays within 0..N", mode);
+        Check(countOk, what);
+        if (retry)
+        {
+            snprintf(what, sizeof(what), "%s: nothing lost", mode);
+            Check(gaps == 0 && popped == produced.load(), what);
+        }
+        else
+        {
+            // 捨てた分だけ番号が飛ぶ．捨てた数の合計と一致する
+            snprintf(what, sizeof(what), "%s: popped + dropped == produced", mode);
+            Check(popped + ring.dropped() == produced.load(), what);
+        }
+    }
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 2.0;
+    if (seconds <= 0.0)
+        seconds = 2.0;
+    printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+
+    StressSeqLock(seconds, false);
+    StressSeqLock(seconds, true);
+    StressRing(seconds, true);
+    StressRing(seconds, false);
+
+    printf("%s\n", failures == 0 ? "all passed" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
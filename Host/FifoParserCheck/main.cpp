@@ -0,0 +1,281 @@
+// MPU6886のFIFOから読み出したバイト列を imu::fifo::FifoParser に様々な区切りで与え，
+// 一度に与えた場合と同じサンプル列になること，あふれた後の reset() でパケット境界に戻れることを確かめる
+// まとめ読みで残したサンプルを数えた時刻の刻印 (imu::fifo::SampleTimestamp) が読み出しをまたいで重ならないことも確かめる
+//
+// build:
+//   S=../../PlatformIO/src
+//   c++ -std=c++11 -O2 -I$S main.cpp $S/imu/fifo/FifoParser.cpp -o fifo_parser_check
+// usage:
+//   ./fifo_parser_check [dump.bin]
+//   dump.bin: FIFO_R_W から読んだバイト列をそのまま保存したもの．省略すると下の FifoDump を使う
+//   終了コード 0: 全て期待どおり, 1: 失敗あり
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "imu/fifo/FifoParser.h"
+
+namespace
+{
+    using imu::fifo::FifoPacketLen;
+    using imu::fifo::FifoParser;
+    using imu::fifo::FifoSample;
+
+    const size_t ReadChunkLen = FifoPacketLen * 8; // Mpu6886Fifo の FifoReadChunkLen
+
+    // 机に置いた状態から長軸 (Z) 周りに720dps まで回し始めた24パケット (200Hz, ±8g, ±2000dps)
+    // accel x, y, z / temp / gyro x, y, z の順にビッグエンディアンの int16
+    const uint8_t FifoDump[] = {
+        0x00, 0x2C, 0xFF, 0xAC, 0x10, 0x03, 0x08, 0x4E, 0xFF, 0xF3, 0x00, 0x08, 0x00, 0x02,
+        0x00, 0x2F, 0xFF, 0xAB, 0x0F, 0xF9, 0x08, 0x4B, 0xFF, 0xF3, 0x00, 0x04, 0x00, 0x02,
+        0x00, 0x26, 0xFF, 0xAE, 0x0F, 0xFB, 0x08, 0x4E, 0xFF, 0xF4, 0x00, 0x02, 0x00, 0x04,
+        0x00, 0x26, 0xFF, 0xAE, 0x10, 0x00, 0x08, 0x4B, 0xFF, 0xF9, 0x00, 0x08, 0x00, 0x02,
+        0x00, 0x25, 0xFF, 0xB4, 0x0F, 0xFA, 0x08, 0x4B, 0xFF, 0xF7, 0x00, 0x06, 0x00, 0x02,
+        0x00, 0x25, 0xFF, 0xAA, 0x0F, 0xF8, 0x08, 0x4A, 0xFF, 0xF4, 0x00, 0x08, 0x00, 0x00,
+        0x00, 0x25, 0xFF, 0xAA, 0x10, 0x01, 0x08, 0x4C, 0xFF, 0xF4, 0x00, 0x06, 0x00, 0x04,
+        0x00, 0x2D, 0xFF, 0xAB, 0x0F, 0xFD, 0x08, 0x4B, 0xFF, 0xF6, 0x00, 0x04, 0xFF, 0xFF,
+        0x00, 0x28, 0xFF, 0xAE, 0x0F, 0xFD, 0x08, 0x4B, 0xFF, 0xF5, 0x00, 0x02, 0x00, 0x01,
+        0x00, 0x27, 0xFF, 0xB1, 0x0F, 0xF8, 0x08, 0x4E, 0xFF, 0xF8, 0x00, 0x07, 0x00, 0x01,
+        0x00, 0x24, 0xFF, 0xAC, 0x10, 0x03, 0x08, 0x4C, 0xFF, 0xF6, 0x00, 0x07, 0x00, 0x01,
+        0x00, 0x25, 0xFF, 0xAF, 0x10, 0x07, 0x08, 0x4B, 0xFF, 0xF3, 0x00, 0x04, 0xFF, 0xFF,
+        0x00, 0xE2, 0xFF, 0xAD, 0x10, 0x04, 0x08, 0x4A, 0xFF, 0xF7, 0x00, 0x08, 0x0B, 0x8A,
+        0x00, 0xDC, 0xFF, 0xAE, 0x0F, 0xF8, 0x08, 0x4D, 0xFF, 0xF3, 0x00, 0x07, 0x17, 0x10,
+        0x00, 0xE0, 0xFF, 0xAB, 0x0F, 0xFB, 0x08, 0x4B, 0xFF, 0xF9, 0x00, 0x05, 0x22, 0x99,
+        0x00, 0xDF, 0xFF, 0xAD, 0x10, 0x08, 0x08, 0x4C, 0xFF, 0xF9, 0x00, 0x05, 0x2E, 0x1F,
+        0x00, 0xE0, 0xFF, 0xB3, 0x10, 0x03, 0x08, 0x4C, 0xFF, 0xF3, 0x00, 0x05, 0x2E, 0x1F,
+        0x00, 0xDA, 0xFF, 0xAD, 0x10, 0x08, 0x08, 0x4E, 0xFF, 0xF5, 0x00, 0x03, 0x2E, 0x21,
+        0x00, 0xDB, 0xFF, 0xB3, 0x0F, 0xFA, 0x08, 0x4C, 0xFF, 0xF8, 0x00, 0x04, 0x2E, 0x21,
+        0x00, 0xD9, 0xFF, 0xB4, 0x0F, 0xFA, 0x08, 0x4B, 0xFF, 0xF8, 0x00, 0x07, 0x2E, 0x21,
+        0x00, 0xDE, 0xFF, 0xAA, 0x0F, 0xF9, 0x08, 0x4A, 0xFF, 0xF7, 0x00, 0x06, 0x2E, 0x22,
+        0x00, 0xD7, 0xFF, 0xAB, 0x10, 0x03, 0x08, 0x4C, 0xFF, 0xF6, 0x00, 0x07, 0x2E, 0x22,
+        0x00, 0xD9, 0xFF, 0xA8, 0x0F, 0xF9, 0x08, 0x4D, 0xFF, 0xF5, 0x00, 0x08, 0x2E, 0x20,
+        0x00, 0xD9, 0xFF, 0xB3, 0x0F, 0xFC, 0x08, 0x4D, 0xFF, 0xF3, 0x00, 0x03, 0x2E, 0x22,
+    };
+
+    int failures = 0;
+
+    void Check(bool condition, const char *what)
+    {
+        printf("%s: %s\n", condition ? "ok" : "NG", what);
+        if (!condition)
+            failures++;
+    }
+
+    bool SameSamples(const std::vector<FifoSample> &a, const std::vector<FifoSample> &b)
+    {
+        if (a.size() != b.size())
+            return false;
+        for (size_t i = 0; i < a.size(); i++)
+            if (memcmp(&a[i], &b[i], sizeof(FifoSample)) != 0)
+                return false;
+        return true;
+    }
+
+    /**
+     * @brief バイト列を splits で区切って順に与え，変換したサンプルを全て返す
+     */
+    std::vector<FifoSample> ParseSplit(FifoParser &parser, const std::vector<uint8_t> &bytes, const std::vector<size_t> &splits)
+    {
+        std::vector<FifoSample> samples;
+        std::vector<FifoSample> out(bytes.size() / FifoPacketLen + 1);
+        size_t pos = 0;
+        for (size_t i = 0; i <= splits.size(); i++)
+        {
+            size_t end = (i < splits.size()) ? splits[i] : bytes.size();
+            size_t n = parser.parse(bytes.data() + pos, end - pos, out.data(), out.size());
+            samples.insert(samples.end(), out.begin(), out.begin() + n);
+            pos = end;
+        }
+        return samples;
+    }
+
+    std::vector<FifoSample> ParseChunks(const std::vector<uint8_t> &bytes, size_t chunk, size_t &outPending)
+    {
+        std::vector<size_t> splits;
+        for (size_t pos = chunk; pos < bytes.size(); pos += chunk)
+            splits.push_back(pos);
+        FifoParser parser;
+        std::vector<FifoSample> samples = ParseSplit(parser, bytes, splits);
+        outPending = parser.pending();
+        return samples;
+    }
+
+    /**
+     * @brief 1度に与えた結果を基準に，あらゆる読み出し長と乱数の区切りで同じサンプル列になるかを確かめる
+     */
+    void CheckSplits(const char *name, const std::vector<uint8_t> &bytes)
+    {
+        char what[128];
+        size_t pending;
+        std::vector<FifoSample> reference = ParseChunks(bytes, bytes.size(), pending);
+        size_t expectedPending = bytes.size() % FifoPacketLen;
+        printf("  %s: %zu bytes -> %zu samples, %zu bytes pending\n", name, bytes.size(), reference.size(), pending);
+
+        bool chunksOk = true;
+        for (size_t chunk = 1; chunk <= ReadChunkLen; chunk++)
+        {
+            size_t p;
+            if (!SameSamples(ParseChunks(bytes, chunk, p), reference) || p != expectedPending)
+                chunksOk = false;
+        }
+        snprintf(what, sizeof(what), "%s: every read length 1..%zu gives the same samples", name, ReadChunkLen);
+        Check(chunksOk, what);
+
+        std::mt19937 rng(7);
+        bool randomOk = true;
+        for (int trial = 0; trial < 1000; trial++)
+        {
+            std::vector<size_t> splits;
+            for (size_t pos = 0;;)
+            {
+                pos += std::uniform_int_distribution<size_t>(0, 40)(rng); // 0byteの読み出しも混ぜる
+                if (pos >= bytes.size())
+                    break;
+                splits.push_back(pos);
+            }
+            FifoParser parser;
+            if (!SameSamples(ParseSplit(parser, bytes, splits), reference) || parser.pending() != expectedPending)
+                randomOk = false;
+        }
+        snprintf(what, sizeof(what), "%s: 1000 random splits give the same samples", name);
+        Check(randomOk, what);
+    }
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::vector<uint8_t> dump(FifoDump, FifoDump + sizeof(FifoDump));
+    const size_t packets = sizeof(FifoDump) / FifoPacketLen;
+    size_t pending;
+    std::vector<FifoSample> reference = ParseChunks(dump, dump.size(), pending);
+
+    // 換算: 加速度 4096LSB/g, 角速度 16.4LSB/dps, 温度 326.8LSB/degC + 25
+    Check(reference.size() == packets && pending == 0, "whole dump: one sample per 14 bytes");
+    const FifoSample &first = reference[0];
+    Check(first.acc[0] == 44 / 4096.0F && first.acc[1] == -84 / 4096.0F && first.acc[2] == 4099 / 4096.0F,
+          "first sample: big-endian signed accel");
+    Check(first.gyro[0] == -13 / 16.4F && first.gyro[1] == 8 / 16.4F && first.gyro[2] == 2 / 16.4F,
+          "first sample: big-endian signed gyro");
+    Check(fabsf(first.temp - (2126 / 326.8F + 25.0F)) < 1e-4F, "first sample: temperature");
+    bool plausible = true;
+    for (size_t i = 0; i < reference.size(); i++)
+    {
+        const FifoSample &s = reference[i];
+        float norm = sqrtf(s.acc[0] * s.acc[0] + s.acc[1] * s.acc[1] + s.acc[2] * s.acc[2]);
+        if (fabsf(norm - 1.0F) > 0.05F || s.temp < 31.0F || s.temp > 32.0F)
+            plausible = false;
+    }
+    Check(plausible, "whole dump: |acc| close to 1 g and temperature steady");
+    Check(fabsf(reference[packets - 1].gyro[2] - 720.0F) < 1.0F, "whole dump: spin reaches 720 dps");
+
+    CheckSplits("dump", dump);
+
+    // パケットの途中で切れた読み出し: 端数は持ち越して次の読み出しで1サンプルになる
+    {
+        FifoParser parser;
+        FifoSample out[4];
+        size_t n1 = parser.parse(FifoDump, 20, out, 4);
+        size_t pending1 = parser.pending();
+        size_t n2 = parser.parse(FifoDump + 20, 3, out + n1, 4 - n1);
+        size_t pending2 = parser.pending();
+        size_t n3 = parser.parse(FifoDump + 23, 5, out + n1 + n2, 4 - n1 - n2);
+        Check(n1 == 1 && pending1 == 6, "split packet: 20 bytes give 1 sample and 6 pending");
+        Check(n2 == 0 && pending2 == 9, "split packet: 3 more bytes complete nothing");
+        Check(n3 == 1 && parser.pending() == 0 && memcmp(&out[1], &reference[1], sizeof(FifoSample)) == 0,
+              "split packet: completed packet decodes like the unsplit one");
+    }
+
+    // 配列が足りない分は捨てるが，バイト列は読み進める (Mpu6886Fifo は読む量を配列に合わせて抑える)
+    {
+        FifoParser parser;
+        FifoSample out[ReadChunkLen];
+        size_t n = parser.parse(FifoDump, sizeof(FifoDump), out, 10);
+        Check(n == 10 && parser.pending() == 0, "maxSamples: extra samples dropped without losing alignment");
+    }
+
+    // あふれ: Mpu6886Fifo::read() は INT_STATUS の FIFO_OFLOW を見て FIFO と parser を reset() する
+    // FIFOはリセット後パケット境界から書き直されるため，端数を捨てれば以降も正しく変換できる
+    {
+        FifoParser parser;
+        FifoSample out[ReadChunkLen];
+        size_t before = parser.parse(FifoDump, 100, out, ReadChunkLen); // 7パケット + 2byte
+        Check(before == 7 && parser.pending() == 2, "overflow: partial packet pending when overflow is seen");
+        parser.reset();
+        Check(parser.pending() == 0, "overflow: reset() drops the partial packet");
+        size_t after = parser.parse(FifoDump, sizeof(FifoDump), out, ReadChunkLen);
+        std::vector<FifoSample> resumed(out, out + after);
+        Check(SameSamples(resumed, reference), "overflow: stream after reset decodes from the packet boundary");
+
+        // reset() しなければ境界がずれ，以降が全て別の値になる
+        FifoParser stale;
+        stale.parse(FifoDump, 100, out, ReadChunkLen);
+        after = stale.parse(FifoDump, sizeof(FifoDump), out, ReadChunkLen);
+        Check(after > 0 && memcmp(&out[0], &reference[0], sizeof(FifoSample)) != 0,
+              "overflow: without reset() the boundary is lost");
+    }
+
+    // 時刻の刻印: 1kHzのFIFOを最大32サンプルずつ読み，途中で50msの停止がある
+    // 読み切れずに残した分を数えて遡れば，時刻は読み出しをまたいでも1周期ずつ進み，真の時刻より後にならない
+    {
+        const uint32_t periodMicros = 1000;
+        const size_t maxBurst = 32; // main.cpp の IMU_BURST_MAX
+        uint32_t reads[200];
+        uint32_t t = 1000000;
+        for (int i = 0; i < 200; i++)
+        {
+            t += (i == 60) ? 50000 : (uint32_t)(periodMicros * (1 + i % 3)); // 1-3ms毎，60回目で停止
+            reads[i] = t;
+        }
+        bool monotonic = true, monotonicOld = true, accurate = true;
+        uint32_t captured = 0;            // FIFOから読み出したサンプルの数
+        uint32_t lastStamp = 0, lastOld = 0;
+        const uint32_t start = 1000000;   // 最初のサンプルの真の時刻
+        for (int i = 0; i < 200; i++)
+        {
+            uint32_t stored = (reads[i] - start) / periodMicros + 1 - captured; // 読み出し時点でFIFOにある数
+            size_t n = (stored > maxBurst) ? maxBurst : stored;
+            size_t remaining = stored - n;
+            for (size_t k = 0; k < n; k++)
+            {
+                uint32_t stamp = imu::fifo::SampleTimestamp(reads[i], k, n, remaining, periodMicros);
+                uint32_t old = imu::fifo::SampleTimestamp(reads[i], k, n, 0, periodMicros); // 残りを数えない場合
+                uint32_t truth = start + (captured + (uint32_t)k) * periodMicros;
+                if (lastStamp != 0 && stamp - lastStamp != periodMicros)
+                    monotonic = false;
+                if (lastOld != 0 && (int32_t)(old - lastOld) <= 0)
+                    monotonicOld = false;
+                if (stamp < truth || stamp - truth >= periodMicros)
+                    accurate = false;
+                lastStamp = stamp;
+                lastOld = old;
+            }
+            captured += (uint32_t)n;
+        }
+        Check(monotonic && accurate, "timestamps: a capped burst leaves no overlap, one period per sample");
+        Check(!monotonicOld, "timestamps: ignoring the samples left in the FIFO makes time go backwards");
+    }
+
+    // 実機で取ったバイト列も同じく確かめる
+    if (argc > 1)
+    {
+        FILE *f = fopen(argv[1], "rb");
+        if (f == NULL)
+        {
+            perror(argv[1]);
+            return 1;
+        }
+        std::vector<uint8_t> recorded;
+        uint8_t buffer[4096];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+            recorded.insert(recorded.end(), buffer, buffer + n);
+        fclose(f);
+        CheckSplits(argv[1], recorded);
+    }
+
+    printf("%s\n", failures == 0 ? "all passed" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
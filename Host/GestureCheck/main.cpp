@@ -0,0 +1,290 @@
+// imu::gesture::GestureDetector に合成した動き (回し始め/止め, 逆回転, 揺さぶり, 紛らわしい動き) を与え，
+// 期待したイベントだけが出ることと，ホスト側で30Hzの /quat から判定した場合に比べた検出の遅れを確かめる
+//
+// build:
+//   S=../../PlatformIO/src
+//   c++ -std=c++11 -O2 -I$S main.cpp $S/imu/gesture/GestureDetector.cpp -o gesture_check
+// usage:
+//   ./gesture_check [seed]
+//   終了コード 0: 全て期待どおり, 1: 失敗あり
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include "imu/gesture/GestureDetector.h"
+
+namespace
+{
+    using imu::gesture::GestureDetector;
+    using imu::gesture::GestureEvent;
+    using imu::gesture::GestureEventType;
+
+    const double Pi = 3.14159265358979323846;
+    const int RateHz = 200;       // ImuLoopのサンプリング周期
+    const int HostRateHz = 30;    // /quat の送信周期 (TASK_SLEEP_SEND_OSC)
+    const float GyroNoiseDps = 1.0F;
+    const float AccelNoiseG = 0.02F;
+    const float RadiusM = 0.03F; // IMUの回転軸からのずれ
+
+    std::mt19937 rng(1);
+    int failures = 0;
+
+    void Check(bool condition, const char *what)
+    {
+        printf("%s: %s\n", condition ? "ok" : "NG", what);
+        if (!condition)
+            failures++;
+    }
+
+    float Gaussian(float sigma)
+    {
+        return std::normal_distribution<float>(0.0F, sigma)(rng);
+    }
+
+    /**
+     * @brief 動きの定義．時刻[s]から棒の長軸 (Z) 周りの角速度[deg/s]とそれ以外の加速度[g]を返す
+     */
+    struct Motion
+    {
+        const char *name;
+        double seconds;
+        std::function<double(double)> spinDps;
+        std::function<double(double)> shakeG; // X方向に加わる加速度
+        bool horizontal;                      // true: 長軸を水平にして回す (重力が回転と共に回る)
+    };
+
+    /**
+     * @brief 1サンプル分のIMUデータを作る．遠心力と重力も加える
+     */
+    imu::ImuData Sample(const Motion &motion, double t, double angle, bool noise)
+    {
+        imu::ImuData d;
+        d.timestamp = (uint32_t)(t * 1e6);
+        double omega = motion.spinDps(t) * Pi / 180.0;
+        double centripetal = omega * omega * RadiusM / 9.80665;
+        d.acc[0] = (float)(centripetal + motion.shakeG(t));
+        if (motion.horizontal)
+        {
+            d.acc[0] += (float)cos(angle);
+            d.acc[1] = (float)-sin(angle);
+        }
+        else
+        {
+            d.acc[2] = 1.0F;
+        }
+        d.gyro[2] = (float)motion.spinDps(t);
+        if (noise)
+        {
+            for (int i = 0; i < imu::ImuXyz; i++)
+            {
+                d.gyro[i] += Gaussian(GyroNoiseDps);
+                d.acc[i] += Gaussian(AccelNoiseG);
+            }
+        }
+        return d;
+    }
+
+    /**
+     * @brief 全サンプルで判定したイベントを返す (ファームウェアと同じ)
+     */
+    std::vector<GestureEvent> RunDevice(const Motion &motion)
+    {
+        GestureDetector detector;
+        std::vector<GestureEvent> events;
+        double angle = 0.0;
+        double dt = 1.0 / RateHz;
+        for (int i = 0; i * dt < motion.seconds; i++)
+        {
+            double t = i * dt;
+            GestureEvent event;
+            if (detector.update(Sample(motion, t, angle, true), event))
+                events.push_back(event);
+            angle += motion.spinDps(t) * Pi / 180.0 * dt;
+        }
+        return events;
+    }
+
+    /**
+     * @brief ホスト側の判定を真似る．30Hzで届く姿勢の差分から角速度を求め，同じ閾値で判定する
+     */
+    std::vector<GestureEvent> RunHost(const Motion &motion)
+    {
+        GestureDetector detector;
+        std::vector<GestureEvent> events;
+        double angle = 0.0;
+        double previousAngle = 0.0;
+        double previousT = 0.0;
+        double dt = 1.0 / RateHz;
+        double nextFrame = 0.0;
+        for (int i = 0; i * dt < motion.seconds; i++)
+        {
+            double t = i * dt;
+            if (t >= nextFrame)
+            {
+                imu::ImuData d = Sample(motion, t, angle, false);
+                if (t > 0.0)
+                    d.gyro[2] = (float)((angle - previousAngle) * 180.0 / Pi / (t - previousT));
+                GestureEvent event;
+                if (detector.update(d, event))
+                    events.push_back(event);
+                previousAngle = angle;
+                previousT = t;
+                nextFrame += 1.0 / HostRateHz;
+            }
+            angle += motion.spinDps(t) * Pi / 180.0 * dt;
+        }
+        return events;
+    }
+
+    std::string Describe(const std::vector<GestureEvent> &events)
+    {
+        std::string s;
+        for (size_t i = 0; i < events.size(); i++)
+        {
+            char buf[96];
+            snprintf(buf, sizeof(buf), "%s%s(%+d) at %.3f s peak %.0f dur %u ms", i > 0 ? ", " : "",
+                     imu::gesture::GestureEventName((GestureEventType)events[i].type), (int)events[i].direction,
+                     events[i].timestamp / 1e6, events[i].peak, (unsigned)events[i].durationMs);
+            s += buf;
+        }
+        return s.empty() ? "(none)" : s;
+    }
+
+    bool Types(const std::vector<GestureEvent> &events, const std::vector<GestureEventType> &expected)
+    {
+        if (events.size() != expected.size())
+            return false;
+        for (size_t i = 0; i < events.size(); i++)
+        {
+            if (events[i].type != expected[i])
+                return false;
+        }
+        return true;
+    }
+
+    double Ramp(double t, double t0, double t1, double from, double to)
+    {
+        if (t <= t0)
+            return from;
+        if (t >= t1)
+            return to;
+        return from + (to - from) * (t - t0) / (t1 - t0);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        rng.seed((unsigned)atoi(argv[1]));
+    auto none = [](double) { return 0.0; };
+
+    // 0.5秒から0.2秒で720deg/sまで回し，2秒後に0.5秒かけて止める
+    Motion spin = {"spin up / down", 4.0,
+                   [](double t) { return Ramp(t, 0.5, 0.7, 0.0, 720.0) - Ramp(t, 2.7, 3.2, 0.0, 720.0); },
+                   none, false};
+    std::vector<GestureEvent> device = RunDevice(spin);
+    std::vector<GestureEvent> host = RunHost(spin);
+    printf("  %s: %s\n", spin.name, Describe(device).c_str());
+    Check(Types(device, {imu::gesture::GestureSpinStart, imu::gesture::GestureSpinStop}), "spin start and stop detected once");
+    if (device.size() == 2)
+    {
+        Check(device[0].direction == 1 && device[0].peak >= 180.0F, "spinstart reports direction and peak so far");
+        Check(fabsf(device[1].peak - 720.0F) < 10.0F, "spinstop reports the spin's peak rate");
+        // 開始の閾値を超えてから停止の閾値を下回るまで
+        float expectedMs = (float)((3.2 - 0.5 * 60.0 / 720.0) - (0.5 + 0.2 * 180.0 / 720.0)) * 1000.0F;
+        Check(fabsf(device[1].durationMs - expectedMs) < 20.0F, "spinstop reports the spin's duration");
+    }
+    double crossing = 0.5 + 0.2 * 180.0 / 720.0; // 開始の閾値を超えた時刻
+    if (!device.empty() && !host.empty())
+    {
+        double deviceLatency = device[0].timestamp / 1e6 - crossing;
+        double hostLatency = host[0].timestamp / 1e6 - crossing;
+        printf("    spinstart latency: device %.0f ms, host at %d Hz %.0f ms (+ network)\n", deviceLatency * 1e3,
+               HostRateHz, hostLatency * 1e3);
+        Check(deviceLatency < hostLatency, "device detects spin start earlier than host-side 30 Hz detection");
+        Check(deviceLatency < 0.08, "spinstart within 80 ms of crossing the threshold");
+    }
+
+    // 止めずに逆向きへ回す
+    Motion reverse = {"reverse", 4.0,
+                      [](double t) { return Ramp(t, 0.5, 0.6, 0.0, 540.0) - Ramp(t, 1.6, 1.75, 0.0, 1080.0) +
+                                            Ramp(t, 3.0, 3.2, 0.0, 540.0); },
+                      none, false};
+    device = RunDevice(reverse);
+    printf("  %s: %s\n", reverse.name, Describe(device).c_str());
+    Check(Types(device, {imu::gesture::GestureSpinStart, imu::gesture::GestureSpinReverse, imu::gesture::GestureSpinStop}),
+          "reversal reported without a stop in between");
+    if (device.size() == 3)
+        Check(device[1].direction == -1 && device[2].direction == -1, "reversal reports the new direction");
+
+    // 一旦止めてから逆向きに回すのは停止と開始
+    Motion pause = {"stop then reverse", 4.0,
+                    [](double t) { return Ramp(t, 0.5, 0.6, 0.0, 540.0) - Ramp(t, 1.5, 1.6, 0.0, 540.0) -
+                                          Ramp(t, 2.2, 2.3, 0.0, 540.0) + Ramp(t, 3.3, 3.4, 0.0, 540.0); },
+                    none, false};
+    device = RunDevice(pause);
+    printf("  %s: %s\n", pause.name, Describe(device).c_str());
+    Check(Types(device, {imu::gesture::GestureSpinStart, imu::gesture::GestureSpinStop, imu::gesture::GestureSpinStart,
+                         imu::gesture::GestureSpinStop}),
+          "pause longer than release time is stop + start");
+
+    // 4Hzで振る (1周期に山が2つ)
+    Motion shake = {"shake", 3.0, none,
+                    [](double t) { return (t > 1.0 && t < 2.0) ? 3.0 * sin(2.0 * Pi * 4.0 * (t - 1.0)) : 0.0; },
+                    false};
+    device = RunDevice(shake);
+    host = RunHost(shake);
+    printf("  %s: %s\n", shake.name, Describe(device).c_str());
+    Check(Types(device, {imu::gesture::GestureShake}), "shake detected once per burst");
+    if (!device.empty())
+    {
+        Check(fabsf(device[0].peak - 2.0F) < 0.3F, "shake reports peak excess over 1 g");
+        printf("    shake latency from first peak: device %.0f ms, host at %d Hz %s\n",
+               (device[0].timestamp / 1e6 - 1.0625) * 1e3, HostRateHz,
+               host.empty() ? "missed" : std::to_string((int)((host[0].timestamp / 1e6 - 1.0625) * 1e3)).append(" ms").c_str());
+    }
+
+    // 紛らわしい動き: 長軸を水平にした高速回転 (遠心力+回る重力)，ゆっくり振る，静止
+    Motion horizontal = {"horizontal spin", 3.0,
+                         [](double t) { return Ramp(t, 0.5, 0.8, 0.0, 1800.0) - Ramp(t, 2.0, 2.3, 0.0, 1800.0); },
+                         none, true};
+    device = RunDevice(horizontal);
+    printf("  %s: %s\n", horizontal.name, Describe(device).c_str());
+    Check(Types(device, {imu::gesture::GestureSpinStart, imu::gesture::GestureSpinStop}),
+          "no shake while spinning with the IMU off axis");
+
+    Motion wave = {"slow wave", 4.0, [](double t) { return 120.0 * sin(2.0 * Pi * 0.7 * t); },
+                   [](double t) { return 0.4 * sin(2.0 * Pi * 1.4 * t); }, false};
+    device = RunDevice(wave);
+    printf("  %s: %s\n", wave.name, Describe(device).c_str());
+    Check(device.empty(), "slow waving below thresholds is ignored");
+
+    Motion rest = {"rest", 10.0, none, none, false};
+    device = RunDevice(rest);
+    Check(device.empty(), "no events at rest");
+
+    // 閾値を変えると同じ動きでも出なくなる
+    imu::gesture::GestureParams params;
+    params.spinStartDps = 800.0F;
+    params.spinStopDps = 2000.0F; // 開始より大きい値は丸められる
+    params.sanitize();
+    Check(params.spinStopDps < params.spinStartDps, "stop threshold kept below start threshold");
+    GestureDetector tuned;
+    tuned.configure(params);
+    int tunedEvents = 0;
+    for (int i = 0; i < 4 * RateHz; i++)
+    {
+        GestureEvent event;
+        double t = (double)i / RateHz;
+        if (tuned.update(Sample(spin, t, 0.0, true), event))
+            tunedEvents++;
+    }
+    Check(tunedEvents == 0, "raised spin threshold suppresses 720 deg/s spin");
+
+    printf("%s\n", failures == 0 ? "all passed" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
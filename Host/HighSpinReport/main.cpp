@@ -0,0 +1,316 @@
+// 棒を長軸周りに高速で回す動きを合成し，回転数の精度を姿勢推定の設定毎に比べる
+// IMUは回転軸から外れた位置にあり，遠心力が加速度に乗る．角速度は ±2000dps で振り切れる
+// 姿勢推定は ImuReader::fuse() と同じ手順 (振り切れの印 / imu::AccelGate / SetAccelWeight) で回し，
+// 高速回転モードでは ImuReader::setHighSpin() と同じく指数写像で積分する
+//
+// build:
+//   S=../../PlatformIO/src
+//   c++ -std=c++11 -O2 -I$S main.cpp $S/imu/AccelGate.cpp $S/imu/mahony/MahonyAHRS.cpp
+//       $S/imu/madgwick/MadgwickAHRS.cpp $S/imu/gyro/GyroIntegrator.cpp $S/imu/twist/Twist.cpp
+//       -o high_spin_report
+// usage:
+//   ./high_spin_report [rateHz radiusMm seed]
+//   rateHz: サンプリング周波数 (200 / 400 / 1000), radiusMm: 回転軸からIMUまでの距離
+//   終了コード 0: 角速度のレンジ内の回転速度で高速回転モードの回転数の誤差が基準以内で，
+//                 レンジを超える回転速度では振り切れたサンプルに全て印が付いている, 1: 失敗あり
+//   レンジを超える回転速度は回転数を保証できないため，行毎に OUT OF RANGE と示し，最後にその回転速度を挙げる
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include "imu/AccelGate.h"
+#include "imu/FusionFilter.h"
+#include "imu/ImuData.h"
+#include "imu/gyro/GyroIntegrator.h"
+#include "imu/madgwick/MadgwickAHRS.h"
+#include "imu/mahony/MahonyAHRS.h"
+#include "imu/twist/Twist.h"
+
+namespace
+{
+    const double Pi = 3.14159265358979;
+    const double DegToRad = Pi / 180.0;
+    const double Gravity = 9.80665;
+    const float GyroLsbPerDps = 16.4F;   // ±2000dps
+    const float AccelLsbPerG = 4096.0F;  // ±8g
+    const float GyroNoiseDps = 0.05F;    // サンプル毎の雑音
+    const float GyroResidualDps = 0.05F; // オフセット補正の残り
+    const float AccelNoiseG = 0.004F;
+    const double SpinUpSeconds = 1.5;
+    const double HoldSeconds = 10.0;
+    const double RestSeconds = 1.0;
+    const int SpinAxis = 2;              // 棒の長軸 = IMUのZ軸
+    const float MaxTurnErrorDeg = 10.0F; // 振り切れない回転速度での累積角度の誤差の基準
+
+    std::mt19937 rng(1);
+
+    struct Quat
+    {
+        double w, x, y, z;
+    };
+
+    Quat Multiply(const Quat &a, const Quat &b)
+    {
+        return {a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+                a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+                a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+                a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w};
+    }
+
+    Quat AxisAngle(double x, double y, double z, double angle)
+    {
+        double s = sin(0.5 * angle);
+        return {cos(0.5 * angle), x * s, y * s, z * s};
+    }
+
+    void Rotate(const Quat &q, const double *v, double *out)
+    {
+        Quat p = {0.0, v[0], v[1], v[2]};
+        Quat c = {q.w, -q.x, -q.y, -q.z};
+        Quat r = Multiply(Multiply(q, p), c);
+        out[0] = r.x;
+        out[1] = r.y;
+        out[2] = r.z;
+    }
+
+    /**
+     * @brief 回転の合成: 歳差 (鉛直軸周り) * 傾き (手首の揺れ) * 長軸周りの回転
+     */
+    struct SpinMotion
+    {
+        double peakRpm;
+
+        double spinAngle(double t) const
+        {
+            double w = peakRpm * 2.0 * Pi / 60.0;
+            double up = SpinUpSeconds;
+            double hold = HoldSeconds;
+            if (t <= 0.0)
+                return 0.0;
+            if (t < up)
+                return 0.5 * w * t * t / up;
+            if (t < up + hold)
+                return 0.5 * w * up + w * (t - up);
+            double tDown = t - up - hold;
+            if (tDown < up)
+                return 0.5 * w * up + w * hold + w * tDown - 0.5 * w * tDown * tDown / up;
+            return w * (up + hold);
+        }
+
+        Quat orientation(double t) const
+        {
+            double tilt = (20.0 + 5.0 * sin(2.0 * Pi * 0.7 * t)) * DegToRad;
+            double precession = 2.0 * Pi * 0.3 * t;
+            return Multiply(Multiply(AxisAngle(0, 0, 1, precession), AxisAngle(1, 0, 0, tilt)),
+                            AxisAngle(0, 0, 1, spinAngle(t)));
+        }
+
+        double duration() const { return 2.0 * SpinUpSeconds + HoldSeconds + RestSeconds; }
+    };
+
+    float Quantize(double value, float lsb, float fullScale)
+    {
+        double q = floor(value * lsb + 0.5) / lsb;
+        double limit = fullScale * 32767.0 / 32768.0;
+        return (float)fmax(-fullScale, fmin(limit, q));
+    }
+
+    /**
+     * @brief 時刻tの理想的な角速度[deg/s]と加速度[g]を数値微分で求め，センサの雑音と振り切れを加える
+     */
+    void Sense(const SpinMotion &motion, double t, const double *imuPos, float *acc, float *gyro, float *trueGyro)
+    {
+        const double h = 1e-4;
+        Quat q = motion.orientation(t);
+        Quat qn = motion.orientation(t + h);
+        Quat qp = motion.orientation(t - h);
+        // 角速度 (機体座標) = 2 * conj(q) * dq/dt
+        Quat dq = {(qn.w - qp.w) / (2 * h), (qn.x - qp.x) / (2 * h), (qn.y - qp.y) / (2 * h), (qn.z - qp.z) / (2 * h)};
+        Quat rate = Multiply({q.w, -q.x, -q.y, -q.z}, dq);
+        double body[3] = {2.0 * rate.x, 2.0 * rate.y, 2.0 * rate.z};
+
+        // IMUの位置の加速度 (世界座標) を2階差分で求め，比力を機体座標へ
+        double p0[3], pn[3], pp[3];
+        Rotate(q, imuPos, p0);
+        Rotate(qn, imuPos, pn);
+        Rotate(qp, imuPos, pp);
+        double force[3];
+        for (int i = 0; i < 3; i++)
+            force[i] = (pn[i] - 2.0 * p0[i] + pp[i]) / (h * h) / Gravity;
+        force[2] += 1.0;
+        double forceBody[3];
+        Rotate({q.w, -q.x, -q.y, -q.z}, force, forceBody);
+
+        std::normal_distribution<float> gyroNoise(0.0F, GyroNoiseDps);
+        std::normal_distribution<float> accelNoise(0.0F, AccelNoiseG);
+        for (int i = 0; i < 3; i++)
+        {
+            trueGyro[i] = (float)(body[i] / DegToRad);
+            gyro[i] = Quantize(body[i] / DegToRad + GyroResidualDps + gyroNoise(rng), GyroLsbPerDps, imu::GyroFullScaleDps);
+            acc[i] = Quantize(forceBody[i] + accelNoise(rng), AccelLsbPerG, imu::AccelFullScaleG);
+        }
+    }
+
+    struct Result
+    {
+        float finalErrorDeg; // 回し終えた後の累積角度の誤差
+        float maxErrorDeg;   // 途中の最大誤差
+        int32_t countError;  // 回転数 (整数) の差
+        float tiltErrorDeg;  // 長軸の向きの誤差の最大値
+        float saturatedPct;
+        float gatedPct;
+        int unflagged; // 真の角速度がレンジを明らかに超えたのに振り切れの印がないサンプル数
+    };
+
+    float AxisAngleError(const float *estimate, const Quat &truth)
+    {
+        const double axis[3] = {0.0, 0.0, 1.0};
+        double a[3], b[3];
+        Rotate({estimate[0], estimate[1], estimate[2], estimate[3]}, axis, a);
+        Rotate(truth, axis, b);
+        double dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+        return (float)(acos(fmax(-1.0, fmin(1.0, dot))) / DegToRad);
+    }
+
+    /**
+     * @brief 1つの設定で合成した動きを最後まで推定する
+     *
+     * @param highSpin true: 高速回転モード (加速度による補正の重みを AccelGate で決める)
+     */
+    Result Run(imu::FusionFilter &filter, bool highSpin, const SpinMotion &motion, int rateHz, const double *imuPos,
+               unsigned seed)
+    {
+        rng.seed(seed);
+        filter.Reset();
+        imu::AccelGate gate;
+        imu::twist::TwistCounter estimated;
+        imu::twist::TwistCounter reference;
+        Quat q0 = motion.orientation(0.0);
+        float quat[4] = {(float)q0.w, (float)q0.x, (float)q0.y, (float)q0.z};
+        estimated.update(quat);
+        reference.update(quat);
+
+        Result result = {0.0F, 0.0F, 0, 0.0F, 0.0F, 0.0F, 0};
+        float dt = 1.0F / rateHz;
+        int samples = (int)(motion.duration() * rateHz);
+        int saturated = 0;
+        int gated = 0;
+        imu::twist::TwistData est;
+        imu::twist::TwistData ref;
+        for (int n = 1; n <= samples; n++)
+        {
+            double t = (double)n / rateHz;
+            float acc[3], gyro[3], trueGyro[3];
+            Sense(motion, t, imuPos, acc, gyro, trueGyro);
+
+            // ImuReader::fuse() と同じ
+            uint32_t flags = imu::SaturationFlags(acc, gyro);
+            float accelWeight = 1.0F;
+            if (highSpin)
+            {
+                accelWeight = gate.update(acc, dt);
+                if (accelWeight < 1.0F)
+                    flags |= imu::ImuFlagAccelGated;
+            }
+            filter.SetAccelWeight(accelWeight);
+            filter.SetExactIntegration(highSpin);
+            filter.UpdateQuaternion(gyro[0] * (float)DegToRad, gyro[1] * (float)DegToRad, gyro[2] * (float)DegToRad,
+                                    acc[0], acc[1], acc[2], dt, quat[0], quat[1], quat[2], quat[3]);
+            if (flags & imu::ImuFlagGyroSaturated)
+                saturated++;
+            else if (fmaxf(fabsf(trueGyro[0]), fmaxf(fabsf(trueGyro[1]), fabsf(trueGyro[2]))) >=
+                     imu::GyroFullScaleDps + 5.0F * GyroNoiseDps)
+                result.unflagged++;
+            if (flags & imu::ImuFlagAccelGated)
+                gated++;
+
+            Quat truth = motion.orientation(t);
+            float truthQuat[4] = {(float)truth.w, (float)truth.x, (float)truth.y, (float)truth.z};
+            estimated.update(quat);
+            reference.update(truthQuat);
+            estimated.read(est);
+            reference.read(ref);
+            float error = est.totalDegree[SpinAxis] - ref.totalDegree[SpinAxis];
+            result.maxErrorDeg = fmaxf(result.maxErrorDeg, fabsf(error));
+            result.finalErrorDeg = error;
+            result.countError = est.count[SpinAxis] - ref.count[SpinAxis];
+            result.tiltErrorDeg = fmaxf(result.tiltErrorDeg, AxisAngleError(quat, truth));
+        }
+        result.saturatedPct = 100.0F * saturated / samples;
+        result.gatedPct = 100.0F * gated / samples;
+        return result;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int rateHz = (argc > 1) ? atoi(argv[1]) : 200;
+    double radiusMm = (argc > 2) ? atof(argv[2]) : 30.0;
+    unsigned seed = (argc > 3) ? (unsigned)atoi(argv[3]) : 1;
+    if (rateHz <= 0)
+        rateHz = 200;
+    const double imuPos[3] = {radiusMm * 1e-3, 0.0, 0.05};
+
+    const double rpms[] = {60.0, 150.0, 250.0, 320.0, 400.0};
+    printf("rate %d Hz, IMU %.0f mm off axis, spin up %.1f s / hold %.0f s / down %.1f s\n",
+           rateHz, radiusMm, SpinUpSeconds, HoldSeconds, SpinUpSeconds);
+    printf("%-7s %-18s %10s %10s %6s %9s %6s %6s  %s\n",
+           "rpm", "mode", "final[deg]", "max[deg]", "count", "tilt[deg]", "sat%", "gate%", "verdict");
+
+    bool ok = true;
+    std::string outOfRange;
+    for (double rpm : rpms)
+    {
+        SpinMotion motion = {rpm};
+        imu::mahony::MahonyAHRS mahony;
+        imu::madgwick::MadgwickAHRS madgwick;
+        imu::gyro::GyroIntegrator gyroExp;
+        struct
+        {
+            const char *name;
+            imu::FusionFilter *filter;
+            bool highSpin;
+        } modes[] = {
+            {"mahony", &mahony, false},
+            {"mahony+highspin", &mahony, true},
+            {"madgwick", &madgwick, false},
+            {"madgwick+highspin", &madgwick, true},
+            {"gyroexp", &gyroExp, false},
+        };
+        bool saturatedRpm = false;
+        for (const auto &mode : modes)
+        {
+            Result r = Run(*mode.filter, mode.highSpin, motion, rateHz, imuPos, seed);
+            // 振り切れない回転速度では，高速回転モードの回転数は基準以内であること
+            // 振り切れる回転速度では回転数を保証しない代わりに，振り切れたサンプルに全て印が付いていること
+            const char *verdict = "";
+            if (r.saturatedPct > 0.0F)
+            {
+                saturatedRpm = true;
+                verdict = (r.unflagged == 0) ? "OUT OF RANGE (flagged)" : "NG: saturation not flagged";
+                ok = ok && r.unflagged == 0;
+            }
+            else if (mode.highSpin)
+            {
+                verdict = (fabsf(r.finalErrorDeg) <= MaxTurnErrorDeg) ? "ok" : "NG";
+                ok = ok && fabsf(r.finalErrorDeg) <= MaxTurnErrorDeg;
+            }
+            printf("%-7.0f %-18s %10.1f %10.1f %6d %9.1f %6.1f %6.1f  %s\n", rpm, mode.name, r.finalErrorDeg,
+                   r.maxErrorDeg, (int)r.countError, r.tiltErrorDeg, r.saturatedPct, r.gatedPct, verdict);
+        }
+        if (saturatedRpm)
+            outOfRange += " " + std::to_string((int)rpm);
+    }
+    if (!outOfRange.empty())
+        printf("out of gyro range (+-%.0f dps), turn count not guaranteed:%s rpm\n", imu::GyroFullScaleDps,
+               outOfRange.c_str());
+    if (!ok)
+        printf("FAILED\n");
+    else if (outOfRange.empty())
+        printf("all passed\n");
+    else
+        printf("passed within gyro range (saturated rates flagged, not passed)\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,266 @@
+// SendImuBundle() と同じ手順 (imu::ImuDataBuffer から取り出し，osc::WriteImuBundle で詰める) で作ったバンドルを
+// デコードし，サンプルが欠けたり入れ替わったりしないことを確かめる．MTUや batchMaxSamples での分割と，
+// バッチを無効にして有効にし直したときに古いサンプルを送らないことも確かめる
+//
+// build:
+//   S=../../PlatformIO/src
+//   c++ -std=c++11 -O2 -I$S main.cpp $S/osc/ImuBundle.cpp $S/osc/OscPacketWriter.cpp $S/osc/OscMessageReader.cpp
+//       -o imu_bundle_check
+// usage:
+//   ./imu_bundle_check
+//   終了コード 0: 全て期待どおり, 1: 失敗あり
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "imu/ImuData.h"
+#include "imu/ImuDataBuffer.h"
+#include "osc/ImuBundle.h"
+#include "osc/OscMessageReader.h"
+#include "osc/OscPacketWriter.h"
+
+namespace
+{
+    const int ImuArgNum = 1 + imu::ImuXyz * 2 + imu::ImuWxyz; // timestamp, acc[3], gyro[3], quat[4]
+
+    int failures = 0;
+
+    void Check(bool condition, const char *what)
+    {
+        printf("%s: %s\n", condition ? "ok" : "NG", what);
+        if (!condition)
+            failures++;
+    }
+
+    /**
+     * @brief 番号から一意に決まるサンプル．デコードした値と比べる
+     */
+    imu::ImuData MakeSample(uint32_t index)
+    {
+        imu::ImuData d;
+        d.timestamp = 1000000U + index * 5000U; // 200Hz
+        for (int i = 0; i < imu::ImuXyz; i++)
+        {
+            d.acc[i] = 0.001F * index + i;
+            d.gyro[i] = -0.5F * index - i;
+        }
+        float angle = 0.01F * index;
+        d.quat[0] = cosf(angle);
+        d.quat[3] = sinf(angle);
+        return d;
+    }
+
+    bool SameSample(const imu::ImuData &a, const imu::ImuData &b)
+    {
+        return a.timestamp == b.timestamp && memcmp(a.acc, b.acc, sizeof(a.acc)) == 0 &&
+               memcmp(a.gyro, b.gyro, sizeof(a.gyro)) == 0 && memcmp(a.quat, b.quat, sizeof(a.quat)) == 0;
+    }
+
+    struct Packet
+    {
+        std::vector<uint8_t> bytes;
+    };
+
+    /**
+     * @brief SendImuBundle() と同じく溜まった分を全て取り出し，分割して詰める
+     */
+    std::vector<Packet> SendImuBundle(imu::ImuDataBuffer &buffer, const char *addr, int maxSamples)
+    {
+        static imu::ImuData batch[imu::ImuDataBufferSize];
+        static uint8_t oscPacket[osc::OscPacketMaxLen];
+        std::vector<Packet> packets;
+        int n = 0;
+        while (n < imu::ImuDataBufferSize && buffer.pop(batch[n]))
+            n++;
+        osc::OscPacketWriter writer(oscPacket, sizeof(oscPacket));
+        int i = 0;
+        while (i < n)
+        {
+            int packed = osc::WriteImuBundle(writer, addr, &batch[i], n - i, maxSamples);
+            if (packed == 0)
+                break;
+            Packet p;
+            p.bytes.assign(writer.data(), writer.data() + writer.size());
+            packets.push_back(p);
+            i += packed;
+        }
+        return packets;
+    }
+
+    uint32_t ReadUint32(const uint8_t *p)
+    {
+        return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
+    }
+
+    /**
+     * @brief バンドルを開いて /imu のサンプルを取り出す
+     *
+     * @return true 正常終了
+     * @return false 異常終了 バンドルでない，要素のサイズが合わない，アドレスか型が違う
+     */
+    bool DecodeBundle(const Packet &packet, const char *addr, std::vector<imu::ImuData> &out, int &outCount)
+    {
+        const uint8_t *data = packet.bytes.data();
+        size_t len = packet.bytes.size();
+        outCount = 0;
+        if (len < 16 || memcmp(data, "#bundle", 8) != 0)
+            return false;
+        size_t pos = 16;
+        while (pos < len)
+        {
+            if (pos + 4 > len)
+                return false;
+            uint32_t size = ReadUint32(data + pos);
+            pos += 4;
+            if (size > len - pos || size % 4 != 0)
+                return false;
+            osc::OscMessageReader m;
+            if (!m.parse(data + pos, size) || strcmp(m.address(), addr) != 0 || strcmp(m.typeTags(), "iffffffffff") != 0 ||
+                m.argCount() != ImuArgNum)
+                return false;
+            imu::ImuData d;
+            d.timestamp = (uint32_t)m.getInt32(0);
+            for (int i = 0; i < imu::ImuXyz; i++)
+            {
+                d.acc[i] = m.getFloat(1 + i);
+                d.gyro[i] = m.getFloat(1 + imu::ImuXyz + i);
+            }
+            for (int i = 0; i < imu::ImuWxyz; i++)
+                d.quat[i] = m.getFloat(1 + imu::ImuXyz * 2 + i);
+            out.push_back(d);
+            outCount++;
+            pos += size;
+        }
+        return true;
+    }
+
+    /**
+     * @brief 送ったパケットを全てデコードし，first から連続した count 個のサンプルになっているかを確かめる
+     */
+    void CheckStream(const char *name, const std::vector<Packet> &packets, const char *addr, uint32_t first, int count,
+                     int maxPerBundle)
+    {
+        std::vector<imu::ImuData> decoded;
+        bool wellFormed = true;
+        bool sizeOk = true;
+        bool perBundleOk = true;
+        for (size_t i = 0; i < packets.size(); i++)
+        {
+            int n;
+            if (!DecodeBundle(packets[i], addr, decoded, n))
+                wellFormed = false;
+            if (packets[i].bytes.size() > osc::OscPacketMaxLen)
+                sizeOk = false;
+            if (n == 0 || n > maxPerBundle)
+                perBundleOk = false;
+        }
+        bool inOrder = (int)decoded.size() == count;
+        for (int i = 0; inOrder && i < count; i++)
+            inOrder = SameSample(decoded[i], MakeSample(first + i));
+        printf("  %s: %d samples in %d bundles\n", name, (int)decoded.size(), (int)packets.size());
+        std::string prefix(name);
+        Check(wellFormed, (prefix + ": bundles decode").c_str());
+        Check(sizeOk, (prefix + ": every bundle fits in one UDP payload").c_str());
+        Check(perBundleOk, (prefix + ": bundle sizes within limit").c_str());
+        Check(inOrder, (prefix + ": no sample lost, reordered or altered").c_str());
+    }
+
+} // namespace
+
+int main()
+{
+    std::string shortAddr = "/stick01/imu";
+    std::string longAddr = "/" + std::string(31, 'k') + "/imu"; // StreamConfig::uniqueId の最大長
+
+    // 満杯まで溜めて1回で送る．長い uniqueId ではMTUで分割される
+    {
+        imu::ImuDataBuffer buffer;
+        for (uint32_t i = 0; i < imu::ImuDataBufferSize; i++)
+            buffer.push(MakeSample(i));
+        std::vector<Packet> packets = SendImuBundle(buffer, longAddr.c_str(), imu::ImuDataBufferSize);
+        CheckStream("full buffer, long id", packets, longAddr.c_str(), 0, imu::ImuDataBufferSize, imu::ImuDataBufferSize);
+        Check(packets.size() > 1, "full buffer, long id: split across MTU-sized bundles");
+    }
+
+    // batchMaxSamples で分割する．端数が最後のバンドルに入る
+    {
+        imu::ImuDataBuffer buffer;
+        for (uint32_t i = 0; i < 23; i++)
+            buffer.push(MakeSample(100 + i));
+        std::vector<Packet> packets = SendImuBundle(buffer, shortAddr.c_str(), 5);
+        CheckStream("maxSamples 5", packets, shortAddr.c_str(), 100, 23, 5);
+        Check(packets.size() == 5, "maxSamples 5: 23 samples make 5 bundles");
+    }
+
+    // 送信周期毎に溜まった分を送り続ける．周期をまたいでも連続している
+    {
+        imu::ImuDataBuffer buffer;
+        std::vector<Packet> packets;
+        uint32_t next = 0;
+        for (int cycle = 0; cycle < 50; cycle++)
+        {
+            int produced = 1 + cycle % 13; // 送信タスクの起床の揺らぎ
+            for (int i = 0; i < produced; i++)
+                buffer.push(MakeSample(next++));
+            std::vector<Packet> sent = SendImuBundle(buffer, shortAddr.c_str(), 8);
+            packets.insert(packets.end(), sent.begin(), sent.end());
+        }
+        CheckStream("50 send cycles", packets, shortAddr.c_str(), 0, (int)next, 8);
+    }
+
+    // 溢れた分は新しい方を捨てる．送れた分は連続している
+    {
+        imu::ImuDataBuffer buffer;
+        for (uint32_t i = 0; i < imu::ImuDataBufferSize + 6; i++)
+            buffer.push(MakeSample(i));
+        Check(buffer.dropped() == 6, "overflow: 6 samples counted as dropped");
+        std::vector<Packet> packets = SendImuBundle(buffer, shortAddr.c_str(), imu::ImuDataBufferSize);
+        CheckStream("overflow", packets, shortAddr.c_str(), 0, imu::ImuDataBufferSize, imu::ImuDataBufferSize);
+    }
+
+    // imu::BatchIntervalMaxMs() の間隔なら，送信タスクの起床が半周期遅れても溢れない．以前の上限1000msでは溢れる
+    {
+        const int rates[] = {200, 400, 500, 1000};
+        bool fits = true;
+        for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++)
+        {
+            int intervalMs = imu::BatchIntervalMaxMs(rates[r]);
+            int samples = (intervalMs + intervalMs / 2) * rates[r] / 1000 + 1; // 端数で1つ多く入る場合も含める
+            imu::ImuDataBuffer buffer;
+            for (int i = 0; i < samples; i++)
+                buffer.push(MakeSample((uint32_t)i));
+            fits = fits && buffer.dropped() == 0;
+        }
+        Check(fits, "BatchIntervalMaxMs: 1.5 intervals of samples fit at 200/400/500/1000 Hz");
+        imu::ImuDataBuffer buffer;
+        for (int i = 0; i < 1000 * 200 / 1000; i++)
+            buffer.push(MakeSample((uint32_t)i));
+        Check(buffer.dropped() > 0, "1000 ms at 200 Hz would overflow the buffer");
+    }
+
+    // バッチを無効にしたときに残ったサンプルは，有効にし直したとき (batchResetRequested) に捨てる
+    {
+        imu::ImuDataBuffer buffer;
+        for (uint32_t i = 0; i < 10; i++)
+            buffer.push(MakeSample(i)); // 無効にする直前に溜まった分
+        buffer.clear();                 // SendOscLoop が batchResetRequested を受けて捨てる
+        for (uint32_t i = 0; i < 7; i++)
+            buffer.push(MakeSample(500 + i));
+        std::vector<Packet> packets = SendImuBundle(buffer, shortAddr.c_str(), imu::ImuDataBufferSize);
+        CheckStream("re-enabled", packets, shortAddr.c_str(), 500, 7, imu::ImuDataBufferSize);
+    }
+
+    // 1サンプルも収まらないアドレスでは何も送らない
+    {
+        uint8_t packet[osc::OscPacketMaxLen];
+        osc::OscPacketWriter writer(packet, sizeof(packet));
+        std::string hugeAddr = "/" + std::string(osc::OscPacketMaxLen, 'x') + "/imu";
+        imu::ImuData sample = MakeSample(0);
+        Check(osc::WriteImuBundle(writer, hugeAddr.c_str(), &sample, 1, 1) == 0, "address too long: nothing packed");
+    }
+
+    printf("%s\n", failures == 0 ? "all passed" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
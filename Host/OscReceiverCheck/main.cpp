@@ -0,0 +1,366 @@
+// osc::OscReceiver で開いたポートへローカルのUDPでコマンドを送り，ReceiveOscLoop と同じ手順
+// (wait() -> receive() を空になるまで -> osc::OscDispatcher::dispatch()) でハンドラが呼ばれることを確かめる
+// バンドル (入れ子，深すぎるもの，途中で切れたもの)，型の違い / 引数の不足 / 未登録のアドレス / 壊れたパケット，
+// 送信元の取得と sendTo() での返信，wait() のタイムアウトと閉じたソケットでのエラーも確かめる
+//
+// build:
+//   S=../../PlatformIO/src
+//   c++ -std=c++11 -O2 -I$S main.cpp $S/osc/OscReceiver.cpp $S/osc/OscDispatcher.cpp $S/osc/OscMessageReader.cpp
+//       $S/osc/OscPacketWriter.cpp -o osc_receiver_check
+// usage:
+//   ./osc_receiver_check [port]   (default: 39002)
+//   終了コード 0: 全て期待どおり, 1: 失敗あり
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "osc/OscDispatcher.h"
+#include "osc/OscMessageReader.h"
+#include "osc/OscPacketWriter.h"
+#include "osc/OscReceiver.h"
+
+namespace
+{
+    const uint32_t WaitMs = 200;
+
+    int failures = 0;
+
+    void Check(bool condition, const char *what)
+    {
+        printf("%s: %s\n", condition ? "ok" : "NG", what);
+        if (!condition)
+            failures++;
+    }
+
+    /**
+     * @brief ハンドラが受け取った内容．ハンドラは関数ポインタのため，ここに書き残す
+     */
+    struct Call
+    {
+        std::string address;
+        float f0, f1;
+        int32_t i0;
+        std::string s0;
+        uint32_t remoteAddress;
+        uint16_t remotePort;
+    };
+    std::vector<Call> calls;
+
+    Call Record(const osc::OscMessageReader &m)
+    {
+        Call c;
+        c.address = m.address();
+        c.f0 = m.getFloat(0);
+        c.f1 = m.getFloat(1);
+        c.i0 = m.getInt32(0);
+        c.s0 = m.getString(0);
+        c.remoteAddress = m.remoteAddress();
+        c.remotePort = m.remotePort();
+        return c;
+    }
+
+    void OnGains(const osc::OscMessageReader &m) { calls.push_back(Record(m)); }
+    void OnFilter(const osc::OscMessageReader &m) { calls.push_back(Record(m)); }
+    void OnHostIp(const osc::OscMessageReader &m) { calls.push_back(Record(m)); }
+    void OnPing(const osc::OscMessageReader &m) { calls.push_back(Record(m)); }
+
+    /**
+     * @brief ReceiveOscLoop の1周分．届いている分を全て振り分ける
+     *
+     * @return int 読んだパケットの数
+     */
+    int Pump(osc::OscReceiver &receiver, osc::OscDispatcher &dispatcher)
+    {
+        static uint8_t packet[osc::OscPacketMaxLen];
+        if (receiver.wait(WaitMs) <= 0)
+            return 0;
+        int packets = 0;
+        uint32_t remoteAddr;
+        uint16_t remotePort;
+        int len;
+        while ((len = receiver.receive(packet, sizeof(packet), remoteAddr, remotePort)) > 0)
+        {
+            dispatcher.dispatch(packet, len, remoteAddr, remotePort, 0);
+            packets++;
+        }
+        return packets;
+    }
+
+    /**
+     * @brief コマンドを送る側 (ホストのアプリの代わり)
+     */
+    struct Client
+    {
+        int sock;
+        uint16_t port; // 自分のポート (ネットワークバイトオーダーではない)
+        struct sockaddr_in to;
+
+        bool open(uint16_t devicePort)
+        {
+            sock = socket(AF_INET, SOCK_DGRAM, 0);
+            if (sock < 0)
+                return false;
+            struct sockaddr_in local;
+            memset(&local, 0, sizeof(local));
+            local.sin_family = AF_INET;
+            local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            if (bind(sock, (struct sockaddr *)&local, sizeof(local)) < 0)
+                return false;
+            socklen_t len = sizeof(local);
+            getsockname(sock, (struct sockaddr *)&local, &len);
+            port = ntohs(local.sin_port);
+            memset(&to, 0, sizeof(to));
+            to.sin_family = AF_INET;
+            to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            to.sin_port = htons(devicePort);
+            return true;
+        }
+
+        void send(const uint8_t *data, size_t len)
+        {
+            sendto(sock, data, len, 0, (struct sockaddr *)&to, sizeof(to));
+        }
+
+        void send(const osc::OscPacketWriter &writer) { send(writer.data(), writer.size()); }
+
+        int receive(uint8_t *buffer, size_t capacity, int timeoutMs)
+        {
+            struct timeval timeout;
+            timeout.tv_sec = 0;
+            timeout.tv_usec = timeoutMs * 1000;
+            setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            return (int)recv(sock, buffer, capacity, 0);
+        }
+    };
+
+    /**
+     * @brief バンドルの要素 (サイズ + 中身) を後ろに付け足す．入れ子のバンドルを組み立てるのに使う
+     */
+    void AppendElement(std::vector<uint8_t> &bundle, const uint8_t *data, size_t len)
+    {
+        uint32_t size = (uint32_t)len;
+        uint8_t header[4] = {(uint8_t)(size >> 24), (uint8_t)(size >> 16), (uint8_t)(size >> 8), (uint8_t)size};
+        bundle.insert(bundle.end(), header, header + 4);
+        bundle.insert(bundle.end(), data, data + len);
+    }
+
+    std::vector<uint8_t> EmptyBundle()
+    {
+        static const uint8_t head[16] = {'#', 'b', 'u', 'n', 'd', 'l', 'e', 0, 0, 0, 0, 0, 0, 0, 0, 1};
+        return std::vector<uint8_t>(head, head + sizeof(head));
+    }
+
+    std::vector<uint8_t> Message(const char *addr, const char *tags, int32_t i, float f)
+    {
+        uint8_t buffer[128];
+        osc::OscPacketWriter writer(buffer, sizeof(buffer));
+        writer.beginMessage(addr, tags);
+        for (const char *t = tags + 1; *t != '\0'; t++)
+        {
+            if (*t == 'i')
+                writer.writeInt32(i);
+            else if (*t == 'f')
+                writer.writeFloat(f);
+            else if (*t == 's')
+                writer.writeString("192.168.1.10");
+        }
+        writer.endMessage();
+        return std::vector<uint8_t>(writer.data(), writer.data() + writer.size());
+    }
+
+    /**
+     * @brief 送って1周分処理し，呼ばれたハンドラと未処理の増え方を返す
+     */
+    struct Outcome
+    {
+        int packets;
+        size_t calls;
+        uint32_t unhandled;
+    };
+
+    Outcome Deliver(Client &client, osc::OscReceiver &receiver, osc::OscDispatcher &dispatcher,
+                    const std::vector<uint8_t> &packet)
+    {
+        calls.clear();
+        uint32_t before = dispatcher.unhandled();
+        client.send(packet.data(), packet.size());
+        Outcome o;
+        o.packets = Pump(receiver, dispatcher);
+        o.calls = calls.size();
+        o.unhandled = dispatcher.unhandled() - before;
+        return o;
+    }
+
+    typedef std::chrono::steady_clock Clock;
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    uint16_t port = (uint16_t)(argc > 1 ? atoi(argv[1]) : 39002);
+
+    // 閉じたソケットでは待たずにエラーを返す (ReceiveOscLoop が空回りせず開き直せる)
+    {
+        osc::OscReceiver closed;
+        Clock::time_point start = Clock::now();
+        int result = closed.wait(WaitMs);
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        Check(result < 0 && ms < WaitMs / 2, "wait() on a closed receiver fails at once");
+        uint32_t a;
+        uint16_t p;
+        uint8_t b[4];
+        Check(closed.receive(b, sizeof(b), a, p) < 0, "receive() on a closed receiver fails");
+    }
+
+    osc::OscReceiver receiver;
+    if (!receiver.begin(port))
+    {
+        fprintf(stderr, "cannot open port %u\n", port);
+        return 1;
+    }
+    Check(receiver.isOpen(), "begin() opens the port");
+    {
+        Clock::time_point start = Clock::now();
+        int result = receiver.wait(WaitMs);
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        Check(result == 0 && ms >= WaitMs * 0.8, "wait() times out with 0 when nothing arrives");
+    }
+
+    osc::OscDispatcher dispatcher;
+    dispatcher.subscribe("/set/gains", ",ff", OnGains);
+    dispatcher.subscribe("/set/filter", ",i", OnFilter);
+    dispatcher.subscribe("/set/hostip", ",s", OnHostIp);
+    dispatcher.subscribe("/ping", "", OnPing);
+
+    Client client;
+    if (!client.open(port))
+    {
+        fprintf(stderr, "cannot open the client socket\n");
+        return 1;
+    }
+
+    // 単独のメッセージ
+    {
+        std::vector<uint8_t> packet = Message("/set/gains", ",ff", 0, 2.5F);
+        Outcome o = Deliver(client, receiver, dispatcher, packet);
+        Check(o.packets == 1 && o.calls == 1 && calls[0].address == "/set/gains" && calls[0].f0 == 2.5F &&
+                  calls[0].f1 == 2.5F,
+              "message: handler called with its float arguments");
+        Check(o.calls == 1 && calls[0].remoteAddress == htonl(INADDR_LOOPBACK) && calls[0].remotePort == client.port,
+              "message: sender address and port reach the handler");
+
+        o = Deliver(client, receiver, dispatcher, Message("/set/gains", ",if", 3, 0.5F));
+        Check(o.calls == 1 && calls[0].f0 == 3.0F && calls[0].f1 == 0.5F, "i accepted where f is expected (converted)");
+        o = Deliver(client, receiver, dispatcher, Message("/set/filter", ",f", 0, 2.0F));
+        Check(o.calls == 1 && calls[0].i0 == 2, "f accepted where i is expected (converted)");
+        o = Deliver(client, receiver, dispatcher, Message("/set/hostip", ",s", 0, 0.0F));
+        Check(o.calls == 1 && calls[0].s0 == "192.168.1.10", "string argument");
+        o = Deliver(client, receiver, dispatcher, Message("/set/gains", ",fff", 0, 1.0F));
+        Check(o.calls == 1 && o.unhandled == 0, "extra arguments are ignored");
+    }
+
+    // 型の違い / 引数の不足 / 未登録 / 壊れたパケット
+    {
+        Outcome o = Deliver(client, receiver, dispatcher, Message("/set/gains", ",s", 0, 0.0F));
+        Check(o.packets == 1 && o.calls == 0 && o.unhandled == 1, "type mismatch (s for ff): not dispatched, counted");
+        o = Deliver(client, receiver, dispatcher, Message("/set/hostip", ",i", 5, 0.0F));
+        Check(o.calls == 0 && o.unhandled == 1, "type mismatch (i for s): not dispatched, counted");
+        o = Deliver(client, receiver, dispatcher, Message("/set/gains", ",f", 0, 1.0F));
+        Check(o.calls == 0 && o.unhandled == 1, "too few arguments: not dispatched, counted");
+        o = Deliver(client, receiver, dispatcher, Message("/set/unknown", ",i", 1, 0.0F));
+        Check(o.calls == 0 && o.unhandled == 1, "unknown address: counted as unhandled");
+        const uint8_t garbage[] = {0x12, 0x34, 0x56};
+        o = Deliver(client, receiver, dispatcher, std::vector<uint8_t>(garbage, garbage + sizeof(garbage)));
+        Check(o.packets == 1 && o.calls == 0 && o.unhandled == 1, "malformed packet: counted, nothing called");
+    }
+
+    // バンドル
+    {
+        uint8_t buffer[osc::OscPacketMaxLen];
+        osc::OscPacketWriter writer(buffer, sizeof(buffer));
+        writer.beginBundle();
+        writer.beginMessage("/set/gains", ",ff");
+        writer.writeFloat(1.0F);
+        writer.writeFloat(0.1F);
+        writer.endMessage();
+        writer.beginMessage("/set/gains", ",s"); // 型違いの要素は飛ばし，残りは処理する
+        writer.writeString("x");
+        writer.endMessage();
+        writer.beginMessage("/set/filter", ",i");
+        writer.writeInt32(1);
+        writer.endMessage();
+        writer.beginMessage("/ping", ",");
+        writer.endMessage();
+        std::vector<uint8_t> bundle(writer.data(), writer.data() + writer.size());
+        Outcome o = Deliver(client, receiver, dispatcher, bundle);
+        Check(o.packets == 1 && o.calls == 3 && o.unhandled == 1 && calls[0].address == "/set/gains" &&
+                  calls[1].address == "/set/filter" && calls[2].address == "/ping",
+              "bundle: elements dispatched in order, mismatched element skipped");
+
+        // 入れ子は OscDispatcherMaxBundleDepth まで
+        std::vector<uint8_t> ping = Message("/ping", ",", 0, 0.0F);
+        std::vector<uint8_t> nested = ping;
+        for (int depth = 1; depth <= osc::OscDispatcherMaxBundleDepth; depth++)
+        {
+            std::vector<uint8_t> outer = EmptyBundle();
+            AppendElement(outer, nested.data(), nested.size());
+            nested = outer;
+        }
+        o = Deliver(client, receiver, dispatcher, nested);
+        Check(o.calls == 1, "nested bundles up to the depth limit are dispatched");
+        std::vector<uint8_t> tooDeep = EmptyBundle();
+        AppendElement(tooDeep, nested.data(), nested.size());
+        o = Deliver(client, receiver, dispatcher, tooDeep);
+        Check(o.packets == 1 && o.calls == 0, "bundles nested beyond the limit are dropped");
+
+        // 要素の長さがパケットを超える: そこで止め，前の要素は処理する
+        std::vector<uint8_t> truncated = EmptyBundle();
+        AppendElement(truncated, ping.data(), ping.size());
+        AppendElement(truncated, ping.data(), ping.size());
+        truncated.resize(truncated.size() - 4);
+        o = Deliver(client, receiver, dispatcher, truncated);
+        Check(o.calls == 1, "truncated bundle: complete elements dispatched, the cut one dropped");
+    }
+
+    // 続けて届いたパケットは1回の待ちで全て処理する
+    {
+        calls.clear();
+        std::vector<uint8_t> ping = Message("/ping", ",", 0, 0.0F);
+        for (int i = 0; i < 20; i++)
+            client.send(ping.data(), ping.size());
+        usleep(20000);
+        int packets = Pump(receiver, dispatcher);
+        Check(packets == 20 && calls.size() == 20, "burst of 20 packets drained after one wait()");
+    }
+
+    // 受信したソケットから送信元へ返信する (/ping への /pong)
+    {
+        uint8_t buffer[64];
+        osc::OscPacketWriter writer(buffer, sizeof(buffer));
+        writer.beginMessage("/pong", ",i");
+        writer.writeInt32(42);
+        writer.endMessage();
+        bool sent = receiver.sendTo(writer.data(), writer.size(), htonl(INADDR_LOOPBACK), client.port);
+        uint8_t reply[64];
+        int len = client.receive(reply, sizeof(reply), 500);
+        osc::OscMessageReader reader;
+        Check(sent && len == (int)writer.size() && reader.parse(reply, len) && strcmp(reader.address(), "/pong") == 0 &&
+                  reader.getInt32(0) == 42,
+              "sendTo() reply reaches the sender");
+    }
+
+    receiver.end();
+    Check(!receiver.isOpen() && receiver.wait(WaitMs) < 0, "after end(): wait() reports an error");
+    Check(receiver.begin(port) && receiver.isOpen(), "begin() reopens the port after end()");
+
+    close(client.sock);
+    printf("%s\n", failures == 0 ? "all passed" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,314 @@
+// 周期送信の /quat と /twist を作る手順を，旧経路と現在の経路でそれぞれ繰り返し，
+// 1回の送信当たりのヒープ確保 (回数 / byte) と時間を比べる．送るバイト列が同じであることも確かめる
+//   旧経路: 送信毎に "/" + uniqueId + "/quat" を連結し，ArduinoOSC の OscWiFi.send() と同じく
+//           アドレス / タイプタグ / 引数の配列を持つメッセージを組み立ててからエンコードする
+//           (ArduinoOSC はホストでビルドできないため，確保の仕方を std::string / std::vector で写したもの)
+//   現在:   SendOscLoop と同じく streamConfig.tryRead() で世代だけ確かめ，
+//           osc::OscPreencodedMessage の引数をその場で書き換える
+//
+// build:
+//   S=../../PlatformIO/src
+//   c++ -std=c++11 -O2 -I$S main.cpp $S/osc/OscPreencodedMessage.cpp $S/osc/OscPacketWriter.cpp -o osc_send_bench
+// usage:
+//   ./osc_send_bench [sends]   (default: 200000回)
+//   終了コード 0: バイト列が一致し，現在の経路がヒープを使わない, 1: 失敗あり
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+#include "concurrent/SeqLock.h"
+#include "osc/OscPreencodedMessage.h"
+
+namespace
+{
+    // operator new を数える．測る区間の前後の差を取る
+    size_t allocCount = 0;
+    size_t allocBytes = 0;
+}
+
+void *operator new(size_t size)
+{
+    allocCount++;
+    allocBytes += size;
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+namespace
+{
+    const int TwistAxisNum = 3;
+
+    int failures = 0;
+
+    void Check(bool condition, const char *what)
+    {
+        printf("%s: %s\n", condition ? "ok" : "NG", what);
+        if (!condition)
+            failures++;
+    }
+
+    /**
+     * @brief main.cpp の StreamConfig と同じ形
+     */
+    struct StreamConfig
+    {
+        char uniqueId[32];
+        uint32_t destinations[4];
+        int destinationCount;
+    };
+
+    /**
+     * @brief 1回の送信で使う値．送信毎に少しずつ変える
+     */
+    struct Pose
+    {
+        float quat[4];
+        float twistDegree[TwistAxisNum];
+        int32_t twistCount[TwistAxisNum];
+    };
+
+    Pose MakePose(uint32_t index)
+    {
+        Pose p;
+        for (int i = 0; i < 4; i++)
+            p.quat[i] = 0.25F * i + 1e-6F * index;
+        for (int i = 0; i < TwistAxisNum; i++)
+        {
+            p.twistDegree[i] = 0.5F * index + i;
+            p.twistCount[i] = (int32_t)(index / 360) - i;
+        }
+        return p;
+    }
+
+    /**
+     * @brief ArduinoOSC のメッセージと同じく，引数を型付きの配列に持ってからエンコードする
+     */
+    struct LegacyMessage
+    {
+        struct Arg
+        {
+            char type;
+            uint32_t bits;
+        };
+        std::string address;
+        std::string typeTags;
+        std::vector<Arg> args;
+
+        void pushFloat(float value)
+        {
+            Arg a;
+            a.type = 'f';
+            memcpy(&a.bits, &value, sizeof(a.bits));
+            args.push_back(a);
+            typeTags += 'f';
+        }
+
+        void pushInt32(int32_t value)
+        {
+            Arg a;
+            a.type = 'i';
+            a.bits = (uint32_t)value;
+            args.push_back(a);
+            typeTags += 'i';
+        }
+
+        static void PushPadded(std::vector<uint8_t> &out, const std::string &str)
+        {
+            out.insert(out.end(), str.begin(), str.end());
+            do
+                out.push_back(0);
+            while (out.size() % 4 != 0);
+        }
+
+        void encode(std::vector<uint8_t> &out) const
+        {
+            PushPadded(out, address);
+            PushPadded(out, "," + typeTags);
+            for (size_t i = 0; i < args.size(); i++)
+            {
+                out.push_back((uint8_t)(args[i].bits >> 24));
+                out.push_back((uint8_t)(args[i].bits >> 16));
+                out.push_back((uint8_t)(args[i].bits >> 8));
+                out.push_back((uint8_t)(args[i].bits));
+            }
+        }
+    };
+
+    /**
+     * @brief 送ったバイト列．最後の1回分だけ残して比べる
+     */
+    struct Sent
+    {
+        std::vector<uint8_t> quat;
+        std::vector<uint8_t> twist;
+        size_t bytes;
+
+        explicit Sent() : bytes(0) {}
+    };
+
+    void SendLegacy(const std::string &uniqueId, const Pose &pose, Sent &sent)
+    {
+        std::string addr = "/" + uniqueId + "/quat";
+        {
+            LegacyMessage m;
+            m.address = addr;
+            for (int i = 0; i < 4; i++)
+                m.pushFloat(pose.quat[i]);
+            std::vector<uint8_t> packet;
+            m.encode(packet);
+            sent.bytes += packet.size();
+            sent.quat.swap(packet);
+        }
+        std::string twistAddr = "/" + uniqueId + "/twist";
+        {
+            LegacyMessage m;
+            m.address = twistAddr;
+            for (int i = 0; i < TwistAxisNum; i++)
+                m.pushFloat(pose.twistDegree[i]);
+            for (int i = 0; i < TwistAxisNum; i++)
+                m.pushInt32(pose.twistCount[i]);
+            std::vector<uint8_t> packet;
+            m.encode(packet);
+            sent.bytes += packet.size();
+            sent.twist.swap(packet);
+        }
+    }
+
+    /**
+     * @brief SendOscLoop の RefreshStreamTarget() と同じ状態
+     */
+    struct Preencoded
+    {
+        osc::OscPreencodedMessage quat;
+        osc::OscPreencodedMessage twist;
+        uint32_t version;
+
+        explicit Preencoded() : version(UINT32_MAX) {}
+
+        void refresh(const concurrent::SeqLock<StreamConfig> &streamConfig)
+        {
+            StreamConfig config;
+            uint32_t v;
+            if (!streamConfig.tryRead(config, v) || v == version)
+                return;
+            version = v;
+            char addr[48];
+            snprintf(addr, sizeof(addr), "/%s/quat", config.uniqueId);
+            quat.encode(addr, ",ffff");
+            snprintf(addr, sizeof(addr), "/%s/twist", config.uniqueId);
+            twist.encode(addr, ",fffiii");
+        }
+    };
+
+    void SendPreencoded(Preencoded &target, const concurrent::SeqLock<StreamConfig> &streamConfig, const Pose &pose,
+                        Sent &sent, std::vector<uint8_t> *keep)
+    {
+        target.refresh(streamConfig);
+        for (int i = 0; i < 4; i++)
+            target.quat.setFloat(i, pose.quat[i]);
+        sent.bytes += target.quat.size();
+        for (int i = 0; i < TwistAxisNum; i++)
+        {
+            target.twist.setFloat(i, pose.twistDegree[i]);
+            target.twist.setInt32(TwistAxisNum + i, pose.twistCount[i]);
+        }
+        sent.bytes += target.twist.size();
+        if (keep != NULL)
+        {
+            keep[0].assign(target.quat.data(), target.quat.data() + target.quat.size());
+            keep[1].assign(target.twist.data(), target.twist.data() + target.twist.size());
+        }
+    }
+
+    struct Measure
+    {
+        double nsPerSend;
+        double allocsPerSend;
+        double bytesPerSend;
+    };
+
+    typedef std::chrono::steady_clock Clock;
+
+    void Print(const char *name, const Measure &m)
+    {
+        printf("  %-12s %10.1f %12.2f %12.1f\n", name, m.nsPerSend, m.allocsPerSend, m.bytesPerSend);
+    }
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    long sends = argc > 1 ? atol(argv[1]) : 200000;
+    if (sends <= 0)
+        sends = 200000;
+
+    const std::string uniqueId = "stick01"; // /set/uniqueid で付ける程度の長さ
+    concurrent::SeqLock<StreamConfig> streamConfig;
+    StreamConfig config;
+    memset(&config, 0, sizeof(config));
+    strncpy(config.uniqueId, uniqueId.c_str(), sizeof(config.uniqueId) - 1);
+    config.destinationCount = 1;
+    streamConfig.write(config);
+
+    // 同じ値から同じバイト列を作る
+    {
+        Sent legacy, current;
+        Preencoded target;
+        std::vector<uint8_t> kept[2];
+        Pose pose = MakePose(12345);
+        SendLegacy(uniqueId, pose, legacy);
+        SendPreencoded(target, streamConfig, pose, current, kept);
+        Check(legacy.quat == kept[0], "/quat: same bytes on both paths");
+        Check(legacy.twist == kept[1], "/twist: same bytes on both paths");
+    }
+
+    Measure legacyResult, currentResult;
+    volatile size_t sink = 0; // 最適化で送信が消えないように使う
+    {
+        Sent sent;
+        size_t count0 = allocCount, bytes0 = allocBytes;
+        Clock::time_point start = Clock::now();
+        for (long i = 0; i < sends; i++)
+            SendLegacy(uniqueId, MakePose((uint32_t)i), sent);
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        legacyResult.nsPerSend = ns / sends;
+        legacyResult.allocsPerSend = (double)(allocCount - count0) / sends;
+        legacyResult.bytesPerSend = (double)(allocBytes - bytes0) / sends;
+        sink += sent.bytes;
+    }
+    {
+        Sent sent;
+        Preencoded target;
+        target.refresh(streamConfig); // 宛先の変更時にだけ作り直す分は周期の外
+        size_t count0 = allocCount, bytes0 = allocBytes;
+        Clock::time_point start = Clock::now();
+        for (long i = 0; i < sends; i++)
+            SendPreencoded(target, streamConfig, MakePose((uint32_t)i), sent, NULL);
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        currentResult.nsPerSend = ns / sends;
+        currentResult.allocsPerSend = (double)(allocCount - count0) / sends;
+        currentResult.bytesPerSend = (double)(allocBytes - bytes0) / sends;
+        sink += sent.bytes;
+    }
+
+    printf("%ld sends of /quat + /twist (uniqueId \"%s\")\n", sends, uniqueId.c_str());
+    printf("  %-12s %10s %12s %12s\n", "path", "ns/send", "allocs/send", "bytes/send");
+    Print("legacy", legacyResult);
+    Print("preencoded", currentResult);
+    Check(currentResult.allocsPerSend == 0.0, "preencoded: no heap allocation per send");
+    Check(legacyResult.allocsPerSend > 0.0, "legacy: allocation counter sees the old path");
+
+    printf("%s\n", failures == 0 ? "all passed" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,217 @@
+// imu::frame::EncodeFrame() で詰めたフレームを DecodeFrame() で戻し，姿勢の誤差が量子化の範囲に収まることと，
+// 省く成分 (w, x, y, z) 毎に成分の並びと符号が保たれることを確かめる (QuatFrameReceiver と同じデコーダ)
+//
+// build:
+//   c++ -std=c++11 -O2 -I../../PlatformIO/src main.cpp ../../PlatformIO/src/imu/frame/QuatFrame.cpp -o quat_frame_check
+// usage:
+//   ./quat_frame_check [samples]   (default: 1000000個の一様な乱数の姿勢)
+//   終了コード 0: 全て期待どおり, 1: 失敗あり
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include "imu/ImuData.h"
+#include "imu/frame/QuatFrame.h"
+
+namespace
+{
+    const double RadToDeg = 57.29577951308232;
+    // 1成分の量子化の刻みは 2 / √2 / (2^15 - 1) ≈ 4.3e-5．その半分が1成分の丸め誤差の上限
+    const double ComponentErrorMax = 2.2e-5;
+    // 姿勢の誤差の上限 [deg]．最大成分が0.5で残りも0.5のとき，復元した最大成分に3成分分の誤差が3倍で乗り，
+    // 差の長さは 2.2e-5 * √(3 + 9) ≈ 7.6e-5，角度はその2倍で約0.0087deg (実測の最悪は0.0075deg程度)
+    const double AngleErrorMaxDeg = 0.009;
+
+    int failures = 0;
+
+    void Check(bool condition, const char *what)
+    {
+        printf("%s: %s\n", condition ? "ok" : "NG", what);
+        if (!condition)
+            failures++;
+    }
+
+    void Normalize(float *q)
+    {
+        double n = sqrt((double)q[0] * q[0] + (double)q[1] * q[1] + (double)q[2] * q[2] + (double)q[3] * q[3]);
+        for (int i = 0; i < imu::ImuWxyz; i++)
+            q[i] = (float)(q[i] / n);
+    }
+
+    /**
+     * @brief 2つの姿勢の角度[deg]．q と -q は同じ姿勢とみなす
+     * @brief acos(内積) は1の近くで桁落ちし，floatの丸めだけで0.05deg程度に見えるため，差の長さから求める
+     */
+    double AngleBetween(const float *a, const float *b)
+    {
+        double minus = 0.0, plus = 0.0;
+        for (int i = 0; i < imu::ImuWxyz; i++)
+        {
+            minus += ((double)a[i] - b[i]) * ((double)a[i] - b[i]);
+            plus += ((double)a[i] + b[i]) * ((double)a[i] + b[i]);
+        }
+        double chord = sqrt(minus < plus ? minus : plus) * 0.5;
+        return 4.0 * asin(chord > 1.0 ? 1.0 : chord) * RadToDeg;
+    }
+
+    /**
+     * @brief フレームを通した結果
+     */
+    struct RoundTrip
+    {
+        bool decoded;
+        int dropped; // フレームに書かれた省いた成分の番号
+        imu::frame::QuatFrame frame;
+    };
+
+    RoundTrip Send(const float *quat, uint16_t deviceId, uint16_t seq, uint32_t timestamp)
+    {
+        imu::ImuData d;
+        d.timestamp = timestamp;
+        memcpy(d.quat, quat, sizeof(d.quat));
+        uint8_t buffer[imu::frame::QuatFrameLen];
+        RoundTrip r;
+        imu::frame::EncodeFrame(d, deviceId, seq, buffer);
+        r.dropped = (buffer[imu::frame::QuatFrameQuatOffset + 5] >> 5) & 0x3; // bit 46-45
+        r.decoded = imu::frame::DecodeFrame(buffer, sizeof(buffer), r.frame);
+        return r;
+    }
+
+    /**
+     * @brief 成分 largest が最大になる姿勢を，符号を変えて通す
+     * @brief 省いた成分の番号が largest であること，デコードした値が元の値 (省いた成分が負なら符号を反転したもの) と
+     * @brief 成分毎に一致することを確かめる．他の成分は大きさも符号も異なる値にして，並びの入れ替わりも検出する
+     */
+    void CheckDroppedComponent(int largest, float sign)
+    {
+        const float others[3] = {0.31F, -0.22F, 0.13F};
+        float q[imu::ImuWxyz];
+        int k = 0;
+        for (int i = 0; i < imu::ImuWxyz; i++)
+            q[i] = (i == largest) ? 0.9F * sign : others[k++];
+        Normalize(q);
+
+        RoundTrip r = Send(q, 0x1234, 7, 1000U);
+        float flip = (sign < 0.0F) ? -1.0F : 1.0F; // 送信側は省く成分が正になる向きにそろえる
+        double worst = 0.0;
+        for (int i = 0; i < imu::ImuWxyz; i++)
+        {
+            double e = fabs(r.frame.quat[i] - flip * q[i]);
+            worst = (e > worst) ? e : worst;
+        }
+        char what[128];
+        snprintf(what, sizeof(what), "dropped %c (%s): index, component order and sign preserved",
+                 "wxyz"[largest], sign < 0.0F ? "negative" : "positive");
+        Check(r.decoded && r.dropped == largest && worst <= ComponentErrorMax * 1.5 && r.frame.quat[largest] > 0.0F,
+              what);
+    }
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    long samples = argc > 1 ? atol(argv[1]) : 1000000;
+    if (samples <= 0)
+        samples = 1000000;
+
+    // 省く成分4通り x 符号
+    for (int largest = 0; largest < imu::ImuWxyz; largest++)
+    {
+        CheckDroppedComponent(largest, 1.0F);
+        CheckDroppedComponent(largest, -1.0F);
+    }
+
+    // 単位元と軸周りの180度回転 (最大以外が全て0)
+    {
+        bool ok = true;
+        for (int axis = 0; axis < imu::ImuWxyz; axis++)
+        {
+            for (int s = -1; s <= 1; s += 2)
+            {
+                float q[imu::ImuWxyz] = {0.0F, 0.0F, 0.0F, 0.0F};
+                q[axis] = (float)s;
+                RoundTrip r = Send(q, 1, 2, 3);
+                ok = ok && r.decoded && r.dropped == axis && AngleBetween(q, r.frame.quat) < AngleErrorMaxDeg;
+            }
+        }
+        Check(ok, "identity and 180 deg turns about x, y, z: exact axis, sign folded");
+    }
+
+    // 2成分が同じ大きさ (最大が決まらない) でも，残りの成分は1/√2以内に収まる
+    {
+        float q[imu::ImuWxyz] = {0.70710678F, 0.0F, 0.0F, -0.70710678F};
+        RoundTrip r = Send(q, 1, 2, 3);
+        Check(r.decoded && AngleBetween(q, r.frame.quat) < AngleErrorMaxDeg, "two equal largest components (90 deg about z)");
+    }
+
+    // ヘッダのフィールド
+    {
+        float q[imu::ImuWxyz] = {1.0F, 0.0F, 0.0F, 0.0F};
+        RoundTrip r = Send(q, 0xBEEF, 0xFFFF, 0xFEDCBA98U);
+        Check(r.decoded && r.frame.deviceId == 0xBEEF && r.frame.seq == 0xFFFF && r.frame.timestamp == 0xFEDCBA98U,
+              "deviceId, seq and timestamp survive the round trip");
+
+        imu::ImuData d;
+        uint8_t buffer[imu::frame::QuatFrameLen];
+        imu::frame::QuatFrame frame;
+        imu::frame::EncodeFrame(d, 1, 1, buffer);
+        bool shortRejected = !imu::frame::DecodeFrame(buffer, imu::frame::QuatFrameLen - 1, frame);
+        buffer[imu::frame::QuatFrameMagicOffset] = 'q';
+        bool magicRejected = !imu::frame::DecodeFrame(buffer, sizeof(buffer), frame);
+        buffer[imu::frame::QuatFrameMagicOffset] = imu::frame::QuatFrameMagic;
+        buffer[imu::frame::QuatFrameVersionOffset] = imu::frame::QuatFrameVersion + 1;
+        bool versionRejected = !imu::frame::DecodeFrame(buffer, sizeof(buffer), frame);
+        Check(shortRejected && magicRejected && versionRejected, "short, wrong magic and wrong version are rejected");
+    }
+
+    // 一様な乱数の姿勢 (4次元の正規分布を正規化) で最悪の誤差を求める
+    {
+        std::mt19937 rng(20240917);
+        std::normal_distribution<float> normal(0.0F, 1.0F);
+        double worstAngle = 0.0, worstComponent = 0.0, sumAngle = 0.0;
+        long droppedCount[imu::ImuWxyz] = {0, 0, 0, 0};
+        float worstQuat[imu::ImuWxyz] = {1.0F, 0.0F, 0.0F, 0.0F};
+        for (long n = 0; n < samples; n++)
+        {
+            float q[imu::ImuWxyz];
+            for (int i = 0; i < imu::ImuWxyz; i++)
+                q[i] = normal(rng);
+            Normalize(q);
+            RoundTrip r = Send(q, 1, (uint16_t)n, (uint32_t)n);
+            droppedCount[r.dropped]++;
+            double angle = AngleBetween(q, r.frame.quat);
+            sumAngle += angle;
+            if (angle > worstAngle)
+            {
+                worstAngle = angle;
+                memcpy(worstQuat, q, sizeof(q));
+            }
+            float flip = (q[r.dropped] < 0.0F) ? -1.0F : 1.0F;
+            for (int i = 0; i < imu::ImuWxyz; i++)
+            {
+                if (i == r.dropped)
+                    continue;
+                double e = fabs(r.frame.quat[i] - flip * q[i]);
+                worstComponent = (e > worstComponent) ? e : worstComponent;
+            }
+        }
+        printf("%ld random orientations: angle error mean %.5f deg, max %.5f deg, component error max %.2e\n", samples,
+               sumAngle / samples, worstAngle, worstComponent);
+        printf("  worst at (%.5f %.5f %.5f %.5f), dropped w/x/y/z %ld %ld %ld %ld\n", worstQuat[0], worstQuat[1],
+               worstQuat[2], worstQuat[3], droppedCount[0], droppedCount[1], droppedCount[2], droppedCount[3]);
+        char what[128];
+        snprintf(what, sizeof(what), "random: worst angle error below %.3f deg", AngleErrorMaxDeg);
+        Check(worstAngle < AngleErrorMaxDeg, what);
+        snprintf(what, sizeof(what), "random: worst stored component error below %.1e", ComponentErrorMax);
+        Check(worstComponent <= ComponentErrorMax, what);
+        bool allDropped = true;
+        for (int i = 0; i < imu::ImuWxyz; i++)
+            allDropped = allDropped && droppedCount[i] > 0;
+        Check(allDropped, "random: every component was dropped at least once");
+    }
+
+    printf("%s\n", failures == 0 ? "all passed" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
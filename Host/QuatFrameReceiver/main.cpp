@@ -0,0 +1,92 @@
+// KaitenBoh のバイナリ姿勢フレーム (imu::frame::QuatFrame) を受信して表示する参照実装
+//
+// build:
+//   c++ -std=c++11 -O2 -I../../PlatformIO/src main.cpp ../../PlatformIO/src/imu/frame/QuatFrame.cpp -o quat_frame_receiver
+// usage:
+//   ./quat_frame_receiver [port]   (default: 33334)
+//   M5StickCに /set/stream 1 を送るとフレームの送信が始まる
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include "imu/frame/QuatFrame.h"
+
+namespace
+{
+    struct DeviceState
+    {
+        uint16_t lastSeq;
+        uint32_t received;
+        uint32_t lost;
+    };
+}
+
+int main(int argc, char **argv)
+{
+    int port = (argc > 1) ? atoi(argv[1]) : 33334;
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0)
+    {
+        perror("socket");
+        return 1;
+    }
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16_t)port);
+    if (bind(sock, (sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("bind");
+        close(sock);
+        return 1;
+    }
+
+    std::map<uint16_t, DeviceState> devices;
+    uint8_t buffer[1500];
+    while (true)
+    {
+        sockaddr_in from = {};
+        socklen_t fromLen = sizeof(from);
+        ssize_t len = recvfrom(sock, buffer, sizeof(buffer), 0, (sockaddr *)&from, &fromLen);
+        if (len < 0)
+        {
+            perror("recvfrom");
+            break;
+        }
+
+        imu::frame::QuatFrame frame;
+        if (!imu::frame::DecodeFrame(buffer, (size_t)len, frame))
+        {
+            fprintf(stderr, "ignored %zd bytes from %s\n", len, inet_ntoa(from.sin_addr));
+            continue;
+        }
+
+        // seqは16bitで折り返す．差分が1より大きければその分を欠落として数える
+        std::map<uint16_t, DeviceState>::iterator it = devices.find(frame.deviceId);
+        if (it == devices.end())
+        {
+            DeviceState state = {frame.seq, 0, 0};
+            it = devices.insert(std::make_pair(frame.deviceId, state)).first;
+        }
+        else
+        {
+            uint16_t gap = (uint16_t)(frame.seq - it->second.lastSeq);
+            if (gap > 1 && gap < 0x8000)
+                it->second.lost += gap - 1;
+            it->second.lastSeq = frame.seq;
+        }
+        it->second.received++;
+
+        printf("%04x seq=%5u t=%10u us q=(% .5f, % .5f, % .5f, % .5f) lost=%u/%u\n",
+               frame.deviceId, frame.seq, frame.timestamp,
+               frame.quat[0], frame.quat[1], frame.quat[2], frame.quat[3],
+               it->second.lost, it->second.received);
+    }
+    close(sock);
+    return 0;
+}
@@ -0,0 +1,211 @@
+// ImuLoopの周期の刻み方をホストで再現し，vTaskDelay (1ms tick) と周期タイマ (imu::sampling::SamplePacer)
+// のサンプル間隔の揺らぎを比べる．タイマ側は偽のクロックを使い，取りこぼした周期の数え方も確かめる
+//
+// build:
+//   S=../../PlatformIO/src
+//   c++ -std=c++11 -O2 -I$S main.cpp $S/imu/sampling/SamplePacer.cpp -o sample_pacer_sim
+// usage:
+//   ./sample_pacer_sim [rateHz workMeanUs preemptUs spikeEvery spikeUs seconds]
+//   preemptUs: 同じコアのほかのタスクに起床を遅らされる最大時間
+//   終了コード 0: 取りこぼしの数と dt の合計が期待どおり, 1: 不一致
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "imu/sampling/SampleClock.h"
+#include "imu/sampling/SamplePacer.h"
+
+namespace
+{
+    const uint32_t TickMicros = 1000;  // FreeRTOSのtick (CONFIG_FREERTOS_HZ=1000)
+    const uint32_t LegacyPeriodMs = 5; // TASK_SLEEP_IMU
+
+    std::mt19937 rng(1);
+
+    uint32_t Uniform(uint32_t lo, uint32_t hi)
+    {
+        return std::uniform_int_distribution<uint32_t>(lo, hi)(rng);
+    }
+
+    /**
+     * @brief 仮想時刻で動く SampleClock．コールバックと起床にそれぞれ数十usの遅れを入れる
+     */
+    class FakeSampleClock : public imu::sampling::SampleClock
+    {
+    public:
+        FakeSampleClock() : now(0), preemptMicros(0), period(0), running(false), nextTick(0), nextFire(0),
+                            pending(0), lastTick(0) {}
+        bool start(uint32_t periodMicros)
+        {
+            period = periodMicros;
+            running = true;
+            nextTick = now;
+            schedule();
+            pending = 0;
+            lastTick = (uint32_t)now;
+            return true;
+        }
+        void stop() { running = false; }
+        uint32_t waitTicks(uint32_t timeoutMicros)
+        {
+            fireUntil(now);
+            if (pending == 0)
+            {
+                if (!running || nextFire > now + timeoutMicros)
+                {
+                    now += timeoutMicros;
+                    return 0;
+                }
+                now = nextFire;
+                fireUntil(now);
+            }
+            now += Uniform(5, 40) + ((preemptMicros > 0) ? Uniform(0, preemptMicros) : 0); // 通知から動き出すまで
+            uint32_t ticks = pending;
+            pending = 0;
+            return ticks;
+        }
+        uint32_t lastTickMicros() const { return lastTick; }
+        uint32_t nowMicros() const { return (uint32_t)now; }
+
+        uint64_t now;
+        uint32_t preemptMicros;
+
+    private:
+        uint32_t period;
+        bool running;
+        uint64_t nextTick;
+        uint64_t nextFire; // 名目上の時刻にコールバックの遅れを足したもの
+        uint32_t pending;
+        uint32_t lastTick;
+
+        void schedule()
+        {
+            nextTick += period;
+            nextFire = nextTick + Uniform(2, 30);
+        }
+        void fireUntil(uint64_t t)
+        {
+            while (running && nextFire <= t)
+            {
+                lastTick = (uint32_t)nextFire;
+                pending++;
+                schedule();
+            }
+        }
+    };
+
+    struct Workload
+    {
+        uint32_t meanMicros;
+        uint32_t spikeEvery; // この回数に1回，処理が長引く (0: なし)
+        uint32_t spikeMicros;
+        uint32_t next(uint32_t n) const
+        {
+            if (spikeEvery > 0 && n % spikeEvery == spikeEvery - 1)
+                return spikeMicros;
+            return Uniform(meanMicros / 2, meanMicros * 3 / 2);
+        }
+    };
+
+    void Report(const char *name, std::vector<uint32_t> intervals, uint32_t nominal)
+    {
+        std::vector<uint32_t> deviation;
+        for (uint32_t v : intervals)
+            deviation.push_back((uint32_t)std::abs((int32_t)(v - nominal)));
+        std::sort(intervals.begin(), intervals.end());
+        std::sort(deviation.begin(), deviation.end());
+        size_t n = intervals.size();
+        printf("%-6s interval min %5u  p50 %5u  max %5u us   |error| p50 %5u  p99 %5u us\n",
+               name, intervals.front(), intervals[n / 2], intervals.back(),
+               deviation[n / 2], deviation[n * 99 / 100]);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint16_t rateHz = (argc > 1) ? (uint16_t)atoi(argv[1]) : 200;
+    uint32_t workMicros = (argc > 2) ? (uint32_t)atoi(argv[2]) : 800u;
+    uint32_t preemptMicros = (argc > 3) ? (uint32_t)atoi(argv[3]) : 1500u;
+    Workload work = {workMicros,
+                     (argc > 4) ? (uint32_t)atoi(argv[4]) : 500u,
+                     (argc > 5) ? (uint32_t)atoi(argv[5]) : 12000u};
+    double seconds = (argc > 6) ? atof(argv[6]) : 60.0;
+    uint64_t duration = (uint64_t)(seconds * 1e6);
+
+    // 従来: millis() で処理時間を引いて vTaskDelay (tickの境界でしか起きない)
+    std::vector<uint32_t> legacy;
+    {
+        uint64_t now = 0, lastSample = 0;
+        for (uint32_t n = 0; now < duration; n++)
+        {
+            uint64_t entry = now;
+            if (n > 0)
+                legacy.push_back((uint32_t)(entry - lastSample));
+            lastSample = entry;
+            now += work.next(n);
+            int32_t sleep = (int32_t)LegacyPeriodMs - (int32_t)(now / 1000 - entry / 1000);
+            if (sleep > 0)
+                now = (now / TickMicros + sleep) * TickMicros;
+            now += Uniform(5, 40) + ((preemptMicros > 0) ? Uniform(0, preemptMicros) : 0);
+        }
+    }
+
+    // 周期タイマ
+    FakeSampleClock clock;
+    clock.preemptMicros = preemptMicros;
+    imu::sampling::SamplePacer pacer(clock);
+    if (!pacer.setRate(rateHz))
+    {
+        fprintf(stderr, "unsupported rate %u\n", rateHz);
+        return 1;
+    }
+    const uint32_t period = pacer.periodMicros();
+    std::vector<uint32_t> wakes, stamps;
+    uint64_t latencySum = 0, dtSum = 0;
+    uint64_t wakeTick = 0;         // 今回起きた周期の名目上の時刻
+    uint32_t expectedOverruns = 0; // 処理時間から求めた取りこぼしの数
+    uint32_t lastWake = clock.nowMicros(), lastStamp = pacer.tickMicros(), firstStamp = lastStamp;
+    uint32_t samples = 0;
+    for (uint32_t n = 0; clock.now < duration; n++)
+    {
+        // ImuLoopと同じく，周期の開始時刻をサンプルの時刻として dt を求める (ImuReader::update)
+        uint32_t wake = clock.nowMicros();
+        uint32_t stamp = pacer.tickMicros();
+        if (n > 0)
+        {
+            wakes.push_back(wake - lastWake);
+            stamps.push_back(stamp - lastStamp);
+            dtSum += imu::sampling::ElapsedTicks(stamp - lastStamp, period) * period;
+        }
+        lastWake = wake;
+        lastStamp = stamp;
+        samples++;
+        clock.now += work.next(n);
+
+        // 起きた周期から数えて処理中に過ぎた周期のうち，最後の1つ以外は取りこぼし
+        uint64_t passed = (clock.now - wakeTick) / period;
+        if (passed > 1)
+            expectedOverruns += (uint32_t)(passed - 1);
+        wakeTick += ((passed > 0) ? passed : 1) * period;
+        if (pacer.waitNext())
+            latencySum += pacer.wakeLatencyMicros();
+    }
+    // 名目上の経過時間．dt の合計はこれと一致するはず (周期の数え漏れがない)
+    uint64_t elapsed = (uint64_t)(lastStamp - firstStamp + period / 2) / period * period;
+
+    printf("%.0f s, work %u us, preempt <= %u us, spike %u us every %u\n",
+           seconds, work.meanMicros, preemptMicros, work.spikeMicros, work.spikeEvery);
+    Report("vTask", legacy, LegacyPeriodMs * 1000);
+    Report("wake", wakes, period);
+    Report("stamp", stamps, period);
+    printf("timer  %u Hz  samples %u  wake latency mean %.1f us  sum(dt) - elapsed %lld us\n",
+           rateHz, samples, (double)latencySum / samples, (long long)dtSum - (long long)elapsed);
+
+    bool ok = pacer.overruns() == expectedOverruns && pacer.timeouts() == 0 && dtSum == elapsed;
+    printf("%s: overruns %u (expected %u)  timeouts %u\n", ok ? "ok" : "NG",
+           pacer.overruns(), expectedOverruns, pacer.timeouts());
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,160 @@
+// 記録したIMUデータ (imu/trace/TraceFormat.h) に可変レート送信 (osc::SendScheduler) を適用し，
+// 送信数と受信側から見た姿勢の遅れを固定レート送信と比べる
+//
+// build:
+//   S=../../PlatformIO/src
+//   c++ -std=c++11 -O2 -I$S main.cpp $S/osc/SendScheduler.cpp $S/imu/trace/TraceFormat.cpp
+//       $S/imu/madgwick/MadgwickAHRS.cpp $S/imu/gyro/GyroIntegrator.cpp -o send_scheduler_replay
+// usage:
+//   ./send_scheduler_replay trace.bin [angleDeg fastGyroDps maxRateHz keepaliveMs]
+//   trace.bin は /record/start 0 でSerialに出力したバイト列をそのまま保存したもの
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "imu/ImuData.h"
+#include "imu/madgwick/MadgwickAHRS.h"
+#include "imu/trace/TraceFormat.h"
+#include "osc/SendScheduler.h"
+
+namespace
+{
+    const float DegToRad = 0.01745329252F;
+    const uint32_t FixedIntervalMicros = 33000; // 従来の固定レート (TASK_SLEEP_SEND_OSC)
+
+    bool LoadTrace(const char *path, std::vector<imu::trace::TraceSample> &outSamples)
+    {
+        FILE *fp = fopen(path, "rb");
+        if (fp == NULL)
+            return false;
+        std::vector<uint8_t> bytes;
+        uint8_t buffer[4096];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+            bytes.insert(bytes.end(), buffer, buffer + n);
+        fclose(fp);
+
+        // Serialのログが混ざっていてもよいように，ヘッダとチャンクを探しながら読む
+        size_t pos = 0;
+        imu::trace::TraceHeader header;
+        while (pos < bytes.size() && !imu::trace::DecodeHeader(&bytes[pos], bytes.size() - pos, header))
+            pos++;
+        if (pos == bytes.size())
+            return false;
+        pos += imu::trace::TraceHeaderLen;
+        while (pos < bytes.size())
+        {
+            uint8_t count;
+            uint32_t seq;
+            if (!imu::trace::DecodeChunkHeader(&bytes[pos], bytes.size() - pos, count, seq) ||
+                pos + imu::trace::TraceChunkHeaderLen + count * imu::trace::TraceSampleLen > bytes.size())
+            {
+                pos++;
+                continue;
+            }
+            pos += imu::trace::TraceChunkHeaderLen;
+            for (int i = 0; i < count; i++)
+            {
+                imu::trace::TraceSample sample;
+                imu::trace::DecodeSample(&bytes[pos], sample);
+                outSamples.push_back(sample);
+                pos += imu::trace::TraceSampleLen;
+            }
+        }
+        return true;
+    }
+
+    // 受信側が持っている姿勢と実際の姿勢のずれ[deg]
+    float AngleBetween(const float *a, const float *b)
+    {
+        float dot = fabsf(a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3]);
+        return 2.0F * acosf(dot > 1.0F ? 1.0F : dot) / DegToRad;
+    }
+
+    struct Result
+    {
+        unsigned sent;
+        double errorSum;
+        float errorMax;
+    };
+
+    void Report(const char *name, const Result &result, size_t samples, double seconds)
+    {
+        printf("%-9s sent %7u (%6.1f Hz)  lag error mean %.3f deg  max %.3f deg\n",
+               name, result.sent, result.sent / seconds,
+               result.errorSum / samples, result.errorMax);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s trace.bin [angleDeg fastGyroDps maxRateHz keepaliveMs]\n", argv[0]);
+        return 1;
+    }
+    std::vector<imu::trace::TraceSample> samples;
+    if (!LoadTrace(argv[1], samples) || samples.size() < 2)
+    {
+        fprintf(stderr, "no trace samples in %s\n", argv[1]);
+        return 1;
+    }
+
+    osc::SendScheduler scheduler;
+    if (argc >= 6)
+        scheduler.configure((float)atof(argv[2]), (float)atof(argv[3]), atoi(argv[4]), atoi(argv[5]));
+
+    imu::madgwick::MadgwickAHRS filter;
+    imu::ImuData current;
+    imu::ImuData adaptiveSent, fixedSent;
+    Result adaptive = {0, 0.0, 0.0F};
+    Result fixed = {0, 0.0, 0.0F};
+    uint32_t fixedLast = samples[0].timestamp - FixedIntervalMicros;
+    uint32_t previous = samples[0].timestamp;
+
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        const imu::trace::TraceSample &s = samples[i];
+        float dt = (s.timestamp - previous) * 1e-6F;
+        previous = s.timestamp;
+        current.timestamp = s.timestamp;
+        for (int j = 0; j < imu::ImuXyz; j++)
+        {
+            current.acc[j] = s.acc[j];
+            current.gyro[j] = s.gyro[j];
+        }
+        filter.UpdateQuaternion(
+            s.gyro[0] * DegToRad, s.gyro[1] * DegToRad, s.gyro[2] * DegToRad,
+            s.acc[0], s.acc[1], s.acc[2],
+            dt,
+            current.quat[0], current.quat[1], current.quat[2], current.quat[3]);
+
+        // 送信タスクが毎サンプル起きるとみなす (実機では最大レートで起きる)
+        if (scheduler.shouldSend(current, s.timestamp))
+        {
+            adaptiveSent = current;
+            adaptive.sent++;
+        }
+        if (s.timestamp - fixedLast >= FixedIntervalMicros)
+        {
+            fixedSent = current;
+            fixed.sent++;
+            fixedLast = s.timestamp;
+        }
+
+        float e = AngleBetween(adaptiveSent.quat, current.quat);
+        adaptive.errorSum += e;
+        adaptive.errorMax = (e > adaptive.errorMax) ? e : adaptive.errorMax;
+        e = AngleBetween(fixedSent.quat, current.quat);
+        fixed.errorSum += e;
+        fixed.errorMax = (e > fixed.errorMax) ? e : fixed.errorMax;
+    }
+
+    double seconds = (samples.back().timestamp - samples.front().timestamp) * 1e-6;
+    printf("%zu samples, %.1f s\n", samples.size(), seconds);
+    Report("fixed", fixed, samples.size(), seconds);
+    Report("adaptive", adaptive, samples.size(), seconds);
+    return 0;
+}
@@ -0,0 +1,251 @@
+// prefs::SettingsService をファイルに保存する BlobStore で動かし，変更のまとめ方と blob の検証を確かめる
+//
+// build:
+//   S=../../PlatformIO/src
+//   c++ -std=c++11 -O2 -I$S main.cpp $S/prefs/SettingsService.cpp $S/prefs/SettingsBlob.cpp
+//       -o settings_service_check
+// usage:
+//   ./settings_service_check [blobPath]
+//   終了コード 0: 全て期待どおり, 1: 失敗あり
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "prefs/BlobStore.h"
+#include "prefs/SettingsBlob.h"
+#include "prefs/SettingsService.h"
+
+namespace
+{
+    /**
+     * @brief NVSの代わりにファイルへ保存する．一時ファイルに書いてから置き換える
+     */
+    class FileBlobStore : public prefs::BlobStore
+    {
+    public:
+        explicit FileBlobStore(const char *path) : path(path), writes(0), failNext(false) {}
+        size_t load(uint8_t *out, size_t capacity)
+        {
+            FILE *fp = fopen(path, "rb");
+            if (fp == NULL)
+                return 0;
+            size_t len = fread(out, 1, capacity, fp);
+            bool tooLong = fgetc(fp) != EOF;
+            fclose(fp);
+            return tooLong ? 0 : len;
+        }
+        bool store(const uint8_t *blob, size_t len)
+        {
+            if (failNext)
+            {
+                failNext = false;
+                return false;
+            }
+            char tmp[512];
+            snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+            FILE *fp = fopen(tmp, "wb");
+            if (fp == NULL)
+                return false;
+            bool ok = fwrite(blob, 1, len, fp) == len;
+            ok = (fclose(fp) == 0) && ok;
+            if (!ok || rename(tmp, path) != 0)
+                return false;
+            writes++;
+            return true;
+        }
+
+        const char *path;
+        int writes;
+        bool failNext; // 次の書き込みを失敗させる
+    };
+
+    int failures = 0;
+
+    void Check(bool condition, const char *what)
+    {
+        printf("%s: %s\n", condition ? "ok" : "NG", what);
+        if (!condition)
+            failures++;
+    }
+
+    // 保存タスクと同じく，変更のたびに apply() し，周期的に poll() する
+    void Run(prefs::SettingsService &service, uint32_t &now, uint32_t untilMicros)
+    {
+        for (; now < untilMicros; now += 10000)
+            service.poll(now);
+    }
+
+    void ModifyFile(const char *path, long offset, uint8_t value)
+    {
+        FILE *fp = fopen(path, "r+b");
+        if (fp == NULL)
+            return;
+        fseek(fp, offset, SEEK_SET);
+        fputc(value, fp);
+        fclose(fp);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = (argc > 1) ? argv[1] : "settings.bin";
+    remove(path);
+    FileBlobStore store(path);
+    uint32_t now = 0;
+
+    {
+        prefs::SettingsService service(store);
+        prefs::SettingsData data;
+        Check(!service.load(data) && data.uniqueId[0] == '\0', "empty store loads defaults");
+
+        // OSCで続けて届いた変更は1回の書き込みにまとまる
+        float offset[3] = {0.5F, -1.25F, 0.125F};
+        service.apply(prefs::SettingsChange::GyroOffset(offset), now);
+        for (int i = 0; i < 20; i++)
+        {
+            char id[16];
+            snprintf(id, sizeof(id), "stick%d", i);
+            service.apply(prefs::SettingsChange::Text(prefs::FieldUniqueId, id), now);
+            Run(service, now, now + 100000);
+        }
+        service.apply(prefs::SettingsChange::Text(prefs::FieldDestinations, "192.168.20.51,192.168.20.52"), now);
+        service.apply(prefs::SettingsChange::Text(prefs::FieldMulticastGroup, "239.0.0.1"), now);
+        prefs::WiFiCache wifi = {};
+        strcpy(wifi.ssid, "future_undokai_wifi");
+        strcpy(wifi.psk, "future_undokai");
+        wifi.channel = 11;
+        wifi.bssid[5] = 0x42;
+        wifi.ip = 0x3314A8C0; // 192.168.20.51
+        service.apply(prefs::SettingsChange::WiFi(wifi), now);
+        prefs::TempBiasTable tempBias = {};
+        tempBias.temp[6] = 26.234F;
+        tempBias.bias[6][2] = -0.8127F;
+        tempBias.weight[6] = 60;
+        tempBias.bias[7][0] = 100.0F; // int16の範囲外は飽和する
+        service.apply(prefs::SettingsChange::TempBias(tempBias), now);
+        Check(store.writes == 0, "no write while changes keep arriving within the quiet time");
+        Run(service, now, now + 1000000);
+        Check(store.writes == 1 && service.commits() == 1, "burst of 25 changes written once");
+
+        // 変更が途切れなくても最大遅延で書く
+        int before = store.writes;
+        for (int i = 0; i < 200; i++)
+        {
+            float drift[3] = {0.001F * i, 0.0F, 0.0F};
+            service.apply(prefs::SettingsChange::GyroOffset(drift), now);
+            Run(service, now, now + 100000);
+        }
+        Run(service, now, now + 1000000);
+        printf("    continuous changes for 20 s: %d writes\n", store.writes - before);
+        Check(store.writes - before >= 4 && store.writes - before <= 5, "continuous changes written every max delay");
+
+        // 最後に書いた内容と同じなら書かない
+        service.apply(prefs::SettingsChange::GyroOffset(offset), now);
+        Run(service, now, now + 1000000);
+        service.apply(prefs::SettingsChange::Text(prefs::FieldUniqueId, "stick19"), now);
+        before = store.writes;
+        service.apply(prefs::SettingsChange::GyroOffset(service.data().gyroOffset), now);
+        Run(service, now, now + 1000000);
+        Check(store.writes == before, "unchanged settings are not rewritten");
+
+        // 書き込みに失敗したら静かな時間を待ってから再試行する
+        store.failNext = true;
+        service.apply(prefs::SettingsChange::Text(prefs::FieldHostIp, "192.168.20.60"), now);
+        Run(service, now, now + 600000);
+        Check(service.failures() == 1 && service.isDirty(), "failed write stays pending");
+        Run(service, now, now + 1000000);
+        Check(!service.isDirty(), "failed write retried");
+    }
+
+    {
+        prefs::SettingsService service(store);
+        prefs::SettingsData data;
+        Check(service.load(data), "blob loads in one read");
+        Check(strcmp(data.uniqueId, "stick19") == 0 && strcmp(data.hostIp, "192.168.20.60") == 0 &&
+                  strcmp(data.destinations, "192.168.20.51,192.168.20.52") == 0 &&
+                  strcmp(data.multicastGroup, "239.0.0.1") == 0 && data.gyroOffset[1] == -1.25F,
+              "values survive reload");
+        Check(strcmp(data.wifi.ssid, "future_undokai_wifi") == 0 && data.wifi.channel == 11 &&
+                  data.wifi.bssid[5] == 0x42 && data.wifi.ip == 0x3314A8C0,
+              "wifi cache survives reload");
+        Check(fabsf(data.tempBias.temp[6] - 26.23F) < 1e-4F && fabsf(data.tempBias.bias[6][2] + 0.813F) < 1e-4F &&
+                  data.tempBias.weight[6] == 60 && fabsf(data.tempBias.bias[7][0] - 32.767F) < 1e-4F,
+              "temperature bias table survives reload (0.01C / 0.001dps steps)");
+    }
+
+    {
+        // 1byteでも壊れていれば読まない
+        uint8_t blob[prefs::SettingsBlobLen];
+        size_t len = store.load(blob, sizeof(blob));
+        ModifyFile(path, 20, blob[20] ^ 0x40);
+        prefs::SettingsService service(store);
+        prefs::SettingsData data;
+        Check(!service.load(data) && data.uniqueId[0] == '\0', "corrupted blob rejected");
+
+        // 旧版のblob (ペイロードが短い) は足りないフィールドを既定値にして読む
+        prefs::SettingsData old;
+        strcpy(old.uniqueId, "legacy");
+        strcpy(old.multicastGroup, "239.1.1.1");
+        len = prefs::EncodeSettings(old, blob, sizeof(blob));
+        size_t shortPayload = 12 + prefs::SettingsUniqueIdLen;
+        blob[6] = (uint8_t)shortPayload;
+        blob[7] = (uint8_t)(shortPayload >> 8);
+        size_t crcPos = prefs::SettingsHeaderLen + shortPayload;
+        uint32_t crc = prefs::Crc32(blob, crcPos);
+        for (int i = 0; i < 4; i++)
+            blob[crcPos + i] = (uint8_t)(crc >> (8 * i));
+        Check(prefs::DecodeSettings(blob, crcPos + 4, data) && strcmp(data.uniqueId, "legacy") == 0 &&
+                  data.multicastGroup[0] == '\0',
+              "shorter payload decoded with defaults");
+
+        // version 1 (WiFiCache なし) のblob
+        len = prefs::EncodeSettings(old, blob, sizeof(blob));
+        blob[4] = 1;
+        blob[6] = (uint8_t)prefs::SettingsPayloadLenV1;
+        blob[7] = (uint8_t)(prefs::SettingsPayloadLenV1 >> 8);
+        crcPos = prefs::SettingsHeaderLen + prefs::SettingsPayloadLenV1;
+        crc = prefs::Crc32(blob, crcPos);
+        for (int i = 0; i < 4; i++)
+            blob[crcPos + i] = (uint8_t)(crc >> (8 * i));
+        Check(prefs::DecodeSettings(blob, crcPos + 4, data) && strcmp(data.multicastGroup, "239.1.1.1") == 0 &&
+                  data.wifi.ssid[0] == '\0',
+              "version 1 blob decoded without wifi cache");
+
+        // version 2 (TempBiasTable なし) のblob
+        len = prefs::EncodeSettings(old, blob, sizeof(blob));
+        blob[4] = 2;
+        blob[6] = (uint8_t)prefs::SettingsPayloadLenV2;
+        blob[7] = (uint8_t)(prefs::SettingsPayloadLenV2 >> 8);
+        crcPos = prefs::SettingsHeaderLen + prefs::SettingsPayloadLenV2;
+        crc = prefs::Crc32(blob, crcPos);
+        for (int i = 0; i < 4; i++)
+            blob[crcPos + i] = (uint8_t)(crc >> (8 * i));
+        Check(prefs::DecodeSettings(blob, crcPos + 4, data) && data.tempBias.weight[0] == 0 &&
+                  data.tempBias.bias[0][0] == 0.0F,
+              "version 2 blob decoded without temperature bias");
+        blob[4] = prefs::SettingsBlobVersion + 1;
+        Check(!prefs::DecodeSettings(blob, len, data), "newer version rejected");
+    }
+
+    {
+        // 送信先の一覧が収まらないときは最後の完全な項目までで切り，途中で切れたアドレスを残さない
+        prefs::SettingsService service(store);
+        uint32_t now = 0;
+        std::string list;
+        for (int i = 0; i < 7; i++)
+            list += (i == 0 ? "" : ",") + std::string("192.168.100.") + std::to_string(101 + i);
+        service.apply(prefs::SettingsChange::Text(prefs::FieldDestinations, list.c_str()), now);
+        std::string kept = service.data().destinations;
+        Check(list.size() >= prefs::SettingsDestinationsLen && kept.size() < prefs::SettingsDestinationsLen &&
+                  list.compare(0, kept.size(), kept) == 0 && list[kept.size()] == ',',
+              "destinations longer than the field cut at the last complete address");
+        list.resize(prefs::SettingsDestinationsLen - 1);
+        service.apply(prefs::SettingsChange::Text(prefs::FieldDestinations, list.c_str()), now);
+        Check(list == service.data().destinations, "destinations that just fit are kept whole");
+    }
+
+    remove(path);
+    printf("%s\n", failures == 0 ? "all passed" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
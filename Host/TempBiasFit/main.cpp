@@ -0,0 +1,261 @@
+// imu::bias::TempBiasModel に合成したジャイロのドリフトを与え，温度特性の当てはめと
+// 固定オフセットに比べた角度誤差の減り方を確かめる．blobへの詰め込みを経ても結果が変わらないことも確かめる
+//
+// build:
+//   S=../../PlatformIO/src
+//   c++ -std=c++11 -O2 -I$S main.cpp $S/imu/bias/TempBiasModel.cpp $S/prefs/SettingsBlob.cpp
+//       -o temp_bias_fit
+// usage:
+//   ./temp_bias_fit [seed]
+//   終了コード 0: 全て期待どおり, 1: 失敗あり
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include "imu/bias/TempBiasModel.h"
+#include "prefs/SettingsBlob.h"
+
+namespace
+{
+    using imu::bias::TempBiasAxes;
+    using imu::bias::TempBiasBinNum;
+    using imu::bias::TempBiasCurve;
+    using imu::bias::TempBiasModel;
+
+    // MPU6886のゼロ点の温度係数は ±0.05 deg/s/℃ 程度．少し曲げて直線から外す
+    const float TrueBias[TempBiasAxes] = {0.42F, -0.73F, 0.18F}; // 25℃でのオフセット[deg/s]
+    const float TrueSlope[TempBiasAxes] = {0.031F, -0.022F, 0.047F};
+    const float TrueCurvature = 0.0004F; // [deg/s/℃^2]
+    const float StillNoiseDps = 0.04F;   // 1秒窓の平均に残る雑音 (0.5deg/s / sqrt(200))
+    const float TempNoiseC = 0.1F;       // 温度センサの読みの揺らぎ
+    const int StillEverySeconds = 45;    // 静止窓が得られる間隔 (手に持って振っている合間)
+
+    std::mt19937 rng(1);
+    int failures = 0;
+
+    void Check(bool condition, const char *what)
+    {
+        printf("%s: %s\n", condition ? "ok" : "NG", what);
+        if (!condition)
+            failures++;
+    }
+
+    float Gaussian(float sigma)
+    {
+        return std::normal_distribution<float>(0.0F, sigma)(rng);
+    }
+
+    void BiasAt(float temp, float *out)
+    {
+        float dt = temp - 25.0F;
+        for (int i = 0; i < TempBiasAxes; i++)
+            out[i] = TrueBias[i] + TrueSlope[i] * dt + TrueCurvature * dt * dt;
+    }
+
+    /**
+     * @brief 手に持って温まり，置いて冷める温度の推移
+     *
+     * @param t 電源投入からの時間[s]
+     */
+    float TemperatureAt(float t, float startC, float peakC)
+    {
+        const float WarmSeconds = 2400.0F;
+        const float Tau = 600.0F;
+        if (t < WarmSeconds)
+            return peakC - (peakC - startC) * expf(-t / Tau);
+        float top = peakC - (peakC - startC) * expf(-WarmSeconds / Tau);
+        return startC + (top - startC) * expf(-(t - WarmSeconds) / Tau);
+    }
+
+    /**
+     * @brief 1回分の使用を流し，静止窓毎に学習させる
+     */
+    void Learn(TempBiasModel &model, float startC, float peakC, int seconds)
+    {
+        for (int t = 0; t < seconds; t += StillEverySeconds)
+        {
+            float temp = TemperatureAt((float)t, startC, peakC);
+            float bias[TempBiasAxes];
+            BiasAt(temp, bias);
+            for (int i = 0; i < TempBiasAxes; i++)
+                bias[i] += Gaussian(StillNoiseDps);
+            model.observe(temp + Gaussian(TempNoiseC), bias);
+        }
+    }
+
+    /**
+     * @brief 残ったオフセットを積分した角度の誤差[deg]の3軸の最大値
+     *
+     * @param curve NULL: 起動時に求めた固定のオフセットを使う
+     */
+    float AngleError(const TempBiasCurve *curve, float startC, float peakC, int seconds)
+    {
+        float fixed[TempBiasAxes];
+        BiasAt(startC, fixed);
+        double error[TempBiasAxes] = {0.0};
+        for (int t = 0; t < seconds; t++)
+        {
+            float temp = TemperatureAt((float)t, startC, peakC);
+            float truth[TempBiasAxes];
+            float applied[TempBiasAxes];
+            BiasAt(temp, truth);
+            if (curve != NULL)
+                curve->evaluate(temp, applied);
+            for (int i = 0; i < TempBiasAxes; i++)
+                error[i] += truth[i] - ((curve != NULL) ? applied[i] : fixed[i]);
+        }
+        float worst = 0.0F;
+        for (int i = 0; i < TempBiasAxes; i++)
+            worst = fmaxf(worst, (float)fabs(error[i]));
+        return worst;
+    }
+
+    /**
+     * @brief main.cpp と同じ手順で区間をblobに詰め，読み戻す
+     */
+    void RoundTrip(const TempBiasModel &model, TempBiasModel &outModel)
+    {
+        prefs::SettingsData data;
+        for (int i = 0; i < TempBiasBinNum; i++)
+        {
+            const imu::bias::TempBiasBin &bin = model.bin(i);
+            data.tempBias.temp[i] = bin.temp;
+            for (int axis = 0; axis < TempBiasAxes; axis++)
+                data.tempBias.bias[i][axis] = bin.bias[axis];
+            data.tempBias.weight[i] = (uint8_t)bin.weight;
+        }
+        uint8_t blob[prefs::SettingsBlobLen];
+        size_t len = prefs::EncodeSettings(data, blob, sizeof(blob));
+        prefs::SettingsData loaded;
+        prefs::DecodeSettings(blob, len, loaded);
+        outModel.clear();
+        for (int i = 0; i < TempBiasBinNum; i++)
+        {
+            imu::bias::TempBiasBin bin;
+            bin.temp = loaded.tempBias.temp[i];
+            for (int axis = 0; axis < TempBiasAxes; axis++)
+                bin.bias[axis] = loaded.tempBias.bias[i][axis];
+            bin.weight = loaded.tempBias.weight[i];
+            outModel.setBin(i, bin);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        rng.seed((unsigned)atoi(argv[1]));
+
+    TempBiasModel model;
+    TempBiasCurve curve;
+    float bias[TempBiasAxes];
+    BiasAt(25.0F, bias);
+    model.observe(25.0F, bias);
+    model.observe(26.0F, bias);
+    Check(!model.fit(curve) && !curve.valid, "narrow temperature span is not fitted");
+    Check(!model.observe(NAN, bias) && !model.observe(5.0F, bias) && !model.observe(55.0F, bias),
+          "temperatures out of range rejected");
+
+    TempBiasModel steep;
+    float wild[TempBiasAxes] = {0.0F, 0.0F, 0.0F};
+    steep.observe(20.0F, wild);
+    wild[0] = 10.0F;
+    steep.observe(30.0F, wild);
+    Check(!steep.fit(curve), "implausible slope rejected");
+
+    // 1回目の使用で学習する (24℃から38℃へ温まり，冷める)
+    model.clear();
+    Learn(model, 24.0F, 38.0F, 4800);
+    Check(model.fit(curve), "curve fitted after one session");
+    printf("    bins %d, range %.1f..%.1f C\n", model.populatedBins(), curve.minTemp, curve.maxTemp);
+    float maxSlopeError = 0.0F;
+    for (int i = 0; i < TempBiasAxes; i++)
+    {
+        float expected = TrueSlope[i] + 2.0F * TrueCurvature * (curve.refTemp - 25.0F); // 参照温度での接線
+        maxSlopeError = fmaxf(maxSlopeError, fabsf(curve.slope[i] - expected));
+        printf("    axis %d: slope %+.4f (true %+.4f) deg/s/C\n", i, curve.slope[i], expected);
+    }
+    Check(maxSlopeError < 0.01F, "slope within 0.01 deg/s/C");
+
+    // 2回目の使用で，起動時の固定オフセットと温度補正の角度誤差を比べる
+    float fixedError = AngleError(NULL, 24.0F, 38.0F, 2400);
+    float curveError = AngleError(&curve, 24.0F, 38.0F, 2400);
+    printf("    40 min warm-up drift: fixed offset %.0f deg, temperature curve %.0f deg\n", fixedError, curveError);
+    Check(curveError * 5.0F < fixedError, "temperature curve cuts drift at least 5x");
+
+    // 観測した範囲の外は端の値で止める
+    float edge[TempBiasAxes];
+    float far[TempBiasAxes];
+    curve.evaluate(curve.maxTemp, edge);
+    curve.evaluate(curve.maxTemp + 20.0F, far);
+    Check(edge[0] == far[0] && edge[2] == far[2], "no extrapolation beyond observed range");
+
+    // 保存して読み戻しても同じ補正になる
+    TempBiasModel loaded;
+    TempBiasCurve loadedCurve;
+    RoundTrip(model, loaded);
+    Check(loaded.fit(loadedCurve), "reloaded table fits");
+    float worst = 0.0F;
+    for (float t = curve.minTemp; t <= curve.maxTemp; t += 0.5F)
+    {
+        float a[TempBiasAxes];
+        float b[TempBiasAxes];
+        curve.evaluate(t, a);
+        loadedCurve.evaluate(t, b);
+        for (int i = 0; i < TempBiasAxes; i++)
+            worst = fmaxf(worst, fabsf(a[i] - b[i]));
+    }
+    printf("    quantization error %.5f deg/s\n", worst);
+    Check(worst < 0.002F, "blob quantization below 0.002 deg/s");
+
+    // /set/offset で測った残りは，1回の観測では重みの大きい区間に埋もれるが，全区間をずらせば直線から消える
+    {
+        const float residual[TempBiasAxes] = {0.3F, -0.2F, 0.1F};
+        const float now = 30.0F;
+        float applied[TempBiasAxes];
+        curve.evaluate(now, applied);
+        float measured[TempBiasAxes];
+        for (int i = 0; i < TempBiasAxes; i++)
+            measured[i] = applied[i] + residual[i];
+
+        TempBiasModel observed = model;
+        TempBiasCurve observedCurve;
+        observed.observe(now, measured);
+        observed.fit(observedCurve);
+        TempBiasModel shifted = model;
+        TempBiasCurve shiftedCurve;
+        shifted.shift(residual);
+        shifted.fit(shiftedCurve);
+
+        float observedLeft = 0.0F, shiftedLeft = 0.0F, slopeChange = 0.0F;
+        float a[TempBiasAxes], b[TempBiasAxes];
+        observedCurve.evaluate(now, a);
+        shiftedCurve.evaluate(now, b);
+        for (int i = 0; i < TempBiasAxes; i++)
+        {
+            observedLeft = fmaxf(observedLeft, fabsf(measured[i] - a[i]) / fabsf(residual[i]));
+            shiftedLeft = fmaxf(shiftedLeft, fabsf(measured[i] - b[i]));
+            slopeChange = fmaxf(slopeChange, fabsf(shiftedCurve.slope[i] - curve.slope[i]));
+        }
+        printf("    residual left after one observation %.0f%%, after shift %.6f deg/s\n", observedLeft * 100.0F,
+               shiftedLeft);
+        Check(observedLeft > 0.5F, "a single observation barely moves a learned curve");
+        Check(shiftedCurve.valid && shiftedLeft < 1e-4F && slopeChange < 1e-5F,
+              "shift() removes the residual at once and keeps the slope");
+    }
+
+    // 重みが上限に達した区間は新しい観測に追従する (経年変化)
+    TempBiasModel aging;
+    float before[TempBiasAxes] = {1.0F, 1.0F, 1.0F};
+    float after[TempBiasAxes] = {1.5F, 1.5F, 1.5F};
+    for (int i = 0; i < 200; i++)
+        aging.observe(30.0F, before);
+    for (int i = 0; i < 120; i++)
+        aging.observe(30.0F, after);
+    int agingBin = TempBiasModel::BinIndex(30.0F);
+    Check(aging.bin(agingBin).bias[0] > 1.4F, "saturated bin follows new observations");
+
+    printf("%s\n", failures == 0 ? "all passed" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
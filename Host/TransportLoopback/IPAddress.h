@@ -0,0 +1,22 @@
+#pragma once
+#include <inttypes.h>
+#include <string.h>
+
+// osc::OscTransport をホストでビルドするための，Arduino の IPAddress のうち使う部分だけを写したもの
+// uint32_t への変換は Arduino と同じくメモリ上のバイト順 (= ネットワークバイトオーダー) のまま
+class IPAddress
+{
+public:
+    IPAddress() : addr(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+    {
+        uint8_t bytes[4] = {a, b, c, d};
+        memcpy(&addr, bytes, sizeof(addr));
+    }
+    IPAddress(uint32_t value) : addr(value) {}
+    operator uint32_t() const { return addr; }
+    uint8_t operator[](int index) const { return ((const uint8_t *)&addr)[index]; }
+
+private:
+    uint32_t addr;
+};
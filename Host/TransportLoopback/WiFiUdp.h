@@ -0,0 +1,77 @@
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <vector>
+#include "IPAddress.h"
+
+// osc::OscTransport をホストでビルドするための，Arduino の WiFiUDP の送信側だけを
+// BSDソケットで写したもの．beginPacket() から endPacket() までに write() した分を1つのデータグラムで送る
+class WiFiUDP
+{
+public:
+    explicit WiFiUDP() : sock(-1), failSends(0)
+    {
+        memset(&to, 0, sizeof(to));
+    }
+    ~WiFiUDP()
+    {
+        if (sock >= 0)
+            close(sock);
+    }
+
+    // マルチキャストをループバックから出して，同じホストで受けられるようにする
+    bool begin()
+    {
+        sock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock < 0)
+            return false;
+        struct in_addr loopback;
+        loopback.s_addr = htonl(INADDR_LOOPBACK);
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &loopback, sizeof(loopback));
+        unsigned char loop = 1;
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+        return true;
+    }
+
+    // 次の n 回の endPacket() を失敗させる (送信エラーの数え方を確かめる)
+    void failNextSends(int n) { failSends = n; }
+
+    int beginPacket(IPAddress ip, uint16_t destPort)
+    {
+        if (sock < 0)
+            return 0;
+        memset(&to, 0, sizeof(to));
+        to.sin_family = AF_INET;
+        to.sin_addr.s_addr = (uint32_t)ip;
+        to.sin_port = htons(destPort);
+        packet.clear();
+        return 1;
+    }
+
+    size_t write(const uint8_t *data, size_t len)
+    {
+        packet.insert(packet.end(), data, data + len);
+        return len;
+    }
+
+    int endPacket()
+    {
+        if (failSends > 0)
+        {
+            failSends--;
+            return 0;
+        }
+        return sendto(sock, packet.data(), packet.size(), 0, (struct sockaddr *)&to, sizeof(to)) == (ssize_t)packet.size();
+    }
+
+private:
+    int sock;
+    int failSends;
+    struct sockaddr_in to;
+    std::vector<uint8_t> packet;
+};
@@ -0,0 +1,272 @@
+// osc::OscTransport で同じパケットを複数の宛先へ送り，ループバック上の受信側 (127.0.0.1 - 127.0.0.5 と
+// マルチキャストグループ) がそれぞれ全てのパケットを1回ずつ，順序どおり，欠けずに受け取ることを確かめる
+// 宛先の重複 / 0.0.0.0 / osc::TransportMaxDestinations を超える追加を断ること，送信エラーの数え方も確かめる
+// WiFiUDP と IPAddress はこのディレクトリのBSDソケットでの写しを使う
+//
+// build:
+//   S=../../PlatformIO/src
+//   c++ -std=c++11 -O2 -I. -I$S main.cpp $S/osc/OscTransport.cpp $S/osc/OscPacketWriter.cpp -o transport_loopback
+// usage:
+//   ./transport_loopback [port]   (default: 39001)
+//   終了コード 0: 全て期待どおり, 1: 失敗あり
+//   127.0.0.2 以降はLinuxのループバック (127.0.0.0/8) を前提とする．
+//   マルチキャストをループバックで受けられない環境ではその受信側を飛ばす (skip と表示する)
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "osc/OscPacketWriter.h"
+#include "osc/OscTransport.h"
+
+namespace
+{
+    const int UnicastListeners = 5;
+    const int Packets = 200;
+    const char *MulticastGroup = "239.255.77.1";
+
+    int failures = 0;
+
+    void Check(bool condition, const char *what)
+    {
+        printf("%s: %s\n", condition ? "ok" : "NG", what);
+        if (!condition)
+            failures++;
+    }
+
+    /**
+     * @brief 1つの宛先で受けるソケット
+     */
+    struct Listener
+    {
+        std::string name;
+        uint32_t address; // ネットワークバイトオーダー
+        int sock;
+        std::vector<std::vector<uint8_t> > received;
+    };
+
+    int OpenListener(uint32_t address, uint16_t port, bool multicast)
+    {
+        int sock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock < 0)
+            return -1;
+        int reuse = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        int rcvbuf = 1 << 20; // 受信側が読む前に全て送るため，取りこぼさない大きさにする
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = address; // マルチキャストはグループのアドレスにbindして，ユニキャストを受けない
+        addr.sin_port = htons(port);
+        if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            close(sock);
+            return -1;
+        }
+        if (multicast)
+        {
+            struct ip_mreq mreq;
+            mreq.imr_multiaddr.s_addr = address;
+            mreq.imr_interface.s_addr = htonl(INADDR_LOOPBACK);
+            if (setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0)
+            {
+                close(sock);
+                return -1;
+            }
+        }
+        return sock;
+    }
+
+    /**
+     * @brief 届いている分を全て読む．timeoutMs の間何も届かなければ終わる
+     */
+    void Drain(std::vector<Listener> &listeners, int timeoutMs)
+    {
+        while (true)
+        {
+            fd_set fds;
+            FD_ZERO(&fds);
+            int maxFd = -1;
+            for (size_t i = 0; i < listeners.size(); i++)
+            {
+                FD_SET(listeners[i].sock, &fds);
+                maxFd = (listeners[i].sock > maxFd) ? listeners[i].sock : maxFd;
+            }
+            struct timeval timeout;
+            timeout.tv_sec = 0;
+            timeout.tv_usec = timeoutMs * 1000;
+            if (select(maxFd + 1, &fds, NULL, NULL, &timeout) <= 0)
+                return;
+            for (size_t i = 0; i < listeners.size(); i++)
+            {
+                if (!FD_ISSET(listeners[i].sock, &fds))
+                    continue;
+                uint8_t buffer[osc::OscPacketMaxLen + 16];
+                ssize_t len = recv(listeners[i].sock, buffer, sizeof(buffer), MSG_DONTWAIT);
+                if (len > 0)
+                    listeners[i].received.push_back(std::vector<uint8_t>(buffer, buffer + len));
+            }
+        }
+    }
+
+    /**
+     * @brief 番号 index のパケット．大きさを変え (最大はMTU分)，中身も番号から決める
+     */
+    std::vector<uint8_t> MakePacket(int index)
+    {
+        uint8_t buffer[osc::OscPacketMaxLen];
+        osc::OscPacketWriter writer(buffer, sizeof(buffer));
+        writer.beginMessage("/stick01/quat", ",ib");
+        writer.writeInt32(index);
+        // 最後のパケットは OscPacketMaxLen ちょうどに合わせる (blobの長さ4byte + 4byte境界)
+        size_t blobLen = (index == Packets - 1) ? ((osc::OscPacketMaxLen - writer.size() - 4) & ~(size_t)3)
+                                                : (size_t)(index * 7 % 1200);
+        std::vector<uint8_t> blob(blobLen, (uint8_t)index);
+        writer.writeBlob(blob.data(), blob.size());
+        return std::vector<uint8_t>(writer.data(), writer.data() + writer.size());
+    }
+
+    IPAddress Loopback(int host)
+    {
+        return IPAddress(127, 0, 0, (uint8_t)host);
+    }
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    uint16_t port = (uint16_t)(argc > 1 ? atoi(argv[1]) : 39001);
+
+    std::vector<Listener> listeners;
+    for (int i = 0; i < UnicastListeners; i++)
+    {
+        Listener l;
+        l.address = (uint32_t)Loopback(i + 1);
+        l.name = "127.0.0." + std::to_string(i + 1);
+        l.sock = OpenListener(l.address, port, false);
+        if (l.sock < 0)
+        {
+            fprintf(stderr, "cannot bind %s:%u\n", l.name.c_str(), port);
+            return 1;
+        }
+        listeners.push_back(l);
+    }
+    bool multicast = false;
+    {
+        Listener l;
+        l.address = inet_addr(MulticastGroup);
+        l.name = MulticastGroup;
+        l.sock = OpenListener(l.address, port, true);
+        if (l.sock >= 0)
+        {
+            listeners.push_back(l);
+            multicast = true;
+        }
+        else
+        {
+            printf("skip: multicast listener (cannot join %s on loopback)\n", MulticastGroup);
+        }
+    }
+
+    WiFiUDP udp;
+    if (!udp.begin())
+    {
+        fprintf(stderr, "cannot open the sending socket\n");
+        return 1;
+    }
+    osc::OscTransport transport(udp);
+
+    // 宛先の登録
+    {
+        bool added = true;
+        for (size_t i = 0; i < listeners.size(); i++)
+            added = added && transport.addDestination(IPAddress(listeners[i].address));
+        Check(added && transport.destinationCount() == (int)listeners.size(), "every listener added as a destination");
+        Check(transport.addDestination(Loopback(1)) && transport.destinationCount() == (int)listeners.size(),
+              "duplicate destination accepted once");
+        Check(!transport.addDestination(IPAddress()), "0.0.0.0 refused");
+        Check(osc::OscTransport::IsMulticast(IPAddress(inet_addr(MulticastGroup))) && !osc::OscTransport::IsMulticast(Loopback(1)),
+              "multicast range detected");
+
+        int room = osc::TransportMaxDestinations - transport.destinationCount();
+        bool filled = true;
+        for (int i = 0; i < room; i++)
+            filled = filled && transport.addDestination(Loopback(100 + i));
+        Check(filled && transport.destinationCount() == osc::TransportMaxDestinations, "fills up to TransportMaxDestinations");
+        Check(!transport.addDestination(Loopback(200)) && transport.destinationCount() == osc::TransportMaxDestinations,
+              "destination beyond TransportMaxDestinations refused");
+
+        // 受信側のない宛先を外し，受信側だけに戻す (送信タスクが宛先を作り直すときと同じ)
+        transport.clear();
+        for (size_t i = 0; i < listeners.size(); i++)
+            transport.addDestination(IPAddress(listeners[i].address));
+    }
+
+    // 全ての宛先へ送る
+    std::vector<std::vector<uint8_t> > sent;
+    bool allSent = true;
+    for (int i = 0; i < Packets; i++)
+    {
+        sent.push_back(MakePacket(i));
+        allSent = allSent && transport.send(sent.back().data(), sent.back().size(), port) == (int)listeners.size();
+        if (i % 32 == 31)
+            Drain(listeners, 0);
+    }
+    Drain(listeners, 200);
+    Check(allSent && transport.sendErrors() == 0, "send() reaches every destination without errors");
+    Check(sent.back().size() == osc::OscPacketMaxLen, "largest packet is exactly OscPacketMaxLen");
+
+    for (size_t i = 0; i < listeners.size(); i++)
+    {
+        const Listener &l = listeners[i];
+        bool same = l.received.size() == sent.size();
+        for (size_t j = 0; same && j < sent.size(); j++)
+            same = l.received[j] == sent[j];
+        char what[128];
+        snprintf(what, sizeof(what), "%s: %d packets received once, in order, intact (got %zu)", l.name.c_str(), Packets,
+                 l.received.size());
+        Check(same, what);
+    }
+
+    // 送信エラーは宛先毎に数え，ほかの宛先への送信は続ける
+    {
+        for (size_t i = 0; i < listeners.size(); i++)
+            listeners[i].received.clear();
+        udp.failNextSends(1);
+        std::vector<uint8_t> packet = MakePacket(1);
+        int reached = transport.send(packet.data(), packet.size(), port);
+        Drain(listeners, 200);
+        bool othersGot = listeners[0].received.empty();
+        for (size_t i = 1; i < listeners.size(); i++)
+            othersGot = othersGot && listeners[i].received.size() == 1;
+        Check(reached == (int)listeners.size() - 1 && transport.sendErrors() == 1 && othersGot,
+              "a failed send counts one error and the other destinations still receive");
+    }
+
+    // 宛先を消したら何も届かない
+    {
+        for (size_t i = 0; i < listeners.size(); i++)
+            listeners[i].received.clear();
+        transport.clear();
+        std::vector<uint8_t> packet = MakePacket(2);
+        int reached = transport.send(packet.data(), packet.size(), port);
+        Drain(listeners, 100);
+        bool silent = true;
+        for (size_t i = 0; i < listeners.size(); i++)
+            silent = silent && listeners[i].received.empty();
+        Check(reached == 0 && silent, "clear(): nothing is sent");
+    }
+
+    for (size_t i = 0; i < listeners.size(); i++)
+        close(listeners[i].sock);
+    printf("%d listeners%s\n", (int)listeners.size(), multicast ? " (including multicast)" : "");
+    printf("%s\n", failures == 0 ? "all passed" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
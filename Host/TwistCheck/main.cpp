@@ -0,0 +1,150 @@
+// imu::twist::TwistCounter に各軸周りの高速回転 (15回転/秒超) と逆回転の姿勢列を与え，
+// 符号付きの累積角度と回転数，reset() と setOffset() の振る舞いを確かめる
+//
+// build:
+//   S=../../PlatformIO/src
+//   c++ -std=c++11 -O2 -I$S main.cpp $S/imu/twist/Twist.cpp -o twist_check
+// usage:
+//   ./twist_check
+//   終了コード 0: 全て期待どおり, 1: 失敗あり
+
+#include <cmath>
+#include <cstdio>
+#include "imu/ImuData.h"
+#include "imu/twist/Twist.h"
+
+namespace
+{
+    using imu::twist::TwistAxisNum;
+    using imu::twist::TwistCounter;
+    using imu::twist::TwistData;
+
+    const double Pi = 3.14159265358979323846;
+    const float DegreeTolerance = 0.5F; // 累積角度の許容誤差[deg] (floatの姿勢を数千回積算した分)
+    const float CrossTolerance = 0.5F;  // 回していない軸のねじれ角の許容値[deg]
+    const char *AxisName[TwistAxisNum] = {"X", "Y", "Z"};
+
+    int failures = 0;
+
+    void Check(bool condition, const char *what)
+    {
+        printf("%s: %s\n", condition ? "ok" : "NG", what);
+        if (!condition)
+            failures++;
+    }
+
+    /**
+     * @brief 軸axis周りに角度angle[deg]回した姿勢 (w, x, y, z)
+     */
+    void AxisAngle(int axis, double angle, float *quat)
+    {
+        double half = angle * Pi / 360.0;
+        quat[0] = (float)cos(half);
+        for (int i = 0; i < TwistAxisNum; i++)
+            quat[1 + i] = (i == axis) ? (float)sin(half) : 0.0F;
+    }
+
+    /**
+     * @brief 現在の角度から一定の角速度で回した姿勢を順に与える
+     *
+     * @param angle 現在の角度[deg]．回した後の角度に更新する
+     * @param revPerSec 回転速度[回転/秒] (負: 逆回転)
+     * @return 回した角度[deg]
+     */
+    double Spin(TwistCounter &counter, int axis, double &angle, double revPerSec, double seconds, int rateHz)
+    {
+        int samples = (int)(seconds * rateHz + 0.5);
+        double step = revPerSec * 360.0 / rateHz;
+        for (int i = 0; i < samples; i++)
+        {
+            angle += step;
+            float quat[imu::ImuWxyz];
+            AxisAngle(axis, angle, quat);
+            counter.update(quat);
+        }
+        return step * samples;
+    }
+
+    /**
+     * @brief 1軸について，正転 -> 逆転 -> setOffset() -> reset() を確かめる
+     */
+    void CheckAxis(int axis, int rateHz)
+    {
+        char what[128];
+        TwistCounter counter;
+        TwistData data;
+        double angle = 0.0;
+        printf("axis %s at %d Hz\n", AxisName[axis], rateHz);
+
+        // 18回転/秒で2.05秒: +36.9回転 (回転数の境目ちょうどで止めない)
+        double expected = Spin(counter, axis, angle, 18.0, 2.05, rateHz);
+        counter.read(data);
+        printf("  forward: %.1f deg (expected %.1f), count %d\n", data.totalDegree[axis], expected, data.count[axis]);
+        snprintf(what, sizeof(what), "%s forward 18 rev/s: signed degrees", AxisName[axis]);
+        Check(fabs(data.totalDegree[axis] - expected) < DegreeTolerance, what);
+        snprintf(what, sizeof(what), "%s forward 18 rev/s: count", AxisName[axis]);
+        Check(data.count[axis] == 36, what);
+        bool crossOk = true;
+        for (int i = 0; i < TwistAxisNum; i++)
+            if (i != axis && fabsf(data.totalDegree[i]) > CrossTolerance)
+                crossOk = false;
+        snprintf(what, sizeof(what), "%s forward: other axes stay near 0", AxisName[axis]);
+        Check(crossOk, what);
+
+        // 向きを変えて25回転/秒で2.1秒: -52.5回転 -> 合計 -15.6回転．回転数は0方向に切り捨てて -15
+        expected += Spin(counter, axis, angle, -25.0, 2.1, rateHz);
+        counter.read(data);
+        printf("  reversed: %.1f deg (expected %.1f), count %d\n", data.totalDegree[axis], expected, data.count[axis]);
+        snprintf(what, sizeof(what), "%s reversed 25 rev/s: signed degrees", AxisName[axis]);
+        Check(fabs(data.totalDegree[axis] - expected) < DegreeTolerance, what);
+        snprintf(what, sizeof(what), "%s reversed 25 rev/s: count truncated toward zero", AxisName[axis]);
+        Check(data.count[axis] == -15, what);
+
+        // setOffset(): 以降は0から数え直す
+        counter.setOffset();
+        counter.read(data);
+        snprintf(what, sizeof(what), "%s setOffset: degrees and count restart at 0", AxisName[axis]);
+        Check(fabsf(data.totalDegree[axis]) < 1e-3F && data.count[axis] == 0, what);
+        double sinceOffset = Spin(counter, axis, angle, 16.0, 0.53, rateHz); // +8.48回転
+        counter.read(data);
+        snprintf(what, sizeof(what), "%s setOffset: counts turns from the offset", AxisName[axis]);
+        Check(fabs(data.totalDegree[axis] - sinceOffset) < DegreeTolerance && data.count[axis] == 8, what);
+
+        // reset(): 累積もオフセットも0に戻る．姿勢はそのままなので続けて回せば0から増える
+        counter.reset();
+        counter.read(data);
+        snprintf(what, sizeof(what), "%s reset: degrees and count are 0", AxisName[axis]);
+        Check(fabsf(data.totalDegree[axis]) < 1e-3F && data.count[axis] == 0, what);
+        double sinceReset = Spin(counter, axis, angle, -20.0, 0.27, rateHz); // -5.4回転
+        counter.read(data);
+        snprintf(what, sizeof(what), "%s reset: counts turns from 0", AxisName[axis]);
+        Check(fabs(data.totalDegree[axis] - sinceReset) < DegreeTolerance && data.count[axis] == -5, what);
+    }
+
+} // namespace
+
+int main()
+{
+    // 200Hz: 1サンプル当たり最大45° (180°未満なら向きを取り違えない), 1kHz: FIFO読み出しの上限
+    const int rates[] = {200, 1000};
+    for (int r = 0; r < 2; r++)
+        for (int axis = 0; axis < TwistAxisNum; axis++)
+            CheckAxis(axis, rates[r]);
+
+    // resetRotation(): AHRSを初期化して姿勢が単位元に飛んでも，その飛びをねじれとして数えない
+    TwistCounter counter;
+    TwistData data;
+    double angle = 0.0;
+    Spin(counter, 2, angle, 20.0, 0.5, 200); // +10回転 (+3600°) から 0° に戻る姿勢で終わる
+    angle = 100.0;
+    float quat[imu::ImuWxyz];
+    AxisAngle(2, angle, quat);
+    counter.resetRotation();
+    counter.update(quat);
+    counter.read(data);
+    Check(fabsf(data.totalDegree[2] - 3700.0F) < DegreeTolerance && data.count[2] == 10,
+          "resetRotation: first pose after reset is measured from identity");
+
+    printf("%s\n", failures == 0 ? "all passed" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <atomic>
+#include <string.h>
+
+namespace concurrent
+{
+
+    /**
+     * @brief 書き込み側が待たないスナップショット (seqlock)
+     * @brief 書き込みは1タスクのみ．読み出しは複数タスクから行える
+     * @brief read() は書き込み中なら終わるまで回り続ける．書き込み側と同じコアで優先度の高いタスクからは
+     * @brief 書き込み側が再開できず止まってしまうため，tryRead() を使うこと
+     * @brief Tはmemcpyでコピーできる型であること
+     */
+    template <typename T>
+    class SeqLock
+    {
+    public:
+        explicit SeqLock() : seq(0), value() {}
+
+        /**
+         * @brief 値を書き込む．読み出し側を一切待たない
+         *
+         * @param in 書き込む値
+         */
+        void write(const T &in)
+        {
+            uint32_t s = seq.load(std::memory_order_relaxed);
+            seq.store(s + 1, std::memory_order_relaxed); // 奇数: 書き込み中
+            std::atomic_thread_fence(std::memory_order_release);
+            memcpy(&value, &in, sizeof(T));
+            seq.store(s + 2, std::memory_order_release);
+        }
+
+        /**
+         * @brief 一貫した値を読み出す．書き込み中に重なった場合は読み直す
+         *
+         * @param out 読み出した値を保存する変数のアドレス
+         * @return uint32_t 読み出した値の世代 (書き込み回数 * 2)
+         */
+        uint32_t read(T &out) const
+        {
+            uint32_t s1, s2;
+            do
+            {
+                s1 = seq.load(std::memory_order_acquire);
+                memcpy(&out, &value, sizeof(T));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                s2 = seq.load(std::memory_order_relaxed);
+            } while ((s1 & 1U) || s1 != s2);
+            return s1;
+        }
+
+        /**
+         * @brief 一貫した値を1回だけ読みにいく．書き込み中に重なった場合は待たずに諦める
+         *
+         * @param out 読み出した値を保存する変数．失敗したときは書き換えない
+         * @param version 読み出した値の世代 (書き込み回数 * 2)．失敗したときは書き換えない
+         * @return true 正常終了
+         * @return false 異常終了 書き込み中だった (前の値を使い続け，次の機会に読み直す)
+         */
+        bool tryRead(T &out, uint32_t &version) const
+        {
+            uint32_t s1 = seq.load(std::memory_order_acquire);
+            if (s1 & 1U)
+                return false;
+            T copy;
+            memcpy(&copy, &value, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq.load(std::memory_order_relaxed) != s1)
+                return false;
+            memcpy(&out, &copy, sizeof(T));
+            version = s1;
+            return true;
+        }
+
+    private:
+        std::atomic<uint32_t> seq;
+        T value;
+    };
+
+} // concurrent
@@ -0,0 +1,81 @@
+#pragma once
+#include <atomic>
+#include <inttypes.h>
+#include <string.h>
+
+namespace concurrent
+{
+
+    /**
+     * @brief 書き込み1タスク/読み出し1タスク専用のロックフリーなリングバッファ
+     * @brief どちらも相手を待たない．満杯の場合は新しいデータを捨てて，捨てた数を数える
+     * @brief Tはmemcpyでコピーできる型，Nは添字の折り返しのため2のべき乗であること
+     */
+    template <typename T, uint32_t N>
+    class SpscRing
+    {
+        static_assert((N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+    public:
+        explicit SpscRing() : head(0), tail(0), droppedCnt(0) {}
+
+        /**
+         * @brief 末尾に追加する．書き込み側タスクからのみ呼ぶこと
+         *
+         * @return true 正常終了
+         * @return false 異常終了 満杯でデータを捨てた
+         */
+        bool push(const T &item)
+        {
+            uint32_t t = tail.load(std::memory_order_relaxed);
+            if (t - head.load(std::memory_order_acquire) >= N)
+            {
+                droppedCnt.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            memcpy(&data[t % N], &item, sizeof(T));
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief 最も古いデータを取り出す．読み出し側タスクからのみ呼ぶこと
+         *
+         * @return true 正常終了
+         * @return false 異常終了 空
+         */
+        bool pop(T &out)
+        {
+            uint32_t h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            memcpy(&out, &data[h % N], sizeof(T));
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        int count() const
+        {
+            return (int)(tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire));
+        }
+
+        uint32_t dropped() const { return droppedCnt.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief 溜まっているデータを全て捨てる．読み出し側タスクからのみ呼ぶこと
+         */
+        void clear()
+        {
+            head.store(tail.load(std::memory_order_acquire), std::memory_order_release);
+        }
+
+    private:
+        T data[N];
+        std::atomic<uint32_t> head; // 読み出し側のみが進める
+        std::atomic<uint32_t> tail; // 書き込み側のみが進める
+        std::atomic<uint32_t> droppedCnt;
+    };
+
+} // concurrent
@@ -0,0 +1,65 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "TextFrame.h"
+
+namespace display
+{
+
+    TextFrame::TextFrame() : rowCount(0)
+    {
+        memset(rowData, 0, sizeof(rowData));
+    }
+
+    /**
+     * @brief 行数を変えて全ての行を空にする．画面の種類を切り替えるときに呼ぶ
+     */
+    void TextFrame::begin(int rows)
+    {
+        rowCount = (rows < TextFrameMaxRows) ? rows : TextFrameMaxRows;
+        for (int i = 0; i < TextFrameMaxRows; i++)
+        {
+            rowData[i].text[0] = '\0';
+            rowData[i].fg = 0;
+            rowData[i].bg = 0;
+        }
+        invalidate();
+    }
+
+    /**
+     * @brief 1行分の内容を設定する．文字と色が前回と同じなら再描画しない
+     *
+     * @param row 行番号
+     * @param fg 文字色 (RGB565)
+     * @param bg 背景色 (RGB565)
+     * @param format printfと同じ書式．TextFrameRowLen-1文字で切り詰める
+     */
+    void TextFrame::setRow(int row, uint16_t fg, uint16_t bg, const char *format, ...)
+    {
+        if (row < 0 || row >= rowCount)
+            return;
+        char text[TextFrameRowLen];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(text, sizeof(text), format, args);
+        va_end(args);
+
+        Row &r = rowData[row];
+        if (r.fg == fg && r.bg == bg && strcmp(r.text, text) == 0)
+            return;
+        memcpy(r.text, text, sizeof(text));
+        r.fg = fg;
+        r.bg = bg;
+        r.dirty = true;
+    }
+
+    /**
+     * @brief 全ての行を描き直す
+     */
+    void TextFrame::invalidate()
+    {
+        for (int i = 0; i < TextFrameMaxRows; i++)
+            rowData[i].dirty = true;
+    }
+
+} // display
@@ -0,0 +1,41 @@
+#pragma once
+#include <inttypes.h>
+
+namespace display
+{
+
+    static const int TextFrameMaxRows = 10; // 160x80 のLcdに 8px のフォントで10行
+    static const int TextFrameRowLen = 32;
+
+    /**
+     * @brief 行単位の文字表示の内容を保持し，前回表示したときから変わった行を求める
+     * @brief 表示タスクは変わった行だけをスプライトに描いてLcdへ送る
+     */
+    class TextFrame
+    {
+    public:
+        explicit TextFrame();
+        void begin(int rows);
+        void setRow(int row, uint16_t fg, uint16_t bg, const char *format, ...)
+            __attribute__((format(printf, 5, 6)));
+        void invalidate();
+        bool isDirty(int row) const { return rowData[row].dirty; }
+        void markClean(int row) { rowData[row].dirty = false; }
+        int rows() const { return rowCount; }
+        const char *text(int row) const { return rowData[row].text; }
+        uint16_t foreground(int row) const { return rowData[row].fg; }
+        uint16_t background(int row) const { return rowData[row].bg; }
+
+    private:
+        struct Row
+        {
+            char text[TextFrameRowLen];
+            uint16_t fg;
+            uint16_t bg;
+            bool dirty;
+        };
+        Row rowData[TextFrameMaxRows];
+        int rowCount;
+    };
+
+} // display
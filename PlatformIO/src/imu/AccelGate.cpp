@@ -0,0 +1,58 @@
+#include <math.h>
+#include "AccelGate.h"
+
+namespace imu
+{
+
+    /**
+     * @brief 1軸でもフルスケールに達した値があれば ImuFlagGyroSaturated / ImuFlagAccelSaturated を返す
+     *
+     * @param acc 加速度[g]
+     * @param gyro 角速度[deg/s] (オフセット補正前)
+     */
+    uint32_t SaturationFlags(const float *acc, const float *gyro)
+    {
+        uint32_t flags = 0;
+        for (int i = 0; i < ImuXyz; i++)
+        {
+            if (fabsf(gyro[i]) >= GyroSaturationDps)
+                flags |= ImuFlagGyroSaturated;
+            if (fabsf(acc[i]) >= AccelSaturationG)
+                flags |= ImuFlagAccelSaturated;
+        }
+        return flags;
+    }
+
+    /**
+     * @brief 加速度の大きさだけから決まる重み
+     *
+     * @param accNormG 加速度の大きさ[g]
+     * @return float 0 (使わない) 〜 1 (そのまま使う)
+     */
+    float AccelGate::InstantWeight(float accNormG)
+    {
+        float deviation = fabsf(accNormG - 1.0F);
+        if (deviation <= AccelTrustBandG)
+            return 1.0F;
+        if (!(deviation < AccelRejectBandG)) // NaNも使わない
+            return 0.0F;
+        return (AccelRejectBandG - deviation) / (AccelRejectBandG - AccelTrustBandG);
+    }
+
+    /**
+     * @brief 1サンプル分の加速度から補正の重みを更新する
+     *
+     * @param acc 加速度[g]
+     * @param dt 前のサンプルからの経過時間[s]
+     * @return float 加速度による補正の重み 0〜1
+     */
+    float AccelGate::update(const float *acc, float dt)
+    {
+        float instant = InstantWeight(sqrtf(acc[0] * acc[0] + acc[1] * acc[1] + acc[2] * acc[2]));
+        // 回転中に大きさが一瞬だけ1gを横切ることがあるため，戻りだけを遅らせる
+        float released = current + dt / AccelReleaseSeconds;
+        current = (instant < released) ? instant : released;
+        return current;
+    }
+
+} // imu
@@ -0,0 +1,36 @@
+#pragma once
+#include <inttypes.h>
+#include "ImuData.h"
+
+namespace imu
+{
+
+    static const float GyroFullScaleDps = 2000.0F;                    // MPU6886の最大レンジ (FS_SEL=3)
+    static const float AccelFullScaleG = 8.0F;                        // M5Unified / FIFO と同じ設定
+    static const float GyroSaturationDps = GyroFullScaleDps * 0.998F; // これ以上は振り切れたとみなす
+    static const float AccelSaturationG = AccelFullScaleG * 0.998F;
+    static const float AccelTrustBandG = 0.02F;                       // |a| と1gの差がこれ以内なら加速度の補正をそのまま使う
+    static const float AccelRejectBandG = 0.15F;                      // これ以上ずれたら加速度の補正を使わない
+    static const float AccelReleaseSeconds = 0.2F;                    // 補正を止めた後，元の重みに戻るまでの時間[s]
+
+    uint32_t SaturationFlags(const float *acc, const float *gyro);
+
+    /**
+     * @brief 加速度の大きさが1gから外れている間 (遠心力 / 振り回し) は重力の向きとして信用しない
+     * @brief 重みは外れた瞬間に下げ，戻るときは AccelReleaseSeconds かけて上げる
+     * @brief update() は毎サンプル呼び，返した重み (0〜1) を加速度による補正に掛ける
+     */
+    class AccelGate
+    {
+    public:
+        explicit AccelGate() : current(1.0F) {}
+        float update(const float *acc, float dt);
+        float weight() const { return current; }
+        void reset() { current = 1.0F; }
+        static float InstantWeight(float accNormG);
+
+    private:
+        float current;
+    };
+
+} // imu
@@ -0,0 +1,60 @@
+#pragma once
+
+namespace imu
+{
+
+    /**
+     * @brief ImuReaderで切り替えられる姿勢推定フィルタの種類
+     */
+    enum FilterType
+    {
+        FilterMahony = 0,
+        FilterMadgwick = 1,
+        FilterGyroExp = 2, // 角速度の厳密な指数写像による積分のみ (加速度補正なし)
+    };
+    static const int FilterTypeNum = 3;
+
+    /**
+     * @brief 姿勢推定フィルタの共通インタフェース
+     */
+    class FusionFilter
+    {
+    public:
+        virtual ~FusionFilter() {}
+
+        /**
+         * @brief 1サンプル分の角速度と加速度で姿勢クォータニオンを更新する
+         *
+         * @param gx, gy, gz 角速度[rad/s]
+         * @param ax, ay, az 加速度 (単位は任意，内部で正規化する)
+         * @param dt 前のサンプルからの経過時間[s]
+         * @param q0, q1, q2, q3 更新する姿勢クォータニオン (w, x, y, z)
+         */
+        virtual void UpdateQuaternion(
+            float gx, float gy, float gz,
+            float ax, float ay, float az,
+            float dt,
+            float &q0, float &q1, float &q2, float &q3) = 0;
+
+        /**
+         * @brief 加速度による補正の重みを変える．次の UpdateQuaternion() から効く
+         *
+         * @param weight 0 (角速度のみで積分) 〜 1 (通常)
+         */
+        virtual void SetAccelWeight(float weight) { (void)weight; }
+
+        /**
+         * @brief 角速度の積分を1次近似から厳密な指数写像に切り替える
+         * @brief 1次近似は1サンプルの回転角の2乗に比例して回転を少なく見積もるため，高速回転で回転数が遅れる
+         *
+         * @param exact true: 厳密な指数写像, false: 1次近似 (元のアルゴリズム)
+         */
+        virtual void SetExactIntegration(bool exact) { (void)exact; }
+
+        /**
+         * @brief 積分項などの内部状態を初期化する
+         */
+        virtual void Reset() {}
+    };
+
+} // imu
@@ -1,27 +1,39 @@
 #pragma once
 #include <inttypes.h>
-#include <Arduino.h>
 
 namespace imu
 {
 
     static const int ImuXyz = 3;
     static const int ImuWxyz = 4;
-    static const int ImuDataLen = 44; // 4 + (4*3) + (4*3) + (4*4), float/uint_32t: 4byte
+
+    /**
+     * @brief ImuData::flags のビット
+     */
+    enum ImuFlag
+    {
+        ImuFlagGyroSaturated = 1 << 0,  // 角速度がフルスケールに達した (実際の回転はもっと速い)
+        ImuFlagAccelSaturated = 1 << 1, // 加速度がフルスケールに達した
+        ImuFlagAccelGated = 1 << 2,     // 加速度による補正を弱めた / 止めた (高速回転モード)
+    };
 
     struct ImuData
     {
     public:
-        uint32_t timestamp;
+        uint32_t timestamp; // [us] micros()
         float acc[ImuXyz];
         float gyro[ImuXyz];
         float quat[ImuWxyz];
+        uint32_t flags; // ImuFlag の組み合わせ
 
-        explicit ImuData() : timestamp(0)
+        explicit ImuData() : timestamp(0), acc(), gyro(), quat(), flags(0)
         {
-            memset(this, 0, ImuDataLen);
             quat[0] = 1.0F;
         }
     };
 
+    // タスク間では代入でコピーする．詰め物が入らないことをビルド時に確かめる
+    static_assert(sizeof(ImuData) == sizeof(uint32_t) * 2 + sizeof(float) * (ImuXyz + ImuXyz + ImuWxyz),
+                  "ImuData must not contain padding");
+
 } // imu
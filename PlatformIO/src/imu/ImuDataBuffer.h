@@ -0,0 +1,25 @@
+#pragma once
+#include "../concurrent/SpscRing.h"
+#include "ImuData.h"
+
+namespace imu
+{
+
+    static const int ImuDataBufferSize = 64; // 200[Hz] で 320[ms] 分．添字の折り返しのため2のべき乗にする
+
+    /**
+     * @brief バッファが溢れずに済むバンドルの送信間隔の上限[ms]．送信タスクの起床の遅れに備えて半分を余らせる
+     *
+     * @param rateHz IMUのサンプリング周波数[Hz]
+     */
+    inline int BatchIntervalMaxMs(int rateHz)
+    {
+        return ImuDataBufferSize / 2 * 1000 / rateHz;
+    }
+
+    /**
+     * @brief 送信までのIMUデータを溜めておくリングバッファ (ImuLoop -> SendOscLoop)
+     */
+    typedef concurrent::SpscRing<ImuData, ImuDataBufferSize> ImuDataBuffer;
+
+} // imu
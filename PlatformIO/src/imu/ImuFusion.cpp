@@ -0,0 +1,275 @@
+#include <string.h>
+#include "ImuFusion.h"
+#include "sampling/SampleClock.h"
+
+namespace imu
+{
+    static const float DegToRad = 0.01745329252F;
+
+    ImuFusion::ImuFusion()
+        : ahrs(), madgwickAhrs(), gyroIntegrator(), activeFilter(&ahrs), filterType(FilterMahony),
+          cycleCounter(NULL), filterCyclesAvg(0), pipelineStats(NULL), imuData(), lastUpdatedMicros(0),
+          hasLastUpdated(false), samplePeriodMicros(0), biasCurve(), temp(0.0F), tempValid(false),
+          highSpin(false), accelGate(), gyroSaturationCount(0), accelGatedCount(0)
+    {
+        memset(gyroOffsets, 0, sizeof(float) * ImuXyz);
+        memset(appliedOffsets, 0, sizeof(float) * ImuXyz);
+    }
+
+    /**
+     * @brief ジャイロのオフセット値をメンバ変数に保存する
+     *
+     * @param x
+     * @param y
+     * @param z
+     * @return true 正常終了
+     * @return false 異常終了
+     */
+    bool ImuFusion::writeGyroOffset(float x, float y, float z)
+    {
+        gyroOffsets[0] = x;
+        gyroOffsets[1] = y;
+        gyroOffsets[2] = z;
+        refreshOffsets();
+        return true;
+    }
+
+    /**
+     * @brief 温度に対するオフセットの直線を設定する．有効な間は writeGyroOffset() の値より優先する
+     *
+     * @param curve bias::TempBiasModel::fit() の結果．valid = false ならば温度補正をやめる
+     * @return true 正常終了
+     * @return false 異常終了
+     */
+    bool ImuFusion::writeBiasCurve(const bias::TempBiasCurve &curve)
+    {
+        biasCurve = curve;
+        refreshOffsets();
+        return true;
+    }
+
+    /**
+     * @brief 現在差し引いているオフセットを取得する
+     *
+     * @param outOffset 3軸のオフセット[deg/s]
+     */
+    void ImuFusion::readAppliedOffset(float *outOffset) const
+    {
+        for (int i = 0; i < ImuXyz; i++)
+            outOffset[i] = appliedOffsets[i];
+    }
+
+    /**
+     * @brief IMUの温度を設定し，温度補正が有効ならオフセットを更新する
+     *
+     * @param degC 温度[℃]
+     */
+    void ImuFusion::writeTemperature(float degC)
+    {
+        temp = degC;
+        tempValid = true;
+        refreshOffsets();
+    }
+
+    /**
+     * @brief 温度が分かっていて直線が有効ならば温度から，そうでなければ固定のオフセットを使う
+     */
+    void ImuFusion::refreshOffsets()
+    {
+        if (biasCurve.valid && tempValid)
+        {
+            biasCurve.evaluate(temp, appliedOffsets);
+            return;
+        }
+        for (int i = 0; i < ImuXyz; i++)
+            appliedOffsets[i] = gyroOffsets[i];
+    }
+
+    /**
+     * @brief AHRSのフィードバックゲインを変更する
+     *
+     * @param kp 比例ゲイン
+     * @param ki 積分ゲイン
+     * @return true 正常終了
+     * @return false 異常終了 負のゲインが指定された
+     */
+    bool ImuFusion::writeGains(float kp, float ki)
+    {
+        if (kp < 0.0F || ki < 0.0F)
+        {
+            return false;
+        }
+        ahrs.SetGains(kp, ki);
+        ahrs.ResetIntegral();
+        return true;
+    }
+
+    /**
+     * @brief Madgwickフィルタのゲインを変更する
+     *
+     * @param beta ゲイン
+     * @return true 正常終了
+     * @return false 異常終了 負のゲインが指定された
+     */
+    bool ImuFusion::writeMadgwickBeta(float beta)
+    {
+        if (beta < 0.0F)
+        {
+            return false;
+        }
+        madgwickAhrs.SetBeta(beta);
+        return true;
+    }
+
+    /**
+     * @brief 姿勢推定に使うフィルタを切り替える．姿勢は切り替え前の値から継続する
+     *
+     * @param type フィルタの種類
+     * @return true 正常終了
+     * @return false 異常終了 不明な種類
+     */
+    bool ImuFusion::selectFilter(FilterType type)
+    {
+        FusionFilter *next;
+        switch (type)
+        {
+        case FilterMahony:
+            next = &ahrs;
+            break;
+        case FilterMadgwick:
+            next = &madgwickAhrs;
+            break;
+        case FilterGyroExp:
+            next = &gyroIntegrator;
+            break;
+        default:
+            return false;
+        }
+        if (next != activeFilter)
+        {
+            next->Reset();
+            activeFilter = next;
+            filterType = type;
+            filterCyclesAvg = 0;
+        }
+        return true;
+    }
+
+    /**
+     * @brief 高速回転モードを切り替える (加速度のゲートと指数写像による積分)．詳細は ImuReader::setHighSpin()
+     *
+     * @param enable true: 高速回転モード, false: 通常
+     */
+    void ImuFusion::setHighSpin(bool enable)
+    {
+        highSpin = enable;
+        accelGate.reset();
+        ahrs.SetExactIntegration(enable);
+        madgwickAhrs.SetExactIntegration(enable);
+    }
+
+    /**
+     * @brief 前回のサンプルからの経過時間を求める
+     * @brief タイマで周期を刻んでいるときは，コールバックの遅れを除くため周期の整数倍に丸める
+     *
+     * @param timestampMicros 今回のサンプルの時刻[us]
+     * @return float 積分に使う経過時間[s]．初回や異常な間隔のときは公称の周期
+     */
+    float ImuFusion::elapsedSeconds(uint32_t timestampMicros) const
+    {
+        uint32_t elapsedMicros = timestampMicros - lastUpdatedMicros;
+        if (samplePeriodMicros > 0)
+            elapsedMicros = sampling::ElapsedTicks(elapsedMicros, samplePeriodMicros) * samplePeriodMicros;
+        float dt = elapsedMicros * 1e-6F;
+        if (!hasLastUpdated || dt <= 0.0F || dt > MaxSamplePeriod)
+            dt = (samplePeriodMicros > 0) ? samplePeriodMicros * 1e-6F : NominalSamplePeriod;
+        return dt;
+    }
+
+    /**
+     * @brief 1サンプル分のオフセット補正と姿勢推定を行う
+     *
+     * @param acc 加速度[g]
+     * @param gyro 角速度[deg/s] (オフセット補正前)．appliedOffsets を差し引く
+     * @param dt 前のサンプルからの経過時間[s]
+     * @param timestampMicros サンプルの時刻[us]
+     */
+    void ImuFusion::fuse(const float *acc, const float *gyro, float dt, uint32_t timestampMicros)
+    {
+        float &ax = imuData.acc[0];
+        float &ay = imuData.acc[1];
+        float &az = imuData.acc[2];
+        float &gx = imuData.gyro[0];
+        float &gy = imuData.gyro[1];
+        float &gz = imuData.gyro[2];
+        float &qw = imuData.quat[0];
+        float &qx = imuData.quat[1];
+        float &qy = imuData.quat[2];
+        float &qz = imuData.quat[3];
+
+        ax = acc[0];
+        ay = acc[1];
+        az = acc[2];
+        gx = gyro[0] - appliedOffsets[0];
+        gy = gyro[1] - appliedOffsets[1];
+        gz = gyro[2] - appliedOffsets[2];
+
+        // 振り切れたサンプルは回転数を少なく見積もるため，印を付けて数える
+        imuData.flags = SaturationFlags(acc, gyro);
+        if (imuData.flags & ImuFlagGyroSaturated)
+            gyroSaturationCount++;
+        float accelWeight = 1.0F;
+        if (highSpin)
+        {
+            accelWeight = accelGate.update(acc, dt);
+            if (accelWeight < 1.0F)
+            {
+                imuData.flags |= ImuFlagAccelGated;
+                accelGatedCount++;
+            }
+        }
+        activeFilter->SetAccelWeight(accelWeight);
+
+        /**
+         * @brief AHRSアルゴリズムで姿勢のクォータニオンを取得する
+         *
+         */
+        uint32_t startCycles = (cycleCounter != NULL) ? cycleCounter() : 0;
+        activeFilter->UpdateQuaternion(
+            gx * DegToRad, gy * DegToRad, gz * DegToRad,
+            ax, ay, az,
+            dt,
+            qw, qx, qy, qz);
+        if (cycleCounter != NULL)
+        {
+            uint32_t cycles = cycleCounter() - startCycles;
+            if (pipelineStats != NULL)
+                pipelineStats->record(stats::StageFusion, cycles);
+            if (filterCyclesAvg == 0)
+                filterCyclesAvg = cycles;
+            else
+                filterCyclesAvg += ((int32_t)cycles - (int32_t)filterCyclesAvg) / 16; // EMA, alpha = 1/16
+        }
+        imuData.timestamp = timestampMicros;
+        lastUpdatedMicros = timestampMicros;
+        hasLastUpdated = true;
+    }
+
+    /**
+     * @brief
+     *
+     * @param outImuData 読み込んだIMUデータを保存する変数のアドレス
+     * @return true 正常終了
+     * @return false 異常終了 IMUデータの更新がない
+     */
+    bool ImuFusion::read(ImuData &outImuData) const
+    {
+        if (lastUpdatedMicros == outImuData.timestamp)
+        {
+            return false; // not updated
+        }
+        outImuData = imuData;
+        return true;
+    }
+
+} // imu
@@ -0,0 +1,78 @@
+#pragma once
+#include <inttypes.h>
+#include "mahony/MahonyAHRS.h"
+#include "madgwick/MadgwickAHRS.h"
+#include "gyro/GyroIntegrator.h"
+#include "bias/TempBiasModel.h"
+#include "AccelGate.h"
+#include "FusionFilter.h"
+#include "ImuData.h"
+#include "../stats/PipelineStats.h"
+
+namespace imu
+{
+
+    static const float NominalSamplePeriod = 1.0F / 200.0F; // 初回や計測値が異常な場合に使う周期[s]
+    static const float MaxSamplePeriod = 0.1F;              // これより長い間隔は異常とみなす[s]
+
+    /**
+     * @brief 姿勢推定の処理サイクル数を測る時計．実機では ESP.getCycleCount()
+     */
+    typedef uint32_t (*CycleCounter)();
+
+    /**
+     * @brief 読み出した加速度/角速度からオフセット補正と姿勢推定を行う (ImuReaderのセンサ以外の部分)
+     */
+    class ImuFusion
+    {
+    public:
+        explicit ImuFusion();
+        void setCycleCounter(CycleCounter counter) { cycleCounter = counter; }
+        void setStats(stats::PipelineStats *pipelineStats) { this->pipelineStats = pipelineStats; }
+        bool writeGyroOffset(float x, float y, float z);
+        bool writeBiasCurve(const bias::TempBiasCurve &curve);
+        void readAppliedOffset(float *outOffset) const;
+        void writeTemperature(float degC);
+        float temperature() const { return temp; }
+        bool hasTemperature() const { return tempValid; }
+        bool writeGains(float kp, float ki);
+        bool writeMadgwickBeta(float beta);
+        bool selectFilter(FilterType type);
+        FilterType filter() const { return filterType; }
+        uint32_t filterCycles() const { return filterCyclesAvg; }
+        void setHighSpin(bool enable);
+        bool isHighSpin() const { return highSpin; }
+        uint32_t gyroSaturations() const { return gyroSaturationCount; }
+        uint32_t accelGatedSamples() const { return accelGatedCount; }
+        void setSamplePeriod(uint32_t periodMicros) { samplePeriodMicros = periodMicros; }
+        float elapsedSeconds(uint32_t timestampMicros) const;
+        void fuse(const float *acc, const float *gyro, float dt, uint32_t timestampMicros);
+        const ImuData &data() const { return imuData; }
+        bool read(ImuData &outImuData) const;
+
+    private:
+        mahony::MahonyAHRS ahrs;
+        madgwick::MadgwickAHRS madgwickAhrs;
+        gyro::GyroIntegrator gyroIntegrator;
+        FusionFilter *activeFilter;
+        FilterType filterType;
+        CycleCounter cycleCounter;  // NULL: 計測しない
+        uint32_t filterCyclesAvg;   // 1回の姿勢推定にかかったCPUサイクル数の移動平均
+        stats::PipelineStats *pipelineStats; // NULL: 計測しない
+        ImuData imuData;
+        uint32_t lastUpdatedMicros;
+        bool hasLastUpdated;
+        uint32_t samplePeriodMicros;   // 0: 実測間隔をそのまま使う
+        float gyroOffsets[ImuXyz];     // /set/offset などで決めた温度に依らないオフセット
+        bias::TempBiasCurve biasCurve; // 有効ならば gyroOffsets の代わりに使う
+        float appliedOffsets[ImuXyz];  // 実際に差し引くオフセット
+        float temp;                    // IMUの温度[℃]
+        bool tempValid;
+        bool highSpin;
+        AccelGate accelGate;
+        uint32_t gyroSaturationCount; // 角速度が振り切れたサンプル数の累計
+        uint32_t accelGatedCount;     // 加速度による補正を弱めたサンプル数の累計
+        void refreshOffsets();
+    };
+
+} // imu
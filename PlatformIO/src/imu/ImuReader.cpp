@@ -2,14 +2,20 @@
 
 namespace imu
 {
+    static uint32_t ReadCycleCount()
+    {
+        return ESP.getCycleCount();
+    }
+
     /**
      * @brief Construct a new Imu Reader:: Imu Reader object
      *
      * @param m5 IMU＿Classのインスタンス
      */
-    ImuReader::ImuReader(m5::IMU_Class &m5) : m5Imu(m5), ahrs(), imuData()
+    ImuReader::ImuReader(m5::IMU_Class &m5)
+        : m5Imu(m5), fifo(m5::In_I2C), fusion(), pipelineStats(NULL), lastTempMicros(0)
     {
-        memset(gyroOffsets, 0, sizeof(float) * ImuXyz);
+        fusion.setCycleCounter(ReadCycleCount);
     }
 
     /**
@@ -24,76 +30,140 @@ namespace imu
     }
 
     /**
-     * @brief ジャイロのオフセット値をメンバ変数に保存する
+     * @brief TempReadIntervalMicros 毎にIMUの温度を読み，オフセットを更新する
+     * @brief 温度はゆっくりとしか変わらないため，毎サンプルは読まない
+     */
+    void ImuReader::updateTemperature(uint32_t timestampMicros)
+    {
+        if (fusion.hasTemperature() && timestampMicros - lastTempMicros < TempReadIntervalMicros)
+            return;
+        lastTempMicros = timestampMicros;
+        float t;
+        if (!m5Imu.getTemp(&t))
+            return;
+        fusion.writeTemperature(t);
+    }
+
+    /**
+     * @brief 区間毎の処理時間の記録先を設定する
+     *
+     * @param pipelineStats 記録先．NULL: 計測しない
+     */
+    void ImuReader::setStats(stats::PipelineStats *pipelineStats)
+    {
+        this->pipelineStats = pipelineStats;
+        fusion.setStats(pipelineStats);
+    }
+
+    /**
+     * @brief ハードウェアFIFOからのまとめ読みを開始する (MPU6886のみ)
      *
-     * @param x
-     * @param y
-     * @param z
+     * @param sampleRateHz サンプリング周波数 (500Hz, 1000Hz など)
      * @return true 正常終了
-     * @return false 異常終了
+     * @return false 異常終了 FIFOに対応していないIMU．ポーリングのまま
      */
-    bool ImuReader::writeGyroOffset(float x, float y, float z)
+    bool ImuReader::beginFifo(uint16_t sampleRateHz)
     {
-        gyroOffsets[0] = x;
-        gyroOffsets[1] = y;
-        gyroOffsets[2] = z;
-        return true;
+        return fifo.begin(sampleRateHz);
+    }
+
+    /**
+     * @brief 高速回転モードを切り替える
+     * @brief 有効な間は，加速度の大きさが1gから外れている (遠心力がかかっている) サンプルで
+     *        加速度による補正を弱め，重力の向きを取り違えないようにする
+     * @brief 角速度は指数写像で積分し，1サンプルの回転角が大きくても回転数が遅れないようにする
+     *
+     * @param enable true: 高速回転モード, false: 通常
+     * @return true 正常終了
+     * @return false 異常終了 角速度のレンジを最大にできなかった (MPU6886以外)．補正の制御は有効になる
+     */
+    bool ImuReader::setHighSpin(bool enable)
+    {
+        fusion.setHighSpin(enable);
+        if (!enable)
+            return true;
+        return fifo.writeFullScale();
+    }
+
+    /**
+     * @brief FIFOを止めてポーリングに戻す
+     */
+    void ImuReader::endFifo()
+    {
+        if (fifo.isEnabled())
+            fifo.end();
     }
 
     /**
      * @brief 最新のIMUのデータを取得する
      *
+     * @param timestampMicros サンプルの時刻[us] (micros() または周期タイマの刻み)
      * @return true 正常終了
      * @return false 異常終了
      */
-    bool ImuReader::update()
+    bool ImuReader::update(uint32_t timestampMicros)
     {
-        float &ax = imuData.acc[0];
-        float &ay = imuData.acc[1];
-        float &az = imuData.acc[2];
-        float &gx = imuData.gyro[0];
-        float &gy = imuData.gyro[1];
-        float &gz = imuData.gyro[2];
-        float &qw = imuData.quat[0];
-        float &qx = imuData.quat[1];
-        float &qy = imuData.quat[2];
-        float &qz = imuData.quat[3];
+        float acc[ImuXyz];
+        float gyro[ImuXyz];
+        uint32_t startCycles = ESP.getCycleCount();
+        m5Imu.getAccel(&acc[0], &acc[1], &acc[2]);
+        m5Imu.getGyro(&gyro[0], &gyro[1], &gyro[2]);
+        if (pipelineStats != NULL)
+            pipelineStats->record(stats::StageImuRead, ESP.getCycleCount() - startCycles);
+        updateTemperature(timestampMicros);
 
-        m5Imu.getAccel(&ax, &ay, &az);
-        m5Imu.getGyro(&gx, &gy, &gz);
+        // 前回の更新からの実測間隔で積分する (タスクの起床周期は揺らぐため)
+        float dt = fusion.elapsedSeconds(timestampMicros);
 
-        gx -= gyroOffsets[0];
-        gy -= gyroOffsets[1];
-        gz -= gyroOffsets[2];
-
-        /**
-         * @brief AHRSアルゴリズムで姿勢のクォータニオンを取得する
-         *
-         */
-        ahrs.UpdateQuaternion(
-            gx * DEG_TO_RAD, gy * DEG_TO_RAD, gz * DEG_TO_RAD,
-            ax, ay, az,
-            qw, qx, qy, qz);
-        imuData.timestamp = millis();
-        lastUpdated = imuData.timestamp;
+        fusion.fuse(acc, gyro, dt, timestampMicros);
         return true;
     }
 
     /**
-     * @brief
+     * @brief 前回から溜まったIMUのデータを全て姿勢推定に通し，サンプル毎の結果を返す
+     * @brief FIFO無効時は update() と同じく1サンプルだけ取得する
      *
-     * @param outImuData 読み込んだIMUデータを保存する変数のアドレス
-     * @return true 正常終了
-     * @return false 異常終了 IMUデータの更新がない
+     * @param outImuData 結果を古い順に保存する配列
+     * @param maxCount outImuDataの要素数
+     * @param timestampMicros 読み出し時刻[us]．FIFO有効時は最後のサンプルの時刻になる
+     * @return size_t 取得したサンプル数
      */
-    bool ImuReader::read(ImuData &outImuData) const
+    size_t ImuReader::updateBurst(ImuData *outImuData, size_t maxCount, uint32_t timestampMicros)
     {
-        if (lastUpdated == outImuData.timestamp)
+        if (maxCount == 0)
         {
-            return false; // not updated
+            return 0;
         }
-        memcpy(&outImuData, &imuData, ImuDataLen);
-        return true;
+        if (!fifo.isEnabled())
+        {
+            update(timestampMicros);
+            outImuData[0] = fusion.data();
+            return 1;
+        }
+
+        static const size_t MaxBurst = 64;
+        fifo::FifoSample samples[MaxBurst];
+        uint32_t startCycles = ESP.getCycleCount();
+        size_t n = fifo.read(samples, (maxCount < MaxBurst) ? maxCount : MaxBurst);
+        if (pipelineStats != NULL && n > 0)
+            pipelineStats->record(stats::StageImuRead, ESP.getCycleCount() - startCycles);
+        if (n == 0)
+        {
+            return 0;
+        }
+        updateTemperature(timestampMicros);
+
+        // FIFOのサンプル間隔は設定値で一定．FIFOに残した分も含めて最新のサンプルを読み出し時刻として遡って刻印する
+        uint32_t periodMicros = 1000000UL / fifo.sampleRate();
+        float dt = periodMicros * 1e-6F;
+        size_t remaining = fifo.remaining();
+        for (size_t i = 0; i < n; i++)
+        {
+            uint32_t timestamp = fifo::SampleTimestamp(timestampMicros, i, n, remaining, periodMicros);
+            fusion.fuse(samples[i].acc, samples[i].gyro, dt, timestamp);
+            outImuData[i] = fusion.data();
+        }
+        return n;
     }
 
 } // imu
@@ -1,26 +1,53 @@
 #pragma once
 #include "utility/IMU_Class.hpp"
-#include "mahony/MahonyAHRS.h"
+#include "fifo/Mpu6886Fifo.h"
+#include "ImuFusion.h"
 #include "ImuData.h"
+#include "../stats/PipelineStats.h"
 
 namespace imu
 {
 
+    static const uint32_t TempReadIntervalMicros = 1000000; // IMUの温度を読む間隔[us]
+
+    /**
+     * @brief M5のIMU (ポーリング / ハードウェアFIFO) から読み出し，ImuFusion で姿勢を推定する
+     */
     class ImuReader
     {
     public:
         explicit ImuReader(m5::IMU_Class &m5);
         bool initialize();
-        bool writeGyroOffset(float x, float y, float z);
-        bool update();
-        bool read(ImuData &outImuData) const;
+        bool writeGyroOffset(float x, float y, float z) { return fusion.writeGyroOffset(x, y, z); }
+        bool writeBiasCurve(const bias::TempBiasCurve &curve) { return fusion.writeBiasCurve(curve); }
+        void readAppliedOffset(float *outOffset) const { fusion.readAppliedOffset(outOffset); }
+        float temperature() const { return fusion.temperature(); }
+        bool hasTemperature() const { return fusion.hasTemperature(); }
+        bool writeGains(float kp, float ki) { return fusion.writeGains(kp, ki); }
+        bool writeMadgwickBeta(float beta) { return fusion.writeMadgwickBeta(beta); }
+        bool selectFilter(FilterType type) { return fusion.selectFilter(type); }
+        FilterType filter() const { return fusion.filter(); }
+        uint32_t filterCycles() const { return fusion.filterCycles(); }
+        void setStats(stats::PipelineStats *pipelineStats);
+        bool beginFifo(uint16_t sampleRateHz);
+        void endFifo();
+        bool isFifoEnabled() const { return fifo.isEnabled(); }
+        bool setHighSpin(bool enable);
+        bool isHighSpin() const { return fusion.isHighSpin(); }
+        uint32_t gyroSaturations() const { return fusion.gyroSaturations(); }
+        uint32_t accelGatedSamples() const { return fusion.accelGatedSamples(); }
+        void setSamplePeriod(uint32_t periodMicros) { fusion.setSamplePeriod(periodMicros); }
+        bool update(uint32_t timestampMicros);
+        size_t updateBurst(ImuData *outImuData, size_t maxCount, uint32_t timestampMicros);
+        bool read(ImuData &outImuData) const { return fusion.read(outImuData); }
 
     private:
         m5::IMU_Class &m5Imu;
-        mahony::MahonyAHRS ahrs;
-        ImuData imuData;
-        uint32_t lastUpdated;
-        float gyroOffsets[ImuXyz];
+        fifo::Mpu6886Fifo fifo;
+        ImuFusion fusion;
+        stats::PipelineStats *pipelineStats; // NULL: 計測しない
+        uint32_t lastTempMicros;
+        void updateTemperature(uint32_t timestampMicros);
     };
 
 } // imu
@@ -0,0 +1,39 @@
+#include "RunningStats.h"
+
+namespace imu
+{
+
+    /**
+     * @brief サンプルを1つ追加する
+     *
+     * @param value 追加する値
+     */
+    void RunningStats::push(float value)
+    {
+        cnt++;
+        float delta = value - mean;
+        mean += delta / (float)cnt;
+        m2 += delta * (value - mean);
+    }
+
+    void RunningStats::reset()
+    {
+        cnt = 0;
+        mean = 0.0F;
+        m2 = 0.0F;
+    }
+
+    /**
+     * @brief 3軸のうち最も大きい分散を返す
+     */
+    float RunningStatsXYZ::maxVariance() const
+    {
+        float v = statsX.variance();
+        if (statsY.variance() > v)
+            v = statsY.variance();
+        if (statsZ.variance() > v)
+            v = statsZ.variance();
+        return v;
+    }
+
+} // imu
@@ -0,0 +1,57 @@
+#pragma once
+#include <inttypes.h>
+
+namespace imu
+{
+
+    /**
+     * @brief 平均と分散を逐次計算する (Welford法)．サンプルを保持しないためメモリはO(1)
+     */
+    class RunningStats
+    {
+    public:
+        explicit RunningStats() : cnt(0), mean(0.0F), m2(0.0F) {}
+        void push(float value);
+        float average() const { return mean; }
+        float variance() const { return (cnt > 1) ? m2 / (float)(cnt - 1) : 0.0F; }
+        uint32_t count() const { return cnt; }
+        void reset();
+
+    private:
+        uint32_t cnt;
+        float mean;
+        float m2; // 平均からの偏差の二乗和
+    };
+
+    class RunningStatsXYZ
+    {
+    public:
+        explicit RunningStatsXYZ() {}
+        void push(float x, float y, float z)
+        {
+            statsX.push(x);
+            statsY.push(y);
+            statsZ.push(z);
+        }
+        float averageX() const { return statsX.average(); }
+        float averageY() const { return statsY.average(); }
+        float averageZ() const { return statsZ.average(); }
+        float varianceX() const { return statsX.variance(); }
+        float varianceY() const { return statsY.variance(); }
+        float varianceZ() const { return statsZ.variance(); }
+        float maxVariance() const;
+        uint32_t count() const { return statsX.count(); }
+        void reset()
+        {
+            statsX.reset();
+            statsY.reset();
+            statsZ.reset();
+        }
+
+    private:
+        RunningStats statsX;
+        RunningStats statsY;
+        RunningStats statsZ;
+    };
+
+} // imu
@@ -0,0 +1,89 @@
+#include <math.h>
+#include "StillDetector.h"
+
+namespace imu
+{
+
+    static const float RadToDeg = 57.29577951F;
+
+    StillDetector::StillDetector() : windowStart(0), biasX(0.0F), biasY(0.0F), biasZ(0.0F), hasLastAccel(false)
+    {
+        lastAccel[0] = lastAccel[1] = lastAccel[2] = 0.0F;
+    }
+
+    /**
+     * @brief サンプルを追加し，窓が終わったら静止していたかを判定する
+     *
+     * @param imuData オフセット補正後のIMUデータ
+     * @return true 直前の窓の間ずっと静止しており，重力の向きも前の窓から変わっていない． gyroBias*() で窓内の角速度の平均を取得できる
+     * @return false 窓の途中か，動いていた (リセット後の最初の窓を含む)
+     */
+    bool StillDetector::push(const ImuData &imuData)
+    {
+        if (gyroStats.count() == 0)
+            windowStart = imuData.timestamp;
+
+        gyroStats.push(imuData.gyro[0], imuData.gyro[1], imuData.gyro[2]);
+        accelNormStats.push(sqrtf(imuData.acc[0] * imuData.acc[0] +
+                                  imuData.acc[1] * imuData.acc[1] +
+                                  imuData.acc[2] * imuData.acc[2]));
+        accelStats.push(imuData.acc[0], imuData.acc[1], imuData.acc[2]);
+
+        if (imuData.timestamp - windowStart < StillWindowMicros)
+        {
+            return false;
+        }
+
+        bool still = gyroStats.maxVariance() < StillGyroStdMax * StillGyroStdMax &&
+                     fabsf(gyroStats.averageX()) < StillGyroMeanMax &&
+                     fabsf(gyroStats.averageY()) < StillGyroMeanMax &&
+                     fabsf(gyroStats.averageZ()) < StillGyroMeanMax &&
+                     accelNormStats.variance() < StillAccelStdMax * StillAccelStdMax;
+
+        // 重力の向きの変化は窓の平均同士で比べる (サンプル毎のノイズは平均で消える)
+        float accel[3] = {accelStats.averageX(), accelStats.averageY(), accelStats.averageZ()};
+        float norm = sqrtf(accel[0] * accel[0] + accel[1] * accel[1] + accel[2] * accel[2]);
+        bool steady = false;
+        if (norm > 0.0F)
+        {
+            for (int i = 0; i < 3; i++)
+                accel[i] /= norm;
+            float dot = accel[0] * lastAccel[0] + accel[1] * lastAccel[1] + accel[2] * lastAccel[2];
+            steady = hasLastAccel && acosf(dot > 1.0F ? 1.0F : dot) * RadToDeg < StillAccelTurnMax;
+            for (int i = 0; i < 3; i++)
+                lastAccel[i] = accel[i];
+        }
+        // 動いていた窓の向きは次の窓と比べない
+        hasLastAccel = still && norm > 0.0F;
+        still = still && steady;
+
+        if (still)
+        {
+            biasX = gyroStats.averageX();
+            biasY = gyroStats.averageY();
+            biasZ = gyroStats.averageZ();
+        }
+        restart();
+        return still;
+    }
+
+    /**
+     * @brief 現在の窓を捨てる．オフセットを書き換えた後などに呼ぶ
+     */
+    void StillDetector::reset()
+    {
+        restart();
+        hasLastAccel = false;
+    }
+
+    /**
+     * @brief 次の窓を始める．前の窓の重力の向きは残す
+     */
+    void StillDetector::restart()
+    {
+        gyroStats.reset();
+        accelNormStats.reset();
+        accelStats.reset();
+    }
+
+} // imu
@@ -0,0 +1,43 @@
+#pragma once
+#include "ImuData.h"
+#include "RunningStats.h"
+
+namespace imu
+{
+
+    static const uint32_t StillWindowMicros = 1000000UL; // 静止判定の窓の長さ [us]
+    static const float StillGyroStdMax = 0.5F;           // 窓内の角速度の標準偏差の上限 [deg/s]
+    static const float StillGyroMeanMax = 1.0F;          // 窓内の角速度の平均の上限 [deg/s] (残留オフセットとして許す範囲)
+    static const float StillAccelStdMax = 0.02F;         // 窓内の加速度ノルムの標準偏差の上限 [g]
+    static const float StillAccelTurnMax = 0.25F;        // 前の窓からの加速度の平均の向きの変化の上限 [deg] (ゆっくりした回転を除く)
+    static const float StillBiasBlend = 0.25F;           // 1回の静止で残留オフセットを反映する割合 (残りは次の静止で詰める)
+
+    /**
+     * @brief 一定時間静止していることを検出し，その間のジャイロの平均 (=残留オフセット) を求める
+     * @brief 窓毎に判定し，窓が終わるまで結果を出さない
+     * @brief 角速度の平均だけではゆっくりした回転を残留オフセットと取り違えるため，
+     * @brief 重力の向き (加速度の平均の向き) が前の窓から変わっていないことも求める．リセット後の最初の窓は静止としない
+     */
+    class StillDetector
+    {
+    public:
+        explicit StillDetector();
+        bool push(const ImuData &imuData);
+        void reset();
+        float gyroBiasX() const { return biasX; }
+        float gyroBiasY() const { return biasY; }
+        float gyroBiasZ() const { return biasZ; }
+
+    private:
+        RunningStatsXYZ gyroStats;
+        RunningStats accelNormStats;
+        RunningStatsXYZ accelStats;
+        uint32_t windowStart;
+        float biasX, biasY, biasZ;
+        float lastAccel[3]; // 前の窓の加速度の平均 (単位ベクトル)
+        bool hasLastAccel;
+
+        void restart();
+    };
+
+} // imu
@@ -0,0 +1,193 @@
+#include <math.h>
+#include <string.h>
+#include "TempBiasModel.h"
+
+namespace imu
+{
+    namespace bias
+    {
+
+        TempBiasCurve::TempBiasCurve() : valid(false), refTemp(0.0F), minTemp(0.0F), maxTemp(0.0F)
+        {
+            memset(bias, 0, sizeof(bias));
+            memset(slope, 0, sizeof(slope));
+        }
+
+        /**
+         * @brief 温度からオフセットを求める
+         *
+         * @param temp IMUの温度[℃]
+         * @param outBias 3軸のオフセット[deg/s]
+         */
+        void TempBiasCurve::evaluate(float temp, float *outBias) const
+        {
+            if (temp < minTemp)
+                temp = minTemp;
+            else if (temp > maxTemp)
+                temp = maxTemp;
+            float dt = temp - refTemp;
+            for (int i = 0; i < TempBiasAxes; i++)
+                outBias[i] = bias[i] + slope[i] * dt;
+        }
+
+        TempBiasModel::TempBiasModel()
+        {
+            clear();
+        }
+
+        /**
+         * @brief 温度が入る区間の番号を返す
+         *
+         * @return int 0〜TempBiasBinNum-1．範囲外は-1
+         */
+        int TempBiasModel::BinIndex(float temp)
+        {
+            if (!(temp >= TempBiasMinC)) // NaNも除く
+                return -1;
+            int i = (int)((temp - TempBiasMinC) / TempBiasBinWidthC);
+            return (i < TempBiasBinNum) ? i : -1;
+        }
+
+        /**
+         * @brief 静止中に求めたオフセットを追加する
+         *
+         * @param temp その間のIMUの温度[℃]
+         * @param bias 3軸のオフセット[deg/s] (補正前の角速度の平均)
+         * @return true 正常終了
+         * @return false 異常終了 温度が範囲外
+         */
+        bool TempBiasModel::observe(float temp, const float *bias)
+        {
+            int i = BinIndex(temp);
+            if (i < 0)
+                return false;
+            TempBiasBin &b = bins[i];
+            if (b.weight < TempBiasMaxWeight)
+                b.weight++;
+            // 重みが上限に達した後は指数移動平均になり，経年変化にも追従する
+            float alpha = 1.0F / (float)b.weight;
+            b.temp += (temp - b.temp) * alpha;
+            for (int axis = 0; axis < TempBiasAxes; axis++)
+                b.bias[axis] += (bias[axis] - b.bias[axis]) * alpha;
+            return true;
+        }
+
+        /**
+         * @brief 観測した区間に重み付き最小二乗法で直線を当てはめる
+         *
+         * @param outCurve 当てはめた直線．失敗したときは valid = false
+         * @return true 正常終了
+         * @return false 異常終了 観測した温度の幅が足りないか，傾きが大きすぎる
+         */
+        bool TempBiasModel::fit(TempBiasCurve &outCurve) const
+        {
+            TempBiasCurve curve;
+            float sumW = 0.0F;
+            float sumT = 0.0F;
+            float minTemp = 0.0F;
+            float maxTemp = 0.0F;
+            for (int i = 0; i < TempBiasBinNum; i++)
+            {
+                const TempBiasBin &b = bins[i];
+                if (b.weight == 0)
+                    continue;
+                if (sumW == 0.0F || b.temp < minTemp)
+                    minTemp = b.temp;
+                if (sumW == 0.0F || b.temp > maxTemp)
+                    maxTemp = b.temp;
+                sumW += b.weight;
+                sumT += b.weight * b.temp;
+            }
+            outCurve = curve;
+            if (sumW == 0.0F || maxTemp - minTemp < TempBiasMinSpanC)
+                return false;
+
+            // 温度の平均を原点にとると，傾きと切片を独立に求められる
+            curve.refTemp = sumT / sumW;
+            float sumTT = 0.0F;
+            float sumY[TempBiasAxes] = {0.0F};
+            float sumTY[TempBiasAxes] = {0.0F};
+            for (int i = 0; i < TempBiasBinNum; i++)
+            {
+                const TempBiasBin &b = bins[i];
+                if (b.weight == 0)
+                    continue;
+                float dt = b.temp - curve.refTemp;
+                sumTT += b.weight * dt * dt;
+                for (int axis = 0; axis < TempBiasAxes; axis++)
+                {
+                    sumY[axis] += b.weight * b.bias[axis];
+                    sumTY[axis] += b.weight * dt * b.bias[axis];
+                }
+            }
+            for (int axis = 0; axis < TempBiasAxes; axis++)
+            {
+                curve.bias[axis] = sumY[axis] / sumW;
+                curve.slope[axis] = sumTY[axis] / sumTT;
+                if (fabsf(curve.slope[axis]) > TempBiasMaxSlope)
+                    return false;
+            }
+            curve.minTemp = minTemp - TempBiasExtrapolateC;
+            curve.maxTemp = maxTemp + TempBiasExtrapolateC;
+            curve.valid = true;
+            outCurve = curve;
+            return true;
+        }
+
+        /**
+         * @brief 観測した全ての区間のオフセットを同じだけずらす．傾きはそのままで，直線の切片だけが delta 動く
+         * @brief /set/offset で温度補正の残りを測ったとき，観測が貯まるのを待たずに残りを消すのに使う
+         *
+         * @param delta 3軸のずらす量[deg/s]
+         */
+        void TempBiasModel::shift(const float *delta)
+        {
+            for (int i = 0; i < TempBiasBinNum; i++)
+            {
+                if (bins[i].weight == 0)
+                    continue;
+                for (int axis = 0; axis < TempBiasAxes; axis++)
+                    bins[i].bias[axis] += delta[axis];
+            }
+        }
+
+        /**
+         * @brief 全ての観測を捨てる
+         */
+        void TempBiasModel::clear()
+        {
+            for (int i = 0; i < TempBiasBinNum; i++)
+            {
+                bins[i].temp = TempBiasMinC + (i + 0.5F) * TempBiasBinWidthC;
+                memset(bins[i].bias, 0, sizeof(bins[i].bias));
+                bins[i].weight = 0;
+            }
+        }
+
+        int TempBiasModel::populatedBins() const
+        {
+            int n = 0;
+            for (int i = 0; i < TempBiasBinNum; i++)
+            {
+                if (bins[i].weight > 0)
+                    n++;
+            }
+            return n;
+        }
+
+        /**
+         * @brief 保存しておいた区間を戻す．温度が区間から外れていれば区間の中央に直す
+         */
+        void TempBiasModel::setBin(int i, const TempBiasBin &value)
+        {
+            if (i < 0 || i >= TempBiasBinNum)
+                return;
+            bins[i] = value;
+            if (bins[i].weight > TempBiasMaxWeight)
+                bins[i].weight = TempBiasMaxWeight;
+            if (BinIndex(bins[i].temp) != i)
+                bins[i].temp = TempBiasMinC + (i + 0.5F) * TempBiasBinWidthC;
+        }
+
+    } // bias
+} // imu
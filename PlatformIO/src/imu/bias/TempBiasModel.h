@@ -0,0 +1,65 @@
+#pragma once
+#include <inttypes.h>
+
+namespace imu
+{
+    namespace bias
+    {
+
+        static const int TempBiasAxes = 3;
+        static const int TempBiasBinNum = 16;           // 温度の区間の数
+        static const float TempBiasMinC = 10.0F;        // 最初の区間の下端[℃]
+        static const float TempBiasBinWidthC = 2.5F;    // 区間の幅[℃] (10〜50℃)
+        static const uint16_t TempBiasMaxWeight = 60;   // 区間毎の重みの上限．以降は古い観測から薄れる
+        static const float TempBiasMinSpanC = 4.0F;     // 傾きを求めるのに必要な観測温度の幅[℃]
+        static const float TempBiasMaxSlope = 0.5F;     // これを超える傾き[deg/s/℃]は誤った観測とみなす
+        static const float TempBiasExtrapolateC = 5.0F; // 観測した範囲の外へ延ばす幅[℃]．その先は一定
+
+        /**
+         * @brief 温度区間1つ分の観測．静止中の角速度の平均 (=オフセット) を重み付きで平均したもの
+         */
+        struct TempBiasBin
+        {
+            float temp;               // 観測した温度の平均[℃]
+            float bias[TempBiasAxes]; // [deg/s]
+            uint16_t weight;          // 0: 観測なし
+        };
+
+        /**
+         * @brief 温度に対するジャイロのオフセットの直線 bias + slope * (T - refTemp)
+         */
+        struct TempBiasCurve
+        {
+            bool valid;
+            float refTemp;
+            float bias[TempBiasAxes];
+            float slope[TempBiasAxes];
+            float minTemp; // evaluate() はこの範囲に温度を丸める
+            float maxTemp;
+
+            explicit TempBiasCurve();
+            void evaluate(float temp, float *outBias) const;
+        };
+
+        /**
+         * @brief 静止中に観測したオフセットを温度区間毎に貯め，温度との関係を最小二乗法で直線に当てはめる
+         */
+        class TempBiasModel
+        {
+        public:
+            explicit TempBiasModel();
+            bool observe(float temp, const float *bias);
+            bool fit(TempBiasCurve &outCurve) const;
+            void shift(const float *delta);
+            void clear();
+            int populatedBins() const;
+            const TempBiasBin &bin(int i) const { return bins[i]; }
+            void setBin(int i, const TempBiasBin &value);
+            static int BinIndex(float temp);
+
+        private:
+            TempBiasBin bins[TempBiasBinNum];
+        };
+
+    } // bias
+} // imu
@@ -0,0 +1,86 @@
+#include <string.h>
+#include "FifoParser.h"
+
+namespace imu
+{
+    namespace fifo
+    {
+
+        static int16_t ReadInt16(const uint8_t *p)
+        {
+            return (int16_t)((uint16_t)p[0] << 8 | p[1]);
+        }
+
+        /**
+         * @brief まとめて読み出したサンプルの時刻を求める
+         * @brief 読み出した時点でFIFOの最新のサンプルが入ったとみなし，まだFIFOに残っている分も数えて遡る
+         * @brief (読み出しを途中で止めても，次の読み出しの時刻と重ならない)
+         *
+         * @param readMicros 読み出した時刻[us]
+         * @param index 読み出したサンプルのうちの番号 (0が最も古い)
+         * @param count 読み出したサンプルの数
+         * @param remaining 読み出した後もFIFOに残っているサンプルの数
+         * @param periodMicros サンプリング周期[us]
+         * @return uint32_t サンプルの時刻[us]
+         */
+        uint32_t SampleTimestamp(uint32_t readMicros, size_t index, size_t count, size_t remaining,
+                                 uint32_t periodMicros)
+        {
+            return readMicros - (uint32_t)(count - 1 - index + remaining) * periodMicros;
+        }
+
+        /**
+         * @brief バイト列を先頭から14byteずつサンプルに変換する
+         *
+         * @param bytes FIFOから読み出したバイト列
+         * @param len バイト列の長さ
+         * @param outSamples 変換したサンプルを保存する配列
+         * @param maxSamples outSamplesの要素数．超えた分は捨てる
+         * @return size_t 変換したサンプル数
+         */
+        size_t FifoParser::parse(const uint8_t *bytes, size_t len, FifoSample *outSamples, size_t maxSamples)
+        {
+            size_t count = 0;
+            size_t pos = 0;
+
+            // 前回の端数を埋める
+            if (pendingLen > 0)
+            {
+                size_t fill = FifoPacketLen - pendingLen;
+                if (fill > len)
+                    fill = len;
+                memcpy(pendingBytes + pendingLen, bytes, fill);
+                pendingLen += fill;
+                pos = fill;
+                if (pendingLen < (size_t)FifoPacketLen)
+                    return 0;
+                if (count < maxSamples)
+                    decode(pendingBytes, outSamples[count++]);
+                pendingLen = 0;
+            }
+
+            while (pos + FifoPacketLen <= len)
+            {
+                if (count < maxSamples)
+                    decode(bytes + pos, outSamples[count++]);
+                pos += FifoPacketLen;
+            }
+
+            // 端数は次回に持ち越す
+            pendingLen = len - pos;
+            memcpy(pendingBytes, bytes + pos, pendingLen);
+            return count;
+        }
+
+        void FifoParser::decode(const uint8_t *packet, FifoSample &outSample)
+        {
+            for (int i = 0; i < 3; i++)
+            {
+                outSample.acc[i] = ReadInt16(packet + i * 2) / AccelLsbPerG;
+                outSample.gyro[i] = ReadInt16(packet + 8 + i * 2) / GyroLsbPerDps;
+            }
+            outSample.temp = ReadInt16(packet + 6) / TempLsbPerDegC + TempOffsetDegC;
+        }
+
+    } // fifo
+} // imu
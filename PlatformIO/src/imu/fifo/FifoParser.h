@@ -0,0 +1,49 @@
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+
+namespace imu
+{
+    namespace fifo
+    {
+
+        static const int FifoPacketLen = 14; // accel(6) + temp(2) + gyro(6), big-endian int16
+        static const float AccelLsbPerG = 4096.0F; // ±8g
+        static const float GyroLsbPerDps = 16.4F;  // ±2000dps
+        static const float TempLsbPerDegC = 326.8F;
+        static const float TempOffsetDegC = 25.0F;
+
+        /**
+         * @brief FIFOから取り出した1サンプル
+         */
+        struct FifoSample
+        {
+        public:
+            float acc[3];  // [g]
+            float gyro[3]; // [deg/s]
+            float temp;    // [degC]
+        };
+
+        uint32_t SampleTimestamp(uint32_t readMicros, size_t index, size_t count, size_t remaining,
+                                 uint32_t periodMicros);
+
+        /**
+         * @brief MPU6886のFIFOバイト列をサンプルに変換する
+         * @brief パケットの途中で切れたバイト列は次回の入力と連結して扱う
+         */
+        class FifoParser
+        {
+        public:
+            explicit FifoParser() : pendingLen(0) {}
+            size_t parse(const uint8_t *bytes, size_t len, FifoSample *outSamples, size_t maxSamples);
+            void reset() { pendingLen = 0; }
+            size_t pending() const { return pendingLen; }
+
+        private:
+            uint8_t pendingBytes[FifoPacketLen];
+            size_t pendingLen;
+            static void decode(const uint8_t *packet, FifoSample &outSample);
+        };
+
+    } // fifo
+} // imu
@@ -0,0 +1,174 @@
+#include "Mpu6886Fifo.h"
+
+namespace imu
+{
+    namespace fifo
+    {
+        // MPU6886 registers
+        static const uint8_t RegSmplrtDiv = 0x19;
+        static const uint8_t RegConfig = 0x1A;
+        static const uint8_t RegGyroConfig = 0x1B;
+        static const uint8_t RegAccelConfig = 0x1C;
+        static const uint8_t RegAccelConfig2 = 0x1D;
+        static const uint8_t RegFifoEn = 0x23;
+        static const uint8_t RegIntStatus = 0x3A;
+        static const uint8_t RegUserCtrl = 0x6A;
+        static const uint8_t RegFifoCountH = 0x72;
+        static const uint8_t RegFifoRw = 0x74;
+        static const uint8_t RegWhoAmI = 0x75;
+
+        static const uint8_t WhoAmIMpu6886 = 0x19;
+        static const uint8_t ConfigDlpf176Hz = 0x01;   // FIFO_MODE=0: 満杯時は古いデータを上書き
+        static const uint8_t GyroConfig2000Dps = 0x18; // FS_SEL=3
+        static const uint8_t AccelConfig8G = 0x10;     // ACCEL_FS_SEL=2
+        static const uint8_t AccelConfig2Dlpf218Hz = 0x00;
+        static const uint8_t FifoEnGyroAccel = 0x18; // GYRO_FIFO_EN | ACC_FIFO_EN
+        static const uint8_t UserCtrlFifoEn = 0x40;
+        static const uint8_t UserCtrlFifoRst = 0x04;
+        static const uint8_t IntStatusFifoOflow = 0x10;
+        static const uint16_t InternalRateHz = 1000; // DLPF有効時の内部サンプリング周波数
+
+        Mpu6886Fifo::Mpu6886Fifo(m5::I2C_Class &i2c)
+            : i2c(i2c), parser(), enabled(false), rateHz(0), overflows(0), remainingSamples(0)
+        {
+        }
+
+        /**
+         * @brief サンプリング周波数を設定してFIFOを有効にする
+         *
+         * @param sampleRateHz サンプリング周波数 (4 - 1000Hz, 1000Hzを割り切れる値)
+         * @return true 正常終了
+         * @return false 異常終了 MPU6886が見つからない
+         */
+        bool Mpu6886Fifo::begin(uint16_t sampleRateHz)
+        {
+            uint8_t whoAmI = 0;
+            if (!readRegisters(RegWhoAmI, &whoAmI, 1) || whoAmI != WhoAmIMpu6886)
+            {
+                return false;
+            }
+            if (sampleRateHz == 0 || sampleRateHz > InternalRateHz)
+                sampleRateHz = InternalRateHz;
+            uint8_t div = (uint8_t)(InternalRateHz / sampleRateHz - 1);
+            rateHz = InternalRateHz / (div + 1);
+
+            bool ok = writeRegister(RegUserCtrl, 0x00) &&
+                      writeRegister(RegFifoEn, 0x00) &&
+                      writeRegister(RegSmplrtDiv, div) &&
+                      writeRegister(RegConfig, ConfigDlpf176Hz) &&
+                      writeRegister(RegGyroConfig, GyroConfig2000Dps) &&
+                      writeRegister(RegAccelConfig, AccelConfig8G) &&
+                      writeRegister(RegAccelConfig2, AccelConfig2Dlpf218Hz) &&
+                      writeRegister(RegFifoEn, FifoEnGyroAccel);
+            if (!ok)
+            {
+                return false;
+            }
+            resetFifo();
+            enabled = true;
+            return true;
+        }
+
+        /**
+         * @brief 角速度を最大レンジ (±2000dps)，加速度を ±8g に設定し，読み戻して確かめる
+         * @brief 加速度のレンジは M5Unified と FifoParser の換算係数に合わせ，変えない
+         *
+         * @return true 正常終了
+         * @return false 異常終了 MPU6886が見つからないか，設定が反映されない
+         */
+        bool Mpu6886Fifo::writeFullScale()
+        {
+            uint8_t whoAmI = 0;
+            if (!readRegisters(RegWhoAmI, &whoAmI, 1) || whoAmI != WhoAmIMpu6886)
+            {
+                return false;
+            }
+            uint8_t config[2] = {0, 0};
+            return writeRegister(RegGyroConfig, GyroConfig2000Dps) &&
+                   writeRegister(RegAccelConfig, AccelConfig8G) &&
+                   readRegisters(RegGyroConfig, config, 2) &&
+                   config[0] == GyroConfig2000Dps && config[1] == AccelConfig8G;
+        }
+
+        /**
+         * @brief FIFOを無効にする
+         */
+        void Mpu6886Fifo::end()
+        {
+            writeRegister(RegFifoEn, 0x00);
+            writeRegister(RegUserCtrl, 0x00);
+            parser.reset();
+            enabled = false;
+        }
+
+        /**
+         * @brief FIFOに溜まっているサンプルを古い順に読み出す
+         *
+         * @param outSamples 読み出したサンプルを保存する配列
+         * @param maxSamples outSamplesの要素数
+         * @return size_t 読み出したサンプル数
+         */
+        size_t Mpu6886Fifo::read(FifoSample *outSamples, size_t maxSamples)
+        {
+            remainingSamples = 0;
+            if (!enabled)
+            {
+                return 0;
+            }
+
+            // あふれた場合はパケット境界がずれるので捨ててやり直す
+            uint8_t intStatus = 0;
+            if (readRegisters(RegIntStatus, &intStatus, 1) && (intStatus & IntStatusFifoOflow))
+            {
+                overflows++;
+                resetFifo();
+                return 0;
+            }
+
+            uint8_t countBytes[2];
+            if (!readRegisters(RegFifoCountH, countBytes, 2))
+            {
+                return 0;
+            }
+            size_t stored = ((size_t)(countBytes[0] & 0x1F) << 8) | countBytes[1];
+            size_t wanted = maxSamples * FifoPacketLen - parser.pending();
+            size_t available = (stored > wanted) ? wanted : stored;
+
+            uint8_t chunk[FifoReadChunkLen];
+            size_t count = 0;
+            size_t readBytes = 0;
+            while (available > 0)
+            {
+                size_t len = (available > (size_t)FifoReadChunkLen) ? FifoReadChunkLen : available;
+                if (!readRegisters(RegFifoRw, chunk, len))
+                {
+                    break;
+                }
+                count += parser.parse(chunk, len, outSamples + count, maxSamples - count);
+                available -= len;
+                readBytes += len;
+            }
+            // maxSamples で止めた分 (と途中まで読んだパケット) は読み出し時刻より前に入ったサンプル
+            remainingSamples = (stored - readBytes + parser.pending()) / FifoPacketLen;
+            return count;
+        }
+
+        void Mpu6886Fifo::resetFifo()
+        {
+            writeRegister(RegUserCtrl, UserCtrlFifoRst);
+            writeRegister(RegUserCtrl, UserCtrlFifoEn);
+            parser.reset();
+        }
+
+        bool Mpu6886Fifo::writeRegister(uint8_t reg, uint8_t value)
+        {
+            return i2c.writeRegister8(Mpu6886Address, reg, value, Mpu6886I2cFreq);
+        }
+
+        bool Mpu6886Fifo::readRegisters(uint8_t reg, uint8_t *out, size_t len)
+        {
+            return i2c.readRegister(Mpu6886Address, reg, out, len, Mpu6886I2cFreq);
+        }
+
+    } // fifo
+} // imu
@@ -0,0 +1,43 @@
+#pragma once
+#include "utility/I2C_Class.hpp"
+#include "FifoParser.h"
+
+namespace imu
+{
+    namespace fifo
+    {
+
+        static const uint8_t Mpu6886Address = 0x68;
+        static const uint32_t Mpu6886I2cFreq = 400000;
+        static const int FifoReadChunkLen = FifoPacketLen * 8; // 1回のI2C読み出しの上限 (112byte)
+
+        /**
+         * @brief MPU6886のハードウェアFIFOを設定し，溜まったサンプルをまとめて読み出す
+         */
+        class Mpu6886Fifo
+        {
+        public:
+            explicit Mpu6886Fifo(m5::I2C_Class &i2c);
+            bool begin(uint16_t sampleRateHz);
+            void end();
+            bool writeFullScale();
+            size_t read(FifoSample *outSamples, size_t maxSamples);
+            bool isEnabled() const { return enabled; }
+            uint16_t sampleRate() const { return rateHz; }
+            uint32_t overflowCount() const { return overflows; }
+            size_t remaining() const { return remainingSamples; } // 前回の read() の後にFIFOに残ったサンプル数
+
+        private:
+            m5::I2C_Class &i2c;
+            FifoParser parser;
+            bool enabled;
+            uint16_t rateHz;
+            uint32_t overflows;
+            size_t remainingSamples;
+            bool writeRegister(uint8_t reg, uint8_t value);
+            bool readRegisters(uint8_t reg, uint8_t *out, size_t len);
+            void resetFifo();
+        };
+
+    } // fifo
+} // imu
@@ -0,0 +1,152 @@
+#include <math.h>
+#include "QuatFrame.h"
+
+namespace imu
+{
+    namespace frame
+    {
+        static const float ComponentMax = 0.70710678F; // 最大成分以外は1/√2を超えない
+        static const uint32_t ComponentSteps = (1UL << QuatComponentBits) - 1;
+
+        static void PutU16(uint8_t *p, uint16_t v)
+        {
+            p[0] = (uint8_t)v;
+            p[1] = (uint8_t)(v >> 8);
+        }
+
+        static void PutU32(uint8_t *p, uint32_t v)
+        {
+            p[0] = (uint8_t)v;
+            p[1] = (uint8_t)(v >> 8);
+            p[2] = (uint8_t)(v >> 16);
+            p[3] = (uint8_t)(v >> 24);
+        }
+
+        static uint16_t GetU16(const uint8_t *p)
+        {
+            return (uint16_t)(p[0] | (uint16_t)p[1] << 8);
+        }
+
+        static uint32_t GetU32(const uint8_t *p)
+        {
+            return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+        }
+
+        /**
+         * @brief 名前 (uniqueId) から16bitの機器IDを求める (FNV-1aを16bitに畳み込む)
+         */
+        uint16_t DeviceIdFromName(const char *name)
+        {
+            uint32_t hash = 2166136261UL;
+            for (const char *p = name; *p != '\0'; p++)
+            {
+                hash ^= (uint8_t)*p;
+                hash *= 16777619UL;
+            }
+            return (uint16_t)((hash >> 16) ^ (hash & 0xFFFF));
+        }
+
+        /**
+         * @brief 単位クォータニオンをsmallest-three形式の48bitに詰める
+         *
+         * @param quat 姿勢クォータニオン (w, x, y, z)
+         * @return uint64_t 下位47bitに詰めた値
+         */
+        uint64_t EncodeQuat(const float *quat)
+        {
+            int largest = 0;
+            for (int i = 1; i < ImuWxyz; i++)
+            {
+                if (fabsf(quat[i]) > fabsf(quat[largest]))
+                    largest = i;
+            }
+            // qと-qは同じ姿勢を表すので，省く成分が正になる向きにそろえる
+            float sign = (quat[largest] < 0.0F) ? -1.0F : 1.0F;
+
+            uint64_t packed = (uint64_t)largest;
+            for (int i = 0; i < ImuWxyz; i++)
+            {
+                if (i == largest)
+                    continue;
+                float normalized = (sign * quat[i] / ComponentMax + 1.0F) * 0.5F; // 0..1
+                float scaled = roundf(normalized * ComponentSteps);
+                if (scaled < 0.0F)
+                    scaled = 0.0F;
+                if (scaled > (float)ComponentSteps)
+                    scaled = (float)ComponentSteps;
+                packed = (packed << QuatComponentBits) | (uint32_t)scaled;
+            }
+            return packed;
+        }
+
+        /**
+         * @brief EncodeQuat()で詰めた値を単位クォータニオンに戻す
+         *
+         * @param packed 下位47bitに詰めた値
+         * @param outQuat 取得した値を保存する配列 (w, x, y, z)
+         */
+        void DecodeQuat(uint64_t packed, float *outQuat)
+        {
+            int largest = (int)((packed >> (QuatComponentBits * 3)) & 0x3);
+            float sumSq = 0.0F;
+            int shift = QuatComponentBits * 2;
+            for (int i = 0; i < ImuWxyz; i++)
+            {
+                if (i == largest)
+                    continue;
+                uint32_t scaled = (uint32_t)(packed >> shift) & ComponentSteps;
+                shift -= QuatComponentBits;
+                float value = ((float)scaled / ComponentSteps * 2.0F - 1.0F) * ComponentMax;
+                outQuat[i] = value;
+                sumSq += value * value;
+            }
+            outQuat[largest] = (sumSq < 1.0F) ? sqrtf(1.0F - sumSq) : 0.0F;
+        }
+
+        /**
+         * @brief IMUデータの姿勢をフレームに書き込む
+         *
+         * @param imuData 姿勢推定済みのIMUデータ
+         * @param deviceId DeviceIdFromName()で求めた機器ID
+         * @param seq 送信毎に1ずつ増やす番号 (受信側で欠落を数えるのに使う)
+         * @param out 書き込み先 (QuatFrameLen byte以上)
+         * @return size_t 書き込んだバイト数
+         */
+        size_t EncodeFrame(const ImuData &imuData, uint16_t deviceId, uint16_t seq, uint8_t *out)
+        {
+            out[QuatFrameMagicOffset] = QuatFrameMagic;
+            out[QuatFrameVersionOffset] = QuatFrameVersion;
+            PutU16(out + QuatFrameDeviceIdOffset, deviceId);
+            PutU16(out + QuatFrameSeqOffset, seq);
+            PutU32(out + QuatFrameTimestampOffset, imuData.timestamp);
+            uint64_t packed = EncodeQuat(imuData.quat);
+            for (size_t i = 0; i < QuatFrameQuatLen; i++)
+                out[QuatFrameQuatOffset + i] = (uint8_t)(packed >> (8 * i));
+            return QuatFrameLen;
+        }
+
+        /**
+         * @brief フレームを読み込む
+         *
+         * @return true 正常終了
+         * @return false 異常終了 フレームではないかバージョンが異なる
+         */
+        bool DecodeFrame(const uint8_t *in, size_t len, QuatFrame &outFrame)
+        {
+            if (len < QuatFrameLen || in[QuatFrameMagicOffset] != QuatFrameMagic ||
+                in[QuatFrameVersionOffset] != QuatFrameVersion)
+            {
+                return false;
+            }
+            outFrame.deviceId = GetU16(in + QuatFrameDeviceIdOffset);
+            outFrame.seq = GetU16(in + QuatFrameSeqOffset);
+            outFrame.timestamp = GetU32(in + QuatFrameTimestampOffset);
+            uint64_t packed = 0;
+            for (size_t i = 0; i < QuatFrameQuatLen; i++)
+                packed |= (uint64_t)in[QuatFrameQuatOffset + i] << (8 * i);
+            DecodeQuat(packed, outFrame.quat);
+            return true;
+        }
+
+    } // frame
+} // imu
@@ -0,0 +1,54 @@
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+#include "../ImuData.h"
+
+namespace imu
+{
+    namespace frame
+    {
+        // /quat の代わりに送る固定長のバイナリフレーム (全てリトルエンディアン)
+        //   magic 'Q'(u8) version(u8) deviceId(u16) seq(u16) timestamp[us](u32) quat(48bit)  = 16byte
+        // quatは最大成分を省いた残り3成分を15bitずつ量子化する (smallest-three)
+        //   bit 46-45: 省いた成分の番号 (w, x, y, z = 0..3)
+        //   bit 44-30, 29-15, 14-0: 残りの成分を w, x, y, z の順に詰めたもの
+
+        static const uint8_t QuatFrameMagic = 'Q';
+        static const uint8_t QuatFrameVersion = 1;
+        static const size_t QuatFrameMagicOffset = 0;
+        static const size_t QuatFrameVersionOffset = 1;
+        static const size_t QuatFrameDeviceIdOffset = 2;
+        static const size_t QuatFrameSeqOffset = 4;
+        static const size_t QuatFrameTimestampOffset = 6;
+        static const size_t QuatFrameQuatOffset = 10;
+        static const size_t QuatFrameQuatLen = 6;
+        static const size_t QuatFrameLen = 16;
+        static const int QuatComponentBits = 15;
+
+        static_assert(QuatFrameQuatOffset + QuatFrameQuatLen == QuatFrameLen,
+                      "QuatFrame fields must fill the frame exactly");
+        static_assert(2 + QuatComponentBits * 3 <= QuatFrameQuatLen * 8,
+                      "smallest-three quaternion must fit in its field");
+
+        struct QuatFrame
+        {
+        public:
+            uint16_t deviceId;
+            uint16_t seq;
+            uint32_t timestamp; // [us]
+            float quat[ImuWxyz]; // w, x, y, z
+
+            explicit QuatFrame() : deviceId(0), seq(0), timestamp(0), quat()
+            {
+                quat[0] = 1.0F;
+            }
+        };
+
+        uint16_t DeviceIdFromName(const char *name);
+        uint64_t EncodeQuat(const float *quat);
+        void DecodeQuat(uint64_t packed, float *outQuat);
+        size_t EncodeFrame(const ImuData &imuData, uint16_t deviceId, uint16_t seq, uint8_t *out);
+        bool DecodeFrame(const uint8_t *in, size_t len, QuatFrame &outFrame);
+
+    } // frame
+} // imu
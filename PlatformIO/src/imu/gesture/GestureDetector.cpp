@@ -0,0 +1,271 @@
+#include <math.h>
+#include "GestureDetector.h"
+
+namespace imu
+{
+    namespace gesture
+    {
+
+        /**
+         * @brief 送信アドレスの末尾 (/<uniqueId>/event/<name>)
+         */
+        const char *GestureEventName(GestureEventType type)
+        {
+            switch (type)
+            {
+            case GestureSpinStart:
+                return "spinstart";
+            case GestureSpinStop:
+                return "spinstop";
+            case GestureSpinReverse:
+                return "spinreverse";
+            case GestureShake:
+                return "shake";
+            default:
+                return "unknown";
+            }
+        }
+
+        GestureParams::GestureParams()
+            : spinAxis(2), spinStartDps(180.0F), spinStopDps(60.0F), spinHoldMs(60), spinReleaseMs(250),
+              shakeG(1.5F), shakeCount(3), shakeWindowMs(800) {}
+
+        /**
+         * @brief OSCで受け取った値を使える範囲に丸める
+         */
+        void GestureParams::sanitize()
+        {
+            if (spinAxis < 0 || spinAxis >= ImuXyz)
+                spinAxis = 2;
+            if (!(spinStartDps >= 10.0F)) // NaNも丸める
+                spinStartDps = 10.0F;
+            if (!(spinStopDps >= 0.0F))
+                spinStopDps = 0.0F;
+            if (spinStopDps > spinStartDps * 0.9F) // 閾値の間に幅がないと開始/停止を繰り返す
+                spinStopDps = spinStartDps * 0.9F;
+            if (spinHoldMs > 2000)
+                spinHoldMs = 2000;
+            if (spinReleaseMs > 5000)
+                spinReleaseMs = 5000;
+            if (!(shakeG >= 0.2F))
+                shakeG = 0.2F;
+            if (shakeCount < 2)
+                shakeCount = 2;
+            else if (shakeCount > GestureShakePeakMax)
+                shakeCount = GestureShakePeakMax;
+            if (shakeWindowMs < 100)
+                shakeWindowMs = 100;
+            else if (shakeWindowMs > 5000)
+                shakeWindowMs = 5000;
+        }
+
+        GestureDetector::GestureDetector()
+        {
+            reset();
+        }
+
+        /**
+         * @brief 閾値を変える．途中の判定は捨てる
+         */
+        void GestureDetector::configure(const GestureParams &value)
+        {
+            params = value;
+            params.sanitize();
+            reset();
+        }
+
+        /**
+         * @brief 判定の途中経過を捨て，止まっている状態に戻す．オフセットの計測中など，送らない間に呼ぶ
+         */
+        void GestureDetector::reset()
+        {
+            spinDirection = 0;
+            candidateDirection = 0;
+            candidateSince = 0;
+            candidatePeak = 0.0F;
+            spinSince = 0;
+            spinPeak = 0.0F;
+            releasing = false;
+            releaseSince = 0;
+            shakePeakCount = 0;
+            shakePeak = 0.0F;
+            shakeAbove = false;
+            shakeReported = false;
+        }
+
+        /**
+         * @brief 1サンプルを追加する．全サンプルで呼ぶこと
+         *
+         * @param imuData オフセット補正後のIMUデータ
+         * @param outEvent 検出したジェスチャー
+         * @return true このサンプルでジェスチャーを検出した
+         * @return false 検出なし
+         */
+        bool GestureDetector::update(const ImuData &imuData, GestureEvent &outEvent)
+        {
+            uint32_t now = imuData.timestamp;
+            bool detected = updateSpin(now, imuData.gyro[params.spinAxis], outEvent);
+            if (detected || isSpinning())
+            {
+                // 棒の中心から外れたIMUには回転中ずっと遠心力と重力の和が周期的にかかり，揺さぶりと区別できない
+                shakePeakCount = 0;
+                shakePeak = 0.0F;
+                shakeAbove = false;
+                shakeReported = false;
+                return detected;
+            }
+            float accelNorm = sqrtf(imuData.acc[0] * imuData.acc[0] +
+                                    imuData.acc[1] * imuData.acc[1] +
+                                    imuData.acc[2] * imuData.acc[2]);
+            return updateShake(now, accelNorm, outEvent);
+        }
+
+        /**
+         * @brief 回転の開始/停止/反転を判定する
+         * @brief 開始と反転は spinStartDps を spinHoldMs 続けて超えたとき，停止は spinStopDps を spinReleaseMs 続けて下回ったときに確定する
+         *
+         * @param rate spinAxis 周りの角速度[deg/s]
+         */
+        bool GestureDetector::updateSpin(uint32_t now, float rate, GestureEvent &outEvent)
+        {
+            float speed = fabsf(rate);
+            int direction = 0;
+            if (rate >= params.spinStartDps)
+                direction = 1;
+            else if (rate <= -params.spinStartDps)
+                direction = -1;
+
+            // 止まっている間は開始の，回転中は反転の候補を追う
+            if (direction == 0 || direction == spinDirection)
+            {
+                candidateDirection = 0;
+            }
+            else
+            {
+                if (candidateDirection != direction)
+                {
+                    candidateDirection = direction;
+                    candidateSince = now;
+                    candidatePeak = 0.0F;
+                }
+                if (speed > candidatePeak)
+                    candidatePeak = speed;
+            }
+            bool confirmed = candidateDirection != 0 && now - candidateSince >= params.spinHoldMs * 1000UL;
+
+            if (spinDirection == 0)
+            {
+                if (!confirmed)
+                    return false;
+                emit(GestureSpinStart, now, now - candidateSince, candidatePeak, candidateDirection, outEvent);
+                spinDirection = candidateDirection;
+                spinSince = candidateSince;
+                spinPeak = candidatePeak;
+                releasing = false;
+                candidateDirection = 0;
+                return true;
+            }
+
+            if (rate * spinDirection > params.spinStopDps)
+            {
+                // 同じ向きに回り続けている
+                if (speed > spinPeak)
+                    spinPeak = speed;
+                releasing = false;
+                return false;
+            }
+            if (!releasing)
+            {
+                releasing = true;
+                releaseSince = now;
+            }
+            if (confirmed)
+            {
+                emit(GestureSpinReverse, now, releaseSince - spinSince, spinPeak, candidateDirection, outEvent);
+                spinDirection = candidateDirection;
+                spinSince = candidateSince;
+                spinPeak = candidatePeak;
+                releasing = false;
+                candidateDirection = 0;
+                return true;
+            }
+            if (now - releaseSince >= params.spinReleaseMs * 1000UL)
+            {
+                // 逆向きの候補は残し，止まった後の開始として確定させる
+                emit(GestureSpinStop, now, releaseSince - spinSince, spinPeak, spinDirection, outEvent);
+                spinDirection = 0;
+                releasing = false;
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * @brief 揺さぶりを判定する．加速度ノルムと1gの差が shakeG を超える山が shakeWindowMs 内に shakeCount 個あれば確定する
+         * @brief 山の最大値を送るため，shakeCount 個目の山が終わった (閾値の半分を下回った) ときに確定する
+         *
+         * @param accelNorm 加速度の大きさ[g]
+         */
+        bool GestureDetector::updateShake(uint32_t now, float accelNorm, GestureEvent &outEvent)
+        {
+            uint32_t windowMicros = params.shakeWindowMs * 1000UL;
+            if (shakePeakCount > 0 && !shakeAbove && now - shakePeaks[shakePeakCount - 1] > windowMicros)
+            {
+                // 山が途切れた．次の揺さぶりを待つ
+                shakePeakCount = 0;
+                shakePeak = 0.0F;
+                shakeReported = false;
+            }
+
+            float excess = accelNorm - 1.0F;
+            if (!shakeAbove)
+            {
+                if (!(excess > params.shakeG))
+                    return false;
+                shakeAbove = true;
+                if (shakePeakCount == GestureShakePeakMax)
+                {
+                    for (int i = 1; i < GestureShakePeakMax; i++)
+                        shakePeaks[i - 1] = shakePeaks[i];
+                    shakePeakCount--;
+                }
+                shakePeaks[shakePeakCount++] = now;
+                if (!shakeReported)
+                {
+                    // 窓から外れた古い山を捨てる
+                    int expired = 0;
+                    while (expired < shakePeakCount && now - shakePeaks[expired] > windowMicros)
+                        expired++;
+                    for (int i = expired; i < shakePeakCount; i++)
+                        shakePeaks[i - expired] = shakePeaks[i];
+                    shakePeakCount -= expired;
+                    if (expired > 0 && shakePeakCount == 1)
+                        shakePeak = 0.0F;
+                }
+            }
+            if (excess > shakePeak)
+                shakePeak = excess;
+            if (excess >= params.shakeG * 0.5F)
+                return false;
+
+            // 山が終わった
+            shakeAbove = false;
+            if (shakeReported || shakePeakCount < params.shakeCount)
+                return false;
+            emit(GestureShake, now, now - shakePeaks[0], shakePeak, 0, outEvent);
+            shakeReported = true;
+            return true;
+        }
+
+        void GestureDetector::emit(GestureEventType type, uint32_t now, uint32_t durationMicros, float peak, int direction,
+                                   GestureEvent &outEvent) const
+        {
+            outEvent.timestamp = now;
+            outEvent.durationMs = durationMicros / 1000UL;
+            outEvent.peak = peak;
+            outEvent.direction = direction;
+            outEvent.type = type;
+        }
+
+    } // gesture
+} // imu
@@ -0,0 +1,97 @@
+#pragma once
+#include <inttypes.h>
+#include "../ImuData.h"
+
+namespace imu
+{
+    namespace gesture
+    {
+
+        static const int GestureShakePeakMax = 8; // 揺さぶりの判定に使う山の数の上限
+
+        /**
+         * @brief 検出するジェスチャー．送信アドレスの末尾 (GestureEventName) と対応する
+         */
+        enum GestureEventType
+        {
+            GestureSpinStart,   // 回転し始めた
+            GestureSpinStop,    // 回転が止まった
+            GestureSpinReverse, // 止まらずに回転の向きが変わった
+            GestureShake,       // 揺さぶった
+            GestureEventTypeNum
+        };
+
+        const char *GestureEventName(GestureEventType type);
+
+        /**
+         * @brief 検出したジェスチャー1つ分．ImuLoop -> SendOscLoop へそのまま渡す
+         */
+        struct GestureEvent
+        {
+            uint32_t timestamp;  // [us] 検出したサンプルの時刻
+            uint32_t durationMs; // spinstart: 閾値を超えてから検出まで, spinstop/spinreverse: 終わった回転の長さ, shake: 最初から最後の山まで
+            float peak;          // 回転: 角速度の絶対値の最大[deg/s], shake: 加速度ノルムと1gの差の最大[g]
+            int32_t direction;   // 回転の向き (+1/-1)．spinreverse は新しい向き，shake は0
+            int32_t type;        // GestureEventType
+
+            explicit GestureEvent() : timestamp(0), durationMs(0), peak(0.0F), direction(0), type(0) {}
+        };
+
+        /**
+         * @brief 検出の閾値．/set/gesture/spin, /set/gesture/shake で変える
+         */
+        struct GestureParams
+        {
+            int spinAxis;           // 回転を見る軸 0: X, 1: Y, 2: Z (棒の長軸)
+            float spinStartDps;     // これを spinHoldMs 続けて超えたら回転とみなす[deg/s]
+            float spinStopDps;      // これを spinReleaseMs 続けて下回ったら停止とみなす[deg/s] (spinStartDps未満)
+            uint32_t spinHoldMs;    // 回転し始め / 逆回転の確定に必要な時間[ms]
+            uint32_t spinReleaseMs; // 停止の確定に必要な時間[ms]．これより早く逆向きに回れば spinreverse
+            float shakeG;           // 加速度ノルムと1gの差がこれを超えたら山とみなす[g]
+            int shakeCount;         // 揺さぶりとみなす山の数
+            uint32_t shakeWindowMs; // shakeCount 個の山が収まるべき時間[ms]
+
+            explicit GestureParams();
+            void sanitize();
+        };
+
+        /**
+         * @brief IMUの全サンプルから回転の開始/停止/反転と揺さぶりを検出する
+         * @brief 回転はオフセット補正後の角速度の1軸，揺さぶりは加速度ノルムで判定する
+         * @brief update() は全サンプルで呼ぶこと．1回の呼び出しで返すイベントは1つまで
+         */
+        class GestureDetector
+        {
+        public:
+            explicit GestureDetector();
+            void configure(const GestureParams &value);
+            const GestureParams &parameters() const { return params; }
+            bool update(const ImuData &imuData, GestureEvent &outEvent);
+            void reset();
+            bool isSpinning() const { return spinDirection != 0; }
+
+        private:
+            bool updateSpin(uint32_t now, float rate, GestureEvent &outEvent);
+            bool updateShake(uint32_t now, float accelNorm, GestureEvent &outEvent);
+            void emit(GestureEventType type, uint32_t now, uint32_t durationMicros, float peak, int direction, GestureEvent &outEvent) const;
+
+            GestureParams params;
+            // 回転
+            int spinDirection;       // 0: 止まっている, +1/-1: 回転中の向き
+            int candidateDirection;  // 閾値を超えている向き (確定前)
+            uint32_t candidateSince; // [us] candidateDirection の向きに閾値を超えた時刻
+            float candidatePeak;     // [deg/s]
+            uint32_t spinSince;      // [us] 回転中の回転が始まった時刻
+            float spinPeak;          // [deg/s]
+            bool releasing;          // 回転中に spinStopDps を下回っている
+            uint32_t releaseSince;   // [us]
+            // 揺さぶり
+            uint32_t shakePeaks[GestureShakePeakMax]; // [us] 直近の山の時刻 (古い順)
+            int shakePeakCount;
+            float shakePeak;    // [g] shakePeaks の間の最大
+            bool shakeAbove;    // 山の途中．閾値の半分を下回ったら山が終わる
+            bool shakeReported; // 揺さぶりを送った．山が shakeWindowMs 途切れるまで次を送らない
+        };
+
+    } // gesture
+} // imu
@@ -0,0 +1,58 @@
+#include <math.h>
+#include "GyroIntegrator.h"
+
+namespace imu
+{
+    namespace gyro
+    {
+
+        void GyroIntegrator::UpdateQuaternion(float gx, float gy, float gz, float ax, float ay, float az, float dt, float &q0, float &q1, float &q2, float &q3)
+        {
+            (void)ax;
+            (void)ay;
+            (void)az;
+            Integrate(gx, gy, gz, dt, q0, q1, q2, q3);
+        }
+
+        /**
+         * @brief 角速度[rad/s]でdtの間回した姿勢を求める．ほかのフィルタも高速回転モードで使う
+         */
+        void GyroIntegrator::Integrate(float gx, float gy, float gz, float dt, float &q0, float &q1, float &q2, float &q3)
+        {
+            float rate = sqrtf(gx * gx + gy * gy + gz * gz);
+            float halfAngle = 0.5f * rate * dt;
+            float c, s;
+            if (halfAngle < 1e-4f)
+            {
+                // 小角度ではテイラー展開で sin(x)/x の0除算を避ける
+                c = 1.0f - 0.5f * halfAngle * halfAngle;
+                s = 0.5f * dt * (1.0f - halfAngle * halfAngle / 6.0f);
+            }
+            else
+            {
+                c = cosf(halfAngle);
+                s = sinf(halfAngle) / rate;
+            }
+            // dq = (cos(|w|dt/2), sin(|w|dt/2) * w/|w|)
+            float dw = c;
+            float dx = s * gx;
+            float dy = s * gy;
+            float dz = s * gz;
+
+            // q = q * dq (機体座標系の角速度なので右から掛ける)
+            float qa = q0, qb = q1, qc = q2, qd = q3;
+            q0 = qa * dw - qb * dx - qc * dy - qd * dz;
+            q1 = qa * dx + qb * dw + qc * dz - qd * dy;
+            q2 = qa * dy - qb * dz + qc * dw + qd * dx;
+            q3 = qa * dz + qb * dy - qc * dx + qd * dw;
+
+            // 丸め誤差の蓄積を防ぐため正規化する
+            float recipNorm = 1.0f / sqrtf(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+            q0 *= recipNorm;
+            q1 *= recipNorm;
+            q2 *= recipNorm;
+            q3 *= recipNorm;
+        }
+
+    } // gyro
+} // imu
@@ -0,0 +1,30 @@
+#pragma once
+#include "../FusionFilter.h"
+
+namespace imu
+{
+    namespace gyro
+    {
+
+        /**
+         * @brief 角速度のみを厳密な指数写像 q <- q * exp(w * dt / 2) で積分する
+         * @brief サンプル間で角速度が一定なら回転速度によらず誤差がないため，高速回転の計測に向く
+         * @brief 加速度による補正は行わないので，長時間ではジャイロのオフセット分だけドリフトする
+         */
+        class GyroIntegrator : public FusionFilter
+        {
+        public:
+            void UpdateQuaternion(
+                float gx, float gy, float gz,
+                float ax, float ay, float az,
+                float dt,
+                float &q0, float &q1, float &q2, float &q3) override;
+
+            static void Integrate(
+                float gx, float gy, float gz,
+                float dt,
+                float &q0, float &q1, float &q2, float &q3);
+        };
+
+    } // gyro
+} // imu
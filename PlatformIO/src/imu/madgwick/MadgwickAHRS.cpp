@@ -0,0 +1,123 @@
+//=====================================================================================================
+// MadgwickAHRS.c
+//=====================================================================================================
+//
+// Implementation of Madgwick's IMU and AHRS algorithms.
+// See: http://www.x-io.co.uk/node/8#open_source_ahrs_and_imu_algorithms
+//
+// Date			Author          Notes
+// 29/09/2011	SOH Madgwick    Initial release
+// 02/10/2011	SOH Madgwick	Optimised for reduced CPU load
+//
+//=====================================================================================================
+// IMU (gyro + accel) update only. sampleFreq replaced by the measured dt.
+
+#include <math.h>
+#include "MadgwickAHRS.h"
+#include "../gyro/GyroIntegrator.h"
+
+namespace imu
+{
+	namespace madgwick
+	{
+
+		static float InvSqrt(float x)
+		{
+			return 1.0f / sqrtf(x);
+		}
+
+		MadgwickAHRS::MadgwickAHRS(float beta) : beta(beta), accelWeight(1.0f), exactIntegration(false)
+		{
+		}
+
+		void MadgwickAHRS::UpdateQuaternion(float gx, float gy, float gz, float ax, float ay, float az, float dt, float &q0, float &q1, float &q2, float &q3)
+		{
+			float recipNorm;
+			float s0, s1, s2, s3;
+			float qDot1, qDot2, qDot3, qDot4;
+			float _2q0, _2q1, _2q2, _2q3, _4q0, _4q1, _4q2, _8q1, _8q2, q0q0, q1q1, q2q2, q3q3;
+
+			// Rate of change of quaternion from gyroscope
+			qDot1 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
+			qDot2 = 0.5f * (q0 * gx + q2 * gz - q3 * gy);
+			qDot3 = 0.5f * (q0 * gy - q1 * gz + q3 * gx);
+			qDot4 = 0.5f * (q0 * gz + q1 * gy - q2 * gx);
+
+			// Compute feedback only if accelerometer measurement valid (avoids NaN in accelerometer normalisation)
+			if (!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f)) && accelWeight > 0.0f)
+			{
+
+				// Normalise accelerometer measurement
+				recipNorm = InvSqrt(ax * ax + ay * ay + az * az);
+				ax *= recipNorm;
+				ay *= recipNorm;
+				az *= recipNorm;
+
+				// Auxiliary variables to avoid repeated arithmetic
+				_2q0 = 2.0f * q0;
+				_2q1 = 2.0f * q1;
+				_2q2 = 2.0f * q2;
+				_2q3 = 2.0f * q3;
+				_4q0 = 4.0f * q0;
+				_4q1 = 4.0f * q1;
+				_4q2 = 4.0f * q2;
+				_8q1 = 8.0f * q1;
+				_8q2 = 8.0f * q2;
+				q0q0 = q0 * q0;
+				q1q1 = q1 * q1;
+				q2q2 = q2 * q2;
+				q3q3 = q3 * q3;
+
+				// Gradient decent algorithm corrective step
+				s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+				s1 = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * q1 - _2q0 * ay - _4q1 + _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
+				s2 = 4.0f * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 + _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
+				s3 = 4.0f * q1q1 * q3 - _2q1 * ax + 4.0f * q2q2 * q3 - _2q2 * ay;
+				float sNormSq = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+				if (sNormSq > 0.0f)
+				{
+					recipNorm = InvSqrt(sNormSq); // normalise step magnitude
+					s0 *= recipNorm;
+					s1 *= recipNorm;
+					s2 *= recipNorm;
+					s3 *= recipNorm;
+
+					// Apply feedback step
+					float gain = beta * accelWeight;
+					qDot1 -= gain * s0;
+					qDot2 -= gain * s1;
+					qDot3 -= gain * s2;
+					qDot4 -= gain * s3;
+				}
+			}
+
+			if (exactIntegration)
+			{
+				// 角速度の分を厳密に回し，補正の分だけを1次で足す
+				float gyroDot1 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
+				float gyroDot2 = 0.5f * (q0 * gx + q2 * gz - q3 * gy);
+				float gyroDot3 = 0.5f * (q0 * gy - q1 * gz + q3 * gx);
+				float gyroDot4 = 0.5f * (q0 * gz + q1 * gy - q2 * gx);
+				qDot1 -= gyroDot1;
+				qDot2 -= gyroDot2;
+				qDot3 -= gyroDot3;
+				qDot4 -= gyroDot4;
+				gyro::GyroIntegrator::Integrate(gx, gy, gz, dt, q0, q1, q2, q3);
+			}
+
+			// Integrate rate of change of quaternion to yield quaternion
+			q0 += qDot1 * dt;
+			q1 += qDot2 * dt;
+			q2 += qDot3 * dt;
+			q3 += qDot4 * dt;
+
+			// Normalise quaternion
+			recipNorm = InvSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+			q0 *= recipNorm;
+			q1 *= recipNorm;
+			q2 *= recipNorm;
+			q3 *= recipNorm;
+		}
+
+	} // madgwick
+} // imu
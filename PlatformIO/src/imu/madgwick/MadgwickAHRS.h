@@ -0,0 +1,37 @@
+#pragma once
+#include "../FusionFilter.h"
+
+namespace imu
+{
+    namespace madgwick
+    {
+
+        static const float DefaultBeta = 0.1f; // 2 * proportional gain
+
+        /**
+         * @brief Madgwickの勾配降下法による姿勢推定 (地磁気なし)
+         */
+        class MadgwickAHRS : public FusionFilter
+        {
+        public:
+            explicit MadgwickAHRS(float beta = DefaultBeta);
+
+            void UpdateQuaternion(
+                float gx, float gy, float gz,
+                float ax, float ay, float az,
+                float dt,
+                float &q0, float &q1, float &q2, float &q3) override;
+
+            void SetBeta(float beta) { this->beta = beta; }
+            void SetAccelWeight(float weight) override { accelWeight = weight; }
+            void SetExactIntegration(bool exact) override { exactIntegration = exact; }
+            float GetBeta() const { return beta; }
+
+        private:
+            float beta;
+            float accelWeight;     // 加速度による補正の重み (0〜1)
+            bool exactIntegration; // true: 角速度の分は指数写像で積分する
+        };
+
+    } // madgwick
+} // imu
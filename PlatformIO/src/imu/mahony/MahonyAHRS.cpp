@@ -12,25 +12,47 @@
 //=====================================================================================================
 // from https://github.com/m5stack/M5StickC/blob/master/src/utility/MahonyAHRS.cpp
 
+#include <inttypes.h>
 #include <math.h>
-#include <M5StickC.h>
+#include <string.h>
 #include "MahonyAHRS.h"
-
-#define sampleFreq 200.0f	   // sample frequency in Hz
-#define twoKpDef (2.0f * 1.0f) // 2 * proportional gain
-#define twoKiDef (2.0f * 0.0f) // 2 * integral gain
+#include "../gyro/GyroIntegrator.h"
 
 namespace imu
 {
 	namespace mahony
 	{
+		static const float RadToDeg = 57.29577951f;
+
+		static float invSqrt(float x);
 
-		volatile float twoKp = twoKpDef; // 2 * proportional gain (Kp)
-		volatile float twoKi = twoKiDef; // 2 * integral gain (Ki)
-		// volatile float q0 = 1.0, q1 = 0.0, q2 = 0.0, q3 = 0.0;					// quaternion of sensor frame relative to auxiliary frame
-		volatile float integralFBx = 0.0f, integralFBy = 0.0f, integralFBz = 0.0f; // integral error terms scaled by Ki
+		MahonyAHRS::MahonyAHRS(float kp, float ki)
+			: twoKp(2.0f * kp), twoKi(2.0f * ki),
+			  integralFBx(0.0f), integralFBy(0.0f), integralFBz(0.0f), accelWeight(1.0f),
+			  exactIntegration(false)
+		{
+		}
+
+		/**
+		 * @brief フィードバックゲインを変更する
+		 *
+		 * @param kp 比例ゲイン
+		 * @param ki 積分ゲイン
+		 */
+		void MahonyAHRS::SetGains(float kp, float ki)
+		{
+			twoKp = 2.0f * kp;
+			twoKi = 2.0f * ki;
+		}
 
-		void MahonyAHRS::UpdateQuaternion(float gx, float gy, float gz, float ax, float ay, float az, float &q0, float &q1, float &q2, float &q3)
+		void MahonyAHRS::ResetIntegral()
+		{
+			integralFBx = 0.0f;
+			integralFBy = 0.0f;
+			integralFBz = 0.0f;
+		}
+
+		void MahonyAHRS::UpdateQuaternion(float gx, float gy, float gz, float ax, float ay, float az, float dt, float &q0, float &q1, float &q2, float &q3)
 		{
 			float recipNorm;
 			float halfvx, halfvy, halfvz;
@@ -38,7 +60,8 @@ namespace imu
 			float qa, qb, qc;
 
 			// Compute feedback only if accelerometer measurement valid (avoids NaN in accelerometer normalisation)
-			if (!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f)))
+			// 重み0 (高速回転中) は積分項を保ったまま角速度のみで進める
+			if (!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f)) && accelWeight > 0.0f)
 			{
 
 				// Normalise accelerometer measurement
@@ -56,13 +79,16 @@ namespace imu
 				halfex = (ay * halfvz - az * halfvy);
 				halfey = (az * halfvx - ax * halfvz);
 				halfez = (ax * halfvy - ay * halfvx);
+				halfex *= accelWeight;
+				halfey *= accelWeight;
+				halfez *= accelWeight;
 
 				// Compute and apply integral feedback if enabled
 				if (twoKi > 0.0f)
 				{
-					integralFBx += twoKi * halfex * (1.0f / sampleFreq); // integral error scaled by Ki
-					integralFBy += twoKi * halfey * (1.0f / sampleFreq);
-					integralFBz += twoKi * halfez * (1.0f / sampleFreq);
+					integralFBx += twoKi * halfex * dt; // integral error scaled by Ki
+					integralFBy += twoKi * halfey * dt;
+					integralFBz += twoKi * halfez * dt;
 					gx += integralFBx; // apply integral feedback
 					gy += integralFBy;
 					gz += integralFBz;
@@ -80,10 +106,16 @@ namespace imu
 				gz += twoKp * halfez;
 			}
 
+			if (exactIntegration)
+			{
+				gyro::GyroIntegrator::Integrate(gx, gy, gz, dt, q0, q1, q2, q3);
+				return;
+			}
+
 			// Integrate rate of change of quaternion
-			gx *= (0.5f * (1.0f / sampleFreq)); // pre-multiply common factors
-			gy *= (0.5f * (1.0f / sampleFreq));
-			gz *= (0.5f * (1.0f / sampleFreq));
+			gx *= (0.5f * dt); // pre-multiply common factors
+			gy *= (0.5f * dt);
+			gz *= (0.5f * dt);
 			qa = q0;
 			qb = q1;
 			qc = q2;
@@ -106,8 +138,8 @@ namespace imu
 			roll = atan2(2 * q2 * q3 + 2 * q0 * q1, -2 * q1 * q1 - 2 * q2 * q2 + 1);	 // roll
 			yaw = atan2(2 * (q1 * q2 + q0 * q3), q0 * q0 + q1 * q1 - q2 * q2 - q3 * q3); // yaw
 
-			pitch *= RAD_TO_DEG;
-			yaw *= RAD_TO_DEG;
+			pitch *= RadToDeg;
+			yaw *= RadToDeg;
 			// Declination of SparkFun Electronics (40°05'26.6"N 105°11'05.9"W) is
 			// 	8° 30' E  ± 0° 21' (or 8.5°) on 2016-07-19
 			// - http://www.ngdc.noaa.gov/geomag-web/#declination
@@ -116,22 +148,21 @@ namespace imu
 			// 7° 48' W  ± 0° 19'  changing by  0° 4' W per year
 			// yaw += 7.6; // -= 8.5 to += 7.6
 			yaw -= 8.5;
-			roll *= RAD_TO_DEG;
+			roll *= RadToDeg;
 		}
 
 		//---------------------------------------------------------------------------------------------------
 		// Fast inverse square-root
 		// See: http://en.wikipedia.org/wiki/Fast_inverse_square_root
 
-		float invSqrt(float x)
+		static float invSqrt(float x)
 		{
 			float halfx = 0.5f * x;
 			float y = x;
-#pragma GCC diagnostic ignored "-Wstrict-aliasing"
-			long i = *(long *)&y;
+			int32_t i; // ESP32のlongと同じ32bit．ホストでも同じ結果になる
+			memcpy(&i, &y, sizeof(i));
 			i = 0x5f3759df - (i >> 1);
-			y = *(float *)&i;
-#pragma GCC diagnostic warning "-Wstrict-aliasing"
+			memcpy(&y, &i, sizeof(y));
 			y = y * (1.5f - (halfx * y * y));
 			return y;
 		}
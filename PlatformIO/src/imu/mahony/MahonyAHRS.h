@@ -4,22 +4,45 @@
 #undef imu
 #endif
 
+#include "../FusionFilter.h"
+
 namespace imu
 {
     namespace mahony
     {
 
-        class MahonyAHRS
+        static const float DefaultKp = 1.0f; // proportional gain
+        static const float DefaultKi = 0.0f; // integral gain
+
+        class MahonyAHRS : public FusionFilter
         {
         public:
+            explicit MahonyAHRS(float kp = DefaultKp, float ki = DefaultKi);
+
             void UpdateQuaternion(
                 float gx, float gy, float gz,
                 float ax, float ay, float az,
-                float &q0, float &q1, float &q2, float &q3);
+                float dt,
+                float &q0, float &q1, float &q2, float &q3) override;
 
             void QuaternionToEuler(
                 float q0, float q1, float q2, float q3,
                 float &pitch, float &roll, float &yaw);
+
+            void SetGains(float kp, float ki);
+            float GetKp() const { return 0.5f * twoKp; }
+            float GetKi() const { return 0.5f * twoKi; }
+            void ResetIntegral();
+            void Reset() override { ResetIntegral(); }
+            void SetAccelWeight(float weight) override { accelWeight = weight; }
+            void SetExactIntegration(bool exact) override { exactIntegration = exact; }
+
+        private:
+            float twoKp;                                 // 2 * proportional gain (Kp)
+            float twoKi;                                 // 2 * integral gain (Ki)
+            float integralFBx, integralFBy, integralFBz; // integral error terms scaled by Ki
+            float accelWeight;                           // 加速度による補正の重み (0〜1)
+            bool exactIntegration;                       // true: 指数写像で積分する
         };
 
     } // mahony
@@ -0,0 +1,68 @@
+#include "EspTimerSampleClock.h"
+
+namespace imu
+{
+    namespace sampling
+    {
+
+        EspTimerSampleClock::EspTimerSampleClock() : timer(NULL), waiter(NULL), lastTick(0) {}
+
+        EspTimerSampleClock::~EspTimerSampleClock()
+        {
+            stop();
+            if (timer != NULL)
+                esp_timer_delete(timer);
+        }
+
+        /**
+         * @brief 周期タイマを動かす．呼び出したタスクを起床先にする
+         *
+         * @param periodMicros 周期[us]
+         * @return true 正常終了
+         * @return false 異常終了 タイマを作れない
+         */
+        bool EspTimerSampleClock::start(uint32_t periodMicros)
+        {
+            if (timer == NULL)
+            {
+                esp_timer_create_args_t args = {};
+                args.callback = OnTimer;
+                args.arg = this;
+                args.dispatch_method = ESP_TIMER_TASK;
+                args.name = "imu_sample";
+                if (esp_timer_create(&args, &timer) != ESP_OK)
+                {
+                    timer = NULL;
+                    return false;
+                }
+            }
+            stop();
+            waiter = xTaskGetCurrentTaskHandle();
+            ulTaskNotifyTake(pdTRUE, 0); // 前の周期の通知を捨てる
+            lastTick = micros();
+            return esp_timer_start_periodic(timer, periodMicros) == ESP_OK;
+        }
+
+        void EspTimerSampleClock::stop()
+        {
+            if (timer != NULL)
+                esp_timer_stop(timer); // 止まっているときは ESP_ERR_INVALID_STATE が返るだけ
+        }
+
+        uint32_t EspTimerSampleClock::waitTicks(uint32_t timeoutMicros)
+        {
+            TickType_t timeout = pdMS_TO_TICKS((timeoutMicros + 999) / 1000);
+            return ulTaskNotifyTake(pdTRUE, (timeout > 0) ? timeout : 1);
+        }
+
+        void EspTimerSampleClock::OnTimer(void *arg)
+        {
+            EspTimerSampleClock *self = (EspTimerSampleClock *)arg;
+            self->lastTick = micros();
+            TaskHandle_t task = self->waiter;
+            if (task != NULL)
+                xTaskNotifyGive(task);
+        }
+
+    } // sampling
+} // imu
@@ -0,0 +1,35 @@
+#pragma once
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "SampleClock.h"
+
+namespace imu
+{
+    namespace sampling
+    {
+
+        /**
+         * @brief esp_timerの周期タイマでタスクを起こすクロック
+         * @brief コールバックは esp_timer タスクで動き，タスク通知で待っているタスクを起こす
+         * @brief 待つタスクの通知値を使うため，そのタスクにはほかから xTaskNotify しないこと
+         */
+        class EspTimerSampleClock : public SampleClock
+        {
+        public:
+            explicit EspTimerSampleClock();
+            ~EspTimerSampleClock();
+            bool start(uint32_t periodMicros);
+            void stop();
+            uint32_t waitTicks(uint32_t timeoutMicros);
+            uint32_t lastTickMicros() const { return lastTick; }
+            uint32_t nowMicros() const { return micros(); }
+
+        private:
+            esp_timer_handle_t timer;
+            volatile TaskHandle_t waiter;
+            volatile uint32_t lastTick;
+            static void OnTimer(void *arg);
+        };
+
+    } // sampling
+} // imu
@@ -0,0 +1,45 @@
+#pragma once
+#include <inttypes.h>
+
+namespace imu
+{
+    namespace sampling
+    {
+
+        /**
+         * @brief サンプリング周期を刻むタイマ．ImuLoopは waitTicks() で次の周期まで眠る
+         * @brief 実機では EspTimerSampleClock，ホストでは時刻を進めるだけの偽物を使う
+         */
+        class SampleClock
+        {
+        public:
+            virtual ~SampleClock() {}
+            /**
+             * @brief 周期[us]でタイマを動かす．waitTicks() を呼ぶタスクから呼ぶこと
+             */
+            virtual bool start(uint32_t periodMicros) = 0;
+            virtual void stop() = 0;
+            /**
+             * @brief 次の周期まで待つ
+             *
+             * @param timeoutMicros 最長の待ち時間[us]
+             * @return uint32_t 前回から経過した周期の数．0: タイムアウト，2以上: 処理が周期に間に合わなかった
+             */
+            virtual uint32_t waitTicks(uint32_t timeoutMicros) = 0;
+            virtual uint32_t lastTickMicros() const = 0; // 直近の周期の開始時刻[us]
+            virtual uint32_t nowMicros() const = 0;
+        };
+
+        /**
+         * @brief 実測の経過時間[us]を周期の数に丸める．起床の遅れで dt が揺れないようにするために使う
+         *
+         * @return uint32_t 1以上の周期数
+         */
+        inline uint32_t ElapsedTicks(uint32_t elapsedMicros, uint32_t periodMicros)
+        {
+            uint32_t ticks = (elapsedMicros + periodMicros / 2) / periodMicros;
+            return (ticks > 0) ? ticks : 1;
+        }
+
+    } // sampling
+} // imu
@@ -0,0 +1,77 @@
+#include "SamplePacer.h"
+
+namespace imu
+{
+    namespace sampling
+    {
+
+        SamplePacer::SamplePacer(SampleClock &clock)
+            : clock(clock), rateHz(0), period(0), lastTicks(0), tickStamp(0), wakeLatency(0),
+              overrunCount(0), timeoutCount(0)
+        {
+        }
+
+        bool SamplePacer::IsSupportedRate(uint16_t rateHz)
+        {
+            for (int i = 0; i < SampleRateNum; i++)
+            {
+                if (SampleRates[i] == rateHz)
+                    return true;
+            }
+            return false;
+        }
+
+        /**
+         * @brief サンプリング周波数を変える．waitNext() を呼ぶタスクから呼ぶこと
+         *
+         * @param rateHz SampleRates のいずれか．0: タイマを止める
+         * @return true 正常終了
+         * @return false 異常終了 対応していない周波数かタイマを動かせない
+         */
+        bool SamplePacer::setRate(uint16_t rateHz)
+        {
+            if (rateHz != 0 && !IsSupportedRate(rateHz))
+                return false;
+            clock.stop();
+            this->rateHz = 0;
+            period = 0;
+            lastTicks = 0;
+            if (rateHz == 0)
+                return true;
+            uint32_t periodMicros = 1000000UL / rateHz;
+            if (!clock.start(periodMicros))
+                return false;
+            this->rateHz = rateHz;
+            period = periodMicros;
+            tickStamp = clock.lastTickMicros();
+            return true;
+        }
+
+        /**
+         * @brief 次の周期まで待つ．周期の開始時刻は tickMicros() で得られる
+         * @brief 起床の遅れを含まないため，サンプルの時刻に使えば間隔は周期の整数倍に揃う
+         *
+         * @return true 周期が来た
+         * @return false 停止中またはタイムアウト (タイマが止まっている)
+         */
+        bool SamplePacer::waitNext()
+        {
+            if (rateHz == 0)
+                return false;
+            // タイマが止まってもタスクが戻ってこられるように，数周期分で諦める
+            uint32_t ticks = clock.waitTicks(period * 4);
+            if (ticks == 0)
+            {
+                timeoutCount++;
+                tickStamp = clock.nowMicros();
+                return false;
+            }
+            lastTicks = ticks;
+            overrunCount += ticks - 1;
+            tickStamp = clock.lastTickMicros();
+            wakeLatency = clock.nowMicros() - tickStamp;
+            return true;
+        }
+
+    } // sampling
+} // imu
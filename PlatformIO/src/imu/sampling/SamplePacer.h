@@ -0,0 +1,44 @@
+#pragma once
+#include <inttypes.h>
+#include "SampleClock.h"
+
+namespace imu
+{
+    namespace sampling
+    {
+
+        static const uint16_t SampleRates[] = {200, 400, 1000}; // 選べるサンプリング周波数[Hz]
+        static const int SampleRateNum = sizeof(SampleRates) / sizeof(SampleRates[0]);
+
+        /**
+         * @brief SampleClockでImuLoopの周期を刻み，周期の取りこぼしと起床の遅れを数える
+         * @brief setRate() と waitNext() は同じタスク (ImuLoop) から呼ぶ
+         */
+        class SamplePacer
+        {
+        public:
+            explicit SamplePacer(SampleClock &clock);
+            bool setRate(uint16_t rateHz);
+            uint16_t rate() const { return rateHz; }
+            uint32_t periodMicros() const { return period; }
+            bool waitNext();
+            uint32_t ticks() const { return lastTicks; }
+            uint32_t tickMicros() const { return tickStamp; }
+            uint32_t wakeLatencyMicros() const { return wakeLatency; }
+            uint32_t overruns() const { return overrunCount; }
+            uint32_t timeouts() const { return timeoutCount; }
+            static bool IsSupportedRate(uint16_t rateHz);
+
+        private:
+            SampleClock &clock;
+            uint16_t rateHz; // 0: 停止中
+            uint32_t period;
+            uint32_t lastTicks;
+            uint32_t tickStamp; // 今回の周期の開始時刻[us]．サンプルの時刻として使う
+            uint32_t wakeLatency;
+            uint32_t overrunCount; // 取りこぼした周期の累計
+            uint32_t timeoutCount;
+        };
+
+    } // sampling
+} // imu
@@ -0,0 +1,138 @@
+#include <math.h>
+#include <string.h>
+#include "TraceFormat.h"
+
+namespace imu
+{
+    namespace trace
+    {
+
+        static void PutU16(uint8_t *p, uint16_t v)
+        {
+            p[0] = (uint8_t)v;
+            p[1] = (uint8_t)(v >> 8);
+        }
+
+        static void PutU32(uint8_t *p, uint32_t v)
+        {
+            p[0] = (uint8_t)v;
+            p[1] = (uint8_t)(v >> 8);
+            p[2] = (uint8_t)(v >> 16);
+            p[3] = (uint8_t)(v >> 24);
+        }
+
+        static uint16_t GetU16(const uint8_t *p)
+        {
+            return (uint16_t)(p[0] | (uint16_t)p[1] << 8);
+        }
+
+        static uint32_t GetU32(const uint8_t *p)
+        {
+            return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+        }
+
+        static int16_t Quantize(float value, float lsb)
+        {
+            float scaled = roundf(value * lsb);
+            if (scaled > 32767.0F)
+                return 32767;
+            if (scaled < -32768.0F)
+                return -32768;
+            return (int16_t)scaled;
+        }
+
+        /**
+         * @brief 記録ストリームの先頭に置くヘッダを書き込む
+         *
+         * @param header ヘッダ
+         * @param out 書き込み先 (TraceHeaderLen byte以上)
+         * @return size_t 書き込んだバイト数
+         */
+        size_t EncodeHeader(const TraceHeader &header, uint8_t *out)
+        {
+            memcpy(out, "KBTR", 4);
+            out[4] = TraceVersion;
+            out[5] = 0;
+            PutU16(out + 6, header.sampleRateHz);
+            for (int i = 0; i < 3; i++)
+            {
+                uint32_t bits;
+                memcpy(&bits, &header.gyroOffset[i], sizeof(bits));
+                PutU32(out + 8 + i * 4, bits);
+            }
+            return TraceHeaderLen;
+        }
+
+        /**
+         * @brief ヘッダを読み込む
+         *
+         * @return true 正常終了
+         * @return false 異常終了 ヘッダではないかバージョンが異なる
+         */
+        bool DecodeHeader(const uint8_t *in, size_t len, TraceHeader &outHeader)
+        {
+            if (len < TraceHeaderLen || memcmp(in, "KBTR", 4) != 0 || in[4] != TraceVersion)
+            {
+                return false;
+            }
+            outHeader.sampleRateHz = GetU16(in + 6);
+            for (int i = 0; i < 3; i++)
+            {
+                uint32_t bits = GetU32(in + 8 + i * 4);
+                memcpy(&outHeader.gyroOffset[i], &bits, sizeof(bits));
+            }
+            return true;
+        }
+
+        /**
+         * @brief サンプル群の前に置くチャンクヘッダを書き込む
+         *
+         * @param count 続くサンプル数
+         * @param seq チャンクの通し番号．受信側で欠落を検出するのに使う
+         * @param out 書き込み先 (TraceChunkHeaderLen byte以上)
+         * @return size_t 書き込んだバイト数
+         */
+        size_t EncodeChunkHeader(uint8_t count, uint32_t seq, uint8_t *out)
+        {
+            out[0] = 'K';
+            out[1] = 'C';
+            out[2] = count;
+            out[3] = 0;
+            PutU32(out + 4, seq);
+            return TraceChunkHeaderLen;
+        }
+
+        bool DecodeChunkHeader(const uint8_t *in, size_t len, uint8_t &outCount, uint32_t &outSeq)
+        {
+            if (len < TraceChunkHeaderLen || in[0] != 'K' || in[1] != 'C')
+            {
+                return false;
+            }
+            outCount = in[2];
+            outSeq = GetU32(in + 4);
+            return true;
+        }
+
+        size_t EncodeSample(const TraceSample &sample, uint8_t *out)
+        {
+            PutU32(out, sample.timestamp);
+            for (int i = 0; i < 3; i++)
+            {
+                PutU16(out + 4 + i * 2, (uint16_t)Quantize(sample.acc[i], TraceAccelLsbPerG));
+                PutU16(out + 10 + i * 2, (uint16_t)Quantize(sample.gyro[i], TraceGyroLsbPerDps));
+            }
+            return TraceSampleLen;
+        }
+
+        void DecodeSample(const uint8_t *in, TraceSample &outSample)
+        {
+            outSample.timestamp = GetU32(in);
+            for (int i = 0; i < 3; i++)
+            {
+                outSample.acc[i] = (int16_t)GetU16(in + 4 + i * 2) / TraceAccelLsbPerG;
+                outSample.gyro[i] = (int16_t)GetU16(in + 10 + i * 2) / TraceGyroLsbPerDps;
+            }
+        }
+
+    } // trace
+} // imu
@@ -0,0 +1,47 @@
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+
+namespace imu
+{
+    namespace trace
+    {
+        // 記録ストリームの構成 (全てリトルエンディアン)
+        //   TraceHeader  : "KBTR" version(u8) reserved(u8) sampleRateHz(u16) gyroOffset(f32 * 3)  = 20byte
+        //   TraceChunk   : "KC" count(u8) reserved(u8) seq(u32) + TraceSample * count
+        //   TraceSample  : timestamp[us](u32) acc(i16 * 3) gyro(i16 * 3)                       = 16byte
+        // acc/gyroはセンサの生値と同じ分解能 (±8g, ±2000dps の16bit) で量子化する
+
+        static const uint8_t TraceVersion = 1;
+        static const size_t TraceHeaderLen = 20;
+        static const size_t TraceChunkHeaderLen = 8;
+        static const size_t TraceSampleLen = 16;
+        static const int TraceChunkMaxSamples = 32;
+        static const size_t TraceChunkMaxLen = TraceChunkHeaderLen + TraceSampleLen * TraceChunkMaxSamples;
+        static const float TraceAccelLsbPerG = 4096.0F;
+        static const float TraceGyroLsbPerDps = 16.4F;
+
+        struct TraceHeader
+        {
+        public:
+            uint16_t sampleRateHz; // 公称サンプリング周波数 (実際の間隔はtimestampを使う)
+            float gyroOffset[3];   // 記録時に差し引かれていたジャイロオフセット[deg/s]
+        };
+
+        struct TraceSample
+        {
+        public:
+            uint32_t timestamp; // [us]
+            float acc[3];       // [g]
+            float gyro[3];      // [deg/s]
+        };
+
+        size_t EncodeHeader(const TraceHeader &header, uint8_t *out);
+        bool DecodeHeader(const uint8_t *in, size_t len, TraceHeader &outHeader);
+        size_t EncodeChunkHeader(uint8_t count, uint32_t seq, uint8_t *out);
+        bool DecodeChunkHeader(const uint8_t *in, size_t len, uint8_t &outCount, uint32_t &outSeq);
+        size_t EncodeSample(const TraceSample &sample, uint8_t *out);
+        void DecodeSample(const uint8_t *in, TraceSample &outSample);
+
+    } // trace
+} // imu
@@ -0,0 +1,99 @@
+#include "TraceRecorder.h"
+
+namespace imu
+{
+    namespace trace
+    {
+
+        TraceRecorder::TraceRecorder() : recording(false), headerPending(false), seq(0)
+        {
+            memset(&header, 0, sizeof(header));
+        }
+
+        /**
+         * @brief 記録を開始する．次の drain() でヘッダから出力する
+         *
+         * @param header ストリームの先頭に書き込むヘッダ
+         */
+        void TraceRecorder::start(const TraceHeader &header)
+        {
+            recording.store(false, std::memory_order_release);
+            ring.clear();
+            this->header = header;
+            headerPending = true;
+            seq = 0;
+            recording.store(true, std::memory_order_release);
+        }
+
+        /**
+         * @brief 記録を終了する．溜まっている分は drain() で取り出せる
+         */
+        void TraceRecorder::stop()
+        {
+            recording.store(false, std::memory_order_release);
+        }
+
+        /**
+         * @brief 1サンプルを記録する．記録中でなければ何もしない
+         *
+         * @param imuData 記録するIMUデータ
+         */
+        void TraceRecorder::push(const ImuData &imuData)
+        {
+            if (!recording.load(std::memory_order_acquire))
+            {
+                return;
+            }
+            TraceSample sample;
+            sample.timestamp = imuData.timestamp;
+            for (int i = 0; i < 3; i++)
+            {
+                sample.acc[i] = imuData.acc[i];
+                sample.gyro[i] = imuData.gyro[i];
+            }
+            ring.push(sample);
+        }
+
+        /**
+         * @brief 記録ストリームの続きを書き出す．未出力のヘッダがあれば先に書き出す
+         *
+         * @param out 書き込み先
+         * @param capacity outのバイト数 (TraceHeaderLen + TraceChunkMaxLen 以上を推奨)
+         * @return size_t 書き込んだバイト数．0なら出力するものがない
+         */
+        size_t TraceRecorder::drain(uint8_t *out, size_t capacity)
+        {
+            size_t len = 0;
+            if (headerPending)
+            {
+                if (capacity < TraceHeaderLen)
+                    return 0;
+                len += EncodeHeader(header, out);
+                headerPending = false;
+            }
+            if (capacity - len < TraceChunkHeaderLen + TraceSampleLen)
+            {
+                return len;
+            }
+
+            size_t maxSamples = (capacity - len - TraceChunkHeaderLen) / TraceSampleLen;
+            if (maxSamples > (size_t)TraceChunkMaxSamples)
+                maxSamples = TraceChunkMaxSamples;
+            uint8_t *chunk = out + len;
+            size_t count = 0;
+            TraceSample sample;
+            while (count < maxSamples && ring.pop(sample))
+            {
+                EncodeSample(sample, chunk + TraceChunkHeaderLen + count * TraceSampleLen);
+                count++;
+            }
+            if (count == 0)
+            {
+                return len;
+            }
+            EncodeChunkHeader((uint8_t)count, seq++, chunk);
+            return len + TraceChunkHeaderLen + count * TraceSampleLen;
+        }
+
+    } // trace
+} // imu
@@ -0,0 +1,38 @@
+#pragma once
+#include <atomic>
+#include "../../concurrent/SpscRing.h"
+#include "../ImuData.h"
+#include "TraceFormat.h"
+
+namespace imu
+{
+    namespace trace
+    {
+
+        static const int TraceBufferSize = 256; // 1kHzでも256[ms]分．2のべき乗にする
+
+        /**
+         * @brief ImuLoopのサンプルを記録ストリームに変換する
+         * @brief push() はIMUタスク，start()/stop()/drain() は送信タスクから呼ぶ
+         */
+        class TraceRecorder
+        {
+        public:
+            explicit TraceRecorder();
+            void start(const TraceHeader &header);
+            void stop();
+            bool isRecording() const { return recording.load(std::memory_order_acquire); }
+            void push(const ImuData &imuData);
+            size_t drain(uint8_t *out, size_t capacity);
+            uint32_t dropped() const { return ring.dropped(); }
+
+        private:
+            concurrent::SpscRing<TraceSample, TraceBufferSize> ring;
+            std::atomic<bool> recording;
+            TraceHeader header;
+            bool headerPending;
+            uint32_t seq;
+        };
+
+    } // trace
+} // imu
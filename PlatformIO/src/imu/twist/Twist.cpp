@@ -0,0 +1,262 @@
+#include <math.h>
+#include "Twist.h"
+
+namespace imu
+{
+    namespace twist
+    {
+        static const float RadToDeg = 57.29577951F;
+
+        // クォータニオンは全て w, x, y, z の順で扱う
+        static void Multiply(const float *a, const float *b, float *out)
+        {
+            float w = a[0] * b[0] - a[1] * b[1] - a[2] * b[2] - a[3] * b[3];
+            float x = a[0] * b[1] + a[1] * b[0] + a[2] * b[3] - a[3] * b[2];
+            float y = a[0] * b[2] - a[1] * b[3] + a[2] * b[0] + a[3] * b[1];
+            float z = a[0] * b[3] + a[1] * b[2] - a[2] * b[1] + a[3] * b[0];
+            out[0] = w;
+            out[1] = x;
+            out[2] = y;
+            out[3] = z;
+        }
+
+        static void Inverse(const float *q, float *out)
+        {
+            float normSq = q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3];
+            float recip = (normSq > 0.0F) ? 1.0F / normSq : 0.0F;
+            out[0] = q[0] * recip;
+            out[1] = -q[1] * recip;
+            out[2] = -q[2] * recip;
+            out[3] = -q[3] * recip;
+        }
+
+        static void Rotate(const float *q, const float *v, float *out)
+        {
+            // v' = v + 2w(u x v) + 2u x (u x v), u = (x, y, z)
+            float tx = 2.0F * (q[2] * v[2] - q[3] * v[1]);
+            float ty = 2.0F * (q[3] * v[0] - q[1] * v[2]);
+            float tz = 2.0F * (q[1] * v[1] - q[2] * v[0]);
+            out[0] = v[0] + q[0] * tx + (q[2] * tz - q[3] * ty);
+            out[1] = v[1] + q[0] * ty + (q[3] * tx - q[1] * tz);
+            out[2] = v[2] + q[0] * tz + (q[1] * ty - q[2] * tx);
+        }
+
+        static float Dot(const float *a, const float *b)
+        {
+            return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+        }
+
+        /**
+         * @brief 単位ベクトルaからbへの最小回転を求める (Unity Quaternion.FromToRotation 相当)
+         */
+        static void FromToRotation(const float *a, const float *b, float *out)
+        {
+            float d = Dot(a, b);
+            if (d < -0.999999F)
+            {
+                // 逆向きの場合はaに垂直な任意の軸で180°回転する
+                float px = 0.0F, py = -a[2], pz = a[1]; // a x (1, 0, 0)
+                if (py * py + pz * pz < 1e-6F)
+                {
+                    px = a[2]; // a x (0, 1, 0)
+                    py = 0.0F;
+                    pz = -a[0];
+                }
+                float recipNorm = 1.0F / sqrtf(px * px + py * py + pz * pz);
+                out[0] = 0.0F;
+                out[1] = px * recipNorm;
+                out[2] = py * recipNorm;
+                out[3] = pz * recipNorm;
+                return;
+            }
+            out[0] = 1.0F + d;
+            out[1] = a[1] * b[2] - a[2] * b[1];
+            out[2] = a[2] * b[0] - a[0] * b[2];
+            out[3] = a[0] * b[1] - a[1] * b[0];
+            float recipNorm = 1.0F / sqrtf(out[0] * out[0] + out[1] * out[1] + out[2] * out[2] + out[3] * out[3]);
+            for (int i = 0; i < 4; i++)
+                out[i] *= recipNorm;
+        }
+
+        /**
+         * @brief クォータニオンを回転角[deg]と回転軸に分解する (Unity Quaternion.ToAngleAxis 相当)
+         */
+        static void ToAngleAxis(const float *q, float &angle, float *axis)
+        {
+            // acos(w)は単位元付近で精度が落ちるため，ベクトル部のノルムとatan2で角度を求める
+            float s = sqrtf(q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+            angle = 2.0F * atan2f(s, q[0]) * RadToDeg;
+            if (s < 1e-9F)
+            {
+                axis[0] = 1.0F;
+                axis[1] = 0.0F;
+                axis[2] = 0.0F;
+                return;
+            }
+            axis[0] = q[1] / s;
+            axis[1] = q[2] / s;
+            axis[2] = q[3] / s;
+        }
+
+        /**
+         * @brief raからrbへの回転から，軸axisに関するねじれ角を得る
+         * @brief Unity側 Twist.GetTwistAroundAxis の移植
+         *
+         * @param ra 起点の回転 (w, x, y, z)
+         * @param rb 終点の回転 (w, x, y, z)
+         * @param axis ねじれ軸 (正規化済み)
+         * @return float 軸axisに関する0°以上360°未満のねじれ角
+         */
+        float GetTwistAroundAxis(const float *ra, const float *rb, const float *axis)
+        {
+            // da、db、rab、rdadbを求める
+            float da[3], db[3];
+            float raInv[4], rab[4], rdadb[4];
+            Rotate(ra, axis, da);
+            Rotate(rb, axis, db);
+            Inverse(ra, raInv);
+            Multiply(rb, raInv, rab);
+            FromToRotation(da, db, rdadb);
+
+            // rdadbからrabへの回転を求めたのち、その軸と角度を抽出する
+            float rdadbInv[4], delta[4];
+            Inverse(rdadb, rdadbInv);
+            Multiply(rab, rdadbInv, delta);
+            float deltaAngle;
+            float deltaAxis[3];
+            ToAngleAxis(delta, deltaAngle, deltaAxis);
+
+            // dbとdeltaAxisは同一直線上にあるはずだが、向きは逆かもしれない
+            float deltaAngleSign = (Dot(db, deltaAxis) < 0.0F) ? -1.0F : 1.0F;
+
+            // 角度の符号を補正した上で0°～360°におさめて返す
+            float result = fmodf(deltaAngleSign * deltaAngle, 360.0F);
+            if (result < 0.0F)
+                result += 360.0F;
+            return result;
+        }
+
+        TwistContainer::TwistContainer() : totalTwistDegree(0.0), offset(0.0)
+        {
+            setAxis(0.0F, 0.0F, 1.0F);
+            resetPreviousRotation();
+        }
+
+        /**
+         * @brief ねじれ軸を設定する
+         */
+        void TwistContainer::setAxis(float x, float y, float z)
+        {
+            float normSq = x * x + y * y + z * z;
+            if (normSq == 0.0F)
+            {
+                z = 1.0F; // Unity側と同じく forward を既定とする
+                normSq = 1.0F;
+            }
+            float recipNorm = 1.0F / sqrtf(normSq);
+            axis[0] = x * recipNorm;
+            axis[1] = y * recipNorm;
+            axis[2] = z * recipNorm;
+        }
+
+        /**
+         * @brief 前回の回転からのねじれ角を累積する
+         *
+         * @param quat 現在の姿勢 (w, x, y, z)
+         */
+        void TwistContainer::updateTwistDegree(const float *quat)
+        {
+            float twist = GetTwistAroundAxis(previousRotation, quat, axis);
+            if (twist > 180.0F)
+                twist -= 360.0F; // 正負の回転方向がある
+
+            totalTwistDegree += twist;
+            for (int i = 0; i < 4; i++)
+                previousRotation[i] = quat[i];
+        }
+
+        int32_t TwistContainer::getTwistCount() const
+        {
+            return (int32_t)trunc((totalTwistDegree - offset) / 360.0);
+        }
+
+        double TwistContainer::getTotalTwistDegree(bool withOffset) const
+        {
+            return withOffset ? totalTwistDegree - offset : totalTwistDegree;
+        }
+
+        void TwistContainer::resetPreviousRotation()
+        {
+            previousRotation[0] = 1.0F;
+            previousRotation[1] = 0.0F;
+            previousRotation[2] = 0.0F;
+            previousRotation[3] = 0.0F;
+        }
+
+        void TwistContainer::resetTotalTwistDegree()
+        {
+            totalTwistDegree = 0.0;
+            offset = 0.0;
+        }
+
+        TwistCounter::TwistCounter()
+        {
+            containers[0].setAxis(1.0F, 0.0F, 0.0F);
+            containers[1].setAxis(0.0F, 1.0F, 0.0F);
+            containers[2].setAxis(0.0F, 0.0F, 1.0F);
+        }
+
+        /**
+         * @brief 最新の姿勢で各軸のねじれを更新する．IMUの更新毎に呼ぶこと
+         *
+         * @param quat 姿勢クォータニオン (w, x, y, z)
+         */
+        void TwistCounter::update(const float *quat)
+        {
+            for (int i = 0; i < TwistAxisNum; i++)
+                containers[i].updateTwistDegree(quat);
+        }
+
+        /**
+         * @brief オフセット適用後の累積角度と回転数を取得する
+         *
+         * @param outTwistData 取得した値を保存する変数のアドレス
+         */
+        void TwistCounter::read(TwistData &outTwistData) const
+        {
+            for (int i = 0; i < TwistAxisNum; i++)
+            {
+                outTwistData.totalDegree[i] = (float)containers[i].getTotalTwistDegree(true);
+                outTwistData.count[i] = containers[i].getTwistCount();
+            }
+        }
+
+        /**
+         * @brief 累積角度とオフセットを0に戻す
+         */
+        void TwistCounter::reset()
+        {
+            for (int i = 0; i < TwistAxisNum; i++)
+                containers[i].resetTotalTwistDegree();
+        }
+
+        /**
+         * @brief 前回の姿勢を単位クォータニオンに戻す．AHRSを初期化したときに呼ぶ
+         */
+        void TwistCounter::resetRotation()
+        {
+            for (int i = 0; i < TwistAxisNum; i++)
+                containers[i].resetPreviousRotation();
+        }
+
+        /**
+         * @brief 現在の累積角度をオフセットとして記録し，以降の回転数を0から数え直す
+         */
+        void TwistCounter::setOffset()
+        {
+            for (int i = 0; i < TwistAxisNum; i++)
+                containers[i].setOffset();
+        }
+
+    } // twist
+} // imu
@@ -0,0 +1,73 @@
+#pragma once
+#include <inttypes.h>
+
+namespace imu
+{
+    namespace twist
+    {
+
+        static const int TwistAxisNum = 3; // X, Y, Z
+
+        /**
+         * @brief 各軸周りの累積ねじれ角と回転数
+         */
+        struct TwistData
+        {
+        public:
+            float totalDegree[TwistAxisNum]; // オフセット適用後の累積角度[deg]
+            int32_t count[TwistAxisNum];     // オフセット適用後の回転数(0方向に切り捨て)
+
+            explicit TwistData()
+            {
+                for (int i = 0; i < TwistAxisNum; i++)
+                {
+                    totalDegree[i] = 0.0F;
+                    count[i] = 0;
+                }
+            }
+        };
+
+        float GetTwistAroundAxis(const float *ra, const float *rb, const float *axis);
+
+        /**
+         * @brief ある軸周りの回転角度及び回転数を保持する
+         * @brief Unity側 TwistGetter.TwistContainer の移植
+         */
+        class TwistContainer
+        {
+        public:
+            explicit TwistContainer();
+            void setAxis(float x, float y, float z);
+            void updateTwistDegree(const float *quat);
+            int32_t getTwistCount() const;
+            double getTotalTwistDegree(bool withOffset = false) const;
+            void setOffset() { offset = totalTwistDegree; }
+            void resetPreviousRotation();
+            void resetTotalTwistDegree();
+
+        private:
+            float axis[3];
+            float previousRotation[4]; // w, x, y, z
+            double totalTwistDegree;   // 長時間の積算で桁落ちしないようdoubleで保持する
+            double offset;
+        };
+
+        /**
+         * @brief X/Y/Z軸それぞれのねじれを積算する
+         */
+        class TwistCounter
+        {
+        public:
+            explicit TwistCounter();
+            void update(const float *quat);
+            void read(TwistData &outTwistData) const;
+            void reset();
+            void resetRotation();
+            void setOffset();
+
+        private:
+            TwistContainer containers[TwistAxisNum];
+        };
+
+    } // twist
+} // imu
@@ -14,96 +14,434 @@
  */
 
 #include <M5Unified.h>
-#include <ArduinoOSCWiFi.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
 #include "imu/ImuReader.h"
-#include "imu/AverageCalc.h"
+#include "imu/RunningStats.h"
+#include "imu/StillDetector.h"
+#include "imu/bias/TempBiasModel.h"
+#include "imu/gesture/GestureDetector.h"
+#include "imu/ImuDataBuffer.h"
+#include "imu/twist/Twist.h"
+#include "imu/trace/TraceRecorder.h"
+#include "imu/frame/QuatFrame.h"
+#include "imu/sampling/EspTimerSampleClock.h"
+#include "imu/sampling/SamplePacer.h"
+#include "concurrent/SeqLock.h"
+#include "osc/OscPacketWriter.h"
+#include "osc/ImuBundle.h"
+#include "osc/OscPreencodedMessage.h"
+#include "osc/SendScheduler.h"
+#include "osc/OscTransport.h"
+#include "osc/OscReceiver.h"
+#include "osc/OscDispatcher.h"
 #include "prefs/Settings.h"
+#include "prefs/SettingsService.h"
+#include "display/TextFrame.h"
+#include "stats/PipelineStats.h"
+#include "stats/TaskProfiler.h"
+#include "stats/BootProfile.h"
 
 #define TASK_DEFAULT_CORE_ID 1
+#ifndef TASK_LAYOUT_SINGLE_CORE
+#define TASK_CORE_SENSOR 1  // IMUの読み出しと姿勢推定 (ほかのタスクを置かない)
+#define TASK_CORE_SERVICE 0 // 通信 / 表示 / 保存 (WiFiスタックと同じコア)
+#else
+#define TASK_CORE_SENSOR TASK_DEFAULT_CORE_ID // -DTASK_LAYOUT_SINGLE_CORE で従来の配置に戻す (比較用)
+#define TASK_CORE_SERVICE TASK_DEFAULT_CORE_ID
+#endif
 #define TASK_STACK_DEPTH 4096UL
 #define TASK_NAME_IMU "IMUTask"
 #define TASK_NAME_SEND_OSC "SendOscTask"
 #define TASK_NAME_RECEIVE_OSC "ReceiveOscTask"
-#define TASK_NAME_NOTIFY "ReceiveOscTask"
+#define TASK_NAME_NOTIFY "NotifyTask"
+#define TASK_NAME_SETTINGS "SettingsTask"
+#define TASK_NAME_DISPLAY "DisplayTask"
 #define TASK_SLEEP_IMU 5           // = 1000[ms] / 200[Hz]
 #define TASK_SLEEP_SEND_OSC 33     // ~= 1000[ms] / 30[Hz]
-#define TASK_SLEEP_RECEIVE_OSC 100 // = 1000[ms] / 10[Hz]
+#define TASK_WAIT_RECEIVE_OSC 1000 // コマンド受信待ちの最長時間[ms]
+#define TASK_RETRY_RECEIVE_OSC 500 // 受信ポートを開けない / 待てないときに開き直すまでの時間[ms]
 #define TASK_SLEEP_NOTIFY 100      // = 1000[ms] / 10[Hz]
-#define MUTEX_DEFAULT_WAIT 1000UL  // 1000ms ESP32のFreeRTOSでは 1TICK=1ms
+#define OSC_BATCH_MAX_SAMPLES 16   // 1バンドルに詰めるサンプル数の既定値
+#define IMU_FIFO_RATE_HZ 0         // 0: 周期毎にポーリング, 500/1000: ハードウェアFIFOからまとめ読み
+#define IMU_BURST_MAX 32           // ImuLoopの1周期で処理するサンプル数の上限
+#define IMU_SAMPLE_RATE_HZ 200     // 0: vTaskDelayで TASK_SLEEP_IMU 毎, 200/400/1000: esp_timerで周期を刻む
+#define IMU_DEFAULT_FILTER imu::FilterMahony
+#define GYRO_CALIBRATION_SAMPLES 1000 // /set/offset で平均するサンプル数
+#define TEMP_BIAS_SAVE_INTERVAL_MS 600000 // 学習した温度特性をNVSへ書く最短の間隔 (書き込み回数を抑える)
+#define DISPLAY_FRAME_MIN_MS 100        // Lcdの更新間隔の下限 (10fps)
+#define DISPLAY_REFRESH_MS 250          // 変化がなくても回転数などを描き直す間隔
+#define WIFI_FAST_TIMEOUT_MS 3000       // 前回の接続先に直接つなぐときの待ち時間
+#define GESTURE_EVENT_QUEUE_LEN 16      // 送信待ちのジェスチャーの数の上限 (2のべき乗)
+#define WIFI_GOT_IP_BIT (1 << 0)
+#define WIFI_DISCONNECTED_BIT (1 << 1)
 
 static void ImuLoop(void *arg);
 static void SendOscLoop(void *arg);
 static void ReceiveOscLoop(void *arg);
 static void NotifyLoop(void *arg);
+static void SettingsLoop(void *arg);
+static void DisplayLoop(void *arg);
+static void SendImuBundle();
+static int ImuRateHz();
+static int BatchIntervalMaxMs();
+static void ProcessImuSample(const imu::ImuData &sample);
+static void ApplySampleRate();
+static void DrainTrace();
+static void PublishStreamConfig();
+static bool ContainsDestination(const String &ip);
+static int CountDestinations();
+static void SaveDestinations();
+static void LoadSettings();
+static void RefitTempBias();
+static void ObserveTempBias(const float *bias, bool saveNow);
+static void SaveTempBias();
+static void QueueSetting(const prefs::SettingsChange &change);
+static void RefreshStreamTarget();
+static void SendPacket(const uint8_t *data, size_t len, int port);
+static void SendStats();
+static void SendReplyToHost(const osc::OscPacketWriter &writer);
+static void ComposeLcd(display::TextFrame &frame, int &rowHeight);
+static void SendTelemetry();
+static void SendGestureEvents();
 
 TaskHandle_t taskHandle;
 
-imu::ImuReader *imuReader;
+// タスク毎の起床周期の揺らぎ / 周期超過 / CPU使用率 / スタック残量
+enum TaskProfileId
+{
+  ProfileImu,
+  ProfileSendOsc,
+  ProfileReceiveOsc,
+  ProfileNotify,
+  ProfileSettings,
+  ProfileDisplay,
+  ProfileNum
+};
+stats::TaskProfiler taskProfiles[ProfileNum] = {
+    {TASK_NAME_IMU, TASK_SLEEP_IMU * 1000UL},
+    {TASK_NAME_SEND_OSC, TASK_SLEEP_SEND_OSC * 1000UL},
+    {TASK_NAME_RECEIVE_OSC, 0}, // 受信待ちのため周期なし
+    {TASK_NAME_NOTIFY, 0}, // 通知待ちのため周期なし
+    {TASK_NAME_SETTINGS, 0},
+    {TASK_NAME_DISPLAY, 0}, // 再描画の依頼でも起きるため周期なし
+};
+TaskHandle_t profiledTasks[ProfileNum] = {NULL};
+
+/**
+ * @brief タスクの生成パラメータ．配置を変えるときはこの表だけを編集する
+ */
+struct TaskLayout
+{
+  TaskFunction_t entry;
+  const char *name;
+  uint32_t stackDepth;
+  UBaseType_t priority;
+  BaseType_t coreId;
+};
+// TaskProfileId の順に並べる
+const TaskLayout taskLayout[ProfileNum] = {
+    {ImuLoop, TASK_NAME_IMU, TASK_STACK_DEPTH * 2, 3, TASK_CORE_SENSOR},
+    {SendOscLoop, TASK_NAME_SEND_OSC, TASK_STACK_DEPTH * 2, 2, TASK_CORE_SERVICE},
+    {ReceiveOscLoop, TASK_NAME_RECEIVE_OSC, TASK_STACK_DEPTH, 1, TASK_CORE_SERVICE},
+    {NotifyLoop, TASK_NAME_NOTIFY, TASK_STACK_DEPTH, 1, TASK_CORE_SERVICE},
+    {SettingsLoop, TASK_NAME_SETTINGS, TASK_STACK_DEPTH, 1, TASK_CORE_SERVICE},
+    {DisplayLoop, TASK_NAME_DISPLAY, TASK_STACK_DEPTH, 1, TASK_CORE_SERVICE},
+};
+int telemetryIntervalMs = 1000; // 0: 送らない
+stats::BootProfile bootProfile;
+volatile int batteryMilliVolts = 0; // I2CをIMUと共有するため ImuLoop が1秒毎に読む
+
+/**
+ * @brief ImuLoopからほかのタスクへ渡す最新のサンプル
+ */
+struct ImuSnapshot
+{
+  imu::ImuData imuData;
+  imu::twist::TwistData twistData;
+};
+
+// ImuLoopのみが書き込む．ほかのタスクは imuSnapshot / imuDataBuffer 経由で受け取る
+// ImuLoopは別のコアか (TASK_LAYOUT_SINGLE_CORE では) 最高優先度で動くため，読み出し側に割り込まれたまま止まることはなく，
+// imuSnapshot は read() で待ってよい
+imu::ImuReader *imuReader = NULL;
 imu::ImuData imuData;
-static SemaphoreHandle_t imuDataMutex = NULL;
+concurrent::SeqLock<ImuSnapshot> imuSnapshot;
+imu::ImuDataBuffer imuDataBuffer;
+volatile bool imuResetRequested = false;
+
+/**
+ * @brief 姿勢推定のゲイン．受信タスクがまとめて組み立てて filterGains に公開し，ImuLoopが tryRead() で受け取る
+ */
+struct FilterGains
+{
+  float kp;   // Mahony
+  float ki;   // Mahony
+  float beta; // Madgwick
+
+  FilterGains() : kp(imu::mahony::DefaultKp), ki(imu::mahony::DefaultKi), beta(imu::madgwick::DefaultBeta) {}
+};
+concurrent::SeqLock<FilterGains> filterGains;
+FilterGains imuGains; // ImuLoopが最後に受け取った値．setup_imu() が使う
+volatile bool ahrsGainsRequested = false;
+int imuFilterType = IMU_DEFAULT_FILTER;
+volatile bool imuFilterRequested = false;
+volatile uint32_t imuFilterCycles = 0;
+int imuFifoRateHz = IMU_FIFO_RATE_HZ;
+volatile bool imuFifoRequested = false;
+imu::sampling::EspTimerSampleClock sampleClock;
+imu::sampling::SamplePacer samplePacer(sampleClock); // ImuLoopのみが使う
+int imuSampleRateHz = IMU_SAMPLE_RATE_HZ;
+volatile bool imuSampleRateRequested = false;
+volatile bool highSpinEnabled = false; // 遠心力がかかっている間は加速度による補正を弱める
+volatile bool highSpinRequested = false;
+volatile uint32_t gyroSaturations = 0; // 以下はテレメトリ用．ImuLoopが書く
+volatile uint32_t accelGatedSamples = 0;
 
 float gyroOffset[3] = {0.0F};
 bool gyroOffsetInstalled = true;
-imu::AverageCalcXYZ gyroAve;
+imu::RunningStatsXYZ gyroAve;
+imu::StillDetector stillDetector;
+bool autoBiasEnabled = true; // 静止中に自動でジャイロのオフセットを推定し直す
+imu::bias::TempBiasModel tempBiasModel;  // ImuLoopのみが使う
+volatile bool tempBiasEnabled = true;    // 静止中のオフセットを温度毎に学習し，温度で補正する
+volatile bool tempBiasRequested = false; // /set/tempbias
+volatile bool tempBiasResetRequested = false;
+uint32_t lastTempBiasSave = 0;        // [ms]
+volatile float imuTemperature = 0.0F; // 以下はテレメトリ用．ImuLoopが書く
+volatile int tempBiasBins = 0;
+volatile bool tempBiasActive = false;
+volatile float appliedGyroOffset[3] = {0.0F};
+static_assert(prefs::SettingsTempBiasBins == imu::bias::TempBiasBinNum, "TempBiasTable must match TempBiasModel");
+imu::gesture::GestureDetector gestureDetector; // ImuLoopのみが使う
+concurrent::SeqLock<imu::gesture::GestureParams> gestureConfig; // 受信タスクが書き，gestureRequested でImuLoopが反映する
+volatile bool gestureEnabled = true;           // 全サンプルから回転の開始/停止/反転と揺さぶりを検出して送る
+volatile bool gestureRequested = false;
+concurrent::SpscRing<imu::gesture::GestureEvent, GESTURE_EVENT_QUEUE_LEN> gestureEvents; // ImuLoop -> SendOscLoop
+imu::twist::TwistCounter twistCounter;
+imu::twist::TwistData twistData;
+volatile bool twistResetRequested = false;
+volatile bool twistOffsetRequested = false;
+volatile bool twistRotationResetRequested = false;
+imu::trace::TraceRecorder traceRecorder;
+volatile int traceSink = 0; // 0: Serial, 1: OSC (/<uniqueId>/trace ,b)
+volatile bool traceStartRequested = false;
+volatile bool traceStopRequested = false;
 prefs::Settings settingPref;
+prefs::SettingsService settingsService(settingPref); // setup() と SettingsLoop だけが使う
+// 保存タスクへ渡す設定の変更．フィールド毎に長さ1のキューを上書きし，続けて届いた変更は最新の値だけを残す
+QueueHandle_t settingsQueues[prefs::SettingsFieldNum] = {NULL}; // prefs::SettingsChange
+volatile uint32_t settingsDropped = 0;                          // 保存タスクへ渡せなかった変更
+stats::PipelineStats pipelineStats; // 各タスクが自分の区間だけを記録する
+volatile bool lcdStatsEnabled = false;
+volatile uint32_t packetsSent = 0; // SendPacket の呼び出し回数．Lcdに送信レートを出すために使う
+
+bool batchEnabled = false;
+int batchMaxSamples = OSC_BATCH_MAX_SAMPLES;
+volatile bool batchResetRequested = false; // 有効にし直したとき，無効にする前の古いサンプルを送らない
+int sendIntervalMs = TASK_SLEEP_SEND_OSC;
+volatile bool quatFrameEnabled = false; // true: /quat の代わりに QuatFrame を frame_port へ送る
+osc::SendScheduler sendScheduler;         // SendOscLoopのみが使う
+
+/**
+ * @brief 可変レート送信の設定．受信タスクがまとめて組み立てて adaptiveConfig に公開し，SendOscLoopが tryRead() で受け取る
+ */
+struct AdaptiveSendConfig
+{
+  bool enabled; // false: sendIntervalMs 毎に必ず送る
+  float angleDeg;
+  float fastGyroDps;
+  int maxRateHz;
+  int keepaliveMs;
+
+  AdaptiveSendConfig()
+      : enabled(true), angleDeg(osc::SendDefaultAngleDeg), fastGyroDps(osc::SendDefaultFastGyroDps),
+        maxRateHz(osc::SendDefaultMaxRateHz), keepaliveMs(osc::SendDefaultKeepaliveMs) {}
+};
+concurrent::SeqLock<AdaptiveSendConfig> adaptiveConfig;
+volatile bool adaptiveSendRequested = false;
+WiFiUDP oscUdp;
+uint8_t oscPacket[osc::OscPacketMaxLen];
+osc::OscReceiver oscReceiver;     // コマンドの受信と応答 (bind_port)
+osc::OscDispatcher oscDispatcher; // ReceiveOscLoopのみが使う
+uint8_t commandPacket[osc::OscPacketMaxLen];
+volatile uint32_t lastCommandMicros = 0; // 直近のコマンド受信時刻 (StageApply の起点)
 
 String hostIp = "192.168.20.50";
+String destinationList = ""; // hostIp に加えて送る宛先 (カンマ区切り)
+String multicastGroup = "";  // 空文字列: マルチキャストしない
 const int bind_port = 22222;
 const int send_port = 33333;
+const int frame_port = 33334; // バイナリフレーム (imu::frame::QuatFrame) の送信先
 
 String uniqueId = "default";
-String quat_addr = "/quat";
+const char *quat_addr = "/quat";
+const char *twist_addr = "/twist";
+const char *imu_addr = "/imu";
+const char *filter_addr = "/filter";
+const char *trace_addr = "/trace";
+const char *pong_addr = "/pong";
+const char *stats_addr = "/stats";
+const char *telemetry_addr = "/telemetry";
+const char *event_addr = "/event";
+EventGroupHandle_t wifiEvents = NULL; // WIFI_GOT_IP_BIT / WIFI_DISCONNECTED_BIT
+prefs::WiFiCache wifiCache;           // 前回の接続先．setup() と ConnectWiFi() だけが使う
 
 /**
- * @brief Lcdの描画を更新する
+ * @brief 送信先の設定．受信タスクが書き込み，SendOscLoopが周期毎に読み出す
+ * @brief 書き込む受信タスクと同じコアで優先度の高いSendOscLoopが書き込みの途中に割り込みうるため，
+ * @brief 読み出しは tryRead() で行い，書き込み中なら前の設定のまま次の周期に読み直す
+ */
+struct StreamConfig
+{
+  char uniqueId[32];
+  uint32_t destinations[osc::TransportMaxDestinations]; // IPv4 (IPAddressのuint32_t表現)
+  int destinationCount;
+};
+concurrent::SeqLock<StreamConfig> streamConfig;
+
+// SendOscLoopのみが使う．streamConfigが変わったときだけ作り直す
+uint32_t streamConfigVersion = UINT32_MAX;
+osc::OscTransport transport(oscUdp);
+osc::OscPreencodedMessage quatMessage;  // /<uniqueId>/quat ,ffff
+osc::OscPreencodedMessage twistMessage; // /<uniqueId>/twist ,fffiii
+uint16_t quatFrameDeviceId = 0;
+uint16_t quatFrameSeq = 0;
+uint8_t quatFrame[imu::frame::QuatFrameLen];
+char imuAddr[48];
+char traceAddr[48];
+char telemetryAddr[48];
+char telemetryTaskAddr[56];
+char telemetryBootAddr[56];
+char telemetryBiasAddr[56];
+char telemetrySpinAddr[56];
+char telemetryDropAddr[56];
+char eventAddr[imu::gesture::GestureEventTypeNum][56]; // /<uniqueId>/event/<GestureEventName>
+
+/**
+ * @brief Lcdの再描画を表示タスクに依頼する．待たないため，どのタスクから呼んでもよい
  */
 void UpdateLcd()
 {
-  M5.Lcd.setCursor(0, 0);
-  if (gyroOffsetInstalled)
-  {
-    M5.Lcd.fillScreen(BLACK);
-    M5.Lcd.println("Kaiten-Boh\n");
-    M5.Lcd.print("IP : ");
-    M5.Lcd.println(WiFi.localIP());
-    M5.Lcd.print("UniqueID : ");
-    M5.Lcd.println(uniqueId);
-  }
-  else
+  TaskHandle_t displayTask = profiledTasks[ProfileDisplay];
+  if (displayTask != NULL)
+    xTaskNotifyGive(displayTask);
+}
+
+/**
+ * @brief WiFiのイベントを wifiEvents に反映する．WiFiのイベントタスクから呼ばれる
+ */
+static void OnWiFiEvent(WiFiEvent_t event, WiFiEventInfo_t info)
+{
+  switch (event)
   {
-    M5.Lcd.fillScreen(GREEN);
-    M5.Lcd.println("GyroOffset");
+  case ARDUINO_EVENT_WIFI_STA_CONNECTED:
+    bootProfile.mark(stats::BootWiFiAssociated, micros());
+    break;
+  case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+    bootProfile.mark(stats::BootWiFiGotIp, micros());
+    xEventGroupClearBits(wifiEvents, WIFI_DISCONNECTED_BIT);
+    xEventGroupSetBits(wifiEvents, WIFI_GOT_IP_BIT);
+    break;
+  case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+    xEventGroupClearBits(wifiEvents, WIFI_GOT_IP_BIT);
+    xEventGroupSetBits(wifiEvents, WIFI_DISCONNECTED_BIT);
+    break;
+  default:
+    break;
   }
 }
 
+/**
+ * @brief IPアドレスが決まるまで待つ．ポーリングせずイベントで起きる
+ *
+ * @param timeoutMs 最長の待ち時間[ms]
+ * @param failOnDisconnect true: 切断されたらすぐに諦める
+ * @return true 接続した
+ * @return false タイムアウトまたは切断
+ */
+static bool WaitWiFi(uint32_t timeoutMs, bool failOnDisconnect)
+{
+  EventBits_t waitBits = WIFI_GOT_IP_BIT | (failOnDisconnect ? WIFI_DISCONNECTED_BIT : 0);
+  EventBits_t bits = xEventGroupWaitBits(wifiEvents, waitBits, pdFALSE, pdFALSE, pdMS_TO_TICKS(timeoutMs));
+  return (bits & WIFI_GOT_IP_BIT) != 0;
+}
+
+/**
+ * @brief 前回のBSSID / チャネル / IPアドレスで直接つなぐ．スキャンとDHCPを省くため1秒かからない
+ * @brief つながらなければ設定を戻し，従来の手順に任せる
+ */
+static bool ConnectCachedWiFi()
+{
+  if (wifiCache.ssid[0] == '\0' || wifiCache.channel == 0)
+    return false;
+  M5.Lcd.println("Fast connect");
+  if (wifiCache.ip != 0)
+    WiFi.config(IPAddress(wifiCache.ip), IPAddress(wifiCache.gateway), IPAddress(wifiCache.subnet),
+                IPAddress(wifiCache.dns));
+  xEventGroupClearBits(wifiEvents, WIFI_DISCONNECTED_BIT);
+  bootProfile.mark(stats::BootWiFiStart, micros());
+  WiFi.begin(wifiCache.ssid, wifiCache.psk, wifiCache.channel, wifiCache.bssid, true);
+  if (WaitWiFi(WIFI_FAST_TIMEOUT_MS, true))
+    return true;
+
+  // アクセスポイントかチャネルが変わった．DHCPに戻して従来の手順でつなぐ
+  WiFi.disconnect(false, false);
+  WiFi.config(IPAddress(), IPAddress(), IPAddress());
+  return false;
+}
+
+/**
+ * @brief つながったアクセスポイントとIPアドレスを次回の起動のために保存する
+ */
+static void SaveWiFiCache()
+{
+  prefs::WiFiCache cache;
+  memset(&cache, 0, sizeof(cache));
+  strlcpy(cache.ssid, WiFi.SSID().c_str(), sizeof(cache.ssid));
+  strlcpy(cache.psk, WiFi.psk().c_str(), sizeof(cache.psk));
+  const uint8_t *bssid = WiFi.BSSID();
+  if (bssid != NULL)
+    memcpy(cache.bssid, bssid, sizeof(cache.bssid));
+  cache.channel = (uint8_t)WiFi.channel();
+  cache.ip = (uint32_t)WiFi.localIP();
+  cache.gateway = (uint32_t)WiFi.gatewayIP();
+  cache.subnet = (uint32_t)WiFi.subnetMask();
+  cache.dns = (uint32_t)WiFi.dnsIP();
+  wifiCache = cache;
+  QueueSetting(prefs::SettingsChange::WiFi(cache)); // 前回と同じなら保存タスクは書かない
+}
+
 /**
  * @brief WiFiに接続する．
- * @brief WiFiの接続に成功するまで試行する． 30回接続に失敗した場合は本体を再起動する．
+ * @brief 前回の接続先 → 保存されたネットワーク → 組み込みのSSID → SmartConfig の順に試す．
+ * @brief SmartConfigでも30秒以内に接続できなかった場合は本体を再起動する．
  */
 void ConnectWiFi()
 {
-
-#ifdef ESP_PLATFORM
-  WiFi.disconnect(true, false); // disable wifi
-  delay(1000);
+  wifiEvents = xEventGroupCreate();
+  WiFi.onEvent(OnWiFiEvent, ARDUINO_EVENT_WIFI_STA_CONNECTED);
+  WiFi.onEvent(OnWiFiEvent, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+  WiFi.onEvent(OnWiFiEvent, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
   WiFi.mode(WIFI_STA);
-#endif
 
   M5.Lcd.fillScreen(RED);
+  M5.Lcd.setCursor(0, 0);
   M5.Lcd.println("Wifi Connecting");
 
+  if (ConnectCachedWiFi())
+  {
+    bootProfile.setPath(stats::BootPathFast);
+    UpdateLcd();
+    return;
+  }
+
   // 前回接続時情報で接続する
   Serial.println("WiFi begin");
+  bootProfile.mark(stats::BootWiFiStart, micros());
   WiFi.begin();
-  u_long start = millis();
-  while (WiFi.status() != WL_CONNECTED)
-  {
-    M5.Lcd.print(".");
-    delay(500);
-    // 10秒以上接続できなかったら抜ける
-    if (10000 < millis() - start)
-      break;
-  }
+  if (WaitWiFi(10000, false))
+    bootProfile.setPath(stats::BootPathSaved);
 
   // undokai wifi への接続を試行する
   M5.Lcd.fillScreen(BLUE);
@@ -112,7 +450,6 @@ void ConnectWiFi()
   {
 #ifdef ESP_PLATFORM
     WiFi.disconnect(true, true); // disable wifi, erase ap info
-    delay(1000);
     WiFi.mode(WIFI_STA);
 #endif
 
@@ -122,23 +459,14 @@ void ConnectWiFi()
     const IPAddress subnet(255, 255, 255, 0);
 
     WiFi.config(ip, ip, subnet);
-    WiFi.mode(WIFI_STA);
     WiFi.begin(ssid, pass);
 
     M5.Lcd.println("Waiting for WiFi");
-    start = millis();
-    while (WiFi.status() != WL_CONNECTED)
-    {
-      delay(500);
-      M5.Lcd.print(".");
-      // 20秒以上接続できなかったら抜ける
-      if (20000 < millis() - start)
-      {
-        M5.Lcd.println("");
-        M5.Lcd.println("RESTART");
-        break;
-      }
-    }
+    // 20秒以上接続できなかったらSmartConfigへ
+    if (WaitWiFi(20000, false))
+      bootProfile.setPath(stats::BootPathFixed);
+    else
+      M5.Lcd.println("RESTART");
   }
 
   // 未接続の場合にはSmartConfig待受
@@ -152,7 +480,7 @@ void ConnectWiFi()
         "1234567890123456"); // AES Key (128 bit)
 
     M5.Lcd.println("Waiting for SmartConfig");
-    start = millis();
+    uint32_t start = millis();
     while (!WiFi.smartConfigDone())
     {
       delay(500);
@@ -170,35 +498,42 @@ void ConnectWiFi()
 
     // Wi-fi接続
     M5.Lcd.println("Waiting for WiFi");
-    start = millis();
-    while (WiFi.status() != WL_CONNECTED)
+    // 30秒以上接続できなかったら再起動する
+    if (!WaitWiFi(30000, false))
     {
-      delay(500);
-      M5.Lcd.print(".");
-      // 30秒以上接続できなかったら抜ける
-      if (30000 < millis() - start)
-      {
-        M5.Lcd.println("");
-        M5.Lcd.println("RESTART");
-        ESP.restart();
-      }
+      M5.Lcd.println("RESTART");
+      ESP.restart();
     }
+    bootProfile.setPath(stats::BootPathSmartConfig);
   }
 
+  SaveWiFiCache();
   UpdateLcd();
 }
 
 void setup_imu(float gyroOffset[3])
 {
   // IMUの初期化
+  if (imuReader != NULL)
+    delete imuReader;
   imuReader = new imu::ImuReader(M5.Imu);
   imuReader->initialize();
+  imuReader->setStats(&pipelineStats);
   if (gyroOffsetInstalled)
     imuReader->writeGyroOffset(gyroOffset[0], gyroOffset[1], gyroOffset[2]);
+  RefitTempBias();
+  imuReader->writeGains(imuGains.kp, imuGains.ki);
+  imuReader->writeMadgwickBeta(imuGains.beta);
+  imuReader->selectFilter((imu::FilterType)imuFilterType);
+  if (imuFifoRateHz > 0)
+    imuReader->beginFifo(imuFifoRateHz);
+  imuReader->setSamplePeriod(samplePacer.periodMicros());
+  imuReader->setHighSpin(highSpinEnabled);
 }
 
 void setup()
 {
+  bootProfile.mark(stats::BootSetup, micros());
   // Initialize
   M5.begin();
   pinMode(GPIO_NUM_10, OUTPUT);
@@ -206,12 +541,11 @@ void setup()
   Serial.begin(115200);
 
   // read settings
-  settingPref.begin();
-  // settingPref.clear();
-  settingPref.readGyroOffset(gyroOffset);
-  settingPref.readUniqueId(uniqueId);
-  // settingPref.readHostIp(hostIp);
-  settingPref.finish();
+  for (int i = 0; i < prefs::SettingsFieldNum; i++)
+    settingsQueues[i] = xQueueCreate(1, sizeof(prefs::SettingsChange));
+  LoadSettings();
+  bootProfile.mark(stats::BootSettingsLoaded, micros());
+  PublishStreamConfig();
 
   // lcd
   M5.Lcd.setRotation(3);
@@ -221,123 +555,1298 @@ void setup()
 
   // wifiに接続する
   ConnectWiFi();
+  if (!oscReceiver.begin(bind_port))
+    Serial.println("OSC receiver: cannot open command port (retrying in ReceiveOscTask)");
 
   // imu
   setup_imu(gyroOffset);
 
-  OscWiFi.subscribe(bind_port, "/set/hostip",
-                    [&](String &s)
-                    {
-                      xTaskNotify(taskHandle, 0, eNoAction);
-                      hostIp = s;
-                      settingPref.begin();
-                      // settingPref.clear();
-                      settingPref.writeHostIp(hostIp);
-                      settingPref.finish();
-                      UpdateLcd();
-                    });
-
-  OscWiFi.subscribe(bind_port, "/set/offset",
-                    []()
-                    {
-                      xTaskNotify(taskHandle, 0, eNoAction);
-                      gyroOffsetInstalled = false;
-                      UpdateLcd();
-                    });
-
-  OscWiFi.subscribe(bind_port, "/set/uniqueid",
-                    [&](String &s)
-                    {
-                      xTaskNotify(taskHandle, 0, eNoAction);
-                      uniqueId = s;
-                      settingPref.begin();
-                      settingPref.writeUniqueId(uniqueId);
-                      settingPref.finish();
-                      UpdateLcd();
-                    });
-
-  OscWiFi.subscribe(bind_port, "/reset/imu",
-                    []()
-                    {
-                      xTaskNotify(taskHandle, 0, eNoAction);
-                      setup_imu(gyroOffset);
-                    });
+  oscDispatcher.subscribe("/set/hostip", ",s",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            String s = m.getString(0);
+                            hostIp = s;
+                            QueueSetting(prefs::SettingsChange::Text(prefs::FieldHostIp, hostIp.c_str()));
+                            PublishStreamConfig();
+                            UpdateLcd();
+                          });
+
+  // hostIp に加える送信先．/set/dest/add 192.168.20.51 など
+  // hostIp / マルチキャストグループと合わせて osc::TransportMaxDestinations を超える分と，
+  // 保存する一覧 (prefs::SettingsDestinationsLen) に収まらない分は受け付けない
+  oscDispatcher.subscribe("/set/dest/add", ",s",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            String s = m.getString(0);
+                            IPAddress ip;
+                            if (!ip.fromString(s) || ContainsDestination(s) ||
+                                CountDestinations() >= osc::TransportMaxDestinations ||
+                                destinationList.length() + 1 + s.length() >= prefs::SettingsDestinationsLen)
+                              return;
+                            if (destinationList.length() > 0)
+                              destinationList += ",";
+                            destinationList += s;
+                            SaveDestinations();
+                          });
+
+  oscDispatcher.subscribe("/set/dest/remove", ",s",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            String s = m.getString(0);
+                            String remaining = "";
+                            int start = 0;
+                            while (start < (int)destinationList.length())
+                            {
+                              int end = destinationList.indexOf(',', start);
+                              if (end < 0)
+                                end = destinationList.length();
+                              String item = destinationList.substring(start, end);
+                              if (item != s)
+                              {
+                                if (remaining.length() > 0)
+                                  remaining += ",";
+                                remaining += item;
+                              }
+                              start = end + 1;
+                            }
+                            destinationList = remaining;
+                            SaveDestinations();
+                          });
+
+  oscDispatcher.subscribe("/set/dest/clear", "",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            destinationList = "";
+                            SaveDestinations();
+                          });
+
+  // マルチキャストグループ (224.0.0.0 - 239.255.255.255)．空文字列か 0.0.0.0 で止める
+  oscDispatcher.subscribe("/set/multicast", ",s",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            String s = m.getString(0);
+                            IPAddress ip;
+                            if (s.length() > 0 && !ip.fromString(s))
+                              return;
+                            if ((uint32_t)ip == 0)
+                              multicastGroup = "";
+                            else if (osc::OscTransport::IsMulticast(ip))
+                              multicastGroup = s;
+                            else
+                              return;
+                            SaveDestinations();
+                          });
+
+  oscDispatcher.subscribe("/set/offset", "",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            gyroOffsetInstalled = false;
+                            UpdateLcd();
+                          });
+
+  // 0: /quat をOSCで送る, 1: 16byteのバイナリフレームを frame_port へ送る
+  oscDispatcher.subscribe("/set/stream", ",i",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            int format = m.getInt32(0);
+                            quatFrameEnabled = format == 1;
+                          });
+
+  // 可変レート送信 enable, angleDeg, fastGyroDps, maxRateHz, keepaliveMs
+  oscDispatcher.subscribe("/set/adaptive", ",iffii",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            int enable = m.getInt32(0);
+                            float angleDeg = m.getFloat(1);
+                            float fastGyroDps = m.getFloat(2);
+                            int maxRateHz = m.getInt32(3);
+                            int keepaliveMs = m.getInt32(4);
+                            AdaptiveSendConfig config;
+                            config.angleDeg = angleDeg;
+                            config.fastGyroDps = fastGyroDps;
+                            config.maxRateHz = constrain(maxRateHz, 1, 1000 / TASK_SLEEP_IMU);
+                            config.keepaliveMs = constrain(keepaliveMs, 1, 60000);
+                            config.enabled = enable != 0;
+                            adaptiveConfig.write(config);
+                            adaptiveSendRequested = true;
+                          });
+
+  oscDispatcher.subscribe("/set/autobias", ",i",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            int enable = m.getInt32(0);
+                            autoBiasEnabled = enable != 0;
+                          });
+
+  // 0: 温度補正をやめる (学習した内容は残す), 1: 静止中に学習して温度で補正する
+  oscDispatcher.subscribe("/set/tempbias", ",i",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            int enable = m.getInt32(0);
+                            tempBiasEnabled = enable != 0;
+                            tempBiasRequested = true;
+                          });
+
+  oscDispatcher.subscribe("/reset/tempbias", "",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            tempBiasResetRequested = true;
+                          });
+
+  oscDispatcher.subscribe("/set/uniqueid", ",s",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            String s = m.getString(0);
+                            uniqueId = s;
+                            QueueSetting(prefs::SettingsChange::Text(prefs::FieldUniqueId, uniqueId.c_str()));
+                            PublishStreamConfig();
+                            UpdateLcd();
+                          });
+
+  oscDispatcher.subscribe("/reset/imu", "",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            imuResetRequested = true;
+                          });
+
+  oscDispatcher.subscribe("/set/gain", ",ff",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            float kp = m.getFloat(0);
+                            float ki = m.getFloat(1);
+                            if (kp < 0.0F || ki < 0.0F)
+                              return;
+                            FilterGains gains;
+                            filterGains.read(gains); // 書き込むのはこのタスクだけなので待たない
+                            gains.kp = kp;
+                            gains.ki = ki;
+                            filterGains.write(gains);
+                            ahrsGainsRequested = true;
+                          });
+
+  oscDispatcher.subscribe("/set/filter", ",i",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            int type = m.getInt32(0);
+                            if (type < 0 || type >= imu::FilterTypeNum)
+                              return;
+                            imuFilterType = type;
+                            imuFilterRequested = true;
+                          });
+
+  oscDispatcher.subscribe("/set/beta", ",f",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            float beta = m.getFloat(0);
+                            if (beta < 0.0F)
+                              return;
+                            FilterGains gains;
+                            filterGains.read(gains); // 書き込むのはこのタスクだけなので待たない
+                            gains.beta = beta;
+                            filterGains.write(gains);
+                            imuFilterRequested = true;
+                          });
+
+  // 使用中のフィルタと1回の姿勢推定にかかるCPUサイクル数を返す
+  oscDispatcher.subscribe("/get/filter", "",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            uint8_t reply[96];
+                            String addr = "/" + uniqueId + filter_addr;
+                            osc::OscPacketWriter writer(reply, sizeof(reply));
+                            writer.beginMessage(addr.c_str(), ",ii");
+                            writer.writeInt32((int32_t)imuFilterType);
+                            writer.writeInt32((int32_t)imuFilterCycles);
+                            if (writer.endMessage())
+                              SendReplyToHost(writer);
+                          });
+
+  // 時刻同期 (NTP方式)．/ping i の送信元へ /<uniqueId>/pong iii (token, 受信時刻[us], 返信時刻[us]) を返す
+  // 時刻は ImuData::timestamp と同じ micros() で，ホスト側でオフセットとドリフトを推定する
+  oscDispatcher.subscribe("/ping", ",i",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            uint8_t reply[96];
+                            char addr[48];
+                            snprintf(addr, sizeof(addr), "/%s%s", uniqueId.c_str(), pong_addr);
+                            osc::OscPacketWriter writer(reply, sizeof(reply));
+                            writer.beginMessage(addr, ",iii");
+                            writer.writeInt32(m.getInt32(0));
+                            writer.writeInt32((int32_t)m.receivedMicros());
+                            writer.writeInt32((int32_t)micros());
+                            if (writer.endMessage())
+                              oscReceiver.sendTo(writer.data(), writer.size(), m.remoteAddress(), m.remotePort());
+                          });
+
+  // パイプラインの区間毎の遅延 (p50 / p90 / p99 / 最大)
+  oscDispatcher.subscribe("/stats", "",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            SendStats();
+                          });
+
+  oscDispatcher.subscribe("/stats/reset", "",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            pipelineStats.reset();
+                          });
+
+  // 1: Lcdに区間毎の p50 / p99 [us] を1秒毎に表示する, 0: 通常の表示に戻す
+  oscDispatcher.subscribe("/set/lcdstats", ",i",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            int enable = m.getInt32(0);
+                            lcdStatsEnabled = enable != 0;
+                            UpdateLcd();
+                          });
+
+  // テレメトリの送信間隔[ms]．0で止める
+  oscDispatcher.subscribe("/set/telemetry", ",i",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            int intervalMs = m.getInt32(0);
+                            telemetryIntervalMs = constrain(intervalMs, 0, 60000);
+                          });
+
+  oscDispatcher.subscribe("/set/fifo", ",i",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            int rateHz = m.getInt32(0);
+                            imuFifoRateHz = constrain(rateHz, 0, 1000);
+                            imuFifoRequested = true;
+                          });
+
+  // 0: 従来どおり vTaskDelay で待つ, 200/400/1000: ハードウェアタイマで周期を刻む
+  oscDispatcher.subscribe("/set/samplerate", ",i",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            int rateHz = m.getInt32(0);
+                            if (rateHz != 0 && !imu::sampling::SamplePacer::IsSupportedRate(rateHz))
+                              return;
+                            imuSampleRateHz = rateHz;
+                            imuSampleRateRequested = true;
+                          });
+
+  // 0: 通常, 1: 高速回転モード (角速度のレンジを最大にし，遠心力がかかっている間は加速度による補正を弱める)
+  oscDispatcher.subscribe("/set/highspin", ",i",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            int enable = m.getInt32(0);
+                            highSpinEnabled = enable != 0;
+                            highSpinRequested = true;
+                          });
+
+  // 0: ジェスチャーを検出しない, 1: 検出して /<uniqueId>/event/... を送る
+  oscDispatcher.subscribe("/set/gesture", ",i",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            int enable = m.getInt32(0);
+                            gestureEnabled = enable != 0;
+                            gestureRequested = true;
+                          });
+
+  // 回転の検出 axis (0: X, 1: Y, 2: Z), startDps, stopDps, holdMs, releaseMs
+  oscDispatcher.subscribe("/set/gesture/spin", ",iffii",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            imu::gesture::GestureParams params;
+                            gestureConfig.read(params); // 書き込むのはこのタスクだけなので待たない
+                            params.spinAxis = m.getInt32(0);
+                            params.spinStartDps = m.getFloat(1);
+                            params.spinStopDps = m.getFloat(2);
+                            params.spinHoldMs = (uint32_t)constrain(m.getInt32(3), 0, 2000);
+                            params.spinReleaseMs = (uint32_t)constrain(m.getInt32(4), 0, 5000);
+                            params.sanitize();
+                            gestureConfig.write(params);
+                            gestureRequested = true;
+                          });
+
+  // 揺さぶりの検出 thresholdG (加速度と1gの差), count (山の数), windowMs
+  oscDispatcher.subscribe("/set/gesture/shake", ",fii",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            imu::gesture::GestureParams params;
+                            gestureConfig.read(params); // 書き込むのはこのタスクだけなので待たない
+                            params.shakeG = m.getFloat(0);
+                            params.shakeCount = m.getInt32(1);
+                            params.shakeWindowMs = (uint32_t)constrain(m.getInt32(2), 0, 5000);
+                            params.sanitize();
+                            gestureConfig.write(params);
+                            gestureRequested = true;
+                          });
+
+  oscDispatcher.subscribe("/set/batch", ",iii",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            int enable = m.getInt32(0);
+                            int maxSamples = m.getInt32(1);
+                            int intervalMs = m.getInt32(2);
+                            batchMaxSamples = constrain(maxSamples, 1, imu::ImuDataBufferSize);
+                            // imuDataBuffer に溜められる時間を超える間隔ではサンプルが欠けるため，そこで止める
+                            sendIntervalMs = constrain(intervalMs, TASK_SLEEP_IMU, BatchIntervalMaxMs());
+                            // imuDataBuffer は読み出し側 (SendOscLoop) でしか捨てられないため，捨てるよう頼む
+                            if (enable != 0 && !batchEnabled)
+                              batchResetRequested = true;
+                            batchEnabled = enable != 0;
+                          });
+
+  // IMUの記録 (imu/trace/TraceFormat.h) を開始する．sink 0: Serial, 1: OSC
+  oscDispatcher.subscribe("/record/start", ",i",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            int sink = m.getInt32(0);
+                            traceSink = (sink == 1) ? 1 : 0;
+                            traceStartRequested = true;
+                          });
+
+  oscDispatcher.subscribe("/record/stop", "",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            traceStopRequested = true;
+                          });
+
+  oscDispatcher.subscribe("/reset/twist", "",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            twistResetRequested = true;
+                          });
+
+  oscDispatcher.subscribe("/set/twistoffset", "",
+                          [](const osc::OscMessageReader &m)
+                          {
+                            xTaskNotify(taskHandle, 0, eNoAction);
+                            twistOffsetRequested = true;
+                          });
 
   // task
-  imuDataMutex = xSemaphoreCreateMutex();
   //! 指定したCPUコアでタスクを起動する
-  xTaskCreatePinnedToCore(ImuLoop, TASK_NAME_IMU, TASK_STACK_DEPTH * 2,
-                          NULL, 3, NULL, TASK_DEFAULT_CORE_ID);
-  xTaskCreatePinnedToCore(SendOscLoop, TASK_NAME_SEND_OSC, TASK_STACK_DEPTH * 2,
-                          NULL, 2, NULL, TASK_DEFAULT_CORE_ID);
-  xTaskCreatePinnedToCore(ReceiveOscLoop, TASK_NAME_RECEIVE_OSC, TASK_STACK_DEPTH,
-                          NULL, 1, NULL, TASK_DEFAULT_CORE_ID);
-  xTaskCreatePinnedToCore(NotifyLoop, TASK_NAME_NOTIFY, TASK_STACK_DEPTH,
-                          NULL, 1, &taskHandle, TASK_DEFAULT_CORE_ID);
+  // 受信タスクのハンドラが taskHandle へ通知するため，表の後ろ (NotifyLoop) から生成する
+  for (int i = ProfileNum - 1; i >= 0; i--)
+  {
+    const TaskLayout &layout = taskLayout[i];
+    xTaskCreatePinnedToCore(layout.entry, layout.name, layout.stackDepth,
+                            NULL, layout.priority, &profiledTasks[i], layout.coreId);
+    if (i == ProfileNotify)
+      taskHandle = profiledTasks[i];
+  }
+  bootProfile.mark(stats::BootTasksStarted, micros());
 }
 
-void loop() {}
+void loop()
+{
+  // loopTaskは空回りでIMUと同じコアを使い続けるため削除する
+  vTaskDelete(NULL);
+}
 
 static void ImuLoop(void *arg)
 {
+  static imu::ImuData burst[IMU_BURST_MAX];
+  ImuSnapshot snapshot;
+  uint32_t lastBatteryRead = 0;
+  ApplySampleRate();
   while (1)
   {
     uint32_t entryTime = millis();
-    if (xSemaphoreTake(imuDataMutex, MUTEX_DEFAULT_WAIT) == pdTRUE)
+    taskProfiles[ProfileImu].begin(micros());
+    bool applied = imuResetRequested || ahrsGainsRequested || imuFilterRequested ||
+                   imuFifoRequested || imuSampleRateRequested || twistResetRequested ||
+                   twistOffsetRequested || tempBiasRequested || tempBiasResetRequested ||
+                   highSpinRequested || gestureRequested;
+    if (imuResetRequested)
+    {
+      setup_imu(gyroOffset);
+      twistRotationResetRequested = true;
+      imuResetRequested = false;
+    }
+    // 要求を先に下ろしてから読む．読んでいる間に届いた変更は次の周期に反映する
+    // 書き込み中に重なったら要求を戻し，前の値のまま次の周期に読み直す
+    if (ahrsGainsRequested)
     {
-      imuReader->update();
-      imuReader->read(imuData);
-      if (!gyroOffsetInstalled)
+      ahrsGainsRequested = false;
+      uint32_t version;
+      if (filterGains.tryRead(imuGains, version))
+        imuReader->writeGains(imuGains.kp, imuGains.ki);
+      else
+        ahrsGainsRequested = true;
+    }
+    if (imuFilterRequested)
+    {
+      imuFilterRequested = false;
+      uint32_t version;
+      if (filterGains.tryRead(imuGains, version))
       {
-        if (!gyroAve.push(imuData.gyro[0], imuData.gyro[1], imuData.gyro[2]))
-        {
-          float x = gyroAve.averageX();
-          float y = gyroAve.averageY();
-          float z = gyroAve.averageZ();
-          // set offset
-          imuReader->writeGyroOffset(x, y, z);
-          // save offset
-          gyroOffset[0] = x;
-          gyroOffset[1] = y;
-          gyroOffset[2] = z;
-          settingPref.begin();
-          settingPref.writeGyroOffset(gyroOffset);
-          settingPref.finish();
-          gyroOffsetInstalled = true;
-          gyroAve.reset();
-          UpdateLcd();
-        }
+        imuReader->writeMadgwickBeta(imuGains.beta);
+        imuReader->selectFilter((imu::FilterType)imuFilterType);
       }
+      else
+        imuFilterRequested = true;
+    }
+    if (imuFifoRequested)
+    {
+      if (imuFifoRateHz > 0)
+        imuReader->beginFifo(imuFifoRateHz);
+      else
+        imuReader->endFifo();
+      imuFifoRequested = false;
+    }
+    if (imuSampleRateRequested)
+    {
+      ApplySampleRate();
+      imuSampleRateRequested = false;
+    }
+    if (highSpinRequested)
+    {
+      imuReader->setHighSpin(highSpinEnabled);
+      highSpinRequested = false;
     }
-    xSemaphoreGive(imuDataMutex);
+    if (gestureRequested)
+    {
+      gestureRequested = false;
+      imu::gesture::GestureParams params;
+      uint32_t version;
+      if (gestureConfig.tryRead(params, version))
+        gestureDetector.configure(params); // 途中の判定は捨てる
+      else
+        gestureRequested = true;
+    }
+    if (tempBiasResetRequested)
+    {
+      tempBiasModel.clear();
+      SaveTempBias();
+      tempBiasResetRequested = false;
+      tempBiasRequested = true;
+    }
+    if (tempBiasRequested)
+    {
+      RefitTempBias();
+      tempBiasRequested = false;
+    }
+
+    if (twistRotationResetRequested)
+    {
+      twistCounter.resetRotation();
+      twistRotationResetRequested = false;
+    }
+    if (twistResetRequested)
+    {
+      twistCounter.reset();
+      twistResetRequested = false;
+    }
+    if (twistOffsetRequested)
+    {
+      twistCounter.setOffset();
+      twistOffsetRequested = false;
+    }
+    if (applied)
+      pipelineStats.recordMicros(stats::StageApply, micros() - lastCommandMicros, getCpuFrequencyMhz());
+
+    // FIFO有効時は前回から溜まった全サンプルを1つずつ処理する
+    // 周期タイマで刻んでいるときは周期の開始時刻をサンプルの時刻にする
+    uint32_t sampleMicros = (samplePacer.rate() > 0) ? samplePacer.tickMicros() : micros();
+    size_t n = imuReader->updateBurst(burst, IMU_BURST_MAX, sampleMicros);
+    for (size_t i = 0; i < n; i++)
+    {
+      uint32_t startCycles = ESP.getCycleCount();
+      ProcessImuSample(burst[i]);
+      pipelineStats.record(stats::StageProcess, ESP.getCycleCount() - startCycles);
+    }
+    imuFilterCycles = imuReader->filterCycles();
+    imuTemperature = imuReader->temperature();
+    gyroSaturations = imuReader->gyroSaturations();
+    accelGatedSamples = imuReader->accelGatedSamples();
+    float offset[3];
+    imuReader->readAppliedOffset(offset);
+    for (int i = 0; i < 3; i++)
+      appliedGyroOffset[i] = offset[i];
+
+    if (n > 0)
+    {
+      snapshot.imuData = imuData;
+      snapshot.twistData = twistData;
+      imuSnapshot.write(snapshot);
+    }
+
+    // 電源ICはIMUと同じI2Cにつながっているため，ほかのタスクからは読まない
+    if (entryTime - lastBatteryRead >= 1000)
+    {
+      batteryMilliVolts = M5.Power.getBatteryVoltage();
+      lastBatteryRead = entryTime;
+    }
+
     // idle
-    int32_t sleep = TASK_SLEEP_IMU - (millis() - entryTime);
-    vTaskDelay((sleep > 0) ? sleep : 0);
+    taskProfiles[ProfileImu].end(micros());
+    if (samplePacer.rate() > 0)
+    {
+      samplePacer.waitNext(); // タイムアウトしたときもそのまま次のサンプルを読む
+    }
+    else
+    {
+      int32_t sleep = TASK_SLEEP_IMU - (millis() - entryTime);
+      vTaskDelay((sleep > 0) ? sleep : 0);
+    }
+  }
+}
+
+/**
+ * @brief imuSampleRateHz に従ってサンプリングの周期を切り替える．ImuLoopから呼ぶこと
+ * @brief タイマを起動できなければ vTaskDelay の周期に戻す
+ */
+static void ApplySampleRate()
+{
+  if (!samplePacer.setRate(imuSampleRateHz))
+  {
+    imuSampleRateHz = 0;
+    samplePacer.setRate(0);
+  }
+  imuReader->setSamplePeriod(samplePacer.periodMicros());
+  taskProfiles[ProfileImu].setPeriod((samplePacer.rate() > 0) ? samplePacer.periodMicros() : TASK_SLEEP_IMU * 1000UL);
+}
+
+/**
+ * @brief 1サンプル分の後段処理 (送信バッファ / ねじれ角の積算 / ジャイロオフセットの計測)
+ *
+ * @param sample 姿勢推定済みのIMUデータ
+ */
+static void ProcessImuSample(const imu::ImuData &sample)
+{
+  imuData = sample;
+  if (batchEnabled && gyroOffsetInstalled)
+    imuDataBuffer.push(imuData); // 満杯なら捨てる．送信側を待たない
+  traceRecorder.push(imuData);
+
+  // ねじれ角は全サンプルで積算する (送信周期で間引くと高速回転時に折り返すため)
+  twistCounter.update(imuData.quat);
+  twistCounter.read(twistData);
+
+  // ジェスチャーも全サンプルで判定し，送信周期を待たずに送信タスクを起こす
+  if (gestureEnabled && gyroOffsetInstalled)
+  {
+    imu::gesture::GestureEvent event;
+    TaskHandle_t sendTask = profiledTasks[ProfileSendOsc];
+    if (gestureDetector.update(imuData, event) && gestureEvents.push(event) && sendTask != NULL)
+      xTaskNotifyGive(sendTask);
+  }
+
+  // imuData.gyro は現在のオフセットを差し引いた値なので，平均は残りのオフセットになる
+  if (!gyroOffsetInstalled)
+  {
+    gyroAve.push(imuData.gyro[0], imuData.gyro[1], imuData.gyro[2]);
+    if (gyroAve.count() >= GYRO_CALIBRATION_SAMPLES)
+    {
+      // set offset (温度補正中は差し引いているのが温度からのオフセットなので，それに足す)
+      float residual[3] = {gyroAve.averageX(), gyroAve.averageY(), gyroAve.averageZ()};
+      imuReader->readAppliedOffset(gyroOffset);
+      for (int i = 0; i < 3; i++)
+        gyroOffset[i] += residual[i];
+      imuReader->writeGyroOffset(gyroOffset[0], gyroOffset[1], gyroOffset[2]);
+      // save offset (NVSへの書き込みは保存タスクが行う)
+      QueueSetting(prefs::SettingsChange::GyroOffset(gyroOffset));
+      // 温度補正中は writeGyroOffset() の値を使わないため，学習した区間を全て残りの分だけずらして
+      // 直線に残りをすぐ反映する (1回の観測では重みの大きい区間に埋もれて直線がほとんど動かない)
+      if (tempBiasActive)
+      {
+        tempBiasModel.shift(residual);
+        RefitTempBias();
+        SaveTempBias();
+      }
+      ObserveTempBias(gyroOffset, true);
+      gyroOffsetInstalled = true;
+      gyroAve.reset();
+      stillDetector.reset();
+      gestureDetector.reset();
+      UpdateLcd();
+    }
+  }
+  else if ((autoBiasEnabled || tempBiasEnabled) && stillDetector.push(imuData))
+  {
+    // 静止している間の平均角速度は，今差し引いているオフセットの残り
+    float applied[3];
+    imuReader->readAppliedOffset(applied);
+    float residual[3] = {stillDetector.gyroBiasX(), stillDetector.gyroBiasY(), stillDetector.gyroBiasZ()};
+    float bias[3];
+    for (int i = 0; i < 3; i++)
+      bias[i] = applied[i] + residual[i];
+    if (autoBiasEnabled)
+    {
+      // 温度補正が使えないときのためのオフセットとして補正する (NVSには書かない)
+      // 1回の窓の推定で置き換えず，残りの一部ずつ近づける (取り違えた静止の影響を抑える)
+      for (int i = 0; i < 3; i++)
+        gyroOffset[i] = applied[i] + residual[i] * imu::StillBiasBlend;
+      imuReader->writeGyroOffset(gyroOffset[0], gyroOffset[1], gyroOffset[2]);
+    }
+    ObserveTempBias(bias, false);
+  }
+}
+
+/**
+ * @brief 学習した温度特性を当てはめ直して ImuReader に渡す．ImuLoopから呼ぶこと
+ * @brief 温度補正が無効か，観測した温度の幅が足りなければ固定のオフセットに戻る
+ */
+static void RefitTempBias()
+{
+  imu::bias::TempBiasCurve curve;
+  if (tempBiasEnabled)
+    tempBiasModel.fit(curve);
+  imuReader->writeBiasCurve(curve);
+  tempBiasBins = tempBiasModel.populatedBins();
+  tempBiasActive = curve.valid;
+}
+
+/**
+ * @brief 静止中に求めたオフセットをその時の温度と共に学習する．ImuLoopから呼ぶこと
+ *
+ * @param bias 補正前の角速度の平均[deg/s]
+ * @param saveNow true: すぐに保存する (/set/offset), false: TEMP_BIAS_SAVE_INTERVAL_MS 毎に保存する
+ */
+static void ObserveTempBias(const float *bias, bool saveNow)
+{
+  if (!tempBiasEnabled || !imuReader->hasTemperature())
+    return;
+  if (!tempBiasModel.observe(imuReader->temperature(), bias))
+    return;
+  RefitTempBias();
+  uint32_t now = millis();
+  if (saveNow || now - lastTempBiasSave >= TEMP_BIAS_SAVE_INTERVAL_MS)
+  {
+    SaveTempBias();
+    lastTempBiasSave = now;
+  }
+}
+
+/**
+ * @brief 学習した温度特性を保存タスクへ渡す
+ */
+static void SaveTempBias()
+{
+  prefs::TempBiasTable table;
+  for (int i = 0; i < imu::bias::TempBiasBinNum; i++)
+  {
+    const imu::bias::TempBiasBin &bin = tempBiasModel.bin(i);
+    table.temp[i] = bin.temp;
+    for (int axis = 0; axis < 3; axis++)
+      table.bias[i][axis] = bin.bias[axis];
+    table.weight[i] = (uint8_t)bin.weight;
   }
+  QueueSetting(prefs::SettingsChange::TempBias(table));
 }
 
 static void SendOscLoop(void *arg)
 {
+  ImuSnapshot snapshot;
+  AdaptiveSendConfig adaptive; // adaptiveConfig から最後に受け取った値
+  uint32_t lastBundleTime = 0;
+  uint32_t lastTelemetryTime = 0;
   while (1)
   {
     uint32_t entryTime = millis();
-    if (gyroOffsetInstalled)
+    taskProfiles[ProfileSendOsc].begin(micros());
+    RefreshStreamTarget();
+    SendGestureEvents();
+    if (adaptiveSendRequested)
     {
-      if (xSemaphoreTake(imuDataMutex, MUTEX_DEFAULT_WAIT) == pdTRUE)
+      // 受信タスクの書き込み中に割り込んだら，前の設定のまま次の周期に読み直す
+      adaptiveSendRequested = false;
+      uint32_t version;
+      if (adaptiveConfig.tryRead(adaptive, version))
       {
-        String addr = "/" + uniqueId + quat_addr;
-        OscWiFi.send(hostIp, send_port, addr,
-                     imuData.quat[0],
-                     imuData.quat[1],
-                     imuData.quat[2],
-                     imuData.quat[3]);
+        sendScheduler.configure(adaptive.angleDeg, adaptive.fastGyroDps, adaptive.maxRateHz, adaptive.keepaliveMs);
+        sendScheduler.reset();
       }
-      xSemaphoreGive(imuDataMutex);
+      else
+        adaptiveSendRequested = true;
+    }
+
+    // 送信中もImuLoopはブロックされない
+    uint32_t startCycles = ESP.getCycleCount();
+    imuSnapshot.read(snapshot);
+    pipelineStats.record(stats::StageHandoff, ESP.getCycleCount() - startCycles);
+    uint32_t nowMicros = micros();
+    bool sendPose = gyroOffsetInstalled &&
+                    (!adaptive.enabled || sendScheduler.shouldSend(snapshot.imuData, nowMicros));
+    if (sendPose)
+    {
+      pipelineStats.recordMicros(stats::StageSampleAge, nowMicros - snapshot.imuData.timestamp, getCpuFrequencyMhz());
+      if (!batchEnabled && quatFrameEnabled)
+      {
+        startCycles = ESP.getCycleCount();
+        size_t len = imu::frame::EncodeFrame(snapshot.imuData, quatFrameDeviceId, quatFrameSeq++, quatFrame);
+        pipelineStats.record(stats::StageEncode, ESP.getCycleCount() - startCycles);
+        SendPacket(quatFrame, len, frame_port);
+      }
+      else if (!batchEnabled && quatMessage.isEncoded())
+      {
+        startCycles = ESP.getCycleCount();
+        for (int i = 0; i < imu::ImuWxyz; i++)
+          quatMessage.setFloat(i, snapshot.imuData.quat[i]);
+        pipelineStats.record(stats::StageEncode, ESP.getCycleCount() - startCycles);
+        SendPacket(quatMessage.data(), quatMessage.size(), send_port);
+      }
+
+      if (twistMessage.isEncoded())
+      {
+        startCycles = ESP.getCycleCount();
+        for (int i = 0; i < imu::twist::TwistAxisNum; i++)
+        {
+          twistMessage.setFloat(i, snapshot.twistData.totalDegree[i]);
+          twistMessage.setInt32(imu::twist::TwistAxisNum + i, snapshot.twistData.count[i]);
+        }
+        pipelineStats.record(stats::StageEncode, ESP.getCycleCount() - startCycles);
+        SendPacket(twistMessage.data(), twistMessage.size(), send_port);
+      }
+    }
+
+    if (batchResetRequested)
+    {
+      imuDataBuffer.clear();
+      lastBundleTime = entryTime;
+      batchResetRequested = false;
+    }
+
+    // バンドルは間引くとサンプルが欠けるため，姿勢の変化によらず sendIntervalMs 毎に送る
+    // /set/batch の後にサンプリング周波数を上げた場合も imuDataBuffer が溢れる前に送る
+    int32_t bundleInterval = (sendIntervalMs < BatchIntervalMaxMs()) ? sendIntervalMs : BatchIntervalMaxMs();
+    if (gyroOffsetInstalled && batchEnabled && entryTime - lastBundleTime >= (uint32_t)bundleInterval)
+    {
+      SendImuBundle();
+      lastBundleTime = entryTime;
+    }
+
+    DrainTrace();
+
+    if (telemetryIntervalMs > 0 && entryTime - lastTelemetryTime >= (uint32_t)telemetryIntervalMs)
+    {
+      SendTelemetry();
+      lastTelemetryTime = entryTime;
     }
 
     // idle
-    int32_t sleep = TASK_SLEEP_SEND_OSC - (millis() - entryTime);
-    vTaskDelay((sleep > 0) ? sleep : 0);
+    // 可変レート時は最大レートで起きて送信要否を判定する
+    int32_t period = adaptive.enabled ? (int32_t)(sendScheduler.minIntervalMicros() / 1000) : sendIntervalMs;
+    if (batchEnabled && period > bundleInterval)
+      period = bundleInterval;
+    taskProfiles[ProfileSendOsc].setPeriod(period * 1000UL);
+    taskProfiles[ProfileSendOsc].end(micros());
+    int32_t sleep = period - (millis() - entryTime);
+    if (sleep <= 0)
+      vTaskDelay(0);
+    // 待っている間に検出したジェスチャーはすぐに送る
+    while (sleep > 0)
+    {
+      if (ulTaskNotifyTake(pdTRUE, sleep) > 0)
+        SendGestureEvents();
+      sleep = period - (millis() - entryTime);
+    }
+  }
+}
+
+/**
+ * @brief ImuLoopが検出したジェスチャーを1つのOSCバンドルで送る
+ * @brief /<uniqueId>/event/<spinstart|spinstop|spinreverse|shake> ,iifi (検出したサンプルの時刻[us],
+ *        回転の向き +1/-1 (spinreverseは新しい向き, shakeは0), 最大値 (回転: 角速度[deg/s], shake: 加速度と1gの差[g]),
+ *        長さ[ms] (spinstart: 閾値を超えてから検出まで, spinstop/spinreverse: 終わった回転, shake: 最初から最後の山まで))
+ */
+static void SendGestureEvents()
+{
+  if (gestureEvents.count() == 0)
+    return;
+  osc::OscPacketWriter writer(oscPacket, sizeof(oscPacket));
+  writer.beginBundle();
+  imu::gesture::GestureEvent event;
+  while (gestureEvents.pop(event))
+  {
+    writer.beginMessage(eventAddr[event.type], ",iifi");
+    writer.writeInt32((int32_t)event.timestamp);
+    writer.writeInt32(event.direction);
+    writer.writeFloat(event.peak);
+    writer.writeInt32((int32_t)event.durationMs);
+    if (!writer.endMessage())
+    {
+      writer.discardMessage();
+      break;
+    }
+  }
+  SendPacket(writer.data(), writer.size(), send_port);
+}
+
+/**
+ * @brief 今のIMUのサンプリング周波数[Hz]．FIFOのまとめ読み，esp_timer，vTaskDelay の順に決まる
+ */
+static int ImuRateHz()
+{
+  if (imuFifoRateHz > 0)
+    return imuFifoRateHz;
+  return (imuSampleRateHz > 0) ? imuSampleRateHz : 1000 / TASK_SLEEP_IMU;
+}
+
+/**
+ * @brief 今のサンプリング周波数で imuDataBuffer が溢れずに済むバンドルの送信間隔の上限[ms] (200Hzで160ms, 1kHzで32ms)
+ */
+static int BatchIntervalMaxMs()
+{
+  int maxMs = imu::BatchIntervalMaxMs(ImuRateHz());
+  return (maxMs > TASK_SLEEP_IMU) ? maxMs : TASK_SLEEP_IMU;
+}
+
+/**
+ * @brief 前回の送信以降に溜まったIMUデータを1サンプル1メッセージとしてOSCバンドルで送信する
+ * @brief メッセージ: /<uniqueId>/imu ,iffffffffff (timestamp, acc[3], gyro[3], quat[4])
+ * @brief batchMaxSamples を超える分やMTUに収まらない分は続くバンドルで送る
+ */
+static void SendImuBundle()
+{
+  static imu::ImuData batch[imu::ImuDataBufferSize];
+  int n = 0;
+  while (n < imu::ImuDataBufferSize && imuDataBuffer.pop(batch[n]))
+    n++;
+
+  osc::OscPacketWriter writer(oscPacket, sizeof(oscPacket));
+  int i = 0;
+  while (i < n)
+  {
+    int packed = osc::WriteImuBundle(writer, imuAddr, &batch[i], n - i, batchMaxSamples);
+    if (packed == 0)
+      break; // 1サンプルも収まらない (uniqueIdが長すぎる)
+
+    SendPacket(writer.data(), writer.size(), send_port);
+    i += packed;
+  }
+}
+
+/**
+ * @brief 現在の送信先を streamConfig に公開する．hostIp / uniqueId を変更したら呼ぶ
+ */
+static void PublishStreamConfig()
+{
+  StreamConfig config;
+  strlcpy(config.uniqueId, uniqueId.c_str(), sizeof(config.uniqueId));
+  config.destinationCount = 0;
+
+  // 宛先が多すぎるときは後ろの追加分を捨てる
+  String list = hostIp + "," + multicastGroup + "," + destinationList;
+  int start = 0;
+  while (start < (int)list.length() && config.destinationCount < osc::TransportMaxDestinations)
+  {
+    int end = list.indexOf(',', start);
+    if (end < 0)
+      end = list.length();
+    IPAddress ip;
+    if (end > start && ip.fromString(list.substring(start, end)))
+      config.destinations[config.destinationCount++] = (uint32_t)ip;
+    start = end + 1;
+  }
+  streamConfig.write(config);
+}
+
+static bool ContainsDestination(const String &ip)
+{
+  return ip == hostIp || ("," + destinationList + ",").indexOf("," + ip + ",") >= 0;
+}
+
+/**
+ * @brief hostIp，マルチキャストグループ，追加の送信先を合わせた数
+ */
+static int CountDestinations()
+{
+  int count = (hostIp.length() > 0 ? 1 : 0) + (multicastGroup.length() > 0 ? 1 : 0);
+  if (destinationList.length() > 0)
+  {
+    count++;
+    for (int i = 0; i < (int)destinationList.length(); i++)
+    {
+      if (destinationList[i] == ',')
+        count++;
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief 送信先の一覧を保存して送信タスクへ反映する
+ */
+static void SaveDestinations()
+{
+  QueueSetting(prefs::SettingsChange::Text(prefs::FieldDestinations, destinationList.c_str()));
+  QueueSetting(prefs::SettingsChange::Text(prefs::FieldMulticastGroup, multicastGroup.c_str()));
+  PublishStreamConfig();
+}
+
+/**
+ * @brief 起動時に設定のblobを1回で読み出す．blobがなければ旧形式のキーから移行する
+ */
+static void LoadSettings()
+{
+  prefs::SettingsData data;
+  if (!settingsService.load(data) && settingPref.readLegacy(data))
+  {
+    settingsService.replace(data, micros());
+    settingsService.flush();
+  }
+  for (int i = 0; i < 3; i++)
+    gyroOffset[i] = data.gyroOffset[i];
+  for (int i = 0; i < imu::bias::TempBiasBinNum; i++)
+  {
+    imu::bias::TempBiasBin bin;
+    bin.temp = data.tempBias.temp[i];
+    for (int axis = 0; axis < 3; axis++)
+      bin.bias[axis] = data.tempBias.bias[i][axis];
+    bin.weight = data.tempBias.weight[i];
+    tempBiasModel.setBin(i, bin);
+  }
+  if (data.uniqueId[0] != '\0')
+    uniqueId = data.uniqueId;
+  // hostIp は保存するが起動時には読み込まない (既定の送信先から始める)
+  destinationList = data.destinations;
+  multicastGroup = data.multicastGroup;
+  wifiCache = data.wifi;
+}
+
+/**
+ * @brief 設定の変更を保存タスクへ渡す．待たないため ImuLoop から呼んでもよい
+ * @brief 保存タスクが取り出す前に同じフィールドが変わったときは新しい値で上書きする (取りこぼさない)
+ */
+static void QueueSetting(const prefs::SettingsChange &change)
+{
+  if (change.field >= prefs::SettingsFieldNum || settingsQueues[change.field] == NULL)
+  {
+    settingsDropped++;
+    return;
+  }
+  xQueueOverwrite(settingsQueues[change.field], &change);
+  TaskHandle_t settingsTask = profiledTasks[ProfileSettings];
+  if (settingsTask != NULL)
+    xTaskNotifyGive(settingsTask);
+}
+
+/**
+ * @brief 設定の変更をまとめ，落ち着いてからNVSへ書き込む
+ * @brief フラッシュへの書き込み中は処理が止まるため，優先度の低いこのタスクだけがNVSに書く
+ */
+static void SettingsLoop(void *arg)
+{
+  while (1)
+  {
+    // タスクの生成前 (setup) に渡された変更もあるため，待つ前に全てのフィールドを見る
+    taskProfiles[ProfileSettings].begin(micros());
+    prefs::SettingsChange change;
+    for (int i = 0; i < prefs::SettingsFieldNum; i++)
+    {
+      if (xQueueReceive(settingsQueues[i], &change, 0) == pdTRUE)
+        settingsService.apply(change, micros());
+    }
+    settingsService.poll(micros());
+    taskProfiles[ProfileSettings].end(micros());
+
+    uint32_t dueMicros = settingsService.dueInMicros(micros());
+    TickType_t wait = (dueMicros == UINT32_MAX) ? portMAX_DELAY : pdMS_TO_TICKS(dueMicros / 1000) + 1;
+    ulTaskNotifyTake(pdTRUE, wait);
+  }
+}
+
+/**
+ * @brief 送信先が変わっていればアドレスとエンコード済みメッセージを作り直す
+ * @brief 変更がなければ何もしないため，送信周期毎にStringを組み立てずに済む
+ */
+static void RefreshStreamTarget()
+{
+  StreamConfig config;
+  uint32_t version;
+  if (!streamConfig.tryRead(config, version) || version == streamConfigVersion)
+    return;
+  streamConfigVersion = version;
+
+  transport.clear();
+  for (int i = 0; i < config.destinationCount; i++)
+    transport.addDestination(IPAddress(config.destinations[i]));
+  char addr[48];
+  snprintf(addr, sizeof(addr), "/%s%s", config.uniqueId, quat_addr);
+  quatMessage.encode(addr, ",ffff");
+  snprintf(addr, sizeof(addr), "/%s%s", config.uniqueId, twist_addr);
+  twistMessage.encode(addr, ",fffiii");
+  snprintf(imuAddr, sizeof(imuAddr), "/%s%s", config.uniqueId, imu_addr);
+  snprintf(traceAddr, sizeof(traceAddr), "/%s%s", config.uniqueId, trace_addr);
+  snprintf(telemetryAddr, sizeof(telemetryAddr), "/%s%s", config.uniqueId, telemetry_addr);
+  snprintf(telemetryTaskAddr, sizeof(telemetryTaskAddr), "/%s%s/task", config.uniqueId, telemetry_addr);
+  snprintf(telemetryBootAddr, sizeof(telemetryBootAddr), "/%s%s/boot", config.uniqueId, telemetry_addr);
+  snprintf(telemetryBiasAddr, sizeof(telemetryBiasAddr), "/%s%s/bias", config.uniqueId, telemetry_addr);
+  snprintf(telemetrySpinAddr, sizeof(telemetrySpinAddr), "/%s%s/spin", config.uniqueId, telemetry_addr);
+  snprintf(telemetryDropAddr, sizeof(telemetryDropAddr), "/%s%s/drop", config.uniqueId, telemetry_addr);
+  for (int i = 0; i < imu::gesture::GestureEventTypeNum; i++)
+    snprintf(eventAddr[i], sizeof(eventAddr[i]), "/%s%s/%s", config.uniqueId, event_addr,
+             imu::gesture::GestureEventName((imu::gesture::GestureEventType)i));
+  quatFrameDeviceId = imu::frame::DeviceIdFromName(config.uniqueId);
+}
+
+/**
+ * @brief エンコード済みのパケットを全ての送信先へ送る
+ */
+static void SendPacket(const uint8_t *data, size_t len, int port)
+{
+  uint32_t startCycles = ESP.getCycleCount();
+  transport.send(data, len, port);
+  pipelineStats.record(stats::StageSend, ESP.getCycleCount() - startCycles);
+  bootProfile.mark(stats::BootFirstPacket, micros());
+  packetsSent++;
+}
+
+/**
+ * @brief 区間毎の計測結果を /<uniqueId>/stats ,siffff (区間名, 件数, p50, p90, p99, 最大[us]) のバンドルで返す
+ */
+static void SendStats()
+{
+  static uint8_t reply[osc::OscPacketMaxLen];
+  String addr = "/" + uniqueId + stats_addr;
+  float usPerCycle = 1.0F / getCpuFrequencyMhz();
+  osc::OscPacketWriter writer(reply, sizeof(reply));
+  writer.beginBundle();
+  for (int i = 0; i < stats::StageNum; i++)
+  {
+    stats::Stage stage = (stats::Stage)i;
+    const stats::LatencyHistogram &h = pipelineStats.histogram(stage);
+    writer.beginMessage(addr.c_str(), ",siffff");
+    writer.writeString(stats::PipelineStats::StageName(stage));
+    writer.writeInt32((int32_t)h.count());
+    writer.writeFloat(h.percentile(0.5F) * usPerCycle);
+    writer.writeFloat(h.percentile(0.9F) * usPerCycle);
+    writer.writeFloat(h.percentile(0.99F) * usPerCycle);
+    writer.writeFloat(h.max() * usPerCycle);
+    if (!writer.endMessage())
+    {
+      writer.discardMessage();
+      break;
+    }
+  }
+  SendReplyToHost(writer);
+}
+
+/**
+ * @brief 受信タスクから hostIp の send_port へ返信する
+ */
+static void SendReplyToHost(const osc::OscPacketWriter &writer)
+{
+  IPAddress ip;
+  if (ip.fromString(hostIp))
+    oscReceiver.sendTo(writer.data(), writer.size(), (uint32_t)ip, send_port);
+}
+
+/**
+ * @brief 電源 / 通信状態とタスク毎の計測結果を1つのOSCバンドルで送る
+ * @brief /<uniqueId>/telemetry ,iiii (電池電圧[mV], RSSI[dBm], 空きヒープ[byte], 起動からの時間[ms])
+ * @brief /<uniqueId>/telemetry/task ,siiiffi (タスク名, 公称周期[us], 揺らぎp50[us], 揺らぎp99[us],
+ *        周期超過の割合[%], CPU使用率[%], スタック残量の最小値[byte]) をタスク毎に1つ
+ *        周期超過の割合とCPU使用率は前回の送信からの同じ区間の値
+ * @brief /<uniqueId>/telemetry/bias ,fiifff (IMUの温度[℃], 学習した温度区間の数, 1: 温度補正中,
+ *        差し引いているオフセット[deg/s] x, y, z)
+ * @brief /<uniqueId>/telemetry/spin ,iii (1: 高速回転モード, 角速度が振り切れたサンプル数,
+ *        加速度による補正を弱めたサンプル数) 数は起動 (/reset/imu) からの累計
+ * @brief /<uniqueId>/telemetry/drop ,ii (送信を待つ imuDataBuffer が満杯で捨てたサンプル数,
+ *        保存タスクへ渡せなかった設定の変更の数) 起動からの累計
+ * @brief /<uniqueId>/telemetry/boot ,iiiiiiii (WiFiの経路 stats::BootPath, 続いて stats::BootMark 毎の
+ *        リセットからの時刻[us]．0はまだ)
+ */
+static void SendTelemetry()
+{
+  uint32_t nowMicros = micros();
+  osc::OscPacketWriter writer(oscPacket, sizeof(oscPacket));
+  writer.beginBundle();
+  writer.beginMessage(telemetryAddr, ",iiii");
+  writer.writeInt32(batteryMilliVolts);
+  writer.writeInt32(WiFi.RSSI());
+  writer.writeInt32((int32_t)ESP.getFreeHeap());
+  writer.writeInt32((int32_t)millis());
+  writer.endMessage();
+  writer.beginMessage(telemetryBiasAddr, ",fiifff");
+  writer.writeFloat(imuTemperature);
+  writer.writeInt32(tempBiasBins);
+  writer.writeInt32(tempBiasActive ? 1 : 0);
+  for (int i = 0; i < 3; i++)
+    writer.writeFloat(appliedGyroOffset[i]);
+  writer.endMessage();
+  writer.beginMessage(telemetrySpinAddr, ",iii");
+  writer.writeInt32(highSpinEnabled ? 1 : 0);
+  writer.writeInt32((int32_t)gyroSaturations);
+  writer.writeInt32((int32_t)accelGatedSamples);
+  writer.endMessage();
+  writer.beginMessage(telemetryDropAddr, ",ii");
+  writer.writeInt32((int32_t)imuDataBuffer.dropped());
+  writer.writeInt32((int32_t)settingsDropped);
+  writer.endMessage();
+  writer.beginMessage(telemetryBootAddr, ",iiiiiiii");
+  writer.writeInt32(bootProfile.wifiPath());
+  for (int i = 0; i < stats::BootMarkNum; i++)
+    writer.writeInt32((int32_t)bootProfile.at((stats::BootMark)i));
+  writer.endMessage();
+  for (int i = 0; i < ProfileNum; i++)
+  {
+    stats::TaskProfiler &profile = taskProfiles[i];
+    stats::TaskWindow window = profile.takeWindow(nowMicros);
+    writer.beginMessage(telemetryTaskAddr, ",siiiffi");
+    writer.writeString(profile.name());
+    writer.writeInt32((int32_t)profile.periodMicros());
+    writer.writeInt32((int32_t)profile.jitter().percentile(0.5F));
+    writer.writeInt32((int32_t)profile.jitter().percentile(0.99F));
+    writer.writeFloat(100.0F * window.missRate);
+    writer.writeFloat(100.0F * window.cpuShare);
+    writer.writeInt32((profiledTasks[i] != NULL) ? (int32_t)uxTaskGetStackHighWaterMark(profiledTasks[i]) : -1);
+    if (!writer.endMessage())
+    {
+      writer.discardMessage();
+      break;
+    }
+  }
+  SendPacket(writer.data(), writer.size(), send_port);
+}
+
+/**
+ * @brief 現在の状態からLcdの各行の内容を作る．表示タスクから呼ぶ
+ *
+ * @param frame 行の内容を書き込む先
+ * @param rowHeight 1行の高さ[px]．画面の種類で変わる
+ */
+static void ComposeLcd(display::TextFrame &frame, int &rowHeight)
+{
+  static uint32_t lastPackets = 0;
+  static uint32_t lastRateMillis = 0;
+  static uint32_t txRate = 0;
+  static StreamConfig config; // 書き込み中に読めなかったときは前の表示のまま
+  enum Screen
+  {
+    ScreenNone,
+    ScreenMain,
+    ScreenCalibration,
+    ScreenStats
+  };
+  static Screen screen = ScreenNone;
+
+  Screen next = !gyroOffsetInstalled ? ScreenCalibration : (lcdStatsEnabled ? ScreenStats : ScreenMain);
+  if (next != screen)
+  {
+    screen = next;
+    rowHeight = (screen == ScreenStats) ? 8 : 16; // Font0 / Font2
+    frame.begin(M5.Lcd.height() / rowHeight);
+  }
+
+  if (screen == ScreenCalibration)
+  {
+    frame.setRow(0, TFT_BLACK, GREEN, "GyroOffset");
+    for (int i = 1; i < frame.rows(); i++)
+      frame.setRow(i, TFT_BLACK, GREEN, "%s", "");
+    return;
+  }
+  if (screen == ScreenStats)
+  {
+    // 区間毎の p50 / p99 [us]
+    float usPerCycle = 1.0F / getCpuFrequencyMhz();
+    for (int i = 0; i < frame.rows(); i++)
+    {
+      if (i >= stats::StageNum)
+      {
+        frame.setRow(i, TFT_WHITE, TFT_BLACK, "%s", "");
+        continue;
+      }
+      stats::Stage stage = (stats::Stage)i;
+      const stats::LatencyHistogram &h = pipelineStats.histogram(stage);
+      frame.setRow(i, TFT_WHITE, TFT_BLACK, "%-8s%8.0f%8.0f", stats::PipelineStats::StageName(stage),
+                   h.percentile(0.5F) * usPerCycle, h.percentile(0.99F) * usPerCycle);
+    }
+    return;
+  }
+
+  uint32_t now = millis();
+  if (now - lastRateMillis >= 1000)
+  {
+    uint32_t packets = packetsSent;
+    txRate = (packets - lastPackets) * 1000UL / (now - lastRateMillis);
+    lastPackets = packets;
+    lastRateMillis = now;
+  }
+  uint32_t configVersion;
+  streamConfig.tryRead(config, configVersion);
+  ImuSnapshot snapshot;
+  imuSnapshot.read(snapshot);
+  const int32_t *turns = snapshot.twistData.count;
+  frame.setRow(0, TFT_WHITE, TFT_BLACK, "Kaiten-Boh");
+  frame.setRow(1, TFT_WHITE, TFT_BLACK, "IP %s", WiFi.localIP().toString().c_str());
+  frame.setRow(2, TFT_WHITE, TFT_BLACK, "ID %s", config.uniqueId);
+  frame.setRow(3, TFT_YELLOW, TFT_BLACK, "turn %d %d %d", (int)turns[0], (int)turns[1], (int)turns[2]);
+  frame.setRow(4, TFT_WHITE, TFT_BLACK, "tx %u/s %ddBm %d.%02dV", (unsigned)txRate, (int)WiFi.RSSI(),
+               batteryMilliVolts / 1000, (batteryMilliVolts % 1000) / 10);
+}
+
+/**
+ * @brief Lcdへの描画を一手に引き受ける．ほかのタスクは UpdateLcd() で再描画を依頼するだけ
+ * @brief 1行分のスプライトに描いてから送り，内容が変わった行だけを転送する
+ */
+static void DisplayLoop(void *arg)
+{
+  static display::TextFrame frame;
+  M5Canvas rowCanvas(&M5.Lcd);
+  int rowHeight = 0;
+  int canvasHeight = 0;
+  uint32_t lastFrame = 0;
+  while (1)
+  {
+    // 依頼があるか DISPLAY_REFRESH_MS が経ったら描く．ただし DISPLAY_FRAME_MIN_MS より頻繁には描かない
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(DISPLAY_REFRESH_MS));
+    uint32_t sinceLast = millis() - lastFrame;
+    if (sinceLast < DISPLAY_FRAME_MIN_MS)
+      vTaskDelay(pdMS_TO_TICKS(DISPLAY_FRAME_MIN_MS - sinceLast));
+    lastFrame = millis();
+    taskProfiles[ProfileDisplay].begin(micros());
+
+    ComposeLcd(frame, rowHeight);
+    if (rowHeight != canvasHeight)
+    {
+      rowCanvas.deleteSprite();
+      rowCanvas.setColorDepth(16);
+      rowCanvas.createSprite(M5.Lcd.width(), rowHeight);
+      rowCanvas.setFont((rowHeight == 8) ? &fonts::Font0 : &fonts::Font2);
+      rowCanvas.setTextSize(1);
+      canvasHeight = rowHeight;
+    }
+    for (int i = 0; i < frame.rows(); i++)
+    {
+      if (!frame.isDirty(i))
+        continue;
+      rowCanvas.fillScreen(frame.background(i));
+      rowCanvas.setTextColor(frame.foreground(i), frame.background(i));
+      rowCanvas.setCursor(0, 0);
+      rowCanvas.print(frame.text(i));
+      rowCanvas.pushSprite(0, i * rowHeight);
+      frame.markClean(i);
+    }
+
+    taskProfiles[ProfileDisplay].end(micros());
   }
 }
 
@@ -345,16 +1854,35 @@ static void ReceiveOscLoop(void *arg)
 {
   while (1)
   {
-    uint32_t entryTime = millis();
+    // ポートを開けていなければ開き直す．失敗やエラーの間は待ってから試し直し，空回りしない
+    if (!oscReceiver.isOpen() && !oscReceiver.begin(bind_port))
+    {
+      vTaskDelay(pdMS_TO_TICKS(TASK_RETRY_RECEIVE_OSC));
+      continue;
+    }
 
-    // osc 受け取る
-    // ジャイロオフセットのアドレスだったらオフセットする
-    // ユニークID変更のアドレスだったら変更する
-    OscWiFi.update();
+    // コマンドが届くまで待つ
+    if (oscReceiver.wait(TASK_WAIT_RECEIVE_OSC) < 0)
+    {
+      oscReceiver.end();
+      vTaskDelay(pdMS_TO_TICKS(TASK_RETRY_RECEIVE_OSC));
+      continue;
+    }
+    taskProfiles[ProfileReceiveOsc].begin(micros());
 
-    // idle
-    int32_t sleep = TASK_SLEEP_RECEIVE_OSC - (millis() - entryTime);
-    vTaskDelay((sleep > 0) ? sleep : 0);
+    // 溜まっているパケットを全て処理する
+    uint32_t remoteAddr;
+    uint16_t remotePort;
+    int len;
+    while ((len = oscReceiver.receive(commandPacket, sizeof(commandPacket), remoteAddr, remotePort)) > 0)
+    {
+      uint32_t received = micros();
+      lastCommandMicros = received;
+      oscDispatcher.dispatch(commandPacket, len, remoteAddr, remotePort, received);
+      pipelineStats.recordMicros(stats::StageCommand, micros() - received, getCpuFrequencyMhz());
+    }
+
+    taskProfiles[ProfileReceiveOsc].end(micros());
   }
 }
 
@@ -364,9 +1892,49 @@ static void NotifyLoop(void *arg)
   {
     // todo: OSC受信時にLEDを点滅させる → 今動作していないので修正する
     xTaskNotifyWait(0, 0, NULL, portMAX_DELAY);
+    taskProfiles[ProfileNotify].begin(micros());
 
     digitalWrite(GPIO_NUM_10, LOW);
+    taskProfiles[ProfileNotify].end(micros());
     vTaskDelay(10);
     digitalWrite(GPIO_NUM_10, HIGH);
   }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief 記録の開始/終了要求を処理し，溜まったIMUの記録を指定の出力先へ書き出す
+ */
+static void DrainTrace()
+{
+  static uint8_t chunk[imu::trace::TraceHeaderLen + imu::trace::TraceChunkMaxLen];
+  if (traceStartRequested)
+  {
+    imu::trace::TraceHeader header;
+    header.sampleRateHz = ImuRateHz();
+    for (int i = 0; i < 3; i++)
+      header.gyroOffset[i] = gyroOffset[i];
+    traceRecorder.start(header);
+    traceStartRequested = false;
+  }
+  if (traceStopRequested)
+  {
+    traceRecorder.stop();
+    traceStopRequested = false;
+  }
+
+  size_t len;
+  while ((len = traceRecorder.drain(chunk, sizeof(chunk))) > 0)
+  {
+    if (traceSink == 0)
+    {
+      Serial.write(chunk, len);
+      continue;
+    }
+    osc::OscPacketWriter writer(oscPacket, sizeof(oscPacket));
+    writer.beginMessage(traceAddr, ",b");
+    writer.writeBlob(chunk, len);
+    if (!writer.endMessage())
+      continue;
+    SendPacket(writer.data(), writer.size(), send_port);
+  }
+}
@@ -0,0 +1,42 @@
+#include "ImuBundle.h"
+
+namespace osc
+{
+
+    /**
+     * @brief samples の先頭から，maxSamples 個かMTUに収まるまでを1つのバンドルに詰める
+     * @brief 残りは戻り値の分だけ samples を進めて再び呼び，続くバンドルで送る
+     *
+     * @param writer 書き込み先．呼ぶたびに先頭から書き直す
+     * @param addr /<uniqueId>/imu
+     * @param count samples の数
+     * @param maxSamples 1つのバンドルに詰める最大数
+     * @return int 詰めたサンプルの数．0: 1サンプルも収まらない (アドレスが長すぎる) か count が0
+     */
+    int WriteImuBundle(OscPacketWriter &writer, const char *addr, const imu::ImuData *samples, int count, int maxSamples)
+    {
+        if (!writer.beginBundle())
+            return 0;
+        int packed = 0;
+        while (packed < count && packed < maxSamples)
+        {
+            const imu::ImuData &d = samples[packed];
+            writer.beginMessage(addr, ",iffffffffff");
+            writer.writeInt32((int32_t)d.timestamp);
+            for (int j = 0; j < imu::ImuXyz; j++)
+                writer.writeFloat(d.acc[j]);
+            for (int j = 0; j < imu::ImuXyz; j++)
+                writer.writeFloat(d.gyro[j]);
+            for (int j = 0; j < imu::ImuWxyz; j++)
+                writer.writeFloat(d.quat[j]);
+            if (!writer.endMessage())
+            {
+                writer.discardMessage();
+                break;
+            }
+            packed++;
+        }
+        return packed;
+    }
+
+} // osc
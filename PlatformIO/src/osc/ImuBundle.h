@@ -0,0 +1,16 @@
+#pragma once
+#include <inttypes.h>
+#include "../imu/ImuData.h"
+#include "OscPacketWriter.h"
+
+namespace osc
+{
+
+    /**
+     * @brief IMUデータを1サンプル1メッセージとしてOSCバンドルに詰める
+     * @brief メッセージ: <addr> ,iffffffffff (timestamp, acc[3], gyro[3], quat[4])
+     * @brief 1回で1バンドルを詰めて詰めたサンプル数を返す．残りは samples を進めて呼び直す
+     */
+    int WriteImuBundle(OscPacketWriter &writer, const char *addr, const imu::ImuData *samples, int count, int maxSamples);
+
+} // osc
@@ -0,0 +1,98 @@
+#include <string.h>
+#include "OscDispatcher.h"
+
+namespace osc
+{
+
+    OscDispatcher::OscDispatcher() : count(0), unhandledCount(0) {}
+
+    /**
+     * @brief アドレスにハンドラを登録する
+     *
+     * @param address OSCアドレス (完全一致)
+     * @param typeTags 期待する引数の型 (例: ",ff")．引数なしは ""．i と f は互いに読み替える
+     * @param handler 一致したときに受信タスクで呼ぶ関数
+     * @return true 正常終了
+     * @return false 異常終了 登録数が多すぎる
+     */
+    bool OscDispatcher::subscribe(const char *address, const char *typeTags, OscHandler handler)
+    {
+        if (count >= OscDispatcherMaxHandlers)
+            return false;
+        entries[count].address = address;
+        entries[count].typeTags = (typeTags[0] == ',') ? typeTags + 1 : typeTags;
+        entries[count].handler = handler;
+        count++;
+        return true;
+    }
+
+    /**
+     * @brief 1つのUDPパケットを解析してハンドラを呼ぶ
+     *
+     * @return int 呼んだハンドラの数
+     */
+    int OscDispatcher::dispatch(const uint8_t *packet, size_t len, uint32_t remoteAddress, uint16_t remotePort,
+                                uint32_t receivedMicros)
+    {
+        reader.setSource(remoteAddress, remotePort, receivedMicros);
+        return dispatchElement(packet, len, 0);
+    }
+
+    int OscDispatcher::dispatchElement(const uint8_t *data, size_t len, int depth)
+    {
+        // バンドル: "#bundle\0" timetag(8byte) { size(4byte) element }*
+        if (len >= 16 && memcmp(data, "#bundle", 8) == 0)
+        {
+            if (depth >= OscDispatcherMaxBundleDepth)
+                return 0;
+            int handled = 0;
+            size_t pos = 16;
+            while (pos + 4 <= len)
+            {
+                uint32_t size = (uint32_t)data[pos] << 24 | (uint32_t)data[pos + 1] << 16 |
+                                (uint32_t)data[pos + 2] << 8 | (uint32_t)data[pos + 3];
+                pos += 4;
+                if (size > len - pos)
+                    break;
+                handled += dispatchElement(data + pos, size, depth + 1);
+                pos += size;
+            }
+            return handled;
+        }
+
+        if (!reader.parse(data, len))
+        {
+            unhandledCount++;
+            return 0;
+        }
+        for (int i = 0; i < count; i++)
+        {
+            if (strcmp(entries[i].address, reader.address()) == 0 &&
+                ArgsMatch(entries[i].typeTags, reader.typeTags()))
+            {
+                entries[i].handler(reader);
+                return 1;
+            }
+        }
+        unhandledCount++;
+        return 0;
+    }
+
+    /**
+     * @brief 受信した引数が期待する型の並びを満たすか．余分な引数は無視する
+     */
+    bool OscDispatcher::ArgsMatch(const char *expected, const char *actual)
+    {
+        for (; *expected != '\0'; expected++, actual++)
+        {
+            if (*actual == '\0')
+                return false;
+            bool expectedNumber = *expected == 'i' || *expected == 'f';
+            bool actualNumber = *actual == 'i' || *actual == 'f';
+            if (expectedNumber ? !actualNumber : *expected != *actual)
+                return false;
+        }
+        return true;
+    }
+
+} // osc
@@ -0,0 +1,43 @@
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+#include "OscMessageReader.h"
+
+namespace osc
+{
+
+    static const int OscDispatcherMaxHandlers = 48;
+    static const int OscDispatcherMaxBundleDepth = 4;
+
+    typedef void (*OscHandler)(const OscMessageReader &message);
+
+    /**
+     * @brief 受信したパケット (メッセージまたはバンドル) をアドレス毎のハンドラへ振り分ける
+     * @brief アドレスは完全一致で比較する．登録は起動時に行い，以降は1つのタスクからだけ dispatch() を呼ぶ
+     */
+    class OscDispatcher
+    {
+    public:
+        explicit OscDispatcher();
+        bool subscribe(const char *address, const char *typeTags, OscHandler handler);
+        int dispatch(const uint8_t *packet, size_t len, uint32_t remoteAddress, uint16_t remotePort,
+                     uint32_t receivedMicros);
+        uint32_t unhandled() const { return unhandledCount; }
+
+    private:
+        struct Entry
+        {
+            const char *address;
+            const char *typeTags; // 先頭の','を除いた期待する引数の型
+            OscHandler handler;
+        };
+
+        Entry entries[OscDispatcherMaxHandlers];
+        int count;
+        uint32_t unhandledCount;
+        OscMessageReader reader;
+        int dispatchElement(const uint8_t *data, size_t len, int depth);
+        static bool ArgsMatch(const char *expected, const char *actual);
+    };
+
+} // osc
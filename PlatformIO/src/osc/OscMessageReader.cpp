@@ -0,0 +1,132 @@
+#include <string.h>
+#include "OscMessageReader.h"
+
+namespace osc
+{
+
+    /**
+     * @brief 4byte境界に揃えられた'\0'終端の文字列を読み飛ばす
+     *
+     * @return size_t 次の要素の位置．文字列が終端されていなければ0
+     */
+    static size_t SkipString(const uint8_t *data, size_t len, size_t pos)
+    {
+        const void *end = memchr(data + pos, '\0', len - pos);
+        if (end == NULL)
+            return 0;
+        size_t next = (((const uint8_t *)end - data) + 4) & ~(size_t)3;
+        return (next <= len) ? next : 0;
+    }
+
+    OscMessageReader::OscMessageReader()
+        : buffer(NULL), addr(""), tags(""), count(0), srcAddress(0), srcPort(0), received(0)
+    {
+    }
+
+    /**
+     * @brief メッセージを解析する．dataは読み終わるまで保持すること
+     *
+     * @return true 正常終了
+     * @return false 異常終了 OSCメッセージではないか，未対応の型を含む
+     */
+    bool OscMessageReader::parse(const uint8_t *data, size_t len)
+    {
+        buffer = data;
+        addr = "";
+        tags = "";
+        count = 0;
+        if (len < 4 || data[0] != '/')
+            return false;
+        size_t pos = SkipString(data, len, 0);
+        if (pos == 0)
+            return false;
+        addr = (const char *)data;
+
+        // タイプタグのない古い形式は引数なしとして扱う
+        if (pos == len)
+            return true;
+        if (data[pos] != ',')
+            return false;
+        size_t argPos = SkipString(data, len, pos);
+        if (argPos == 0)
+            return false;
+        tags = (const char *)data + pos + 1;
+
+        for (const char *t = tags; *t != '\0'; t++)
+        {
+            if (count >= OscMessageMaxArgs)
+                return false;
+            argOffsets[count] = argPos;
+            switch (*t)
+            {
+            case 'i':
+            case 'f':
+                argPos += 4;
+                if (argPos > len)
+                    return false;
+                break;
+            case 's':
+                argPos = SkipString(data, len, argPos);
+                if (argPos == 0)
+                    return false;
+                break;
+            default:
+                return false;
+            }
+            count++;
+        }
+        return true;
+    }
+
+    /**
+     * @brief 送信元と受信時刻を記録する (返信や遅延の計測に使う)
+     */
+    void OscMessageReader::setSource(uint32_t address, uint16_t port, uint32_t receivedMicros)
+    {
+        srcAddress = address;
+        srcPort = port;
+        received = receivedMicros;
+    }
+
+    char OscMessageReader::argType(int index) const
+    {
+        return (index >= 0 && index < count) ? tags[index] : '\0';
+    }
+
+    int32_t OscMessageReader::getInt32(int index) const
+    {
+        char type = argType(index);
+        if (type == 'i')
+            return (int32_t)readUint32(index);
+        if (type == 'f')
+            return (int32_t)getFloat(index);
+        return 0;
+    }
+
+    float OscMessageReader::getFloat(int index) const
+    {
+        char type = argType(index);
+        if (type == 'f')
+        {
+            uint32_t bits = readUint32(index);
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        if (type == 'i')
+            return (float)(int32_t)readUint32(index);
+        return 0.0F;
+    }
+
+    const char *OscMessageReader::getString(int index) const
+    {
+        return (argType(index) == 's') ? (const char *)buffer + argOffsets[index] : "";
+    }
+
+    uint32_t OscMessageReader::readUint32(int index) const
+    {
+        const uint8_t *p = buffer + argOffsets[index];
+        return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
+    }
+
+} // osc
@@ -0,0 +1,43 @@
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+
+namespace osc
+{
+
+    static const int OscMessageMaxArgs = 16;
+
+    /**
+     * @brief 受信したOSCメッセージを読む．文字列は受信バッファを指すためコピーしない
+     * @brief 引数の型は i, f, s に対応し，i と f は互いに変換して読める
+     */
+    class OscMessageReader
+    {
+    public:
+        explicit OscMessageReader();
+        bool parse(const uint8_t *data, size_t len);
+        void setSource(uint32_t address, uint16_t port, uint32_t receivedMicros);
+        const char *address() const { return addr; }
+        const char *typeTags() const { return tags; } // 先頭の','を除いたもの
+        int argCount() const { return count; }
+        char argType(int index) const;
+        int32_t getInt32(int index) const;
+        float getFloat(int index) const;
+        const char *getString(int index) const;
+        uint32_t remoteAddress() const { return srcAddress; } // IPv4 (ネットワークバイトオーダーのまま)
+        uint16_t remotePort() const { return srcPort; }
+        uint32_t receivedMicros() const { return received; }
+
+    private:
+        const uint8_t *buffer;
+        const char *addr;
+        const char *tags;
+        int count;
+        size_t argOffsets[OscMessageMaxArgs];
+        uint32_t srcAddress;
+        uint16_t srcPort;
+        uint32_t received;
+        uint32_t readUint32(int index) const;
+    };
+
+} // osc
@@ -0,0 +1,165 @@
+#include <string.h>
+#include "OscPacketWriter.h"
+
+namespace osc
+{
+
+    OscPacketWriter::OscPacketWriter(uint8_t *buffer, size_t capacity)
+        : buffer(buffer), capacity(capacity)
+    {
+        reset();
+    }
+
+    /**
+     * @brief 書き込み位置を先頭に戻す
+     */
+    void OscPacketWriter::reset()
+    {
+        length = 0;
+        messageStart = 0;
+        inBundle = false;
+        overflow = false;
+    }
+
+    /**
+     * @brief バンドルのヘッダを書き込む．以降のメッセージはバンドル要素になる
+     *
+     * @param timetag NTP形式のタイムタグ
+     * @return true 正常終了
+     * @return false 異常終了 バッファ不足
+     */
+    bool OscPacketWriter::beginBundle(uint64_t timetag)
+    {
+        reset();
+        inBundle = true;
+        return writeString("#bundle") &&
+               writeUint32((uint32_t)(timetag >> 32)) &&
+               writeUint32((uint32_t)(timetag & 0xFFFFFFFFUL));
+    }
+
+    /**
+     * @brief メッセージのアドレスとタイプタグを書き込む
+     *
+     * @param addr OSCアドレス
+     * @param typeTags 先頭の','を含むタイプタグ (例: ",iff")
+     * @return true 正常終了
+     * @return false 異常終了 バッファ不足
+     */
+    bool OscPacketWriter::beginMessage(const char *addr, const char *typeTags)
+    {
+        if (!inBundle)
+        {
+            reset();
+        }
+        else
+        {
+            messageStart = length;
+            if (!writeUint32(0)) // endMessage()でサイズを埋める
+                return false;
+        }
+        return writeString(addr) && writeString(typeTags);
+    }
+
+    bool OscPacketWriter::writeInt32(int32_t value)
+    {
+        return writeUint32((uint32_t)value);
+    }
+
+    bool OscPacketWriter::writeFloat(float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return writeUint32(bits);
+    }
+
+    /**
+     * @brief blob引数 (タイプタグ 'b') を書き込む
+     *
+     * @param data 書き込むバイト列
+     * @param len バイト数
+     * @return true 正常終了
+     * @return false 異常終了 バッファ不足
+     */
+    bool OscPacketWriter::writeBlob(const uint8_t *data, size_t len)
+    {
+        size_t padded = (len + 3) & ~(size_t)3;
+        if (!writeUint32((uint32_t)len))
+            return false;
+        if (!hasRoom(padded))
+        {
+            overflow = true;
+            return false;
+        }
+        memcpy(buffer + length, data, len);
+        memset(buffer + length + len, 0, padded - len);
+        length += padded;
+        return true;
+    }
+
+    /**
+     * @brief メッセージを閉じる．バンドル内ならば要素サイズを確定する
+     *
+     * @return true 正常終了
+     * @return false 異常終了 書き込み中にバッファが不足した
+     */
+    bool OscPacketWriter::endMessage()
+    {
+        if (overflow)
+            return false;
+        if (inBundle)
+        {
+            uint32_t elementLen = (uint32_t)(length - messageStart - 4);
+            buffer[messageStart + 0] = (uint8_t)(elementLen >> 24);
+            buffer[messageStart + 1] = (uint8_t)(elementLen >> 16);
+            buffer[messageStart + 2] = (uint8_t)(elementLen >> 8);
+            buffer[messageStart + 3] = (uint8_t)(elementLen);
+        }
+        return true;
+    }
+
+    /**
+     * @brief 書き込み途中のバンドル要素を取り消す．バッファ不足時に直前の要素までを送るために使う
+     */
+    void OscPacketWriter::discardMessage()
+    {
+        if (inBundle)
+            length = messageStart;
+        else
+            reset();
+        overflow = false;
+    }
+
+    bool OscPacketWriter::writeUint32(uint32_t value)
+    {
+        if (overflow || !hasRoom(4))
+        {
+            overflow = true;
+            return false;
+        }
+        // OSCはビッグエンディアン
+        buffer[length++] = (uint8_t)(value >> 24);
+        buffer[length++] = (uint8_t)(value >> 16);
+        buffer[length++] = (uint8_t)(value >> 8);
+        buffer[length++] = (uint8_t)(value);
+        return true;
+    }
+
+    /**
+     * @brief 文字列引数 (タイプタグ 's') またはアドレス / タイプタグを書き込む
+     */
+    bool OscPacketWriter::writeString(const char *str)
+    {
+        size_t len = strlen(str);
+        size_t padded = (len + 4) & ~(size_t)3; // 終端の'\0'を含めて4byte境界に揃える
+        if (overflow || !hasRoom(padded))
+        {
+            overflow = true;
+            return false;
+        }
+        memcpy(buffer + length, str, len);
+        memset(buffer + length + len, 0, padded - len);
+        length += padded;
+        return true;
+    }
+
+} // osc
@@ -0,0 +1,42 @@
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+
+namespace osc
+{
+
+    static const size_t OscPacketMaxLen = 1472; // 1500(MTU) - 20(IP) - 8(UDP)
+
+    /**
+     * @brief 呼び出し側のバッファにOSCメッセージ/バンドルをエンコードする
+     * @brief ヒープを使わないため，送信タスクから毎周期呼んでもよい
+     */
+    class OscPacketWriter
+    {
+    public:
+        explicit OscPacketWriter(uint8_t *buffer, size_t capacity);
+        void reset();
+        bool beginBundle(uint64_t timetag = 1ULL); // 1: immediately
+        bool beginMessage(const char *addr, const char *typeTags);
+        bool writeInt32(int32_t value);
+        bool writeFloat(float value);
+        bool writeString(const char *str);
+        bool writeBlob(const uint8_t *data, size_t len);
+        bool endMessage();
+        void discardMessage();
+        bool hasRoom(size_t len) const { return len <= capacity - length; }
+        const uint8_t *data() const { return buffer; }
+        size_t size() const { return length; }
+        bool overflowed() const { return overflow; }
+
+    private:
+        uint8_t *buffer;
+        size_t capacity;
+        size_t length;
+        size_t messageStart; // バンドル要素のサイズ欄の位置
+        bool inBundle;
+        bool overflow;
+        bool writeUint32(uint32_t value);
+    };
+
+} // osc
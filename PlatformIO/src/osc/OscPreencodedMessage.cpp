@@ -0,0 +1,62 @@
+#include <string.h>
+#include "OscPreencodedMessage.h"
+#include "OscPacketWriter.h"
+
+namespace osc
+{
+
+    OscPreencodedMessage::OscPreencodedMessage() : length(0), argsOffset(0), argCount(0) {}
+
+    /**
+     * @brief アドレスとタイプタグをエンコードし，引数を0で埋める．宛先の変更時にだけ呼ぶ
+     *
+     * @param addr OSCアドレス
+     * @param typeTags 先頭の','を含むタイプタグ．'i'と'f'のみ使える
+     * @return true 正常終了
+     * @return false 異常終了 対応していない型かバッファ不足
+     */
+    bool OscPreencodedMessage::encode(const char *addr, const char *typeTags)
+    {
+        length = 0;
+        int count = (int)strlen(typeTags) - 1;
+        for (int i = 1; typeTags[i] != '\0'; i++)
+        {
+            if (typeTags[i] != 'i' && typeTags[i] != 'f')
+                return false;
+        }
+
+        OscPacketWriter writer(buffer, sizeof(buffer));
+        if (!writer.beginMessage(addr, typeTags))
+            return false;
+        size_t offset = writer.size();
+        for (int i = 0; i < count; i++)
+        {
+            if (!writer.writeInt32(0))
+                return false;
+        }
+        argsOffset = offset;
+        argCount = count;
+        length = writer.size();
+        return true;
+    }
+
+    void OscPreencodedMessage::setInt32(int index, int32_t value)
+    {
+        if (index < 0 || index >= argCount)
+            return;
+        uint8_t *p = buffer + argsOffset + index * 4;
+        uint32_t v = (uint32_t)value;
+        p[0] = (uint8_t)(v >> 24);
+        p[1] = (uint8_t)(v >> 16);
+        p[2] = (uint8_t)(v >> 8);
+        p[3] = (uint8_t)(v);
+    }
+
+    void OscPreencodedMessage::setFloat(int index, float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        setInt32(index, (int32_t)bits);
+    }
+
+} // osc
@@ -0,0 +1,32 @@
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+
+namespace osc
+{
+
+    static const size_t OscPreencodedMaxLen = 128;
+
+    /**
+     * @brief アドレスとタイプタグをエンコード済みのOSCメッセージ
+     * @brief 引数は全て4byte (i, f) とし，送信毎に値だけをその場で書き換える
+     */
+    class OscPreencodedMessage
+    {
+    public:
+        explicit OscPreencodedMessage();
+        bool encode(const char *addr, const char *typeTags);
+        void setInt32(int index, int32_t value);
+        void setFloat(int index, float value);
+        bool isEncoded() const { return length > 0; }
+        const uint8_t *data() const { return buffer; }
+        size_t size() const { return length; }
+
+    private:
+        uint8_t buffer[OscPreencodedMaxLen];
+        size_t length;
+        size_t argsOffset;
+        int argCount;
+    };
+
+} // osc
@@ -0,0 +1,115 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "OscReceiver.h"
+
+namespace osc
+{
+
+    OscReceiver::OscReceiver() : sock(-1) {}
+
+    OscReceiver::~OscReceiver()
+    {
+        end();
+    }
+
+    /**
+     * @brief ポートを開く．WiFiに接続した後に呼ぶこと
+     *
+     * @param port 受信するポート
+     * @return true 正常終了
+     * @return false 異常終了 ソケットを作れないかポートが使用中
+     */
+    bool OscReceiver::begin(uint16_t port)
+    {
+        end();
+        sock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock < 0)
+            return false;
+        int reuse = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port);
+        if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            end();
+            return false;
+        }
+        return true;
+    }
+
+    void OscReceiver::end()
+    {
+        if (sock >= 0)
+        {
+            close(sock);
+            sock = -1;
+        }
+    }
+
+    /**
+     * @brief パケットが届くまで待つ．待っている間タスクはCPUを使わない
+     *
+     * @param timeoutMs 最長の待ち時間[ms]
+     * @return int 1: 受信できるパケットがある, 0: タイムアウト, 負: エラー (ソケットが開いていない場合を含む．待たずに戻る)
+     */
+    int OscReceiver::wait(uint32_t timeoutMs)
+    {
+        if (sock < 0)
+            return -1;
+        fd_set readFds;
+        FD_ZERO(&readFds);
+        FD_SET(sock, &readFds);
+        struct timeval timeout;
+        timeout.tv_sec = timeoutMs / 1000;
+        timeout.tv_usec = (timeoutMs % 1000) * 1000;
+        int ready = select(sock + 1, &readFds, NULL, NULL, &timeout);
+        if (ready < 0)
+            return (errno == EINTR) ? 0 : -1;
+        return (ready > 0) ? 1 : 0;
+    }
+
+    /**
+     * @brief 届いているパケットを1つ読む．なければ待たずに戻る
+     *
+     * @param outAddress 送信元のIPv4アドレス (ネットワークバイトオーダー)
+     * @param outPort 送信元のポート
+     * @return int 読んだバイト数．パケットがなければ0，エラーは負
+     */
+    int OscReceiver::receive(uint8_t *buffer, size_t capacity, uint32_t &outAddress, uint16_t &outPort)
+    {
+        if (sock < 0)
+            return -1;
+        struct sockaddr_in from;
+        socklen_t fromLen = sizeof(from);
+        int len = (int)recvfrom(sock, buffer, capacity, MSG_DONTWAIT, (struct sockaddr *)&from, &fromLen);
+        if (len < 0)
+            return (errno == EWOULDBLOCK || errno == EAGAIN) ? 0 : -1;
+        outAddress = from.sin_addr.s_addr;
+        outPort = ntohs(from.sin_port);
+        return len;
+    }
+
+    /**
+     * @brief 受信用のソケットから返信を送る (/ping への /pong など)
+     */
+    bool OscReceiver::sendTo(const uint8_t *data, size_t len, uint32_t address, uint16_t port)
+    {
+        if (sock < 0)
+            return false;
+        struct sockaddr_in to;
+        memset(&to, 0, sizeof(to));
+        to.sin_family = AF_INET;
+        to.sin_addr.s_addr = address;
+        to.sin_port = htons(port);
+        return sendto(sock, data, len, 0, (struct sockaddr *)&to, sizeof(to)) == (int)len;
+    }
+
+} // osc
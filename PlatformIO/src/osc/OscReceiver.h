@@ -0,0 +1,28 @@
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+
+namespace osc
+{
+
+    /**
+     * @brief コマンド受信用のUDPソケット．パケットが届くまでタスクを眠らせる
+     * @brief BSDソケットのみを使うため，ESP32 (lwIP) とホストのどちらでも動く
+     */
+    class OscReceiver
+    {
+    public:
+        explicit OscReceiver();
+        ~OscReceiver();
+        bool begin(uint16_t port);
+        void end();
+        bool isOpen() const { return sock >= 0; }
+        int wait(uint32_t timeoutMs);
+        int receive(uint8_t *buffer, size_t capacity, uint32_t &outAddress, uint16_t &outPort);
+        bool sendTo(const uint8_t *data, size_t len, uint32_t address, uint16_t port);
+
+    private:
+        int sock;
+    };
+
+} // osc
@@ -0,0 +1,58 @@
+#include "OscTransport.h"
+
+namespace osc
+{
+
+    OscTransport::OscTransport(WiFiUDP &udp) : udp(udp), count(0), errors(0) {}
+
+    /**
+     * @brief 送信先を追加する
+     *
+     * @param ip 送信先のアドレス (ユニキャストまたはマルチキャストグループ)
+     * @return true 正常終了 (登録済みの場合も含む)
+     * @return false 異常終了 0.0.0.0 か送信先が多すぎる
+     */
+    bool OscTransport::addDestination(const IPAddress &ip)
+    {
+        uint32_t addr = (uint32_t)ip;
+        if (addr == 0)
+            return false;
+        for (int i = 0; i < count; i++)
+        {
+            if (destinations[i] == addr)
+                return true;
+        }
+        if (count >= TransportMaxDestinations)
+            return false;
+        destinations[count++] = addr;
+        return true;
+    }
+
+    /**
+     * @brief 全ての送信先へ同じパケットを送る
+     *
+     * @param data 送信するパケット
+     * @param len バイト数
+     * @param port 送信先のポート
+     * @return int 送信できた宛先の数
+     */
+    int OscTransport::send(const uint8_t *data, size_t len, uint16_t port)
+    {
+        int sent = 0;
+        for (int i = 0; i < count; i++)
+        {
+            if (udp.beginPacket(IPAddress(destinations[i]), port) &&
+                udp.write(data, len) == len &&
+                udp.endPacket())
+            {
+                sent++;
+            }
+            else
+            {
+                errors++;
+            }
+        }
+        return sent;
+    }
+
+} // osc
@@ -0,0 +1,36 @@
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+#include <IPAddress.h>
+#include <WiFiUdp.h>
+
+namespace osc
+{
+
+    static const int TransportMaxDestinations = 6; // hostIp + 追加の送信先 + マルチキャストグループ
+
+    /**
+     * @brief 同じパケットを複数の送信先 (ユニキャスト / マルチキャストグループ) へ送る
+     * @brief マルチキャストグループ (224.0.0.0/4) も送信側では通常の宛先と同じに扱える
+     */
+    class OscTransport
+    {
+    public:
+        explicit OscTransport(WiFiUDP &udp);
+        void clear() { count = 0; }
+        bool addDestination(const IPAddress &ip);
+        int destinationCount() const { return count; }
+        IPAddress destination(int index) const { return IPAddress(destinations[index]); }
+        int send(const uint8_t *data, size_t len, uint16_t port);
+        uint32_t sendErrors() const { return errors; }
+
+        static bool IsMulticast(const IPAddress &ip) { return (ip[0] & 0xF0) == 0xE0; }
+
+    private:
+        WiFiUDP &udp;
+        uint32_t destinations[TransportMaxDestinations];
+        int count;
+        uint32_t errors;
+    };
+
+} // osc
@@ -0,0 +1,90 @@
+#include <math.h>
+#include "SendScheduler.h"
+
+namespace osc
+{
+
+    SendScheduler::SendScheduler() : hasSent(false), lastSentMicros(0), lastSentTimestamp(0)
+    {
+        configure(SendDefaultAngleDeg, SendDefaultFastGyroDps, SendDefaultMaxRateHz, SendDefaultKeepaliveMs);
+        lastSentQuat[0] = 1.0F;
+        lastSentQuat[1] = 0.0F;
+        lastSentQuat[2] = 0.0F;
+        lastSentQuat[3] = 0.0F;
+    }
+
+    /**
+     * @brief 送信条件を設定する
+     *
+     * @param angleDeg 前回送った姿勢からの回転角[deg]がこれ以上なら送る
+     * @param fastGyroDps 角速度の大きさ[deg/s]がこれ以上なら送る
+     * @param maxRateHz 送信レートの上限[Hz]
+     * @param keepaliveMs 変化がなくてもこの間隔[ms]で送る
+     */
+    void SendScheduler::configure(float angleDeg, float fastGyroDps, int maxRateHz, int keepaliveMs)
+    {
+        if (angleDeg < 0.0F)
+            angleDeg = 0.0F;
+        if (fastGyroDps < 0.0F)
+            fastGyroDps = 0.0F;
+        if (maxRateHz < 1)
+            maxRateHz = 1;
+        if (keepaliveMs < 1)
+            keepaliveMs = 1;
+        sinHalfAngleThreshold = sinf(angleDeg * 0.5F * 0.01745329252F);
+        fastGyroSq = fastGyroDps * fastGyroDps;
+        minInterval = 1000000UL / (uint32_t)maxRateHz;
+        keepaliveInterval = (uint32_t)keepaliveMs * 1000UL;
+    }
+
+    /**
+     * @brief 最新のサンプルを送るべきかを判定する．trueを返したときは送ったものとして記録する
+     *
+     * @param sample 最新のIMUデータ
+     * @param nowMicros 現在時刻[us]
+     * @return true 送る
+     * @return false 送らない
+     */
+    bool SendScheduler::shouldSend(const imu::ImuData &sample, uint32_t nowMicros)
+    {
+        bool send = false;
+        if (!hasSent)
+        {
+            send = true;
+        }
+        else
+        {
+            uint32_t elapsed = nowMicros - lastSentMicros;
+            if (elapsed >= keepaliveInterval)
+            {
+                send = true;
+            }
+            else if (elapsed >= minInterval && sample.timestamp != lastSentTimestamp)
+            {
+                // 前回送った姿勢からの相対回転 conj(last) * q のベクトル部のノルムが sin(θ/2)
+                const float *a = lastSentQuat;
+                const float *b = sample.quat;
+                float x = a[0] * b[1] - a[1] * b[0] - a[2] * b[3] + a[3] * b[2];
+                float y = a[0] * b[2] + a[1] * b[3] - a[2] * b[0] - a[3] * b[1];
+                float z = a[0] * b[3] - a[1] * b[2] + a[2] * b[1] - a[3] * b[0];
+                float sinHalfSq = x * x + y * y + z * z;
+                float gyroSq = sample.gyro[0] * sample.gyro[0] +
+                               sample.gyro[1] * sample.gyro[1] +
+                               sample.gyro[2] * sample.gyro[2];
+                send = sinHalfSq >= sinHalfAngleThreshold * sinHalfAngleThreshold ||
+                       gyroSq >= fastGyroSq;
+            }
+        }
+
+        if (send)
+        {
+            hasSent = true;
+            lastSentMicros = nowMicros;
+            lastSentTimestamp = sample.timestamp;
+            for (int i = 0; i < imu::ImuWxyz; i++)
+                lastSentQuat[i] = sample.quat[i];
+        }
+        return send;
+    }
+
+} // osc
@@ -0,0 +1,38 @@
+#pragma once
+#include <inttypes.h>
+#include "../imu/ImuData.h"
+
+namespace osc
+{
+
+    static const float SendDefaultAngleDeg = 0.5F;     // 前回送った姿勢からこれ以上回ったら送る
+    static const float SendDefaultFastGyroDps = 90.0F; // 角速度がこれ以上なら毎周期送る
+    static const int SendDefaultMaxRateHz = 100;
+    static const int SendDefaultKeepaliveMs = 1000;
+
+    /**
+     * @brief 姿勢の変化量に応じて送信するかどうかを決める
+     * @brief 動いている間は最大レートで，静止中はキープアライブの間隔でだけ送る
+     * @brief shouldSend() がtrueを返したサンプルは送ったものとして次の判定の基準になる
+     */
+    class SendScheduler
+    {
+    public:
+        explicit SendScheduler();
+        void configure(float angleDeg, float fastGyroDps, int maxRateHz, int keepaliveMs);
+        bool shouldSend(const imu::ImuData &sample, uint32_t nowMicros);
+        void reset() { hasSent = false; }
+        uint32_t minIntervalMicros() const { return minInterval; }
+
+    private:
+        float sinHalfAngleThreshold; // 角度の比較を sin(θ/2) で行い，逆三角関数を避ける
+        float fastGyroSq;            // [(deg/s)^2]
+        uint32_t minInterval;        // [us]
+        uint32_t keepaliveInterval;  // [us]
+        bool hasSent;
+        uint32_t lastSentMicros;
+        uint32_t lastSentTimestamp;
+        float lastSentQuat[imu::ImuWxyz];
+    };
+
+} // osc
@@ -0,0 +1,23 @@
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+
+namespace prefs
+{
+
+    /**
+     * @brief 設定のblobを1回の操作で読み書きする保存先
+     * @brief 実機では prefs::Settings (NVS)，ホストではファイルを使う
+     */
+    class BlobStore
+    {
+    public:
+        virtual ~BlobStore() {}
+        /**
+         * @return size_t 読んだバイト数．0: 保存されていないか capacity に収まらない
+         */
+        virtual size_t load(uint8_t *out, size_t capacity) = 0;
+        virtual bool store(const uint8_t *blob, size_t len) = 0;
+    };
+
+} // prefs
@@ -31,15 +31,65 @@ namespace prefs
     }
 
     /**
-     * @brief ジャイロのオフセット値を書き込む
+     * @brief 設定のblobを読み出す
      *
-     * @param gyroOffset 書き込むジャイロのオフセット値配列のアドレス
+     * @return size_t 読んだバイト数．0: 保存されていないか capacity に収まらない
      */
-    void Settings::writeGyroOffset(const float *gyroOffset)
+    size_t Settings::load(uint8_t *out, size_t capacity)
     {
-        preferences.putFloat(PrefDataKey_gyroOffsetX, gyroOffset[0]);
-        preferences.putFloat(PrefDataKey_gyroOffsetY, gyroOffset[1]);
-        preferences.putFloat(PrefDataKey_gyroOffsetZ, gyroOffset[2]);
+        if (!preferences.begin(PrefNameSpaceKey, true))
+            return 0;
+        size_t len = preferences.getBytesLength(PrefDataKey_settingsBlob);
+        if (len == 0 || len > capacity)
+        {
+            preferences.end();
+            return 0;
+        }
+        len = preferences.getBytes(PrefDataKey_settingsBlob, out, len);
+        preferences.end();
+        return len;
+    }
+
+    /**
+     * @brief 設定のblobを1回で書き込む
+     *
+     * @return true 正常終了
+     * @return false 異常終了 NVSを開けないか書き込めない
+     */
+    bool Settings::store(const uint8_t *blob, size_t len)
+    {
+        if (!preferences.begin(PrefNameSpaceKey, false))
+            return false;
+        bool ok = preferences.putBytes(PrefDataKey_settingsBlob, blob, len) == len;
+        preferences.end();
+        return ok;
+    }
+
+    /**
+     * @brief キー毎に保存していた旧形式の設定を読み出す．blobがないときの移行に使う
+     *
+     * @return true 正常終了 旧形式の設定が1つ以上あった
+     * @return false 異常終了 旧形式の設定もない
+     */
+    bool Settings::readLegacy(SettingsData &outData)
+    {
+        SettingsData data;
+        String uniqueId, hostIp, destinations, group;
+        begin();
+        bool found = readGyroOffset(data.gyroOffset);
+        found |= readUniqueId(uniqueId);
+        found |= readHostIp(hostIp);
+        found |= readDestinations(destinations);
+        found |= readMulticastGroup(group);
+        finish();
+        if (uniqueId != "default")
+            strlcpy(data.uniqueId, uniqueId.c_str(), sizeof(data.uniqueId));
+        if (hostIp != "192.168.20.50")
+            strlcpy(data.hostIp, hostIp.c_str(), sizeof(data.hostIp));
+        strlcpy(data.destinations, destinations.c_str(), sizeof(data.destinations));
+        strlcpy(data.multicastGroup, group.c_str(), sizeof(data.multicastGroup));
+        outData = data;
+        return found;
     }
 
     /**
@@ -60,26 +110,28 @@ namespace prefs
         return x != 0.0F || y != 0.0F || z != 0.0F;
     }
 
-    void Settings::writeUniqueId(const String &uniqueId)
-    {
-        preferences.putString(PrefDataKey_uniqueId, uniqueId);
-    }
-
     bool Settings::readUniqueId(String &uniqueId)
     {
         uniqueId = preferences.getString(PrefDataKey_uniqueId, "default");
         return uniqueId != "default";
     }
 
-    void Settings::writeHostIp(const String &hostIp)
-    {
-        preferences.putString(PrefDataKey_hostIp, hostIp);
-    }
-
     bool Settings::readHostIp(String &hostIp)
     {
         hostIp = preferences.getString(PrefDataKey_hostIp, "192.168.20.50");
         return hostIp != "192.168.20.50";
     }
 
+    bool Settings::readDestinations(String &destinations)
+    {
+        destinations = preferences.getString(PrefDataKey_destinations, "");
+        return destinations.length() > 0;
+    }
+
+    bool Settings::readMulticastGroup(String &group)
+    {
+        group = preferences.getString(PrefDataKey_multicastGroup, "");
+        return group.length() > 0;
+    }
+
 } // prefs
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <Preferences.h>
+#include "BlobStore.h"
+#include "SettingsBlob.h"
 
 namespace prefs
 {
@@ -11,8 +13,15 @@ namespace prefs
     static const char *PrefDataKey_gyroOffsetZ = "gyro_offset_z";
     static const char *PrefDataKey_uniqueId = "unique_id";
     static const char *PrefDataKey_hostIp = "host_ip";
+    static const char *PrefDataKey_destinations = "dest_list";
+    static const char *PrefDataKey_multicastGroup = "mcast_group";
+    static const char *PrefDataKey_settingsBlob = "settings"; // SettingsBlob (上のキーは旧形式)
 
-    class Settings
+    /**
+     * @brief NVSの読み書き．設定は PrefDataKey_settingsBlob に1つのblobとして保存する
+     * @brief フラッシュへの書き込みで止まるため，保存タスク (prefs::SettingsService) からだけ書くこと
+     */
+    class Settings : public BlobStore
     {
     public:
         explicit Settings();
@@ -20,12 +29,14 @@ namespace prefs
         void begin();
         void clear();
         void finish();
-        void writeGyroOffset(const float *gyroOffset);
+        size_t load(uint8_t *out, size_t capacity);
+        bool store(const uint8_t *blob, size_t len);
+        bool readLegacy(SettingsData &outData);
         bool readGyroOffset(float *gyroOffset);
-        void writeUniqueId(const String &uniqueId);
         bool readUniqueId(String &uniqueId);
-        void writeHostIp(const String &hostIp);
         bool readHostIp(String &hostIp);
+        bool readDestinations(String &destinations);
+        bool readMulticastGroup(String &group);
 
     private:
         Preferences preferences;
@@ -0,0 +1,204 @@
+#include <math.h>
+#include <string.h>
+#include "SettingsBlob.h"
+
+namespace prefs
+{
+    static const uint8_t SettingsMagic[4] = {'K', 'B', 'S', 'T'};
+
+    static void PutU16(uint8_t *p, uint16_t v)
+    {
+        p[0] = (uint8_t)v;
+        p[1] = (uint8_t)(v >> 8);
+    }
+
+    static void PutU32(uint8_t *p, uint32_t v)
+    {
+        p[0] = (uint8_t)v;
+        p[1] = (uint8_t)(v >> 8);
+        p[2] = (uint8_t)(v >> 16);
+        p[3] = (uint8_t)(v >> 24);
+    }
+
+    static uint16_t GetU16(const uint8_t *p)
+    {
+        return (uint16_t)(p[0] | (uint16_t)p[1] << 8);
+    }
+
+    static uint32_t GetU32(const uint8_t *p)
+    {
+        return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    }
+
+    /**
+     * @brief 固定小数点にしてint16に詰める．範囲外は飽和させる
+     */
+    static void PutFixed16(uint8_t *&p, float value, float scale)
+    {
+        float scaled = roundf(value * scale);
+        if (!(scaled > -32768.0F)) // NaNも下限にする
+            scaled = -32768.0F;
+        else if (scaled > 32767.0F)
+            scaled = 32767.0F;
+        PutU16(p, (uint16_t)(int16_t)scaled);
+        p += 2;
+    }
+
+    static float GetFixed16(const uint8_t *&p, float scale)
+    {
+        float value = (int16_t)GetU16(p) / scale;
+        p += 2;
+        return value;
+    }
+
+    static void PutText(uint8_t *&p, const char *text, size_t len)
+    {
+        size_t textLen = strnlen(text, len - 1);
+        memcpy(p, text, textLen);
+        memset(p + textLen, 0, len - textLen);
+        p += len;
+    }
+
+    static void GetText(const uint8_t *&p, char *text, size_t len)
+    {
+        memcpy(text, p, len);
+        text[len - 1] = '\0';
+        p += len;
+    }
+
+    SettingsData::SettingsData()
+    {
+        memset(gyroOffset, 0, sizeof(gyroOffset));
+        memset(uniqueId, 0, sizeof(uniqueId));
+        memset(hostIp, 0, sizeof(hostIp));
+        memset(destinations, 0, sizeof(destinations));
+        memset(multicastGroup, 0, sizeof(multicastGroup));
+        memset(&wifi, 0, sizeof(wifi));
+        memset(&tempBias, 0, sizeof(tempBias));
+    }
+
+    /**
+     * @brief CRC-32 (IEEE 802.3, 反転多項式 0xEDB88320)
+     */
+    uint32_t Crc32(const uint8_t *data, size_t len)
+    {
+        uint32_t crc = 0xFFFFFFFFUL;
+        for (size_t i = 0; i < len; i++)
+        {
+            crc ^= data[i];
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc >> 1) ^ (0xEDB88320UL & (0UL - (crc & 1UL)));
+        }
+        return ~crc;
+    }
+
+    static void EncodePayload(const SettingsData &data, uint8_t *p)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            uint32_t bits;
+            memcpy(&bits, &data.gyroOffset[i], sizeof(bits));
+            PutU32(p, bits);
+            p += 4;
+        }
+        PutText(p, data.uniqueId, SettingsUniqueIdLen);
+        PutText(p, data.hostIp, SettingsIpLen);
+        PutText(p, data.destinations, SettingsDestinationsLen);
+        PutText(p, data.multicastGroup, SettingsIpLen);
+        PutText(p, data.wifi.ssid, SettingsSsidLen);
+        PutText(p, data.wifi.psk, SettingsPskLen);
+        memcpy(p, data.wifi.bssid, sizeof(data.wifi.bssid));
+        p += sizeof(data.wifi.bssid);
+        *p++ = data.wifi.channel;
+        PutU32(p, data.wifi.ip);
+        PutU32(p + 4, data.wifi.gateway);
+        PutU32(p + 8, data.wifi.subnet);
+        PutU32(p + 12, data.wifi.dns);
+        p += 16;
+        for (int i = 0; i < SettingsTempBiasBins; i++)
+        {
+            PutFixed16(p, data.tempBias.temp[i], 100.0F);
+            for (int axis = 0; axis < 3; axis++)
+                PutFixed16(p, data.tempBias.bias[i][axis], 1000.0F);
+            *p++ = data.tempBias.weight[i];
+        }
+    }
+
+    /**
+     * @brief 設定をblobにエンコードする
+     *
+     * @param capacity outのバイト数．SettingsBlobLen以上
+     * @return size_t blobのバイト数．0: バッファ不足
+     */
+    size_t EncodeSettings(const SettingsData &data, uint8_t *out, size_t capacity)
+    {
+        if (capacity < SettingsBlobLen)
+            return 0;
+        memcpy(out, SettingsMagic, sizeof(SettingsMagic));
+        PutU16(out + 4, SettingsBlobVersion);
+        PutU16(out + 6, (uint16_t)SettingsPayloadLen);
+        EncodePayload(data, out + SettingsHeaderLen);
+        size_t crcPos = SettingsHeaderLen + SettingsPayloadLen;
+        PutU32(out + crcPos, Crc32(out, crcPos));
+        return SettingsBlobLen;
+    }
+
+    /**
+     * @brief blobから設定を復元する
+     * @brief 古い版のblobはペイロードが短い．足りないフィールドは既定値のままにする
+     *
+     * @return true 正常終了
+     * @return false 異常終了 形式 / 版 / 長さ / CRC のいずれかが不正．outDataは変更しない
+     */
+    bool DecodeSettings(const uint8_t *blob, size_t len, SettingsData &outData)
+    {
+        if (len < SettingsHeaderLen + 4 || memcmp(blob, SettingsMagic, sizeof(SettingsMagic)) != 0)
+            return false;
+        uint16_t version = GetU16(blob + 4);
+        size_t payloadLen = GetU16(blob + 6);
+        if (version == 0 || version > SettingsBlobVersion || payloadLen > SettingsPayloadLen ||
+            len != SettingsHeaderLen + payloadLen + 4)
+            return false;
+        size_t crcPos = SettingsHeaderLen + payloadLen;
+        if (GetU32(blob + crcPos) != Crc32(blob, crcPos))
+            return false;
+
+        // 既定値の上に保存されていた分だけを重ねる
+        SettingsData data;
+        uint8_t payload[SettingsPayloadLen];
+        EncodePayload(data, payload);
+        memcpy(payload, blob + SettingsHeaderLen, payloadLen);
+
+        const uint8_t *p = payload;
+        for (int i = 0; i < 3; i++)
+        {
+            uint32_t bits = GetU32(p);
+            memcpy(&data.gyroOffset[i], &bits, sizeof(bits));
+            p += 4;
+        }
+        GetText(p, data.uniqueId, SettingsUniqueIdLen);
+        GetText(p, data.hostIp, SettingsIpLen);
+        GetText(p, data.destinations, SettingsDestinationsLen);
+        GetText(p, data.multicastGroup, SettingsIpLen);
+        GetText(p, data.wifi.ssid, SettingsSsidLen);
+        GetText(p, data.wifi.psk, SettingsPskLen);
+        memcpy(data.wifi.bssid, p, sizeof(data.wifi.bssid));
+        p += sizeof(data.wifi.bssid);
+        data.wifi.channel = *p++;
+        data.wifi.ip = GetU32(p);
+        data.wifi.gateway = GetU32(p + 4);
+        data.wifi.subnet = GetU32(p + 8);
+        data.wifi.dns = GetU32(p + 12);
+        p += 16;
+        for (int i = 0; i < SettingsTempBiasBins; i++)
+        {
+            data.tempBias.temp[i] = GetFixed16(p, 100.0F);
+            for (int axis = 0; axis < 3; axis++)
+                data.tempBias.bias[i][axis] = GetFixed16(p, 1000.0F);
+            data.tempBias.weight[i] = *p++;
+        }
+        outData = data;
+        return true;
+    }
+
+} // prefs
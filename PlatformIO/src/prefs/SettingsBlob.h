@@ -0,0 +1,70 @@
+#pragma once
+#include <inttypes.h>
+#include <stddef.h>
+
+namespace prefs
+{
+
+    static const uint16_t SettingsBlobVersion = 3; // 2: WiFiCache, 3: TempBiasTable を追加
+    static const size_t SettingsUniqueIdLen = 32;
+    static const size_t SettingsIpLen = 16;           // "255.255.255.255" + '\0'
+    static const size_t SettingsDestinationsLen = 96; // カンマ区切りのIPアドレス
+    static const size_t SettingsSsidLen = 33;
+    static const size_t SettingsPskLen = 65;
+    static const int SettingsTempBiasBins = 16; // imu::bias::TempBiasBinNum と同じ
+
+    /**
+     * @brief 前回つながったアクセスポイントとIPアドレス．起動時にスキャンとDHCPを省くために使う
+     * @brief IPアドレスは IPAddress の uint32_t 表現．ssidが空なら無効
+     */
+    struct WiFiCache
+    {
+        char ssid[SettingsSsidLen];
+        char psk[SettingsPskLen];
+        uint8_t bssid[6];
+        uint8_t channel;
+        uint32_t ip;
+        uint32_t gateway;
+        uint32_t subnet;
+        uint32_t dns;
+    };
+
+    /**
+     * @brief 温度区間毎のジャイロのオフセット (imu::bias::TempBiasModel の区間)
+     * @brief blobには温度を0.01℃，オフセットを0.001deg/s単位のint16に詰める
+     */
+    struct TempBiasTable
+    {
+        float temp[SettingsTempBiasBins];     // [℃]
+        float bias[SettingsTempBiasBins][3];  // [deg/s]
+        uint8_t weight[SettingsTempBiasBins]; // 0: 観測なし
+    };
+
+    /**
+     * @brief NVSに1つのblobとして保存する設定の全体
+     * @brief 文字列は '\0' 終端．空文字列は未設定を表す
+     */
+    struct SettingsData
+    {
+        float gyroOffset[3];
+        char uniqueId[SettingsUniqueIdLen];
+        char hostIp[SettingsIpLen];
+        char destinations[SettingsDestinationsLen];
+        char multicastGroup[SettingsIpLen];
+        WiFiCache wifi;         // version 2
+        TempBiasTable tempBias; // version 3
+        SettingsData();
+    };
+
+    // magic(4) version(2) payloadLen(2) payload crc32(4)．値はリトルエンディアン
+    static const size_t SettingsHeaderLen = 8;
+    static const size_t SettingsPayloadLenV1 = 3 * 4 + SettingsUniqueIdLen + SettingsIpLen + SettingsDestinationsLen + SettingsIpLen;
+    static const size_t SettingsPayloadLenV2 = SettingsPayloadLenV1 + SettingsSsidLen + SettingsPskLen + 6 + 1 + 4 * 4;
+    static const size_t SettingsPayloadLen = SettingsPayloadLenV2 + SettingsTempBiasBins * (2 + 3 * 2 + 1);
+    static const size_t SettingsBlobLen = SettingsHeaderLen + SettingsPayloadLen + 4;
+
+    size_t EncodeSettings(const SettingsData &data, uint8_t *out, size_t capacity);
+    bool DecodeSettings(const uint8_t *blob, size_t len, SettingsData &outData);
+    uint32_t Crc32(const uint8_t *data, size_t len);
+
+} // prefs
@@ -0,0 +1,213 @@
+#include <string.h>
+#include "SettingsService.h"
+
+namespace prefs
+{
+
+    /**
+     * @brief カンマ区切りの一覧を size に収まるだけ写す．収まらないときは最後に収まったカンマの手前で切り，
+     * @brief 途中で切れた項目 (不完全なIPアドレス) を残さない
+     */
+    static void CopyList(char *dst, size_t size, const char *src)
+    {
+        size_t len = strlen(src);
+        if (len >= size)
+        {
+            len = 0;
+            for (size_t i = 0; i < size; i++)
+            {
+                if (src[i] == ',')
+                    len = i;
+            }
+        }
+        memcpy(dst, src, len);
+        dst[len] = '\0';
+    }
+
+    SettingsChange SettingsChange::GyroOffset(const float *offset)
+    {
+        SettingsChange change;
+        memset(&change, 0, sizeof(change));
+        change.field = FieldGyroOffset;
+        for (int i = 0; i < 3; i++)
+            change.gyroOffset[i] = offset[i];
+        return change;
+    }
+
+    SettingsChange SettingsChange::Text(SettingsField field, const char *text)
+    {
+        SettingsChange change;
+        memset(&change, 0, sizeof(change));
+        change.field = (uint8_t)field;
+        if (field == FieldDestinations)
+            CopyList(change.text, sizeof(change.text), text);
+        else
+            strncpy(change.text, text, sizeof(change.text) - 1);
+        return change;
+    }
+
+    SettingsChange SettingsChange::WiFi(const WiFiCache &cache)
+    {
+        SettingsChange change;
+        memset(&change, 0, sizeof(change));
+        change.field = FieldWiFiCache;
+        change.wifi = cache;
+        return change;
+    }
+
+    SettingsChange SettingsChange::TempBias(const TempBiasTable &table)
+    {
+        SettingsChange change;
+        memset(&change, 0, sizeof(change));
+        change.field = FieldTempBias;
+        change.tempBias = table;
+        return change;
+    }
+
+    SettingsService::SettingsService(BlobStore &store)
+        : store(store), current(), dirty(false), firstChangeMicros(0), lastChangeMicros(0),
+          storedCrc(0), commitCount(0), failureCount(0)
+    {
+    }
+
+    /**
+     * @brief 保存先からblobを1回で読み出す．起動時に1度だけ呼ぶ
+     *
+     * @param outData 読み出した設定．失敗したときは既定値
+     * @return true 正常終了
+     * @return false 異常終了 保存されていないか，blobが壊れている
+     */
+    bool SettingsService::load(SettingsData &outData)
+    {
+        uint8_t blob[SettingsBlobLen];
+        size_t len = store.load(blob, sizeof(blob));
+        SettingsData data;
+        bool ok = len > 0 && DecodeSettings(blob, len, data);
+        current = data;
+        dirty = false;
+        storedCrc = ok ? Crc32(blob, len - 4) : 0;
+        outData = current;
+        return ok;
+    }
+
+    /**
+     * @brief 設定全体を置き換える (旧形式からの移行など)
+     */
+    void SettingsService::replace(const SettingsData &data, uint32_t nowMicros)
+    {
+        current = data;
+        markDirty(nowMicros);
+    }
+
+    void SettingsService::apply(const SettingsChange &change, uint32_t nowMicros)
+    {
+        switch (change.field)
+        {
+        case FieldGyroOffset:
+            for (int i = 0; i < 3; i++)
+                current.gyroOffset[i] = change.gyroOffset[i];
+            break;
+        case FieldUniqueId:
+            strncpy(current.uniqueId, change.text, sizeof(current.uniqueId) - 1);
+            current.uniqueId[sizeof(current.uniqueId) - 1] = '\0';
+            break;
+        case FieldHostIp:
+            strncpy(current.hostIp, change.text, sizeof(current.hostIp) - 1);
+            current.hostIp[sizeof(current.hostIp) - 1] = '\0';
+            break;
+        case FieldDestinations:
+            CopyList(current.destinations, sizeof(current.destinations), change.text);
+            break;
+        case FieldMulticastGroup:
+            strncpy(current.multicastGroup, change.text, sizeof(current.multicastGroup) - 1);
+            current.multicastGroup[sizeof(current.multicastGroup) - 1] = '\0';
+            break;
+        case FieldWiFiCache:
+            current.wifi = change.wifi;
+            break;
+        case FieldTempBias:
+            current.tempBias = change.tempBias;
+            break;
+        default:
+            return;
+        }
+        markDirty(nowMicros);
+    }
+
+    void SettingsService::markDirty(uint32_t nowMicros)
+    {
+        if (!dirty)
+            firstChangeMicros = nowMicros;
+        lastChangeMicros = nowMicros;
+        dirty = true;
+    }
+
+    /**
+     * @brief 次に poll() で書き込むまでの時間[us]．保存タスクのキュー待ちの時間に使う
+     *
+     * @return uint32_t UINT32_MAX: 書くものがない
+     */
+    uint32_t SettingsService::dueInMicros(uint32_t nowMicros) const
+    {
+        if (!dirty)
+            return UINT32_MAX;
+        uint32_t sinceLast = nowMicros - lastChangeMicros;
+        uint32_t sinceFirst = nowMicros - firstChangeMicros;
+        if (sinceLast >= SettingsQuietMicros || sinceFirst >= SettingsMaxDelayMicros)
+            return 0;
+        uint32_t quiet = SettingsQuietMicros - sinceLast;
+        uint32_t max = SettingsMaxDelayMicros - sinceFirst;
+        return (quiet < max) ? quiet : max;
+    }
+
+    /**
+     * @brief 変更が落ち着いていれば書き込む
+     *
+     * @return true 書き込んだ
+     * @return false 書くものがないか，まだ待つ
+     */
+    bool SettingsService::poll(uint32_t nowMicros)
+    {
+        if (dueInMicros(nowMicros) != 0)
+            return false;
+        if (flush())
+            return true;
+        if (dirty)
+        {
+            // 書き込みに失敗した．静かな時間をもう一度待ってから再試行する
+            firstChangeMicros = nowMicros;
+            lastChangeMicros = nowMicros;
+        }
+        return false;
+    }
+
+    /**
+     * @brief 待たずに書き込む．内容が最後に書いたものと同じなら書かない
+     *
+     * @return true 書き込んだ
+     * @return false 書く必要がないか，書き込みに失敗した (次の poll() で再試行する)
+     */
+    bool SettingsService::flush()
+    {
+        if (!dirty)
+            return false;
+        uint8_t blob[SettingsBlobLen];
+        size_t len = EncodeSettings(current, blob, sizeof(blob));
+        uint32_t crc = Crc32(blob, len - 4);
+        if (crc == storedCrc)
+        {
+            dirty = false;
+            return false;
+        }
+        if (!store.store(blob, len))
+        {
+            failureCount++;
+            return false;
+        }
+        storedCrc = crc;
+        dirty = false;
+        commitCount++;
+        return true;
+    }
+
+} // prefs
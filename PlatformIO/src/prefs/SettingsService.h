@@ -0,0 +1,76 @@
+#pragma once
+#include <inttypes.h>
+#include "BlobStore.h"
+#include "SettingsBlob.h"
+
+namespace prefs
+{
+
+    static const uint32_t SettingsQuietMicros = 500000;     // 最後の変更からこれだけ経ったら書く
+    static const uint32_t SettingsMaxDelayMicros = 5000000; // 変更が続いてもこれ以上は待たない
+
+    enum SettingsField
+    {
+        FieldGyroOffset,
+        FieldUniqueId,
+        FieldHostIp,
+        FieldDestinations,
+        FieldMulticastGroup,
+        FieldWiFiCache,
+        FieldTempBias,
+        SettingsFieldNum, // フィールドの数
+    };
+
+    /**
+     * @brief 1つの設定の変更．キューで保存タスクへ渡すため固定長にする
+     * @brief field で使う値が決まるため，値は共用体に重ねてキューの要素を小さくする
+     */
+    struct SettingsChange
+    {
+        uint8_t field; // SettingsField
+        union
+        {
+            float gyroOffset[3];
+            char text[SettingsDestinationsLen];
+            WiFiCache wifi;
+            TempBiasTable tempBias;
+        };
+
+        static SettingsChange GyroOffset(const float *offset);
+        static SettingsChange Text(SettingsField field, const char *text);
+        static SettingsChange WiFi(const WiFiCache &cache);
+        static SettingsChange TempBias(const TempBiasTable &table);
+    };
+
+    /**
+     * @brief 設定の変更をまとめ，変更が落ち着いてから1つのblobとして書き込む
+     * @brief 呼び出しは1つのタスク (保存タスク) からだけ行う
+     */
+    class SettingsService
+    {
+    public:
+        explicit SettingsService(BlobStore &store);
+        bool load(SettingsData &outData);
+        void replace(const SettingsData &data, uint32_t nowMicros);
+        void apply(const SettingsChange &change, uint32_t nowMicros);
+        bool poll(uint32_t nowMicros);
+        bool flush();
+        uint32_t dueInMicros(uint32_t nowMicros) const;
+        bool isDirty() const { return dirty; }
+        uint32_t commits() const { return commitCount; }
+        uint32_t failures() const { return failureCount; }
+        const SettingsData &data() const { return current; }
+
+    private:
+        BlobStore &store;
+        SettingsData current;
+        bool dirty;
+        uint32_t firstChangeMicros; // 書き込んでから最初の変更
+        uint32_t lastChangeMicros;
+        uint32_t storedCrc; // 最後に書いた (読んだ) blobのCRC．同じ内容なら書かない
+        uint32_t commitCount;
+        uint32_t failureCount;
+        void markDirty(uint32_t nowMicros);
+    };
+
+} // prefs
@@ -0,0 +1,59 @@
+#pragma once
+#include <inttypes.h>
+
+namespace stats
+{
+
+    /**
+     * @brief 起動からの節目．時刻は micros() (リセットからの経過時間[us])
+     */
+    enum BootMark
+    {
+        BootSetup = 0,          // setup() の開始
+        BootSettingsLoaded = 1, // 設定のblobを読み終えた
+        BootWiFiStart = 2,      // 最初の WiFi.begin()
+        BootWiFiAssociated = 3, // アクセスポイントにつながった
+        BootWiFiGotIp = 4,      // IPアドレスが決まった
+        BootTasksStarted = 5,   // 全タスクを生成した
+        BootFirstPacket = 6,    // 最初のパケットを送った
+    };
+    static const int BootMarkNum = 7;
+
+    /**
+     * @brief WiFiにつながった経路
+     */
+    enum BootPath
+    {
+        BootPathNone = 0,
+        BootPathFast = 1,        // 前回のBSSID / チャネル / IPアドレスで直接つないだ
+        BootPathSaved = 2,       // 保存されたネットワークにスキャンからつないだ
+        BootPathFixed = 3,       // 組み込みのSSIDにつないだ
+        BootPathSmartConfig = 4, // SmartConfigで設定した
+    };
+
+    /**
+     * @brief 起動にかかった時間の内訳．節目毎に最初の1回だけを記録する
+     */
+    class BootProfile
+    {
+    public:
+        explicit BootProfile() : path(BootPathNone)
+        {
+            for (int i = 0; i < BootMarkNum; i++)
+                marks[i] = 0;
+        }
+        void mark(BootMark m, uint32_t nowMicros)
+        {
+            if (marks[m] == 0)
+                marks[m] = (nowMicros != 0) ? nowMicros : 1;
+        }
+        uint32_t at(BootMark m) const { return marks[m]; } // 0: まだ
+        void setPath(BootPath p) { path = p; }
+        BootPath wifiPath() const { return (BootPath)path; }
+
+    private:
+        volatile uint32_t marks[BootMarkNum];
+        volatile uint8_t path;
+    };
+
+} // stats
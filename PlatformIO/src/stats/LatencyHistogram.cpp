@@ -0,0 +1,78 @@
+#include <string.h>
+#include "LatencyHistogram.h"
+
+namespace stats
+{
+    static const int SubCount = 1 << HistogramSubBits;
+
+    LatencyHistogram::LatencyHistogram()
+    {
+        reset();
+    }
+
+    void LatencyHistogram::record(uint32_t value)
+    {
+        buckets[BucketOf(value)]++;
+        total++;
+        if (value > maxValue)
+            maxValue = value;
+    }
+
+    void LatencyHistogram::reset()
+    {
+        memset(buckets, 0, sizeof(buckets));
+        total = 0;
+        maxValue = 0;
+    }
+
+    /**
+     * @brief 分位点を求める
+     *
+     * @param q 0.0 - 1.0 (0.5: 中央値, 0.99: p99)
+     * @return uint32_t 分位点を含む区間の上限 (最大値を超えない)．記録がなければ0
+     */
+    uint32_t LatencyHistogram::percentile(float q) const
+    {
+        if (total == 0)
+            return 0;
+        uint32_t rank = (uint32_t)(q * total + 0.5F);
+        if (rank < 1)
+            rank = 1;
+        if (rank > total)
+            rank = total;
+        uint32_t seen = 0;
+        for (int i = 0; i < HistogramBuckets; i++)
+        {
+            seen += buckets[i];
+            if (seen >= rank)
+            {
+                uint32_t upper = BucketUpperBound(i);
+                return (upper < maxValue) ? upper : maxValue;
+            }
+        }
+        return maxValue;
+    }
+
+    /**
+     * @brief 値の入る区間．SubCount未満は値そのもの，それ以上は上位 HistogramSubBits+1 bit で決める
+     */
+    int LatencyHistogram::BucketOf(uint32_t value)
+    {
+        if (value < (uint32_t)SubCount)
+            return (int)value;
+        int octave = 31 - __builtin_clz(value); // >= HistogramSubBits
+        int sub = (int)(value >> (octave - HistogramSubBits)) & (SubCount - 1);
+        return (octave - HistogramSubBits + 1) * SubCount + sub;
+    }
+
+    uint32_t LatencyHistogram::BucketUpperBound(int bucket)
+    {
+        if (bucket < SubCount)
+            return (uint32_t)bucket;
+        int octave = bucket / SubCount + HistogramSubBits - 1;
+        int sub = bucket % SubCount;
+        uint64_t upper = ((uint64_t)(SubCount + sub + 1) << (octave - HistogramSubBits)) - 1;
+        return (uint32_t)upper;
+    }
+
+} // stats
@@ -0,0 +1,34 @@
+#pragma once
+#include <inttypes.h>
+
+namespace stats
+{
+
+    static const int HistogramSubBits = 2;                                  // 1オクターブを4区間に分ける
+    static const int HistogramBuckets = (32 - 1) * (1 << HistogramSubBits); // 0..2^32-1 を覆う区間数
+
+    /**
+     * @brief 区間が対数で固定されたヒストグラム．値の単位は呼び出し側で決める (CPUサイクル数など)
+     * @brief 相対誤差は最大で25%．記録はO(1)でヒープを使わない
+     * @brief 1つのタスクから記録し，ほかのタスクから読み出してもよい (読み出し値が数件ずれることはある)
+     */
+    class LatencyHistogram
+    {
+    public:
+        explicit LatencyHistogram();
+        void record(uint32_t value);
+        void reset();
+        uint32_t count() const { return total; }
+        uint32_t max() const { return maxValue; }
+        uint32_t percentile(float q) const;
+
+        static int BucketOf(uint32_t value);
+        static uint32_t BucketUpperBound(int bucket);
+
+    private:
+        uint32_t buckets[HistogramBuckets];
+        uint32_t total;
+        uint32_t maxValue;
+    };
+
+} // stats
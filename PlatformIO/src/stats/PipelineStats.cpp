@@ -0,0 +1,42 @@
+#include "PipelineStats.h"
+
+namespace stats
+{
+
+    void PipelineStats::reset()
+    {
+        for (int i = 0; i < StageNum; i++)
+            histograms[i].reset();
+    }
+
+    /**
+     * @brief OSCで返すときの区間名
+     */
+    const char *PipelineStats::StageName(Stage stage)
+    {
+        switch (stage)
+        {
+        case StageImuRead:
+            return "read";
+        case StageFusion:
+            return "fusion";
+        case StageProcess:
+            return "process";
+        case StageHandoff:
+            return "handoff";
+        case StageSampleAge:
+            return "age";
+        case StageEncode:
+            return "encode";
+        case StageSend:
+            return "send";
+        case StageCommand:
+            return "command";
+        case StageApply:
+            return "apply";
+        default:
+            return "unknown";
+        }
+    }
+
+} // stats
@@ -0,0 +1,53 @@
+#pragma once
+#include <inttypes.h>
+#include "LatencyHistogram.h"
+
+namespace stats
+{
+
+    /**
+     * @brief センサの読み出しからパケット送出までの計測区間
+     */
+    enum Stage
+    {
+        StageImuRead = 0,   // I2C / FIFO の読み出し (ImuReader)
+        StageFusion = 1,    // 1サンプルの姿勢推定 (ImuReader)
+        StageProcess = 2,   // 1サンプルの後段処理 (ねじれ角 / バッファ / 校正)
+        StageHandoff = 3,   // 送信タスクでのスナップショットの読み出し (SeqLockの再試行を含む)
+        StageSampleAge = 4, // サンプル時刻から送信タスクが取り出すまで
+        StageEncode = 5,    // OSC / バイナリフレームへのエンコード
+        StageSend = 6,      // UDPの送出 (WiFiスタック)
+        StageCommand = 7,   // コマンドパケットの受信からハンドラ終了まで (受信タスク)
+        StageApply = 8,     // コマンド受信から ImuLoop が要求を反映するまで
+    };
+    static const int StageNum = 9;
+
+    /**
+     * @brief 区間毎のヒストグラム．値はCPUサイクル数で記録し，読み出すときにusへ直す
+     * @brief ESP32のサイクルカウンタはコア毎なので，区間の始点と終点は同じタスクで計ること
+     */
+    class PipelineStats
+    {
+    public:
+        explicit PipelineStats() : enabled(true) {}
+        void record(Stage stage, uint32_t cycles)
+        {
+            if (enabled)
+                histograms[stage].record(cycles);
+        }
+        void recordMicros(Stage stage, uint32_t micros, uint32_t cpuMhz)
+        {
+            record(stage, (micros < UINT32_MAX / cpuMhz) ? micros * cpuMhz : UINT32_MAX);
+        }
+        void reset();
+        void setEnabled(bool enable) { enabled = enable; }
+        const LatencyHistogram &histogram(Stage stage) const { return histograms[stage]; }
+
+        static const char *StageName(Stage stage);
+
+    private:
+        LatencyHistogram histograms[StageNum];
+        volatile bool enabled;
+    };
+
+} // stats
@@ -0,0 +1,83 @@
+#include "TaskProfiler.h"
+
+namespace stats
+{
+
+    /**
+     * @param name 報告に使うタスク名
+     * @param periodMicros 公称の起床周期[us]．0ならば揺らぎと周期超過は数えない
+     */
+    TaskProfiler::TaskProfiler(const char *name, uint32_t periodMicros)
+        : taskName(name), period(periodMicros), busyMicros(0), windowMisses(0), windowLoops(0), windowStart(0)
+    {
+        reset();
+    }
+
+    void TaskProfiler::reset()
+    {
+        jitterMicros.reset();
+        misses = 0;
+        loopCount = 0;
+        started = false;
+        lastBegin = 0;
+        busyMicros.store(0);
+        windowMisses.store(0);
+        windowLoops.store(0);
+        windowStart.store(0);
+    }
+
+    /**
+     * @brief ループの先頭で呼ぶ．前回の先頭からの間隔と公称周期の差を記録する
+     * @brief 間隔が公称周期の1.5倍を超えたら周期超過として数える
+     */
+    void TaskProfiler::begin(uint32_t nowMicros)
+    {
+        if (started && period > 0)
+        {
+            uint32_t actual = nowMicros - lastBegin;
+            uint32_t diff = (actual > period) ? actual - period : period - actual;
+            jitterMicros.record(diff);
+            if (actual > period + period / 2)
+            {
+                misses++;
+                windowMisses.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        if (!started)
+            windowStart.store(nowMicros, std::memory_order_relaxed);
+        started = true;
+        lastBegin = nowMicros;
+        loopCount++;
+        windowLoops.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 待機の直前で呼ぶ．begin()からの処理時間をCPU使用率の計算に加える
+     */
+    void TaskProfiler::end(uint32_t nowMicros)
+    {
+        if (started)
+            busyMicros.fetch_add(nowMicros - lastBegin, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 前回の呼び出しからのCPU使用率と周期超過の割合を求め，計測窓を始め直す
+     * @brief 計測するタスクとは別のタスク (送信タスク) から呼ぶ．両方とも同じ窓の値になる
+     *
+     * @param nowMicros 現在の micros()
+     * @return TaskWindow 前回の呼び出しから今回までの値
+     */
+    TaskWindow TaskProfiler::takeWindow(uint32_t nowMicros)
+    {
+        TaskWindow window;
+        uint32_t elapsed = nowMicros - windowStart.exchange(nowMicros, std::memory_order_relaxed);
+        uint32_t busy = busyMicros.exchange(0, std::memory_order_relaxed);
+        window.loops = windowLoops.exchange(0, std::memory_order_relaxed);
+        window.misses = windowMisses.exchange(0, std::memory_order_relaxed);
+        float share = (elapsed > 0) ? (float)busy / elapsed : 0.0F;
+        window.cpuShare = (share < 1.0F) ? share : 1.0F;
+        window.missRate = (window.loops > 0) ? (float)window.misses / window.loops : 0.0F;
+        return window;
+    }
+
+} // stats
@@ -0,0 +1,54 @@
+#pragma once
+#include <inttypes.h>
+#include <atomic>
+#include "LatencyHistogram.h"
+
+namespace stats
+{
+
+    /**
+     * @brief takeWindow() で読み出した，前回の呼び出しからの計測窓の値
+     */
+    struct TaskWindow
+    {
+        float cpuShare; // 0.0 - 1.0
+        float missRate; // 0.0 - 1.0 (周期超過の回数 / ループの回数)
+        uint32_t loops;
+        uint32_t misses;
+    };
+
+    /**
+     * @brief 周期タスクの起床間隔の揺らぎ，周期超過回数，CPU使用率を計測する
+     * @brief ループの先頭で begin()，待機の直前で end() を呼ぶ．ほかのタスクから読み出してもよい
+     * @brief 計測窓の値は計測するタスクが加え，読み出すタスクが exchange(0) で取り出すため，窓の境目で取りこぼさない
+     */
+    class TaskProfiler
+    {
+    public:
+        TaskProfiler(const char *name, uint32_t periodMicros); // std::atomic を持ちコピーできないため，配列は {name, period} で初期化する
+        void setPeriod(uint32_t periodMicros) { period = periodMicros; }
+        void begin(uint32_t nowMicros);
+        void end(uint32_t nowMicros);
+        TaskWindow takeWindow(uint32_t nowMicros);
+        void reset();
+        const char *name() const { return taskName; }
+        uint32_t periodMicros() const { return period; }
+        uint32_t deadlineMisses() const { return misses; }
+        uint32_t loops() const { return loopCount; }
+        const LatencyHistogram &jitter() const { return jitterMicros; }
+
+    private:
+        const char *taskName;
+        volatile uint32_t period; // 0: 周期を持たない (イベント駆動)
+        LatencyHistogram jitterMicros;
+        uint32_t misses;    // 起動からの合計
+        uint32_t loopCount; // 起動からの合計
+        bool started;
+        uint32_t lastBegin;
+        std::atomic<uint32_t> busyMicros;   // 今回の計測窓でbegin()からend()までに費やした時間の合計
+        std::atomic<uint32_t> windowMisses; // 今回の計測窓での周期超過
+        std::atomic<uint32_t> windowLoops;  // 今回の計測窓でのループ
+        std::atomic<uint32_t> windowStart;
+    };
+
+} // stats